@@ -20,6 +20,7 @@
 #include "G4SystemOfUnits.hh"
 #include <iostream>
 #include <string>
+#include <vector>
 #include <sstream>
 #include <thread>
 
@@ -46,7 +47,26 @@ void PrintUsage() {
     G4cout << "  -nudex [Z A|ZA]     : NuDEX thermal capture cascades" << G4endl;
     G4cout << "                        Z,A integers (e.g., 24 53 for Cr-53) or ZA=1000*Z+A" << G4endl;
     G4cout << "                        Default if omitted: 17 35 (Cl-35)" << G4endl;
+    G4cout << "  -nudex-mix ZA1:w1,ZA2:w2,..." << G4endl;
+    G4cout << "                      : NuDEX thermal capture cascades in a mixture of isotopes, sampled per event" << G4endl;
+    G4cout << "                        with weights w (abundance x capture cross section), e.g. 17035:33.2,17037:0.11" << G4endl;
+    G4cout << "  -nudex-spectrum <file>" << G4endl;
+    G4cout << "                      : NuDEX capture cascades with the neutron energy sampled from a histogram" << G4endl;
+    G4cout << "                        (lines 'Emin Emax content', MeV) for the isotopes of -nudex or -nudex-mix" << G4endl;
+    G4cout << "  -nudex-ensemble <K> [block]" << G4endl;
+    G4cout << "                      : K realizations of the NuDEX level scheme (K > 1), one per event or per block" << G4endl;
+    G4cout << "                        of consecutive events; the realization is saved in the ntuple (default block: 1)" << G4endl;
+    G4cout << "  -nudex-precompute-br [N]" << G4endl;
+    G4cout << "                      : Compute all the NuDEX branching ratios at initialization with N threads" << G4endl;
+    G4cout << "                        (at most those of -threads, default: all of them) instead of when needed" << G4endl;
     G4cout << "  -nudex-libdir <path>: Override NuDEX library directory (default: ../NuDEX/NuDEXlib/)" << G4endl;
+    G4cout << "  -nudex-producers <N> [seed]" << G4endl;
+    G4cout << "                      : Generate the NuDEX cascades ahead of demand in N background threads" << G4endl;
+    G4cout << "                        (the event k always gets the cascade k of the seed; default seed: 1234567)" << G4endl;
+    G4cout << "  -nudex-library <file> [random|sequential]" << G4endl;
+    G4cout << "                      : Replay NuDEX cascades from a cascade library file" << G4endl;
+    G4cout << "                        (made with NuDEX_NCaptureCascadeGenerator01 ... CASCADELIBRARY <file>)" << G4endl;
+    G4cout << "                        Default access: random" << G4endl;
     // -cascade mode removed
     // RAINIER file mode removed
     G4cout << "  -threads <N>        : Number of threads for parallel execution (default: 1)" << G4endl;
@@ -77,6 +97,16 @@ int main(int argc, char** argv)
     // NuDEX configuration
     int nudexZA = 17035; // Default: Cl-35 target
     std::string nudexLibDir = "../NuDEX/NuDEXlib/";
+    std::string nudexLibraryFile = "";
+    bool nudexLibrarySequential = false;
+    int nudexProducerThreads = 0;        // > 0: pipelined NuDEX mode
+    unsigned int nudexProducerSeed = 1234567;
+    std::vector<int> nudexMixZA;          // not empty: mixture of isotopes instead of nudexZA
+    std::vector<double> nudexMixWeights;
+    std::string nudexSpectrumFile = "";
+    int nudexEnsembleSize = 1;            // > 1: ensemble of NuDEX level scheme realizations
+    long long nudexEnsembleBlock = 1;
+    int nudexPrecomputeBRThreads = 0;     // > 0: all the NuDEX BR computed at initialization (-1: all the run threads)
 
     // -cascade parameters removed
 
@@ -113,8 +143,117 @@ int main(int argc, char** argv)
                 return 1;
             }
         }
+        else if (arg == "-nudex-producers") {
+            std::stringstream ss(i + 1 < argc ? argv[i + 1] : "");
+            if (!(ss >> nudexProducerThreads) || nudexProducerThreads < 1) {
+                if (!quietMode) {
+                    G4cout << "Error: -nudex-producers requires a number of threads > 0" << G4endl;
+                }
+                return 1;
+            }
+            i++;
+            if (i + 1 < argc) {
+                std::stringstream ssSeed(argv[i + 1]);
+                unsigned int seed = 0;
+                if ((ssSeed >> seed) && ssSeed.eof() && seed > 0) {
+                    nudexProducerSeed = seed;
+                    i++;
+                }
+            }
+        }
+        else if (arg == "-nudex-ensemble") {
+            std::stringstream ss(i + 1 < argc ? argv[i + 1] : "");
+            if (!(ss >> nudexEnsembleSize) || nudexEnsembleSize < 2) {
+                if (!quietMode) {
+                    G4cout << "Error: -nudex-ensemble requires a number of realizations > 1" << G4endl;
+                }
+                return 1;
+            }
+            i++;
+            if (i + 1 < argc) {
+                std::stringstream ssBlock(argv[i + 1]);
+                long long block = 0;
+                if ((ssBlock >> block) && ssBlock.eof() && block > 0) {
+                    nudexEnsembleBlock = block;
+                    i++;
+                }
+            }
+        }
+        else if (arg == "-nudex-precompute-br") {
+            nudexPrecomputeBRThreads = -1;
+            if (i + 1 < argc) {
+                std::stringstream ss(argv[i + 1]);
+                int n = 0;
+                if ((ss >> n) && ss.eof() && n > 0) {
+                    nudexPrecomputeBRThreads = n;
+                    i++;
+                }
+            }
+        }
+        else if (arg == "-nudex-mix") {
+            // ZA1:w1,ZA2:w2,...
+            nudexMixZA.clear();
+            nudexMixWeights.clear();
+            std::stringstream ss(i + 1 < argc ? argv[i + 1] : "");
+            std::string item;
+            while (std::getline(ss, item, ',')) {
+                std::stringstream ssItem(item);
+                int za = -1;
+                double w = -1;
+                char sep = 0;
+                if (!(ssItem >> za >> sep >> w) || sep != ':' || za <= 0 || w < 0) {
+                    nudexMixZA.clear();
+                    break;
+                }
+                nudexMixZA.push_back(za);
+                nudexMixWeights.push_back(w);
+            }
+            if (nudexMixZA.empty()) {
+                if (!quietMode) {
+                    G4cout << "Error: -nudex-mix requires a list ZA1:w1,ZA2:w2,... with weights >= 0" << G4endl;
+                }
+                return 1;
+            }
+            if (sourceMode != NUDEX_SPECTRUM) {
+                sourceMode = NUDEX_CAPTURE;
+            }
+            i++;
+        }
+        else if (arg == "-nudex-spectrum") {
+            if (i + 1 < argc) {
+                sourceMode = NUDEX_SPECTRUM;
+                nudexSpectrumFile = argv[i + 1];
+                i++;
+            } else {
+                if (!quietMode) {
+                    G4cout << "Error: -nudex-spectrum requires a file argument" << G4endl;
+                }
+                return 1;
+            }
+        }
+        else if (arg == "-nudex-library") {
+            if (i + 1 < argc) {
+                sourceMode = NUDEX_LIBRARY;
+                nudexLibraryFile = argv[i + 1];
+                i++;
+                if (i + 1 < argc) {
+                    std::string access = argv[i + 1];
+                    if (access == "sequential" || access == "random") {
+                        nudexLibrarySequential = (access == "sequential");
+                        i++;
+                    }
+                }
+            } else {
+                if (!quietMode) {
+                    G4cout << "Error: -nudex-library requires a file argument" << G4endl;
+                }
+                return 1;
+            }
+        }
         else if (arg == "-nudex") {
-            sourceMode = NUDEX_CAPTURE;
+            if (sourceMode != NUDEX_SPECTRUM) {
+                sourceMode = NUDEX_CAPTURE;
+            }
             // Optional Z A or ZA argument
             auto parseInt = [](const std::string& s, int& out) -> bool {
                 if (s.empty()) return false;
@@ -186,12 +325,9 @@ int main(int argc, char** argv)
     // Set the global quiet mode flag
     g_quietMode = quietMode;
 
-    // NuDEX currently runs safest in single-threaded mode
-    if (sourceMode == NUDEX_CAPTURE && nThreads > 1) {
-        if (!quietMode) {
-            G4cout << "NuDEX mode selected: forcing single-thread execution for stability." << G4endl;
-        }
-        nThreads = 1;
+    // The NuDEX BR are precomputed with the threads of the run, not more
+    if (nudexPrecomputeBRThreads < 0 || nudexPrecomputeBRThreads > nThreads) {
+        nudexPrecomputeBRThreads = nThreads;
     }
 
     // Print startup info only if not in quiet mode
@@ -208,10 +344,36 @@ int main(int argc, char** argv)
             modeStr = "Co-60 Cascade (2 gammas/event)";
         } else if (sourceMode == SINGLE_GAMMA) {
             modeStr = "Single gamma (1 gamma/event)";
+        } else if (sourceMode == NUDEX_LIBRARY) {
+            modeStr = "NuDEX cascade library (" + std::string(nudexLibrarySequential ? "sequential" : "random") + " access)";
+            G4cout << "  NuDEX cascade library: " << nudexLibraryFile << G4endl;
         } else {
-            int zDisp = nudexZA / 1000; int aDisp = nudexZA % 1000;
-            modeStr = "NuDEX thermal capture (Z=" + std::to_string(zDisp) + ", A=" + std::to_string(aDisp) + ")";
+            std::string captureStr = (sourceMode == NUDEX_SPECTRUM) ? "NuDEX capture" : "NuDEX thermal capture";
+            if (nudexMixZA.empty()) {
+                int zDisp = nudexZA / 1000; int aDisp = nudexZA % 1000;
+                modeStr = captureStr + " (Z=" + std::to_string(zDisp) + ", A=" + std::to_string(aDisp) + ")";
+            } else {
+                modeStr = captureStr + " (" + std::to_string(nudexMixZA.size()) + " isotopes)";
+                for (size_t k = 0; k < nudexMixZA.size(); ++k) {
+                    G4cout << "  NuDEX isotope: ZA=" << nudexMixZA[k] << ", weight " << nudexMixWeights[k] << G4endl;
+                }
+            }
             G4cout << "  NuDEX libdir: " << nudexLibDir << G4endl;
+            if (sourceMode == NUDEX_SPECTRUM) {
+                G4cout << "  NuDEX neutron spectrum: " << nudexSpectrumFile << G4endl;
+            }
+            if (nudexProducerThreads > 0) {
+                G4cout << "  NuDEX producer threads: " << nudexProducerThreads
+                       << " (seed " << nudexProducerSeed << ")" << G4endl;
+            }
+            if (nudexEnsembleSize > 1) {
+                G4cout << "  NuDEX level scheme realizations: " << nudexEnsembleSize
+                       << " (blocks of " << nudexEnsembleBlock << " events)" << G4endl;
+            }
+            if (nudexPrecomputeBRThreads > 0) {
+                G4cout << "  NuDEX BR precomputed at initialization: " << nudexPrecomputeBRThreads
+                       << " threads" << G4endl;
+            }
         }
         G4cout << "  Generation mode: " << modeStr << G4endl;
         if (!macroFile.empty()) {
@@ -267,7 +429,12 @@ int main(int argc, char** argv)
 
     // Use ActionInitialization for MT-safe action setup
     ActionInitialization* actionInitialization =
-        new ActionInitialization(cascadeMode, sourceMode, nudexZA, nudexLibDir);
+        new ActionInitialization(cascadeMode, sourceMode, nudexZA, nudexLibDir,
+                                 nudexLibraryFile, nudexLibrarySequential,
+                                 nudexProducerThreads, nudexProducerSeed,
+                                 nudexMixZA, nudexMixWeights, nudexSpectrumFile,
+                                 nudexEnsembleSize, nudexEnsembleBlock,
+                                 nThreads, nudexPrecomputeBRThreads);
     runManager->SetUserInitialization(actionInitialization);
 
     // Initialize visualization (only if not quiet mode)
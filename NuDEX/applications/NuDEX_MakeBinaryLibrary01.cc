@@ -0,0 +1,64 @@
+
+
+
+#include "NuDEXStatisticalNucleus.hh"
+
+using namespace std;
+
+#define MAXZKNOWNLEVELS 200
+
+/*
+
+Program to make the binary files of the NuDEX data library, which are read by NuDEX instead of the text ones:
+   - ICC_factors.dat --> ICC_factors.bin
+   - KnownLevels/zXXX.dat --> KnownLevels/zXXX.bin
+They have to be made again if the text files are modified (otherwise NuDEX reads the text files).
+
+*/
+
+int main(int argc,char** argv){
+
+
+  if(argc<2){
+    std::cout<<" #########################################################################  "<<std::endl;
+    std::cout<<" This program can be executed as: "<<std::endl;
+    std::cout<<"    NuDEX_MakeBinaryLibrary01 LIBDIR"<<std::endl;
+    std::cout<<" #########################################################################  "<<std::endl;
+    return 1;
+  }
+
+  char LibDir[200],fname[500];
+  sprintf(LibDir,"%s",argv[1]);
+
+  //--------------------------------------------------------
+  //Internal conversion coefficients:
+  sprintf(fname,"%s/ICC_factors.dat",LibDir);
+  std::string binfname=NuDEXGetBinaryFileName(fname);
+  if(NuDEXInternalConversion::MakeBinaryFile(fname,binfname.c_str())<0){
+    std::cout<<" ############# Error making "<<binfname<<" #############"<<std::endl;
+    return 1;
+  }
+  std::cout<<" "<<binfname<<" done"<<std::endl;
+  //--------------------------------------------------------
+
+  //--------------------------------------------------------
+  //Known levels:
+  int nFiles=0;
+  for(int Z=0;Z<=MAXZKNOWNLEVELS;Z++){
+    sprintf(fname,"%s/KnownLevels/z%03d.dat",LibDir,Z);
+    std::ifstream in(fname);
+    if(!in.good()){continue;}
+    in.close();
+    binfname=NuDEXGetBinaryFileName(fname);
+    if(NuDEXStatisticalNucleus::MakeKnownLevelsBinaryFile(fname,binfname.c_str())<0){
+      std::cout<<" ############# Error making "<<binfname<<" #############"<<std::endl;
+      return 1;
+    }
+    nFiles++;
+  }
+  std::cout<<" "<<nFiles<<" files of known levels done"<<std::endl;
+  //--------------------------------------------------------
+
+  return 0;
+
+}
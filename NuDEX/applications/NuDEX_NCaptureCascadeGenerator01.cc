@@ -1,6 +1,8 @@
 
 
 #include "NuDEXStatisticalNucleus.hh"
+#include "NuDEXCascadeBuffer.hh"
+#include "NuDEXCascadeLibrary.hh"
 #include <cstring>
 
 using namespace std;
@@ -33,6 +35,14 @@ int main(int argc,char** argv){
   double BandWidth_MeV=0;
   double MaxExcEnergy=0; // MeV --> this value should be larger than "Sn+(A-1)/A*NeutronEnergy" (2)
   int BrOption=-1;
+  int brSamplingOption=-1; // 0: binary search in the cumulative BR, 1: alias tables
+  int brStorageOption=-1; // 0: BR stored in double, 1: in float
+  double brCacheSize_MB=-1; // BROpt=0,2: memory for the cache of decay intensities
+  int brPrecomputeNThreads=-1; // if >0, compute all the BR at Init with this number of threads
+  double psfTabulationError=-1; // if >0, the PSF are tabulated at Init with this max. relative interpolation error
+  int iccTablePointsPerDecade=-1; // if >0, the ICC are tabulated at Init with this number of points per decade
+  int ldTablePointsPerMeV=-1; // if >0, the level density is tabulated at Init with this number of points per MeV
+  int levelSchemeNThreads=-1; // if >0, the unknown levels of each spin and parity are generated with their own random numbers, with this number of threads
   int sampleGammaWidths=-1;
   unsigned int seed1=0;
   unsigned int seed2=0;
@@ -45,6 +55,8 @@ int main(int argc,char** argv){
   double ecrit=-1;
   //----------------------------
   char LibDir[200];
+  char SnapshotDir[200]=""; // if not empty, directory with the snapshots of the initialized nucleus (see NuDEXStatisticalNucleus::SetSnapshotDir)
+  char CascadeLibrary[500]=""; // if not empty, the cascades are written in this binary file (see NuDEXCascadeLibrary.hh) instead of in the .cas file
   int ZA=0; //ZA of the target nucleus
   int NCascades=100; //number of cascades to be generated
   bool DoThermal=true; //If true, create thermal cascades.
@@ -89,6 +101,8 @@ int main(int argc,char** argv){
       if(word.c_str()[0]=='#'){in.ignore(10000,'\n');}
       if(word==string("END")){break;}
       else if(word==string("LIBDIR")){in>>LibDir;}
+      else if(word==string("SNAPSHOTDIR")){in>>SnapshotDir;}
+      else if(word==string("CASCADELIBRARY")){in>>CascadeLibrary;}
       else if(word==string("ZA")){in>>ZA;}
       else if(word==string("NCASCADES")){in>>NCascades;}
       else if(word==string("NEUTRONENERGY_MEV")){in>>NeutronEnergy;}
@@ -106,6 +120,14 @@ int main(int argc,char** argv){
 
       else if(word==string("PSF_FLAG")){in>>PSFflag;}
       else if(word==string("BROPTION")){in>>BrOption;}
+      else if(word==string("BRSAMPLINGOPTION")){in>>brSamplingOption;}
+      else if(word==string("BRSTORAGEOPTION")){in>>brStorageOption;}
+      else if(word==string("BRCACHESIZE_MB")){in>>brCacheSize_MB;}
+      else if(word==string("BRPRECOMPUTENTHREADS")){in>>brPrecomputeNThreads;}
+      else if(word==string("PSFTABULATIONERROR")){in>>psfTabulationError;}
+      else if(word==string("ICCTABLEPOINTSPERDECADE")){in>>iccTablePointsPerDecade;}
+      else if(word==string("LDTABLEPOINTSPERMEV")){in>>ldTablePointsPerMeV;}
+      else if(word==string("LEVELSCHEMENTHREADS")){in>>levelSchemeNThreads;}
       else if(word==string("SAMPLEGAMMAWIDTHS")){in>>sampleGammaWidths;}
       
       else if(word==string("SEED1")){in>>seed1;}
@@ -141,6 +163,8 @@ int main(int argc,char** argv){
   for(int i=0;i<nparameters;i++){
     char* parname=argv[i_firstpar+2*i];
     if(string(parname)==string("LIBDIR")){sprintf(LibDir,"%s",argv[i_firstpar+2*i+1]);  cout<<"      "<<parname<<"  "<<LibDir<<std::endl;}
+    else if(string(parname)==string("SNAPSHOTDIR")){sprintf(SnapshotDir,"%s",argv[i_firstpar+2*i+1]);  cout<<"      "<<parname<<"  "<<SnapshotDir<<std::endl;}
+    else if(string(parname)==string("CASCADELIBRARY")){sprintf(CascadeLibrary,"%s",argv[i_firstpar+2*i+1]);  cout<<"      "<<parname<<"  "<<CascadeLibrary<<std::endl;}
     else if(string(parname)==string("ZA")){ZA=std::atoi(argv[i_firstpar+2*i+1]);  cout<<"      "<<parname<<"  "<<ZA<<std::endl;}
     else if(string(parname)==string("NCASCADES")){NCascades=std::atoi(argv[i_firstpar+2*i+1]);  cout<<"      "<<parname<<"  "<<NCascades<<std::endl;}
     else if(string(parname)==string("NEUTRONENERGY_MEV")){NeutronEnergy=std::atof(argv[i_firstpar+2*i+1]);  cout<<"      "<<parname<<"  "<<NeutronEnergy<<std::endl;}
@@ -158,6 +182,14 @@ int main(int argc,char** argv){
     
     else if(string(parname)==string("PSF_FLAG")){PSFflag=std::atoi(argv[i_firstpar+2*i+1]);  cout<<"      "<<parname<<"  "<<PSFflag<<std::endl;}
     else if(string(parname)==string("BROPTION")){BrOption=std::atoi(argv[i_firstpar+2*i+1]);  cout<<"      "<<parname<<"  "<<BrOption<<std::endl;}
+    else if(string(parname)==string("BRSAMPLINGOPTION")){brSamplingOption=std::atoi(argv[i_firstpar+2*i+1]);  cout<<"      "<<parname<<"  "<<brSamplingOption<<std::endl;}
+    else if(string(parname)==string("BRSTORAGEOPTION")){brStorageOption=std::atoi(argv[i_firstpar+2*i+1]);  cout<<"      "<<parname<<"  "<<brStorageOption<<std::endl;}
+    else if(string(parname)==string("BRCACHESIZE_MB")){brCacheSize_MB=std::atof(argv[i_firstpar+2*i+1]);  cout<<"      "<<parname<<"  "<<brCacheSize_MB<<std::endl;}
+    else if(string(parname)==string("BRPRECOMPUTENTHREADS")){brPrecomputeNThreads=std::atoi(argv[i_firstpar+2*i+1]);  cout<<"      "<<parname<<"  "<<brPrecomputeNThreads<<std::endl;}
+    else if(string(parname)==string("PSFTABULATIONERROR")){psfTabulationError=std::atof(argv[i_firstpar+2*i+1]);  cout<<"      "<<parname<<"  "<<psfTabulationError<<std::endl;}
+    else if(string(parname)==string("ICCTABLEPOINTSPERDECADE")){iccTablePointsPerDecade=std::atoi(argv[i_firstpar+2*i+1]);  cout<<"      "<<parname<<"  "<<iccTablePointsPerDecade<<std::endl;}
+    else if(string(parname)==string("LDTABLEPOINTSPERMEV")){ldTablePointsPerMeV=std::atoi(argv[i_firstpar+2*i+1]);  cout<<"      "<<parname<<"  "<<ldTablePointsPerMeV<<std::endl;}
+    else if(string(parname)==string("LEVELSCHEMENTHREADS")){levelSchemeNThreads=std::atoi(argv[i_firstpar+2*i+1]);  cout<<"      "<<parname<<"  "<<levelSchemeNThreads<<std::endl;}
     else if(string(parname)==string("SAMPLEGAMMAWIDTHS")){sampleGammaWidths=std::atoi(argv[i_firstpar+2*i+1]);  cout<<"      "<<parname<<"  "<<sampleGammaWidths<<std::endl;}
     
     else if(string(parname)==string("SEED1")){seed1=std::atoi(argv[i_firstpar+2*i+1]);  cout<<"      "<<parname<<"  "<<seed1<<std::endl;}
@@ -189,6 +221,15 @@ int main(int argc,char** argv){
   NuDEXStatisticalNucleus* theStatisticalNucleus=new NuDEXStatisticalNucleus(Z,A);
   theStatisticalNucleus->SetSomeInitalParameters(LDtype,PSFflag,MaxSpin,minlevelsperband,BandWidth_MeV,MaxExcEnergy,BrOption,sampleGammaWidths,seed1,seed2,seed3);
   theStatisticalNucleus->SetInitialParameters02(knownLevelsFlag,electronConversionFlag,primGamNormFactor,primGamEcut,ecrit);
+  if(brSamplingOption>=0){theStatisticalNucleus->SetBRSamplingOption(brSamplingOption);}
+  if(brStorageOption>=0){theStatisticalNucleus->SetBRStorageOption(brStorageOption);}
+  if(brCacheSize_MB>=0){theStatisticalNucleus->SetBRCacheSize(brCacheSize_MB);}
+  if(brPrecomputeNThreads>=0){theStatisticalNucleus->SetBRPrecomputeNThreads(brPrecomputeNThreads);}
+  if(psfTabulationError>=0){theStatisticalNucleus->SetPSFTabulationError(psfTabulationError);}
+  if(iccTablePointsPerDecade>=0){theStatisticalNucleus->SetICCTablePointsPerDecade(iccTablePointsPerDecade);}
+  if(ldTablePointsPerMeV>=0){theStatisticalNucleus->SetLDTablePointsPerMeV(ldTablePointsPerMeV);}
+  if(levelSchemeNThreads>=0){theStatisticalNucleus->SetLevelSchemeNThreads(levelSchemeNThreads);}
+  if(SnapshotDir[0]!=0){theStatisticalNucleus->SetSnapshotDir(SnapshotDir);}
   int check=theStatisticalNucleus->Init(LibDir,inputfname);
   if(check<0){
     std::cout<<" Error initializing StatisticalNucleus with Z = "<<Z<<" , A = "<<A<<std::endl;
@@ -248,6 +289,8 @@ int main(int argc,char** argv){
   std::ofstream outi(outfname_inp);
   outi<<std::endl;
   outi<<"LIBDIR "<<LibDir<<std::endl;
+  if(SnapshotDir[0]!=0){outi<<"SNAPSHOTDIR "<<SnapshotDir<<std::endl;}
+  if(CascadeLibrary[0]!=0){outi<<"CASCADELIBRARY "<<CascadeLibrary<<std::endl;}
   outi<<"ZA "<<ZA<<std::endl;
   outi<<"NCASCADES "<<NCascades<<std::endl;
   outi<<"NEUTRONENERGY_MEV "<<NeutronEnergy<<std::endl;
@@ -267,30 +310,61 @@ int main(int argc,char** argv){
      
   //--------------------------------------------------------
   //Generate the cascades:
-  int Npar,Npar2;
-  std::vector<char> pType;
-  std::vector<double> pEnergy,pTime;
+  //The cascades are generated in batches, stored in a NuDEXCascadeBuffer which is reused:
+  const int BatchSize=1000;
+  int Npar,Npar2,NBatch;
+  char* pType;
+  double *pEnergy,*pTime;
+  NuDEXCascadeBuffer* theBuffer=new NuDEXCascadeBuffer(BatchSize,20*BatchSize);
+
+  if(CascadeLibrary[0]!=0){
+    NuDEXCascadeLibraryWriter theWriter;
+    if(theWriter.Open(CascadeLibrary,Z,A,InitialLevel,ExcitationEnergy,seed3)<0){exit(1);}
+    for(int i0=0;i0<NCascades;i0+=BatchSize){
+      NBatch=std::min(BatchSize,NCascades-i0);
+      theStatisticalNucleus->GenerateCascades(NBatch,InitialLevel,ExcitationEnergy,theBuffer);
+      if(theWriter.AddCascades(theBuffer,TimeWindow*1.e-9)<0){exit(1);}
+      int nPercent=(int)((i0+NBatch)*10./NCascades);
+      if(nPercent>(int)(i0*10./NCascades)){
+        std::cout<<nPercent*10<<" % done"<<std::endl;
+      }
+    }
+    if(theWriter.Close()<0){exit(1);}
+    std::cout<<" "<<NCascades<<" cascades written in "<<CascadeLibrary<<std::endl;
+    delete theBuffer;
+    delete theStatisticalNucleus;
+    return 0;
+  }
 
   std::ofstream out(outfname_cas);
   if(!out.good()){
     std::cout<<" ######## Error opening "<<outfname_cas<<" ########"<<std::endl; exit(1);
   }
 
-  for(int i=0;i<NCascades;i++){
-    Npar=theStatisticalNucleus->GenerateCascade(InitialLevel,ExcitationEnergy,pType,pEnergy,pTime);
-    Npar2=0; 
-    for(int j=0;j<Npar;j++){
-      if(pTime.at(j)<TimeWindow*1.e-9){Npar2++;}
-    }
-    out<<Npar2;
-    for(int j=0;j<Npar;j++){
-      if(pTime.at(j)<TimeWindow*1.e-9){out<<"  "<<pType.at(j)<<"  "<<pEnergy.at(j)<<"  "<<pTime.at(j);}
-    }
-    out<<std::endl;
-    if(((i+1)*10)%NCascades==0){
-      std::cout<<(i+1.)/NCascades*100.<<" % done"<<std::endl;
+  for(int i0=0;i0<NCascades;i0+=BatchSize){
+    NBatch=std::min(BatchSize,NCascades-i0);
+    theStatisticalNucleus->GenerateCascades(NBatch,InitialLevel,ExcitationEnergy,theBuffer);
+    for(int i_cas=0;i_cas<NBatch;i_cas++){
+      int i=i0+i_cas;
+      Npar=theBuffer->GetNParticles(i_cas);
+      pType=theBuffer->GetTypes(i_cas);
+      pEnergy=theBuffer->GetEnergies(i_cas);
+      pTime=theBuffer->GetTimes(i_cas);
+      Npar2=0; 
+      for(int j=0;j<Npar;j++){
+        if(pTime[j]<TimeWindow*1.e-9){Npar2++;}
+      }
+      out<<Npar2;
+      for(int j=0;j<Npar;j++){
+        if(pTime[j]<TimeWindow*1.e-9){out<<"  "<<pType[j]<<"  "<<pEnergy[j]<<"  "<<pTime[j];}
+      }
+      out<<std::endl;
+      if(((i+1)*10)%NCascades==0){
+        std::cout<<(i+1.)/NCascades*100.<<" % done"<<std::endl;
+      }
     }
   }
+  delete theBuffer;
   out.close();
   //--------------------------------------------------------
 
@@ -0,0 +1,203 @@
+#include "NuDEXStatisticalNucleus.hh"
+#include "NuDEXCascadeSampler.hh"
+#include <sstream>
+
+using namespace std;
+
+/*
+
+Program to check that ChangeLevelSpinParityAndBR re-builds the BR of a level consistently after PrecomputeBR (BROPTION 1).
+Two nuclei are created with the same parameters and seeds, and the spin and parity of a statistical level close to Sn is changed:
+   - nucleus A: PrecomputeBR, some cascades (so the alias table of the level is built), and then ChangeLevelSpinParityAndBR
+   - nucleus B: ChangeLevelSpinParityAndBR, and then PrecomputeBR
+Then:
+   - the stored BR (CSR rows) of the changed level, and of all the levels below it, have to be the same in both nuclei
+   - the cascades starting in the changed level, sampled from the alias tables with two NuDEXCascadeSampler with the same seed, have to be the same
+In addition, a third nucleus is created with MaxSpin=0.5, so that there are no levels with the spin and parity of the thermal capture level
+(only known levels below 1 MeV, and statistical levels with J=0), and its primary BR are computed from the PSF (database intensities scaled to 0.1%).
+Then the capture level has to decay only through E1, M1 or E2 transitions.
+Returns 0 if all the checks are passed, 1 if not.
+
+*/
+
+NuDEXStatisticalNucleus* CreateNucleus(int Z,int A,const char* LibDir);
+std::string GetBRRow(NuDEXStatisticalNucleus* theNucleus,int i_level);
+int CheckThermalCaptureLevel(int Z,int A,const char* LibDir);
+
+int main(int argc,char** argv){
+
+  if(argc<2){
+    std::cout<<" #########################################################################  "<<std::endl;
+    std::cout<<" This program can be executed as: "<<std::endl;
+    std::cout<<"    NuDEX_TestChangeLevel01 LIBDIR [ZA] [NCASCADES]"<<std::endl;
+    std::cout<<" #########################################################################  "<<std::endl;
+    return 1;
+  }
+  const char* LibDir=argv[1];
+  int ZA=9019;
+  int NCascades=10000;
+  if(argc>2){ZA=atoi(argv[2]);}
+  if(argc>3){NCascades=atoi(argv[3]);}
+  unsigned int seed=1234567;
+
+  int Z=ZA/1000;
+  int A=ZA-1000*Z+1;
+  NuDEXStatisticalNucleus* theNucleusA=CreateNucleus(Z,A,LibDir);
+  NuDEXStatisticalNucleus* theNucleusB=CreateNucleus(Z,A,LibDir);
+  if(theNucleusA==0 || theNucleusB==0){
+    std::cout<<" Error initializing StatisticalNucleus with Z = "<<Z<<" , A = "<<A<<std::endl;
+    return 1;
+  }
+
+  //--------------------------------------------------------
+  //The level to change, in the statistical part of the level scheme:
+  double Sn,I0;
+  theNucleusA->GetSnAndI0(Sn,I0);
+  int i_level=theNucleusA->GetClosestLevel(Sn,-1,true);
+  Level* iLevel=theNucleusA->GetLevel(i_level);
+  if(i_level<=0 || iLevel==0 || iLevel->KnownLevelID>0){
+    std::cout<<" ############ Error: no statistical level close to Sn = "<<Sn<<" MeV ############"<<std::endl;
+    return 1;
+  }
+  int newspinx2=iLevel->spinx2+2;
+  bool newParity=!iLevel->parity;
+  double LevelEnergy=iLevel->Energy;
+  std::cout<<" Changing level "<<i_level<<", with E="<<LevelEnergy<<" MeV, from spin="<<iLevel->spinx2/2.<<" and parity="<<iLevel->parity<<" to spin="<<newspinx2/2.<<" and parity="<<newParity<<std::endl;
+  //--------------------------------------------------------
+
+  //--------------------------------------------------------
+  theNucleusA->PrecomputeBR(1);
+  std::vector<char> pType;
+  std::vector<double> pEnergy,pTime;
+  for(int i=0;i<100;i++){
+    theNucleusA->GenerateCascade(i_level,LevelEnergy,pType,pEnergy,pTime);
+  }
+  std::string oldRow=GetBRRow(theNucleusA,i_level);
+  theNucleusA->ChangeLevelSpinParityAndBR(i_level,newspinx2,newParity,-1,-1,seed);
+
+  theNucleusB->ChangeLevelSpinParityAndBR(i_level,newspinx2,newParity,-1,-1,seed);
+  theNucleusB->PrecomputeBR(1);
+  //--------------------------------------------------------
+
+  int NFailed=0;
+  Level* levelA=theNucleusA->GetLevel(i_level);
+  Level* levelB=theNucleusB->GetLevel(i_level);
+  if(levelA->spinx2!=newspinx2 || levelA->parity!=newParity || levelB->spinx2!=newspinx2 || levelB->parity!=newParity){
+    std::cout<<" ############# The spin and parity of the level have not been changed #############"<<std::endl;
+    NFailed++;
+  }
+  std::string newRow=GetBRRow(theNucleusA,i_level);
+  if(newRow.empty() || newRow==oldRow){
+    std::cout<<" ############# The BR of the level have not been re-built #############"<<std::endl;
+    NFailed++;
+  }
+  for(int j=0;j<=i_level;j++){
+    if(GetBRRow(theNucleusA,j)!=GetBRRow(theNucleusB,j)){
+      std::cout<<" ############# Different BR of level "<<j<<" #############"<<std::endl;
+      NFailed++;
+    }
+  }
+
+  NuDEXCascadeSampler* theSamplerA=new NuDEXCascadeSampler(theNucleusA,seed);
+  NuDEXCascadeSampler* theSamplerB=new NuDEXCascadeSampler(theNucleusB,seed);
+  std::vector<char> pTypeB;
+  std::vector<double> pEnergyB,pTimeB;
+  int NDifferent=0;
+  for(int i=0;i<NCascades;i++){
+    int npA=theSamplerA->GenerateCascade(i_level,LevelEnergy,pType,pEnergy,pTime);
+    int npB=theSamplerB->GenerateCascade(i_level,LevelEnergy,pTypeB,pEnergyB,pTimeB);
+    if(npA!=npB || pType!=pTypeB || pEnergy!=pEnergyB || pTime!=pTimeB){NDifferent++;}
+  }
+  if(NDifferent>0){
+    std::cout<<" ############# "<<NDifferent<<" of "<<NCascades<<" cascades from level "<<i_level<<" are different #############"<<std::endl;
+    NFailed++;
+  }
+
+  delete theSamplerA;
+  delete theSamplerB;
+  delete theNucleusA;
+  delete theNucleusB;
+
+  NFailed+=CheckThermalCaptureLevel(Z,A,LibDir);
+
+  if(NFailed>0){
+    std::cout<<" ############# "<<NFailed<<" checks failed #############"<<std::endl;
+    return 1;
+  }
+  std::cout<<" All the checks passed"<<std::endl;
+  return 0;
+
+}
+
+
+NuDEXStatisticalNucleus* CreateNucleus(int Z,int A,const char* LibDir){
+
+  NuDEXStatisticalNucleus* theNucleus=new NuDEXStatisticalNucleus(Z,A);
+  theNucleus->SetSomeInitalParameters(-1,-1,-1,-1,0,0,1,-1,1234567,2345678,3456789); //BROpt=1: all the BR stored
+  theNucleus->SetInitialParameters02(0,-1,-1,-1,1.0); //known levels only below 1 MeV
+  theNucleus->SetBRSamplingOption(1);
+  int check=theNucleus->Init(LibDir);
+  if(check<0){
+    delete theNucleus;
+    return 0;
+  }
+  return theNucleus;
+}
+
+std::string GetBRRow(NuDEXStatisticalNucleus* theNucleus,int i_level){
+
+  std::ostringstream out;
+  out.precision(17);
+  theNucleus->PrintTotalCumulBR(i_level,out);
+  return out.str();
+}
+
+//Returns the number of failed checks:
+int CheckThermalCaptureLevel(int Z,int A,const char* LibDir){
+
+  NuDEXStatisticalNucleus* theNucleus=new NuDEXStatisticalNucleus(Z,A);
+  theNucleus->SetVerbosity(0);
+  theNucleus->SetSomeInitalParameters(-1,-1,0.5,-1,0,0,1,-1,1234567,2345678,3456789); //MaxSpin=0.5
+  theNucleus->SetInitialParameters02(0,-1,1.e-3,1.e-6,1.0); //primary intensities from the database scaled to 0.1%, and computed down to the ground state
+  if(theNucleus->Init(LibDir)<0){
+    std::cout<<" ############# Error initializing StatisticalNucleus with MaxSpin=0.5 #############"<<std::endl;
+    delete theNucleus;
+    return 1;
+  }
+  double Sn,I0;
+  theNucleus->GetSnAndI0(Sn,I0);
+  int capturespinx2=(int)((std::fabs(I0)+0.5)*2+0.001);
+  bool captureParity=(I0>=0);
+  for(int i=0;i<theNucleus->GetNLevels();i++){
+    Level* aLevel=theNucleus->GetLevel(i);
+    if(aLevel->spinx2==capturespinx2 && aLevel->parity==captureParity){
+      std::cout<<" There are levels with the spin and parity of the thermal capture level, the check of its primary BR is not done"<<std::endl;
+      delete theNucleus;
+      return 0;
+    }
+  }
+
+  //Lines of PrintThermalPrimaryTransitions: i_level, energy, Eg, BR
+  std::stringstream out;
+  theNucleus->PrintThermalPrimaryTransitions(out);
+  std::string word;
+  int NLevelsBelow=0;
+  out>>word>>word>>word>>word>>NLevelsBelow;
+  double ForbiddenBR=0;
+  for(int k=0;k<NLevelsBelow;k++){
+    int i_level;
+    double ene,Eg,BR;
+    out>>i_level>>ene>>Eg>>BR;
+    Level* aLevel=theNucleus->GetLevel(i_level);
+    int d=std::abs(capturespinx2-aLevel->spinx2),sum=capturespinx2+aLevel->spinx2;
+    bool same=(captureParity==aLevel->parity);
+    if(!(d<4 && sum>1) && !(same && d<6 && sum>3)){ForbiddenBR+=BR;}
+  }
+  delete theNucleus;
+  std::cout<<" Primary BR of the thermal capture level (spin="<<capturespinx2/2.<<", parity="<<captureParity<<") to levels not reachable with E1, M1 or E2: "<<ForbiddenBR<<std::endl;
+  if(NLevelsBelow<=0 || ForbiddenBR>0){
+    std::cout<<" ############# Wrong primary BR of the thermal capture level #############"<<std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,112 @@
+
+
+#include "NuDEXRandom.hh"
+#include <vector>
+#include <algorithm>
+
+using namespace std;
+
+/*
+
+Program to check that NuDEXRandom::ChiSquare(nu) (SAMPLEGAMMAWIDTHS 2) is statistically equivalent to the sum of nu squared
+Gaussians (SAMPLEGAMMAWIDTHS 1), for several nu. For each of them, NSamples values are drawn in both ways and:
+   - the mean and variance of the chi-squared values have to agree with nu and 2·nu, within NSIGMA standard errors
+   - the two-sample Kolmogorov-Smirnov distance has to be below the critical value for a significance level of 0.1%
+Returns 0 if all the checks are passed, 1 if not.
+
+*/
+
+#define NSIGMA 5
+#define KSCOEF 1.949 //c(alpha) of the two-sample KS test, for alpha=0.001
+
+int CheckChiSquare(int nu,int NSamples,NuDEXRandom* aRandom);
+double KSDistance(std::vector<double>& x,std::vector<double>& y);
+
+int main(int argc,char** argv){
+
+  int NSamples=100000;
+  unsigned int seed=1234567;
+  if(argc>1){NSamples=atoi(argv[1]);}
+  if(argc>2){seed=atoi(argv[2]);}
+  if(NSamples<100){
+    std::cout<<" #########################################################################  "<<std::endl;
+    std::cout<<" This program can be executed as: "<<std::endl;
+    std::cout<<"    NuDEX_TestChiSquare01 [NSAMPLES (>=100)] [SEED]"<<std::endl;
+    std::cout<<" #########################################################################  "<<std::endl;
+    return 1;
+  }
+
+  NuDEXRandom theRandom(seed);
+  int nu[7]={1,2,3,5,20,100,999};
+  int NFailed=0;
+  for(int i=0;i<7;i++){
+    NFailed+=CheckChiSquare(nu[i],NSamples,&theRandom);
+  }
+
+  if(NFailed>0){
+    std::cout<<" ############# "<<NFailed<<" chi-squared checks failed #############"<<std::endl;
+    return 1;
+  }
+  std::cout<<" All the chi-squared checks passed"<<std::endl;
+  return 0;
+
+}
+
+
+//Returns the number of failed checks (0 to 3):
+int CheckChiSquare(int nu,int NSamples,NuDEXRandom* aRandom){
+
+  std::vector<double> chi2(NSamples),sumGaus2(NSamples);
+  for(int i=0;i<NSamples;i++){
+    chi2[i]=aRandom->ChiSquare(nu);
+  }
+  for(int i=0;i<NSamples;i++){
+    double sum=0;
+    for(int j=0;j<nu;j++){
+      double rand=aRandom->Gaus(0,1);
+      sum+=rand*rand;
+    }
+    sumGaus2[i]=sum;
+  }
+
+  double mean=0,var=0;
+  for(int i=0;i<NSamples;i++){mean+=chi2[i];}
+  mean/=NSamples;
+  for(int i=0;i<NSamples;i++){var+=(chi2[i]-mean)*(chi2[i]-mean);}
+  var/=(NSamples-1);
+
+  //Standard errors of the mean and variance of a chi-squared with nu degrees of freedom (4th central moment: 12·nu^2+48·nu):
+  double meanError=std::sqrt(2.*nu/NSamples);
+  double varError=std::sqrt((8.*nu*nu+48.*nu)/NSamples);
+  double D=KSDistance(chi2,sumGaus2);
+  double Dcrit=KSCOEF*std::sqrt(2./NSamples);
+
+  int NFailed=0;
+  if(std::fabs(mean-nu)>NSIGMA*meanError){NFailed++;}
+  if(std::fabs(var-2.*nu)>NSIGMA*varError){NFailed++;}
+  if(D>Dcrit){NFailed++;}
+
+  char buffer[1000];
+  sprintf(buffer," nu = %4d   mean = %10.5g (%g)   variance = %10.5g (%g)   KS distance = %8.5f (critical value %8.5f)   %s",
+	  nu,mean,(double)nu,var,2.*nu,D,Dcrit,(NFailed==0?"OK":"FAILED"));
+  std::cout<<buffer<<std::endl;
+
+  return NFailed;
+}
+
+
+//Maximum distance between the empirical distributions of x and y (both are sorted here):
+double KSDistance(std::vector<double>& x,std::vector<double>& y){
+
+  std::sort(x.begin(),x.end());
+  std::sort(y.begin(),y.end());
+  size_t i=0,j=0;
+  double D=0;
+  while(i<x.size() && j<y.size()){
+    double val=std::min(x[i],y[j]);
+    while(i<x.size() && x[i]<=val){i++;}
+    while(j<y.size() && y[j]<=val){j++;}
+    D=std::max(D,std::fabs((double)i/x.size()-(double)j/y.size()));
+  }
+  return D;
+}
@@ -0,0 +1,49 @@
+#ifndef NUDEXBINARYFILE_HH
+#define NUDEXBINARYFILE_HH 1
+
+#include <cstdlib>
+#include <iostream>
+#include <fstream>
+#include <cstring>
+#include <string>
+
+/*
+Binary copies of the text files of the data library, which can be read without parsing any text.
+They start with a NuDEXBinaryHeader, which keeps the size and modification time of the text file used to make them.
+If the text file changes, the binary file is not used anymore (it has to be made again with NuDEX_MakeBinaryLibrary01).
+The rest of the file (index and records) is defined by each class using it.
+*/
+
+struct NuDEXBinaryHeader{
+  char magic[8]; //type of file
+  int version,nEntries; //nEntries: number of entries of the index that follows the header
+  long long textSize,textMTime; //of the text file used to make the binary one
+};
+
+//Fills the header for a binary copy of textfname. Returns -1 if textfname does not exist:
+int NuDEXMakeBinaryHeader(NuDEXBinaryHeader* header,const char* magic,int version,int nEntries,const char* textfname);
+//Memory maps binfname (read only), if it has the right magic and version and it was made from the present version of textfname
+//(if textfname does not exist, the binary file is used anyway). Returns 0 if not:
+const char* NuDEXMapBinaryFile(const char* binfname,const char* magic,int version,const char* textfname,size_t& size);
+void NuDEXUnmapBinaryFile(const char* data,size_t size);
+const char* NuDEXMapFile(const char* fname,size_t& size); //memory maps any file (read only). Returns 0 if it cannot be done
+std::string NuDEXGetBinaryFileName(const char* textfname); //.dat --> .bin
+std::string NuDEXGetTemporaryFileName(const char* fname); //different for each process, to write fname and then rename it
+unsigned long long NuDEXHash(const std::string& s); //64-bit FNV-1a hash
+std::string NuDEXGetFileStamp(const char* fname); //"size modification-time" of fname ("-1 -1" if it does not exist), to know if it has been modified
+
+//Read-only content of a binary file: memory mapped (mapped==true) or, if it has been made in memory, in image. It is unmapped when deleted,
+//so it can be kept in a std::shared_ptr by several users (for example, a cache and the nuclei reading it):
+struct NuDEXFileData{
+  NuDEXFileData():data(0),size(0),mapped(false){}
+  NuDEXFileData(const NuDEXFileData&)=delete; //data can point to image
+  NuDEXFileData& operator=(const NuDEXFileData&)=delete;
+  ~NuDEXFileData(){if(mapped){NuDEXUnmapBinaryFile(data,size);}}
+  const char* data;
+  size_t size;
+  bool mapped;
+  std::string image;
+};
+
+
+#endif
@@ -0,0 +1,56 @@
+
+#ifndef NUDEXCASCADEBUFFER_HH
+#define NUDEXCASCADEBUFFER_HH 1
+
+
+#include <cstdlib>
+#include <iostream>
+#include <cstring>
+
+/*
+Struct-of-arrays container for a batch of cascades, filled by NuDEXCascadeSampler::GenerateCascades(...).
+The particles of the cascade i_cas are those between Offset[i_cas] and Offset[i_cas+1]-1 of the Type, Energy and Time arrays.
+The arrays are owned by the buffer and only grow, so once they are big enough the buffer can be reused
+(event after event) without any memory allocation.
+A cascade that could not be generated (negative value returned by GenerateCascade) is stored without particles.
+*/
+
+class NuDEXCascadeBuffer{
+
+public:
+  NuDEXCascadeBuffer(int maxNCascades=1,int maxNParticles=100);
+  ~NuDEXCascadeBuffer();
+
+public:
+  void Clear(){NCascades=0; NParticles=0; Offset[0]=0;} //the memory is not released
+  void Reserve(int maxNCascades,int maxNParticles);
+  int GetNCascades(){return NCascades;}
+  int GetNParticles(){return NParticles;}
+  int GetNParticles(int i_cas){return Offset[i_cas+1]-Offset[i_cas];}
+  char* GetTypes(int i_cas){return Type+Offset[i_cas];}
+  double* GetEnergies(int i_cas){return Energy+Offset[i_cas];}
+  double* GetTimes(int i_cas){return Time+Offset[i_cas];}
+
+  //To fill the buffer (used by NuDEXCascadeSampler):
+  void AddParticle(char type,double energy,double time){
+    if(NParticles==MaxNParticles){Reserve(MaxNCascades,2*MaxNParticles);}
+    Type[NParticles]=type; Energy[NParticles]=energy; Time[NParticles]=time; NParticles++;
+  }
+  void CloseCascade(){
+    if(NCascades==MaxNCascades){Reserve(2*MaxNCascades,MaxNParticles);}
+    NCascades++; Offset[NCascades]=NParticles;
+  }
+  void DiscardOpenCascade(){NParticles=Offset[NCascades];} //remove the particles added after the last CloseCascade()
+
+public:
+  int NCascades,NParticles;
+  int MaxNCascades,MaxNParticles;
+  char* Type;     //'g' gamma, 'e' electron
+  double* Energy; //MeV
+  double* Time;   //s
+  int* Offset;    //MaxNCascades+1 values
+};
+
+
+#endif
+
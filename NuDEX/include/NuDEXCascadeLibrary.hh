@@ -0,0 +1,95 @@
+#ifndef NUDEXCASCADELIBRARY_HH
+#define NUDEXCASCADELIBRARY_HH 1
+
+
+#include <cstdlib>
+#include <iostream>
+#include <fstream>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "NuDEXCascadeBuffer.hh"
+#include "NuDEXBinaryFile.hh"
+
+#define CASCADELIBRARY_BINARYVERSION 1
+
+/*
+Binary file with a large number of cascades generated beforehand (see CASCADELIBRARY in NuDEX_NCaptureCascadeGenerator01), to be replayed later
+without initializing any nucleus. Made of:
+   - NuDEXCascadeLibraryHeader
+   - the particles of all the cascades, one after the other (NuDEXCascadeLibraryParticle, energy and time in float)
+   - the index: NCascades+1 long long values, where the particles of the cascade i_cas are those between Offset[i_cas] and Offset[i_cas+1]-1
+NuDEXCascadeLibraryWriter writes the file batch after batch (only the index is kept in memory), and NuDEXCascadeLibrary reads it
+through a read-only memory map. The same NuDEXCascadeLibrary can be read by several threads at the same time.
+*/
+
+struct NuDEXCascadeLibraryHeader{
+  char magic[8]; //"NuDEXCAS"
+  int version;
+  int Z,A; //of the nucleus emitting the cascades (compound nucleus for the neutron captures)
+  int InitialLevel; //as in NuDEXStatisticalNucleus::GenerateCascade(...)
+  double ExcitationEnergy; //as in NuDEXStatisticalNucleus::GenerateCascade(...)
+  long long NCascades,NParticles;
+  long long IndexOffset; //position (bytes) of the index in the file
+  unsigned int Seed;
+  int unused;
+};
+
+struct NuDEXCascadeLibraryParticle{
+  float Energy; //MeV
+  float Time;   //s
+  char Type;    //'g' gamma, 'e' electron
+  char unused[3];
+};
+
+
+class NuDEXCascadeLibraryWriter{
+
+public:
+  NuDEXCascadeLibraryWriter();
+  ~NuDEXCascadeLibraryWriter(); //the file is not valid if Close() has not been called
+
+public:
+  //The file is written with a temporary name, and renamed by Close(). Returns -1 if there is an error:
+  int Open(const char* fname,int Z,int A,int InitialLevel,double ExcitationEnergy,unsigned int seed);
+  //All the cascades of theBuffer. If maxTime>0, the particles emitted at maxTime (s) or later are not written:
+  int AddCascades(NuDEXCascadeBuffer* theBuffer,double maxTime=0);
+  int Close(); //writes the index and the header
+  long long GetNCascades(){return (long long)Offset.size()-1;}
+
+private:
+  std::ofstream out;
+  std::string theFileName,theTmpFileName;
+  NuDEXCascadeLibraryHeader theHeader;
+  std::vector<long long> Offset;
+  std::vector<NuDEXCascadeLibraryParticle> theParticles; //of the present batch
+};
+
+
+class NuDEXCascadeLibrary{
+
+public:
+  NuDEXCascadeLibrary();
+  ~NuDEXCascadeLibrary();
+
+public:
+  int Open(const char* fname); //returns -1 if fname does not exist or it is not a valid cascade library
+  void Close();
+  const NuDEXCascadeLibraryHeader* GetHeader(){return theHeader;}
+  long long GetNCascades(){return NCascades;}
+  int GetNParticles(long long i_cas){return (int)(Offset[i_cas+1]-Offset[i_cas]);}
+  const NuDEXCascadeLibraryParticle* GetParticles(long long i_cas){return theParticles+Offset[i_cas];}
+
+private:
+  const char* theData;
+  size_t theSize;
+  const NuDEXCascadeLibraryHeader* theHeader;
+  const NuDEXCascadeLibraryParticle* theParticles;
+  const long long* Offset;
+  long long NCascades;
+};
+
+
+#endif
+
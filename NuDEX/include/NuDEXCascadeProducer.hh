@@ -0,0 +1,79 @@
+#ifndef NUDEXCASCADEPRODUCER_HH
+#define NUDEXCASCADEPRODUCER_HH 1
+
+
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+#include <atomic>
+#include <thread>
+
+#include "NuDEXStatisticalNucleus.hh"
+#include "NuDEXCascadeSampler.hh"
+#include "NuDEXCascadeQueue.hh"
+#include "NuDEXNeutronSpectrum.hh"
+
+/*
+Background threads generating the cascades of one or several (already initialized) nuclei ahead of demand, into a NuDEXCascadeQueue.
+The consumers (for example the threads of a Geant4 simulation) only take the cascades already generated with GetCascade(index,...),
+where index is for example the event number, so the cascade of each event does not depend on the consumer thread.
+Each producer thread has its own NuDEXCascadeSampler per nucleus. The cascade number index is generated with the seed GetCascadeSeed(index)
+(theRandom3 and theRandom4 of the sampler), so it does not depend on the number of producer threads or on which of them generates it.
+With several nuclei (AddNucleus), the cascade index goes to the realization (index/BlockSize)%NRealizations, as in
+NuDEXNucleusEnsemble::GetRealizationOfEvent, and then to one of the nuclei of this realization, sampled from their weights with
+another seed which also depends only on index.
+*/
+
+class NuDEXCascadeProducer{
+
+public:
+  NuDEXCascadeProducer(NuDEXStatisticalNucleus* aNucleus,unsigned int seed,int queueSize=1024); //aNucleus==0 --> given with AddNucleus
+  ~NuDEXCascadeProducer(); //calls Stop()
+
+public:
+  //Same as in NuDEXStatisticalNucleus::GenerateCascade(...). Has to be called before Start. Default: thermal capture (-1,-1e-6):
+  void SetInitialLevel(int InitialLevel,double ExcitationEnergy){theInitialLevel=InitialLevel; theExcitationEnergy=ExcitationEnergy;}
+  //Another nucleus (before Start), for example an isotope of a mixture, with its weight. If aSpectrum is not 0 (it is not deleted by this class),
+  //the initial level of its cascades is sampled from it, with the seed of the cascade. Realization: if the nucleus is a realization of an ensemble.
+  //Returns the number of the nucleus (0 for the one of the constructor):
+  int AddNucleus(NuDEXStatisticalNucleus* aNucleus,double weight=1,const NuDEXNeutronSpectrum* aSpectrum=0,int Realization=0);
+  void SetRealizationBlockSize(long long BlockSize){theBlockSize=(BlockSize>0)?BlockSize:1;} //before Start
+  void Start(int nThreads);
+  void Stop(); //the threads are stopped, and the cascades still in the queue cannot be taken anymore
+  //Swaps theCascade (maybe 0) with the buffer where the cascade index has been generated (its cascade 0, without particles if it
+  //could not be generated), waiting if it has not been generated yet. The buffer given goes back to the producers, so nothing is copied.
+  //Each index has to be taken once, all of them (0,1,2,...), since the producers cannot go further than GetQueue()->GetNSlots() cascades
+  //beyond the oldest one not taken: with several consumers, the queue has to hold all the indices that they can ask for at the same time.
+  //Returns false if the producer has been stopped. Can be called from several threads at the same time:
+  bool GetCascade(long long index,NuDEXCascadeBuffer*& theCascade){return theQueue->Pop(index,theCascade);}
+  unsigned int GetCascadeSeed(long long index);
+  NuDEXCascadeQueue* GetQueue(){return theQueue;}
+  NuDEXStatisticalNucleus* GetNucleus(int i=0){return theNuclei[i];}
+  int GetNNuclei(){return (int)theNuclei.size();}
+  int GetNThreads(){return (int)theThreads.size();}
+  void PrintStatistics(std::ostream &out);
+
+private:
+  void ProduceCascades(); //loop of each thread
+  int SampleNucleus(long long index,NuDEXRandom* aRandom);
+
+private:
+  std::vector<NuDEXStatisticalNucleus*> theNuclei;
+  std::vector<double> theWeights;
+  std::vector<const NuDEXNeutronSpectrum*> theSpectra;
+  std::vector<int> theRealizations;
+  int NRealizations;
+  long long theBlockSize;
+  std::vector<std::vector<int> > theRealizationNuclei; //[NRealizations], computed at Start
+  std::vector<AliasTable*> theRealizationAlias; //[NRealizations], 0 if only one nucleus
+  NuDEXCascadeQueue* theQueue;
+  unsigned int theSeed;
+  int theInitialLevel;
+  double theExcitationEnergy;
+  std::vector<std::thread> theThreads;
+  std::atomic<long long> NextIndex; //next cascade to be generated
+};
+
+
+#endif
+
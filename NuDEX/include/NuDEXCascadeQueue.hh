@@ -0,0 +1,68 @@
+#ifndef NUDEXCASCADEQUEUE_HH
+#define NUDEXCASCADEQUEUE_HH 1
+
+
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <utility>
+
+#include "NuDEXCascadeBuffer.hh"
+
+/*
+Bounded queue of cascades, filled and emptied by several threads at the same time (multi-producer, multi-consumer), without locks.
+Each cascade has an index (0,1,2,...), and it goes into the slot index%NSlots of a ring. Each slot has a sequence number telling if it
+is free for the cascade index (Sequence==index) or it contains it (Sequence==index+1), as in the bounded MPMC queue of D. Vyukov.
+Each cascade is taken (Pop) by the consumer asking for its index (for example, the cascade index for the event number index), so the
+cascade given to a consumer does not depend on the order in which the cascades are pushed or taken. Each index has to be taken once,
+since its slot is not free for the cascade index+NSlots until then.
+Each slot keeps the cascade in a NuDEXCascadeBuffer, which is not copied: Push and Pop swap it with the buffer of the caller, so the
+buffers (and their memory) go round between the producers, the slots and the consumers, without memory allocations once they are big enough.
+A thread finding its slot not ready (queue full for Push, cascade not generated yet for Pop) waits (spin, yield and then sleep),
+and this is counted as a stall.
+*/
+
+class NuDEXCascadeQueue{
+
+public:
+  NuDEXCascadeQueue(int nSlots);
+  ~NuDEXCascadeQueue();
+
+public:
+  //Each index has to be pushed once, by one thread. Waits while the slot is still used by the cascade index-NSlots.
+  //theCascade (the cascade 0 of the buffer) goes to the slot, and theCascade takes the buffer which was there (maybe 0).
+  //Returns false (without pushing it) if Abort() has been called:
+  bool Push(long long index,NuDEXCascadeBuffer*& theCascade);
+  //Swaps theCascade (maybe 0) with the buffer of the cascade index, waiting until it has been pushed. Each index has to be taken once,
+  //by one thread. Returns false if Abort() has been called:
+  bool Pop(long long index,NuDEXCascadeBuffer*& theCascade);
+  void Abort(); //the threads waiting in Push or Pop return, and the next calls too
+
+  int GetNSlots(){return NSlots;}
+  long long GetDepth(){return NPushed.load()-NPopped.load();} //cascades ready to be taken
+  long long GetNPushed(){return NPushed.load();}
+  long long GetNPopped(){return NPopped.load();}
+  long long GetNPushStalls(){return NPushStalls.load();} //Push calls which had to wait (queue full)
+  long long GetNPopStalls(){return NPopStalls.load();} //Pop calls which had to wait (cascade not ready)
+
+private:
+  void Wait(int& nTries);
+
+private:
+  struct Slot{
+    std::atomic<long long> Sequence;
+    NuDEXCascadeBuffer* Cascade;
+    char padding[64]; //so two slots are not in the same cache line
+  };
+  Slot* theSlots;
+  int NSlots;
+  std::atomic<long long> NPushed,NPopped,NPushStalls,NPopStalls;
+  std::atomic<bool> Aborted;
+};
+
+
+#endif
+
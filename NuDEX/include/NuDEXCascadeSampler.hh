@@ -0,0 +1,81 @@
+
+#ifndef NUDEXCASCADESAMPLER_HH
+#define NUDEXCASCADESAMPLER_HH 1
+
+
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include "NuDEXRandom.hh"
+#include "NuDEXInternalConversion.hh"
+#include "NuDEXStatisticalNucleus.hh"
+#include "NuDEXCascadeBuffer.hh"
+
+/*
+Class to generate the cascades of an (already initialized) NuDEXStatisticalNucleus.
+The nucleus (level scheme, known levels, PSF, ICC, etc.) is not modified, so it can be shared between several threads,
+each of them with its own NuDEXCascadeSampler.
+All the random numbers needed to generate the cascades are taken from the random generators of this class:
+   - theRandom2: to compute on the fly the BR (its seed is changed for each level, so the results do not depend on the thread)
+   - theRandom3: to sample the cascades
+   - theRandom4: to sample the internal conversion
+*/
+
+class NuDEXCascadeSampler{
+
+public:
+  NuDEXCascadeSampler(NuDEXStatisticalNucleus* aNucleus,unsigned int seed);
+  NuDEXCascadeSampler(NuDEXStatisticalNucleus* aNucleus,NuDEXRandom* aRandom2,NuDEXRandom* aRandom3,NuDEXRandom* aRandom4); //the random generators are not deleted by this class
+  ~NuDEXCascadeSampler();
+
+public:
+  //Same as NuDEXStatisticalNucleus::GenerateCascade(...):
+  //If InitialLevel==-1 then we start from the thermal capture level
+  //If ExcitationEnergy>0 then is the excitation energy of the nucleus
+  //If ExcitationEnergy<0 then is a capture reaction of a neutron with energy -ExcitationEnergy (MeV)
+  int GenerateCascade(int InitialLevel,double ExcitationEnergy,std::vector<char>& pType,std::vector<double>& pEnergy,std::vector<double>& pTime);
+  //Same, but NCascades cascades are generated and stored in theBuffer, without any memory allocation once theBuffer is big enough.
+  int GenerateCascades(int NCascades,int InitialLevel,double ExcitationEnergy,NuDEXCascadeBuffer* theBuffer);
+
+  void SetSeed(unsigned int seed); //seed of theRandom3 and theRandom4
+  void ClearBRCache();
+  NuDEXRandom* GetRandom3(){return theRandom3;}
+  NuDEXStatisticalNucleus* GetNucleus(){return theNucleus;}
+
+private:
+  int FillCascade(int InitialLevel,double ExcitationEnergy,NuDEXCascadeBuffer* theBuffer);
+  int SampleFinalLevel(int i_level,int& multipolarity,double &icc_fac,int nTransition);
+  DecayIntensitiesRow* GetCachedDecayIntensities(int i_level,bool& isCached);
+
+private:
+  NuDEXStatisticalNucleus* theNucleus;
+  NuDEXRandom* theRandom2;
+  NuDEXRandom* theRandom3;
+  NuDEXRandom* theRandom4;
+  bool OwnRandomGenerators;
+  NuDEXICCProducts theICCProducts;
+  NuDEXCascadeBuffer* theOwnBuffer; //used by GenerateCascade(...)
+
+  //--------------------------------------------------------------------------
+  //for internal use, when generating the cascades:
+  int theSampledLevel,theSampledMultipolarity;
+  //--------------------------------------------------------------------------
+
+  //--------------------------------------------------------------------------
+  //LRU cache of decay intensities (BROpt=0,2). The levels are in a double linked list, the most recently used first:
+  int CacheNLevels;
+  DecayIntensitiesRow** theCachedRows;
+  int* CachePrev;
+  int* CacheNext;
+  int CacheFirst,CacheLast;
+  double CacheMemory_MB;
+  int CacheNBRChanges;
+  //--------------------------------------------------------------------------
+
+  friend class NuDEXStatisticalNucleus;
+};
+
+
+#endif
+
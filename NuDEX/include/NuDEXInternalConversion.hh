@@ -7,12 +7,16 @@
 #include <fstream>
 #include <cmath>
 #include <cstring>
+#include <string>
 
 #include "NuDEXRandom.hh"
+#include "NuDEXBinaryFile.hh"
 
 #define ICC_MAXNSHELLS 40
 #define ICC_NMULTIP 5
 #define MINZINTABLES 10 //below this value, the alpha is always 0
+#define ICC_BINARYVERSION 1
+#define ICC_MAXORBITALNAME 32
 
 /*
 Class to manage the internal conversion factors and the generation of converted-e-
@@ -20,24 +24,53 @@ Still not included the fluorescence-auger effects, i.e., what happens with the h
 We read the occ factors from a file, and they are stored in a matrix
 The total Icc are in index=0 (data from the libraries) and index=NShells (sum of the partials)
 Data are taken from: https://doi.org/10.1006/adnd.2002.0884
+Init(fname) reads first the binary copy of fname (same name with .bin instead of .dat, see NuDEXBinaryFile.hh), made with MakeBinaryFile.
+If it does not exist, or it was not made from the present version of fname, the text file is read.
+With SetDataCache(true), the data read by Init are also kept in a process-wide cache (by file and Z), and the next objects
+with the same Z take them from there, without reading the file again.
 */
 
+//Particles emitted after an internal conversion (the electron + the ones from filling the hole):
+struct NuDEXICCProducts{
+  int Ne,Ng;
+  double Eele[100],Egam[100];
+};
+
 class NuDEXInternalConversion{
 
 public:
   NuDEXInternalConversion(int Z);
   ~NuDEXInternalConversion();
   void Init(const char* fname);
+  //Writes in binfname all the data of the text file textfname, with an index by Z. Returns -1 if there is an error:
+  static int MakeBinaryFile(const char* textfname,const char* binfname);
+  //Keep the data of each Z read by Init, to be used by the next objects with the same Z (thread safe). false --> the cache is emptied (also while some Init is running):
+  static void SetDataCache(bool useCache);
   void PrintICC(std::ostream &out);
   double GetICC(double Ene,int multipolarity,int i_shell=-1);
   bool SampleInternalConversion(double Ene,int multipolarity,double alpha=-1,bool CalculateProducts=true);
   void FillElectronHole(int i_shell); //Fluorescence/auger
+  //Same as before, but with the random generator and the output given from outside (to be used by several threads at the same time):
+  bool SampleInternalConversion(double Ene,int multipolarity,NuDEXRandom* aRandom,NuDEXICCProducts* theProducts,double alpha=-1,bool CalculateProducts=true);
+  void FillElectronHole(int i_shell,NuDEXRandom* aRandom,NuDEXICCProducts* theProducts);
   void SetRandom4Seed(unsigned int seed){theRandom4->SetSeed(seed);}
+  NuDEXRandom* GetRandom4(){return theRandom4;}
+  //Tabulates, in a uniform log-energy grid with NPointsPerDecade points per decade, the total alpha and the cumulative
+  //fractions of the shells for each multipolarity. Then GetICC(Ene,mult) and the choice of the orbital are a couple of table reads.
+  //The cells with a discontinuity (binding energy or end of the data of a shell) are still computed from the data.
+  void Tabulate(int NPointsPerDecade);
 
 
 private:
   double Interpolate(double val,int npoints,double* x,double* y);
   void MakeTotal();
+  void ReadTextFile(const char* fname);
+  bool ReadBinaryFile(const char* binfname,const char* textfname); //false if binfname does not exist or is not valid for textfname
+  void AllocateShell(int orbindex,int npoints);
+  void CopyData(const NuDEXInternalConversion* other); //all the shells (included the total), from an object with the same Z
+  int GetTableCell(double Ene,int multipolarity,double& f); //-1 if Ene is not in the tables
+  double InterpolateTable(int i_mult,int i_cell,double f);
+  int SampleOrbitalFromTable(double Ene,int multipolarity,double relRand); //relRand in [0,1). -1 if Ene is not in the tables
 
 
 private:
@@ -46,8 +79,18 @@ private:
   double *Eg[ICC_MAXNSHELLS],*Icc_E[ICC_NMULTIP][ICC_MAXNSHELLS],*Icc_M[ICC_NMULTIP][ICC_MAXNSHELLS];
   int np[ICC_MAXNSHELLS];
   std::string OrbitalName[ICC_MAXNSHELLS];
+  double FluoYield[ICC_MAXNSHELLS]; //fluorescence yield of each shell, used to fill the hole
   NuDEXRandom* theRandom4;  
 
+  //--------------------------------------------------------------------------
+  //Tables (if Tabulate has been called). Index of the multipolarity: E1-E5 --> 0-4, M1-M5 --> 5-9
+  int TableNPoints;
+  double TableLogEmin,TableInvDLogE;
+  double *TableAlpha[2*ICC_NMULTIP],*TableLogAlpha[2*ICC_NMULTIP];
+  double *TableCumulFraction[2*ICC_NMULTIP]; //[TableNPoints*(NShells-1)], cumulative fraction of alpha of the shells 1..i
+  bool* TableExactCell; //[TableNPoints-1], true if the cell has a discontinuity
+  //--------------------------------------------------------------------------
+
 public:
   int Ne,Ng;
   double Eele[100],Egam[100];
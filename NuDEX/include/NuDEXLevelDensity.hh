@@ -5,6 +5,8 @@
 #include <iostream>
 #include <fstream>
 #include <cmath>
+#include <vector>
+#include <algorithm>
 
 #include "NuDEXRandom.hh"
 
@@ -20,7 +22,7 @@ class NuDEXLevelDensity{
 
 public:
   NuDEXLevelDensity(int aZ,int aA,int ldtype=DEFAULTLDTYPE);
-  ~NuDEXLevelDensity(){}
+  ~NuDEXLevelDensity();
 
 
   int ReadLDParameters(const char* dirname,const char* inputfname=0,const char* defaultinputfname=0);
@@ -34,6 +36,11 @@ public:
   double EstimateInverse(double LevDen_iMeV,double spin,bool parity); //an approximate value of ExcEnergy(rho), the inverse function of rho(ExcEnergy) - iMeV means 1/MeV
   double Integrate(double Emin,double Emax,double spin,bool parity);
 
+  //Tabulates the level density and its integral between Emin and Emax, for spins up to maxspinx2/2, with NPointsPerMeV points per MeV.
+  //Then Integrate and EstimateInverse use the tables (the level density does not depend on the parity, so there is one table per spin).
+  void Tabulate(double Emin,double Emax,int maxspinx2,int NPointsPerMeV);
+  bool IsTabulated(){return (TableRho!=0);}
+
   void PrintParameters(std::ostream &out);
   void PrintParametersInInputFileFormat(std::ostream &out);
 
@@ -50,6 +57,19 @@ private:
   //Level density parameters:
   double A_mass,ainf_ldpar,gamma_ldpar,dW_ldpar,Delta_ldpar,T_ldpar,E0_ldpar,Ex_ldpar;
 
+  //Tables (only if Tabulate has been called). The energies are a uniform grid plus the points where the level density
+  //has a discontinuity or a kink (Delta, Ed, Sn and Ex), taken twice (just below and at the point).
+  //Between two points the level density is interpolated exponentially (linearly if one of them is 0),
+  //and TableCumul is the integral of the interpolated level density from TableE[0]:
+  int TableNSpins,TableNPoints,TableNBins; //TableNSpins=maxspinx2+1
+  double TableDeltaE; //of the uniform grid
+  double* TableE; //[i]
+  int* TableFirstPoint; //[j] last point with TableE<=TableE[0]+j*TableDeltaE
+  double* TableRho; //[spinx2*TableNPoints+i]
+  double* TableCumul;
+  bool GetTableCell(double ExcEnergy,double spin,int& spinx2,int& i); //false if it is out of the tables
+  double InterpolateCell(int spinx2,int i,double ExcEnergy);
+  double IntegrateCell(int spinx2,int i,double ExcEnergy); //integral of the interpolated level density from TableE[i] to ExcEnergy
 
 };
 
@@ -0,0 +1,62 @@
+#ifndef NUDEXNEUTRONSPECTRUM_HH
+#define NUDEXNEUTRONSPECTRUM_HH 1
+
+
+#include <cstdlib>
+#include <iostream>
+#include <fstream>
+#include <vector>
+
+#include "NuDEXStatisticalNucleus.hh"
+
+/*
+Neutron energy spectrum (histogram) of the captures in an (already initialized) compound nucleus, to generate capture cascades
+at any neutron energy and not only thermal ones.
+The starting levels of each energy bin are found only once, at Init:
+   - bins below ThermalEnergy: the thermal capture level (-1)
+   - other bins: the levels with the spin and parity reached by s-wave capture (|I0|-1/2 and |I0|+1/2, parity of the target)
+     with excitation energy inside the bin, each of them with weight (2J+1)·(number of levels of the band). If there are none,
+     the closest one to the center of the bin.
+The full BR of all these levels are also computed and stored in the nucleus at Init (NuDEXStatisticalNucleus::PrecomputeEntryBR),
+whatever its BROpt is, and the first transition of the cascades is sampled from them. The next transitions are sampled as usual.
+The nucleus is not modified after Init, so the same NuDEXNeutronSpectrum can be used by several threads at the same time.
+*/
+
+class NuDEXNeutronSpectrum{
+
+public:
+  NuDEXNeutronSpectrum(NuDEXStatisticalNucleus* aNucleus);
+  ~NuDEXNeutronSpectrum();
+
+public:
+  //nBins bins with edges binEdges[nBins+1] (neutron energy, MeV) and contents content[nBins] (not normalized).
+  //The BR of the starting levels are computed and stored with nThreads threads. Returns -1 if something is wrong:
+  int Init(int nBins,const double* binEdges,const double* content,double ThermalEnergy=0.5e-6,int nThreads=1);
+  //Reads the histogram from a text file with one bin per line: "Emin Emax content" (MeV). Returns -1 if something is wrong:
+  int Init(const char* fname,double ThermalEnergy=0.5e-6,int nThreads=1);
+  //From three random numbers in [0,1): bin, neutron energy inside the bin (uniform) and starting level of the bin.
+  //InitialLevel and ExcitationEnergy (Sn+(A-1)/A·neutron energy) are the ones to use in GenerateCascade(...). Returns the bin:
+  int Sample(double r1,double r2,double r3,int& InitialLevel,double& ExcitationEnergy) const;
+  int GetNBins() const {return NBins;}
+  const std::vector<int>& GetStartingLevels(int i_bin) const {return theStartingLevels[i_bin];}
+  NuDEXStatisticalNucleus* GetNucleus(){return theNucleus;}
+  void PrintStartingLevels(std::ostream &out) const;
+
+private:
+  void Clear();
+  int FindStartingLevels(int i_bin);
+
+private:
+  NuDEXStatisticalNucleus* theNucleus;
+  int NBins;
+  double ThermalEnergy;
+  std::vector<double> theBinEdges; //[NBins+1]
+  std::vector<double> theBinContents; //[NBins]
+  AliasTable* theBinAlias;
+  std::vector<std::vector<int> > theStartingLevels; //[NBins]
+  std::vector<std::vector<double> > theStartingLevelWeights; //[NBins]
+  std::vector<AliasTable*> theStartingLevelAlias; //[NBins]
+};
+
+
+#endif
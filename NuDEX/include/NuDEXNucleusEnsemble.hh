@@ -0,0 +1,44 @@
+#ifndef NUDEXNUCLEUSENSEMBLE_HH
+#define NUDEXNUCLEUSENSEMBLE_HH 1
+
+
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+#include <thread>
+
+#include "NuDEXStatisticalNucleus.hh"
+#include "NuDEXBinaryFile.hh"
+
+/*
+Several realizations of the same nucleus, which differ only in the random part of the level scheme and BR (SEED1 and SEED2),
+to estimate the uncertainties due to the statistical model in a single job.
+The realization 0 is initialized first, with the seeds given to Init (or the ones of the data library, if 0), so it is the same
+nucleus as the one of a single run. The rest of them are initialized after it, in parallel, with the seeds GetRealizationSeeds(k).
+All of them share the deterministic data: the known levels and ICC are read only once (library data cache), and the
+level density and PSF are the ones of the realization 0 (see NuDEXStatisticalNucleus::SetSharedData).
+*/
+
+class NuDEXNucleusEnsemble{
+
+public:
+  NuDEXNucleusEnsemble(int Z,int A,int NRealizations);
+  ~NuDEXNucleusEnsemble();
+
+public:
+  //nThreads: to initialize the realizations 1,...,NRealizations-1. Returns -1 if any of them cannot be initialized:
+  int Init(const char* dirname,const char* inputfname=0,unsigned int seed1=0,unsigned int seed2=0,int nThreads=1,int BRPrecomputeNThreads=0);
+  int GetNRealizations() const {return (int)theRealizations.size();}
+  NuDEXStatisticalNucleus* GetRealization(int k){return theRealizations[k];}
+  void GetRealizationSeeds(int k,unsigned int& seed1,unsigned int& seed2); //after Init
+  //Realization of the event number iEvent: one after the other (BlockSize=1), or in blocks of BlockSize consecutive events:
+  int GetRealizationOfEvent(long long iEvent,long long BlockSize=1) const;
+
+private:
+  int Z_Int,A_Int;
+  unsigned int theSeed1,theSeed2; //of the realization 0
+  std::vector<NuDEXStatisticalNucleus*> theRealizations;
+};
+
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef NUDEXNUCLEUSREGISTRY_HH
+#define NUDEXNUCLEUSREGISTRY_HH 1
+
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <map>
+#include <mutex>
+#include <future>
+
+#include "NuDEXStatisticalNucleus.hh"
+#include "NuDEXNucleusEnsemble.hh"
+
+/*
+Process-wide registry of initialized nuclei, to be shared by several generators, threads and runs.
+The first call to GetNucleus with some Z, A, LIBDIR and input file creates and initializes the nucleus. The next calls with the
+same arguments return the same object, which is kept until DeleteAll is called (i.e., usually, until the end of the process).
+The nuclei are not modified after Init, so each thread can sample cascades from them with its own NuDEXCascadeSampler.
+The registry also switches on the cache of the library data (see NuDEXStatisticalNucleus::SetLibraryDataCache), so the
+known levels and ICC of an element are read only once, for the first of its isotopes.
+Ensembles of realizations of a nucleus (NuDEXNucleusEnsemble) are kept in the same way by GetEnsemble.
+The registry is locked only to find or insert the entry of a nucleus, and not during its Init: the calls asking for a nucleus
+which is being initialized wait for it, and the other ones (other nuclei, or nuclei already initialized) return at once.
+*/
+
+class NuDEXNucleusRegistry{
+
+public:
+  //Returns 0 if the nucleus cannot be initialized (and then it is not tried again). BRPrecomputeNThreads is used only if the
+  //nucleus is created in this call. If newNucleus!=0, it says if this has been the case:
+  static NuDEXStatisticalNucleus* GetNucleus(int Z,int A,const char* dirname,const char* inputfname=0,int BRPrecomputeNThreads=0,bool* newNucleus=0);
+  static int GetNNuclei();
+  //Same, for an ensemble of NRealizations realizations (with the seeds of the library in the realization 0), initialized with nThreads:
+  static NuDEXNucleusEnsemble* GetEnsemble(int Z,int A,const char* dirname,int NRealizations,const char* inputfname=0,int nThreads=1,int BRPrecomputeNThreads=0,bool* newEnsemble=0);
+  //Deletes all the nuclei and ensembles (they cannot be used anymore) and empties the cache of the library data:
+  static void DeleteAll();
+
+private:
+  static std::string MakeKey(int Z,int A,const char* dirname,const char* inputfname);
+
+private:
+  static std::mutex theMutex;
+  static std::map<std::string,std::shared_future<NuDEXStatisticalNucleus*> > theNuclei; //ready when Init has finished
+  static std::map<std::string,std::shared_future<NuDEXNucleusEnsemble*> > theEnsembles;
+};
+
+
+#endif
+
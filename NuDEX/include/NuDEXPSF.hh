@@ -5,6 +5,7 @@
 #include <iostream>
 #include <fstream>
 #include <cmath>
+#include <algorithm>
 
 //using namespace std;
 
@@ -42,6 +43,28 @@ Procedure to obtain the PSF, in order of hierarchy:
 */
 
 
+class NuDEXPSF;
+struct PSFTerm;
+//Shape of a PSF term, resolved at Init. It adds the PSF of the term for n gamma energies to result[]:
+typedef void (NuDEXPSF::*PSFShapeFunction)(int n,const double* Eg,double ExcitationEnergy,const PSFTerm& term,double* result);
+
+//One term (resonance) of the PSF:
+struct PSFTerm{
+  PSFShapeFunction Shape;
+  double Norm; //8.674E-8 (E1, M1) or 5.22E-8 (E2)
+  double Er,Gr,sr;
+  double k1,k2,Temp; //MEGLO
+  int Opt; //EGLO, GLO, MGLO
+  int np; double* x; double* y; //pointwise functions
+};
+
+//PSF tabulated in a regular grid of (Eg,Ef), with Ef=ExcitationEnergy-Eg the energy of the final level:
+struct PSFGrid{
+  int nEg,nEf; //nEf=1 if the PSF does not depend on the excitation energy
+  double Egmin,dEg,dEf; //Ef starts at 0
+  double* Value; //Value[i_Ef*nEg+i_Eg]
+  double MaxRelError; //maximum relative error found in the middle of the cells
+};
 
 class NuDEXPSF{
 
@@ -53,11 +76,20 @@ public:
   double GetE1(double Eg,double ExcitationEnergy);
   double GetM1(double Eg,double ExcitationEnergy);
   double GetE2(double Eg,double ExcitationEnergy);
+  //Same, for n gamma energies (Eg[]) with the same ExcitationEnergy:
+  void GetE1(int n,const double* Eg,double ExcitationEnergy,double* result);
+  void GetM1(int n,const double* Eg,double ExcitationEnergy,double* result);
+  void GetE2(int n,const double* Eg,double ExcitationEnergy,double* result);
+  //Tabulate the PSF up to ExMax, with a relative interpolation error below MaxRelError. Then GetE1/GetM1/GetE2 interpolate.
+  //If PrintSummary, the size of the grids is printed:
+  void Tabulate(double ExMax,double MaxRelError,bool PrintSummary=false);
+  bool IsTabulated(){return (theE1Grid!=0);}
   void PrintPSFParameters(std::ostream &out);
   void PrintPSFParametersInInputFileFormat(std::ostream &out);
 
 private:
 
+  void TakePSFData(const char* dirname,const char* inputfname,const char* defaultinputfname,int PSFflag);
   bool TakePSFFromInputFile(const char* fname);
   bool TakePSFFromDetailedParFile(const char* fname);
   bool TakePSFFromIAEA01(const char* fname); // IAEA - PSF values 2019
@@ -66,6 +98,34 @@ private:
   void GenerateM1AndE2FromE1(); // From RIPL-3 and RIPL-2 recommendations
 
 
+  //Computed PSF (without the grids):
+  double ComputeE1(double Eg,double ExcitationEnergy);
+  double ComputeM1(double Eg,double ExcitationEnergy);
+  double ComputeE2(double Eg,double ExcitationEnergy);
+  double ComputePSF(int multipolarity,double Eg,double ExcitationEnergy); //multipolarity: 1,2,3 --> E1,M1,E2
+  void EvaluatePSF(int multipolarity,int n,const double* Eg,double ExcitationEnergy,double* result);
+  void GetPSF(int multipolarity,const PSFGrid* theGrid,int n,const double* Eg,double ExcitationEnergy,double* result);
+  void ResolvePSF();
+
+  //Shapes, as PSFShapeFunction:
+  void Shape_SLO(int n,const double* Eg,double ExcitationEnergy,const PSFTerm& term,double* result);
+  void Shape_EGLO_GLO_MGLO(int n,const double* Eg,double ExcitationEnergy,const PSFTerm& term,double* result);
+  void Shape_SMLO(int n,const double* Eg,double ExcitationEnergy,const PSFTerm& term,double* result);
+  void Shape_KMF(int n,const double* Eg,double ExcitationEnergy,const PSFTerm& term,double* result);
+  void Shape_GH(int n,const double* Eg,double ExcitationEnergy,const PSFTerm& term,double* result);
+  void Shape_MEGLO(int n,const double* Eg,double ExcitationEnergy,const PSFTerm& term,double* result);
+  void Shape_SMLO_v2(int n,const double* Eg,double ExcitationEnergy,const PSFTerm& term,double* result);
+  void Shape_Gauss(int n,const double* Eg,double ExcitationEnergy,const PSFTerm& term,double* result);
+  void Shape_Expo(int n,const double* Eg,double ExcitationEnergy,const PSFTerm& term,double* result);
+  void Shape_Pointwise(int n,const double* Eg,double ExcitationEnergy,const PSFTerm& term,double* result); //PSFType=40
+  void Shape_PointwiseLog(int n,const double* Eg,double ExcitationEnergy,const PSFTerm& term,double* result); //PSFType=41
+
+  //Grids:
+  bool DependsOnExcitationEnergy(int multipolarity);
+  PSFGrid* CreateGrid(int multipolarity,double ExMax,double MaxRelError);
+  bool InterpolateGrid(const PSFGrid* theGrid,double Eg,double ExcitationEnergy,double& result);
+  void DeleteGrids();
+
   //Shapes:
   //Typical ones:
   double SLO(double Eg,double Er,double Gr,double sr);                          //PSFType=0
@@ -113,6 +173,19 @@ private:
   double EvaluateFunction(double xval,int np,double* x,double* y);
   void Renormalize();
 
+  //-----------------------------------------------
+  //PSF terms of E1, M1 and E2, resolved by ResolvePSF():
+  int nTerms[3];
+  PSFTerm theTerms[3][10];
+  //-----------------------------------------------
+
+  //-----------------------------------------------
+  //Tabulated PSF (only if Tabulate has been called):
+  PSFGrid* theE1Grid;
+  PSFGrid* theM1Grid;
+  PSFGrid* theE2Grid;
+  //-----------------------------------------------
+
   NuDEXLevelDensity* theLD;
 };
 
@@ -5,6 +5,7 @@
 #include <iostream>
 #include <fstream>
 #include <cmath>
+#include <string>
 
 //COMPILATIONTYPE==1 compile with ROOT
 //COMPILATIONTYPE==2 compile with GEANT4
@@ -30,6 +31,16 @@
   #error Unsupported COMPILATIONTYPE setting
 #endif
 
+#if COMPILATIONTYPE == 1
+//TRandom2 with access to the state of the generator (protected in TRandom2):
+class NuDEXTRandom2:public TRandom2{
+public:
+  NuDEXTRandom2(unsigned int seed):TRandom2(seed){}
+  void GetState(unsigned int* state){state[0]=fSeed; state[1]=fSeed1; state[2]=fSeed2;}
+  void SetState(const unsigned int* state){fSeed=state[0]; fSeed1=state[1]; fSeed2=state[2];}
+};
+#endif
+
 void NuDEXException(const char* originOfException,const char* exceptionCode,const char* description);
 
 class NuDEXRandom{
@@ -46,11 +57,16 @@ public:
   double Exp(double tau);
   double Gaus(double mean=0,double sigma=1);
   int Poisson(double mean);
+  double Gamma(double shape,double scale=1);
+  double ChiSquare(double nu); //nu degrees of freedom
+  //The state of the generator, to continue later from the same point (SetState returns false if the state is not valid):
+  std::string GetState();
+  bool SetState(const std::string& state);
 
 private:
 
 #if COMPILATIONTYPE == 1
-  TRandom2* theRandom;
+  NuDEXTRandom2* theRandom;
 #elif COMPILATIONTYPE == 2
   CLHEP::HepJamesRandom* theEngine;
   CLHEP::RandFlat* theRandFlat;
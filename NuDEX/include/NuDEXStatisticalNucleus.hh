@@ -5,18 +5,32 @@
 #include <iostream>
 #include <fstream>
 #include <cmath>
+#include <sstream>
+#include <iomanip>
 #include <vector>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <string>
+#include <memory>
 
 #include "NuDEXRandom.hh"
 #include "NuDEXLevelDensity.hh"
 #include "NuDEXInternalConversion.hh"
 #include "NuDEXPSF.hh"
+#include "NuDEXBinaryFile.hh"
 
 
 
 //This define remains:
 //#define GENERATEEXPLICITLYALLLEVELSCHEME 1
 
+//Number of transitions for which the PSF are evaluated together, when computing the decay of a level:
+#define PSFBLOCKSIZE 64
+
+#define KNOWNLEVELS_BINARYVERSION 1
+#define SNAPSHOT_VERSION 2
+
 //Class to obtain the level density for each excitation energy, spin, and parity
 //All energies in MeV, all times in s
 //Some of the class methods could be functions out of the class
@@ -31,6 +45,15 @@ struct Level{
   double Width;
 };
 
+//Copy of the level scheme as a structure of arrays, used by the vectorized loops over the final levels (selection rules and Eg only):
+struct LevelsSoA{
+  double* Energy;
+  double* LowEdge; //Energy-Width
+  double* HighEdge; //Energy+Width
+  int* spinx2;
+  int* parity; //1/0 --> positive,negative
+};
+
 
 
 //multipolarity of a transition is ...,-2,-1,0,1,2,... --> ...,M2,M1,Unk,E1,E2,...
@@ -48,13 +71,79 @@ struct KnownLevel{
   int NGammas;
   int *FinalLevelID,*multipolarity;
   double *Eg,*cumulPtot,*Pg,*Pe,*Icc;
+  bool GammasInPool; //true if the arrays of the gammas are in the memory pool of the known levels (not deleted one by one)
+};
+
+//Known levels, as they are read from the files KnownLevels/zXXX.dat (before sampling the missing spins and parities and normalizing the BR).
+//They are also the records of the binary copies of these files (zXXX.bin), where each nucleus (one index entry) has
+//its KnownLevelRecord[NLevels], then the KnownGammaRecord[NGammas] and then the KnownDecayRecord[NDecays] of all its levels:
+struct KnownNucleusRecord{
+  int Z,A,NLevels,NGammas,NDecays,unused;
+  double Sn;
+  long long offset; //binary file: position of the first KnownLevelRecord
+};
+struct KnownLevelRecord{
+  double Energy,spin,parity,T12;
+  int id,NGammas,Ndecays,unused;
+};
+struct KnownGammaRecord{
+  double Eg,Pg,Pe,Icc;
+  int FinalLevelID,unused;
+};
+struct KnownDecayRecord{
+  double decayFraction;
+  char decayMode[8];
 };
 
 
 
-int ComparisonLevels(const void* va, const void* vb);
+//Cumulative BR of a level, only for the allowed (non-zero) transitions (one row of a compressed sparse matrix):
+struct SparseBR{
+  int N;
+  int* FinalLevel;
+  double* CumulBR; //only one of CumulBR or CumulBRf is used (BRStorageOpt==0 or 1)
+  float* CumulBRf;
+};
+
+//Partial sums of the decay intensities (GammaRho) of a level, only for the allowed (non-zero) transitions.
+//With them the final level and multipolarity are sampled as in ComputeDecayIntensities(i_level,0,randnumber), without computing them again:
+struct DecayIntensitiesRow{
+  int N;
+  int* FinalLevel;
+  double* SumGammaRho; //sum of the GammaRho up to this transition (included)
+  double* GammaRhoMult; //[3*k+m], partial GammaRho of the transition k after adding E1,M1,E2 (-1 if not allowed)
+};
+
+//Walker/Vose alias table, to sample from a discrete distribution with only one random number in O(1):
+struct AliasTable{
+  int N;
+  double* Prob;
+  int* Alias;
+};
+
+
+
+class NuDEXCascadeSampler;
+class NuDEXCascadeBuffer;
+struct SnapshotHeader;
+
+bool LevelEnergyLess(const Level& a,const Level& b); //to sort the levels by energy
 void CopyLevel(Level* a,Level* b);
 void CopyLevel(KnownLevel* a,Level* b);
+AliasTable* CreateAliasTable(const double* cumulativeBR,int n); //from a cumulative distribution
+void DeleteAliasTable(AliasTable* a);
+int SampleFromAliasTable(const AliasTable* a,double randnumber);
+int SampleFromCumulative(const double* cumulativeBR,int n,double randnumber); //binary search, returns the first i with cumulativeBR[i]>randnumber, -1 if none
+int FindClosestEnergy(const double* energies,int n,double Energy); //binary search in the sorted energies, returns the i of the closest one (the first one if there are several), -1 if none
+SparseBR* CreateSparseBR(const double* cumulativeBR,int n,bool useFloat); //from a dense cumulative distribution
+void DeleteSparseBR(SparseBR* a);
+double GetSparseBRCumul(const SparseBR* a,int k);
+AliasTable* CreateAliasTable(const SparseBR* a); //the index sampled is the one of a->FinalLevel
+int SampleFromSparseBR(const SparseBR* a,double randnumber); //returns the final level, -1 if none
+void DeleteDecayIntensitiesRow(DecayIntensitiesRow* a);
+double GetDecayIntensitiesRowMemory_MB(const DecayIntensitiesRow* a);
+int SampleFromDecayIntensitiesRow(const DecayIntensitiesRow* a,double SampledGammaRho,int& multipolarity); //returns the final level, -1 if none
+int SampleMultipolarity(double PreviousGammaRho,const double* GammaRhoMult,double SampledGammaRho);
 
 
 class NuDEXStatisticalNucleus{
@@ -71,12 +160,19 @@ public:
   //If InitialLevel==-1 then we start from the thermal capture level
   //If ExcitationEnergy>0 then is the excitation energy of the nucleus
   //If ExcitationEnergy<0 then is a capture reaction of a neutron with energy -ExcitationEnergy (MeV)
+  //Uses an internal NuDEXCascadeSampler with theRandom3. To generate cascades from several threads, use one NuDEXCascadeSampler per thread.
   int GenerateCascade(int InitialLevel,double ExcitationEnergy,std::vector<char>& pType,std::vector<double>& pEnergy,std::vector<double>& pTime);
+  //Same, but NCascades cascades are stored in theBuffer (see NuDEXCascadeBuffer). Returns the total number of particles.
+  int GenerateCascades(int NCascades,int InitialLevel,double ExcitationEnergy,NuDEXCascadeBuffer* theBuffer);
 
   int GetClosestLevel(double Energy,int spinx2,bool parity); //if spinx2<0, then retrieves the closest level of any spin and parity
   double GetLevelEnergy(int i_level);
   void GetSnAndI0(double &sn,double &i0){sn=Sn; i0=I0;}
   Level* GetLevel(int i_level);
+  int GetNLevels(){return NLevels;}
+  int GetZ(){return Z_Int;}
+  int GetA(){return A_Int;}
+  //The BR are changed in place, so these two cannot be used once a NuDEXCascadeSampler (or a NuDEXCascadeProducer) has been created for this nucleus, apart from the one of GenerateCascade(s):
   void ChangeLevelSpinParityAndBR(int i_level,int newspinx2,bool newParity,int nlevels,double width,unsigned int seed=0); //if nlevels or width are negative they don't change. If seed (to generate the BR) is 0 it does not change.
   void ChangeThermalCaptureLevelBR(double LevelEnergy,double absoluteIntensity);
 
@@ -84,6 +180,30 @@ public:
   void SetInitialParameters02(int knownLevelsFlag=-1,int electronConversionFlag=-1,double primGamNormFactor=-1,double primGamEcut=-1,double ecrit=-1);
   void SetBandWidth(double bandWidth){ if(bandWidth==0){bandWidth=-1;} BandWidth=bandWidth;} //So it is not re-written with the lib-params.
   void SetBrOption(int BrOption){BROpt=BrOption;}
+  void SetBRSamplingOption(int brSamplingOption){BRSamplingOpt=brSamplingOption;} //0: binary search in the cumulative BR, 1: alias tables
+  void SetBRStorageOption(int brStorageOption){BRStorageOpt=brStorageOption;} //0: stored BR in double, 1: in float
+  void SetBRCacheSize(double cacheSize_MB){BRCacheSize_MB=cacheSize_MB;} //BROpt=0,2: memory (per NuDEXCascadeSampler) to keep the decay intensities of the last levels used. 0 --> no cache
+  void SetVerbosity(int verbosity){Verbosity=verbosity;} //messages of Init: 0 none, 1 (default) summary of the nucleus, 2 also of the tabulated PSF
+  void SetPSFTabulationError(double maxRelError){PSFTabulationError=maxRelError;} //if >0, the PSF are tabulated at Init with this max. relative interpolation error. 0 --> computed each time
+  void SetICCTablePointsPerDecade(int nPointsPerDecade){ICCTablePointsPerDecade=nPointsPerDecade;} //if >0, the ICC are tabulated at Init with this number of points per decade. 0 --> computed each time
+  void SetLDTablePointsPerMeV(int nPointsPerMeV){LDTablePointsPerMeV=nPointsPerMeV;} //if >0, the level density and its integral are tabulated at Init with this number of points per MeV. 0 --> computed each time
+  //If >0, each spin and parity of the unknown levels is generated with its own random numbers (taken from seed1), with nThreads threads.
+  //The level scheme does not depend on nThreads, but it is different from the one with 0 (all of them generated one after the other with theRandom1):
+  void SetLevelSchemeNThreads(int nThreads){LevelSchemeNThreads=nThreads;}
+  void SetBRPrecomputeNThreads(int nThreads){BRPrecomputeNThreads=nThreads;} //if >0, all the BR are computed at Init with nThreads threads. 0 --> computed when needed
+  //If set, Init reads the level scheme, known levels and BR from a snapshot in snapshotDir, made by a previous Init with the same inputs (ZA, parameters, seeds, input files and library files, which have not been modified since then).
+  //If there is no such snapshot, Init creates everything as usual and writes it at the end (with the BR computed until then, all of them if BRPrecomputeNThreads>0):
+  void SetSnapshotDir(const char* snapshotDir){theSnapshotDir=std::string(snapshotDir);}
+  //If set, Init takes the level density and PSF from aNucleus (already initialized with the same Z, A, library and input files),
+  //instead of creating them again. They do not depend on the seeds. aNucleus has to be deleted after this one:
+  void SetSharedData(NuDEXStatisticalNucleus* aNucleus){theSharedDataNucleus=aNucleus;}
+  //Computes now all the BR (BROpt=1) or total GammaRho (BROpt=0,2) of the statistical levels. Same result as computing them when needed:
+  void PrecomputeBR(int nThreads);
+  void PrecomputeBR(int nThreads,const std::vector<int>& levels); //only of these levels
+  //Computes now and stores the BR of these levels, whatever BROpt is. They are used for the first transition of the cascades starting there:
+  void PrecomputeEntryBR(int nThreads,const std::vector<int>& levels);
+  double GetBRMemoryBudget_MB(){return BRMemoryBudget_MB;} //maximum memory needed to store the BR (BROpt=1,2), computed at Init
+  void GetSeeds(unsigned int& s1,unsigned int& s2,unsigned int& s3){s1=seed1; s2=seed2; s3=seed3;}
   void SetRandom1Seed(unsigned int seed){theRandom1->SetSeed(seed); Rand1seedProvided=true;}
   void SetRandom2Seed(unsigned int seed){theRandom2->SetSeed(seed); Rand2seedProvided=true;}
   void SetRandom3Seed(unsigned int seed){theRandom3->SetSeed(seed); Rand3seedProvided=true;}
@@ -91,6 +211,13 @@ public:
   NuDEXRandom* GetRandom3(){return theRandom3;}
   bool HasBeenInitialized(){return hasBeenInitialized;}
 
+  //Writes in binfname all the nuclei of the known levels file textfname (KnownLevels/zXXX.dat), with an index by Z,A.
+  //Init reads it instead of the text file (see NuDEXBinaryFile.hh). Returns -1 if there is an error:
+  static int MakeKnownLevelsBinaryFile(const char* textfname,const char* binfname);
+  //If true, the known levels files (all the nuclei of each file) and ICC data read by Init are kept in a process-wide cache,
+  //and the next nuclei of the same element take them from there (thread safe). false --> the cache is emptied (the data used by some Init running are kept until it finishes):
+  static void SetLibraryDataCache(bool useCache);
+
 
   //-------------------------------------------------------
   //Print:
@@ -120,6 +247,18 @@ private:
   int ReadGeneralStatNuclParameters(const char* fname);
   double ReadEcrit(const char* fname);
   double ReadKnownLevels(const char* fname);
+  //Reads NLevels levels from the present position of in:
+  static int ReadKnownLevelsRecords(std::istream& in,int NLevels,std::vector<KnownLevelRecord>& levels,std::vector<KnownGammaRecord>& gammas,std::vector<KnownDecayRecord>& decays);
+  static const KnownNucleusRecord* FindKnownNucleus(const char* data,size_t size,int Z,int A); //in a binary file, 0 if not there
+  //Same content as the binary file made by MakeKnownLevelsBinaryFile, in image. Returns -1 if there is an error:
+  static int MakeKnownLevelsImage(const char* textfname,std::string& image);
+  //The binary file of fname, memory mapped. With the cache (see SetLibraryDataCache) it is mapped, or made from the text file fname
+  //if there is no binary file, only once, and kept while the cache or some nucleus reading it holds it. 0 if it cannot be read:
+  static std::shared_ptr<const NuDEXFileData> GetKnownLevelsFile(const char* fname);
+  //The levels and gammas are copied from the records, since their spins, parities and intensities are completed and normalized here
+  //(and the multipolarities later) for each nucleus, so the records of the binary file are only read:
+  void FillKnownLevels(double newSn,int nRecords,const KnownLevelRecord* levels,const KnownGammaRecord* gammas,const KnownDecayRecord* decays,const char* fname);
+  int BuildLevelScheme(const char* dirname); //known levels + CreateLevelScheme + InsertHighEnergyKnownLevels + seeds of the levels
   void CreateLevelScheme();
   int InsertHighEnergyKnownLevels();
   void ComputeKnownLevelsMissingBR();
@@ -127,13 +266,36 @@ private:
   //-------------------------------------------------------
   double TakeTargetNucleiI0(const char* fname,int& check);
   void CreateThermalCaptureLevel(unsigned int seed=0); //If seed (to generate the BR) is 0 it does not change.
+  void CheckNoAttachedSamplers(); //exception if there are other samplers than theDefaultSampler
   void GenerateThermalCaptureLevelBR(const char* dirname);
+  void ComputeBRMemoryBudget();
+  bool HasStatisticalBR(int i_level); //true if the decay of the level is computed from the PSF (i.e., not taken from the known levels)
+  //-------------------------------------------------------
+
+  //-------------------------------------------------------
+  //Snapshots (see SetSnapshotDir):
+  std::string MakeSnapshotKey(const char* inputfname,const char* definputfname); //all the inputs which define the level scheme and BR
+  std::string GetSnapshotFileName(const std::string& key);
+  int ReadSnapshot(const char* fname,const std::string& key); //returns -1 if there is no valid snapshot for this key
+  int ReadSnapshotBody(const std::string& body,const SnapshotHeader& header); //returns -1 if the body is not consistent with the header
+  int WriteSnapshot(const char* fname,const std::string& key);
   //-------------------------------------------------------
 
   //-------------------------------------------------------
   //cascade generation:
-  double ComputeDecayIntensities(int i_level,double* cumulativeBR=0,double randnumber=-1,double TotGR=-1,bool AllowE1=false);
-  int SampleFinalLevel(int i_level,int& multipolarity,double &icc_fac,int nTransition);
+  //If theSampler!=0, its random generator is used to compute the intensities and the sampled level is stored there (needed if randnumber>0)
+  double ComputeDecayIntensities(int i_level,double* cumulativeBR=0,double randnumber=-1,double TotGR=-1,bool AllowE1=false,NuDEXCascadeSampler* theSampler=0);
+  //Thread-safe access to the BR computed on demand:
+  SparseBR* GetTotalCumulBR(int i_level,NuDEXCascadeSampler* theSampler);
+  AliasTable* GetTotalAliasBR(int i_level,NuDEXCascadeSampler* theSampler);
+  double GetTotalGammaRho(int i_level,NuDEXCascadeSampler* theSampler);
+  DecayIntensitiesRow* ComputeDecayIntensitiesRow(int i_level,NuDEXCascadeSampler* theSampler,bool AllowE1=false);
+  void ComputeAllowedMultipolarities(int i_level,int j0,int n,bool AllowE1,int* Allowed,double* Eg);
+  void ComputeAllowedMultipolarities(int i_level,const int* FinalLevels,int n,int* Allowed,double* Eg);
+  void ComputeTransitionsPSF(int i_level,const int* FinalLevels,int j0,int n,bool AllowE1,int* Allowed,double* PSFValues);
+  const int* GetReachableLevels(int i_level,int& nReachable);
+  double ComputeTransitionIntensity(int i_level,int j_level,int Allowed,const double* PSFValues,NuDEXRandom* aRandom2,double* GammaRhoMult);
+  double SampleSumOfWidths(int RealNTransitions,NuDEXRandom* aRandom2);
   int GetMultipolarity(Level* theInitialLevel,Level* theFinalLevel);
   //-------------------------------------------------------
 
@@ -141,13 +303,21 @@ private:
 private:
   //-------------------------------------------------------
   //Used to create the unknown Levels:
-  int GenerateLevelsInBigRange(double Emin,double Emax,int spinx2,bool parity,Level* someLevels,int MaxNLevelsToFill); //salen sin ordenar
-  int GenerateLevelsInSmallRange(double Emin,double Emax,int spinx2,bool parity,Level* someLevels,int MaxNLevelsToFill); //salen sin ordenar
-  int GenerateWignerLevels(double Emin,double Emax,int spinx2,bool parity,Level* someLevels,int MaxNLevelsToFill); //salen ordenados
-  int GenerateBandLevels(int bandmin,int bandmax,int spinx2,bool parity,Level* someLevels,int MaxNLevelsToFill);
-  int GenerateAllUnknownLevels(Level* someLevels,int MaxNLevelsToFill); //salen ordenados
-  int CreateBandsFromLevels(int thisNLevels,Level* someLevels,int spinx2,bool parity); 
-  int EstimateNumberOfLevelsToFill(); //to estimate the length of "theLevels" vector
+  //The levels are added at the end of someLevels. They return the number of levels added:
+  int GenerateLevelsInBigRange(double Emin,double Emax,int spinx2,bool parity,std::vector<Level>& someLevels,NuDEXRandom* aRandom1); //salen sin ordenar
+  int GenerateLevelsInSmallRange(double Emin,double Emax,int spinx2,bool parity,std::vector<Level>& someLevels,NuDEXRandom* aRandom1); //salen sin ordenar
+  int GenerateWignerLevels(double Emin,double Emax,int spinx2,bool parity,std::vector<Level>& someLevels,NuDEXRandom* aRandom1); //salen ordenados
+  int GenerateBandLevels(int bandmin,int bandmax,int spinx2,bool parity,std::vector<Level>& someLevels,NuDEXRandom* aRandom1);
+  int GenerateUnknownLevels(int spinx2,bool parity,std::vector<Level>& someLevels,NuDEXRandom* aRandom1); //one spin and parity, salen sin ordenar
+  int GenerateAllUnknownLevels(std::vector<Level>& someLevels); //salen ordenados
+  int GenerateAllUnknownLevelsInParallel(std::vector<Level>& someLevels,int nThreads); //salen ordenados
+  unsigned int GetLevelSchemeSubstreamSeed(int spinx2,bool parity); //seed of the random numbers of each spin and parity, taken from seed1
+  int CreateBandsFromLevels(std::vector<Level>& someLevels,int FirstLevel,int spinx2,bool parity); //the levels from FirstLevel
+  void FillLevelsSoA();
+  void UpdateLevelsSoA(int i_level); //after changing theLevels[i_level]
+  void DeleteLevelsSoA();
+  void CreateSpinParityClasses();
+  void DeleteSpinParityClasses();
   //-------------------------------------------------------
 
 
@@ -158,6 +328,7 @@ private:
   double Sn,D0,I0; //I0 es el del nucleo A-1 (el que captura)
   bool hasBeenInitialized;
   std::string theLibDir;
+  std::string theSnapshotDir;
 
   NuDEXRandom* theRandom1;  //To generate the unknown level scheme
   NuDEXRandom* theRandom2;  //To calculate the Gamma-rho values (i.e. to generate the branching ratios)
@@ -172,6 +343,11 @@ private:
   int maxspinx2,NBands,MinLevelsPerBand; //maximum spin (x2) to consider, number of bands used to "rebin" the stat. part
   int LevelDensityType; //if negative or cero, use the default one.
   int PSFflag; // use IAEA PSF-data (PSFflag==0), use RIPL-3 data (PSFflag==1)
+  double PSFTabulationError; // if >0, the PSF are tabulated at Init, with this maximum relative interpolation error
+  int Verbosity; // messages printed by Init (see SetVerbosity)
+  int ICCTablePointsPerDecade; // if >0, the ICC are tabulated at Init, with this number of points per decade
+  int LevelSchemeNThreads; // if >0, the unknown levels are generated with a random substream per spin and parity, with this number of threads
+  int LDTablePointsPerMeV; // if >0, the level density is tabulated at Init (to create the level scheme), with this number of points per MeV
   double E_unk_min,E_unk_max; //min and max energy where the statistical part will be generated
   double Emin_bands,Emax_bands; //limites de energia para calcular las bandas de niveles
   //--------------------------------------------------------------------------
@@ -180,18 +356,36 @@ private:
   //Level scheme:
   Level* theLevels; //known+unknown levels
   KnownLevel* theKnownLevels; // known levels
+  int* theKnownLevelsIntPool; //arrays of the known levels, as read from the file
+  double* theKnownLevelsDoublePool;
   int NKnownLevels,NUnknownLevels,NLevels,KnownLevelsVectorSize;
   Level theThermalCaptureLevel;
   int NLevelsBelowThermalCaptureLevel; //excluding the last one
   int KnownLevelsFlag;
+  LevelsSoA theLevelsSoA; //filled by FillLevelsSoA(), once theLevels is complete
+  //Spin-parity classes: class=parity*NClassSpins+spinx2 (if NClasses==0, there are no classes and all the levels are visited):
+  int NClasses,NClassSpins;
+  int* theLevelClass; //class of each level
+  int* theClassMultipolarities; //[NClasses*NClasses] allowed multipolarities (1:E1 + 2:M1 + 4:E2) of the transitions between two classes
+  std::vector<int>* theClassLevels; //[NClasses] levels of each class, sorted
+  std::vector<double>* theClassEnergies; //[NClasses] energies of theClassLevels, to find the closest level of each class (GetClosestLevel)
+  std::vector<int>* theReachableLevels; //[NClasses] levels that can be reached from each class (theClassMultipolarities>0), sorted. Also for the empty classes (the thermal capture level can be in one of them)
   //--------------------------------------------------------------------------
 
   //--------------------------------------------------------------------------
   //Branching ratios:
-  int BROpt,SampleGammaWidths;
-  double* TotalGammaRho;
+  int BROpt,SampleGammaWidths; //SampleGammaWidths: 0 no Porter-Thomas fluctuations, 1 sum of squared Gaussians, 2 sampled from a chi-squared distribution
+  int BRSamplingOpt; //how the final level is sampled from the stored BR (BROpt=1,2 and thermal capture level): 0 binary search, 1 alias tables
+  int BRStorageOpt; //precision of the stored BR (BROpt=1,2): 0 double, 1 float
+  double BRMemoryBudget_MB,BRMemoryDense_MB;
+  double BRCacheSize_MB; //BROpt=0,2: cache of decay intensities, in each NuDEXCascadeSampler
+  int BRPrecomputeNThreads;
+  std::atomic<int> NBRChanges; //number of calls to ChangeLevelSpinParityAndBR, to know if the cached decay intensities are still valid
+  std::atomic<double>* TotalGammaRho;
   double* theThermalCaptureLevelCumulBR;
-  double** TotalCumulBR; //all BR
+  AliasTable* theThermalCaptureLevelAliasBR; //only if BRSamplingOpt==1
+  std::atomic<SparseBR*>* TotalCumulBR; //all (non-zero) BR (BROpt=0: only the ones of PrecomputeEntryBR). TotalGammaRho and TotalCumulBR are computed on demand, maybe from several threads
+  std::atomic<AliasTable*>* TotalAliasBR; //same as TotalCumulBR, but in alias tables (only if BRSamplingOpt==1)
   double PrimaryGammasIntensityNormFactor;
   double PrimaryGammasEcut; //This variable can be used to avoid generating transitions close to the "Primary Gammas" region
   //--------------------------------------------------------------------------
@@ -205,9 +399,13 @@ private:
   //--------------------------------------------------------------------------
 
   //--------------------------------------------------------------------------
-  //for internal use, when generating the cascades:
-  int theSampledLevel,theSampledMultipolarity;
+  //for internal use, when generating the cascades with GenerateCascade(...):
+  NuDEXCascadeSampler* theDefaultSampler;
+  std::atomic<int> NAttachedSamplers; //number of NuDEXCascadeSampler of this nucleus (including theDefaultSampler), which could be reading the BR from other threads
+  NuDEXStatisticalNucleus* theSharedDataNucleus; //if !=0, theLD and thePSF belong to it (see SetSharedData)
   //--------------------------------------------------------------------------
+
+  friend class NuDEXCascadeSampler;
 };
 
 //***************************************************************************************************************
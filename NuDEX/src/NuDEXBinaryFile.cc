@@ -0,0 +1,120 @@
+
+#include "NuDEXBinaryFile.hh"
+#include <algorithm>
+#include <sys/stat.h>
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+
+int NuDEXMakeBinaryHeader(NuDEXBinaryHeader* header,const char* magic,int version,int nEntries,const char* textfname){
+
+  struct stat st;
+  if(stat(textfname,&st)!=0){return -1;}
+  memset(header,0,sizeof(NuDEXBinaryHeader));
+  memcpy(header->magic,magic,std::min(strlen(magic),sizeof(header->magic)));
+  header->version=version;
+  header->nEntries=nEntries;
+  header->textSize=st.st_size;
+  header->textMTime=st.st_mtime;
+  return 0;
+}
+
+
+const char* NuDEXMapBinaryFile(const char* binfname,const char* magic,int version,const char* textfname,size_t& size){
+
+  size=0;
+  size_t fsize;
+  const char* map=NuDEXMapFile(binfname,fsize);
+  if(map==0){return 0;}
+  if(fsize<sizeof(NuDEXBinaryHeader)){NuDEXUnmapBinaryFile(map,fsize); return 0;}
+
+  const NuDEXBinaryHeader* header=(const NuDEXBinaryHeader*)map;
+  char theMagic[8];
+  memset(theMagic,0,sizeof(theMagic));
+  memcpy(theMagic,magic,std::min(strlen(magic),sizeof(theMagic)));
+  if(memcmp(header->magic,theMagic,sizeof(theMagic))!=0 || header->version!=version || header->nEntries<0){
+    NuDEXUnmapBinaryFile(map,fsize); return 0;
+  }
+  struct stat st;
+  if(stat(textfname,&st)==0 && (st.st_size!=header->textSize || st.st_mtime!=header->textMTime)){
+    std::cout<<" ###### Warning: "<<binfname<<" was not made from the present "<<textfname<<", the text file is read instead ######"<<std::endl;
+    NuDEXUnmapBinaryFile(map,fsize); return 0;
+  }
+
+  size=fsize;
+  return map;
+}
+
+
+const char* NuDEXMapFile(const char* fname,size_t& size){
+
+  size=0;
+#if defined(__unix__) || defined(__APPLE__)
+  int fd=open(fname,O_RDONLY);
+  if(fd<0){return 0;}
+  struct stat st;
+  if(fstat(fd,&st)!=0 || st.st_size<=0){close(fd); return 0;}
+  size_t fsize=st.st_size;
+  void* map=mmap(0,fsize,PROT_READ,MAP_PRIVATE,fd,0);
+  close(fd);
+  if(map==MAP_FAILED){return 0;}
+
+  size=fsize;
+  return (const char*)map;
+#else
+  return 0;
+#endif
+}
+
+
+void NuDEXUnmapBinaryFile(const char* data,size_t size){
+
+#if defined(__unix__) || defined(__APPLE__)
+  if(data!=0){munmap((void*)data,size);}
+#endif
+}
+
+
+std::string NuDEXGetBinaryFileName(const char* textfname){
+
+  std::string binfname(textfname);
+  if(binfname.size()>4 && binfname.substr(binfname.size()-4)==std::string(".dat")){
+    binfname.resize(binfname.size()-4);
+  }
+  binfname+=".bin";
+  return binfname;
+}
+
+
+std::string NuDEXGetTemporaryFileName(const char* fname){
+
+  std::string tmpfname(fname);
+#if defined(__unix__) || defined(__APPLE__)
+  tmpfname+=".tmp"+std::to_string((long long)getpid());
+#else
+  tmpfname+=".tmp";
+#endif
+  return tmpfname;
+}
+
+
+unsigned long long NuDEXHash(const std::string& s){
+
+  unsigned long long hash=14695981039346656037ULL;
+  for(size_t i=0;i<s.size();i++){
+    hash^=(unsigned char)s[i];
+    hash*=1099511628211ULL;
+  }
+  return hash;
+}
+
+
+std::string NuDEXGetFileStamp(const char* fname){
+
+  struct stat st;
+  if(stat(fname,&st)!=0){return std::string("-1 -1");}
+  return std::to_string((long long)st.st_size)+" "+std::to_string((long long)st.st_mtime);
+}
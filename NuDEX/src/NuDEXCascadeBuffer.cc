@@ -0,0 +1,53 @@
+#include "NuDEXCascadeBuffer.hh"
+
+
+
+
+NuDEXCascadeBuffer::NuDEXCascadeBuffer(int maxNCascades,int maxNParticles){
+
+  if(maxNCascades<1){maxNCascades=1;}
+  if(maxNParticles<1){maxNParticles=1;}
+  MaxNCascades=0; MaxNParticles=0;
+  Type=0; Energy=0; Time=0; Offset=0;
+  NCascades=0; NParticles=0;
+  Reserve(maxNCascades,maxNParticles);
+  Offset[0]=0;
+}
+
+NuDEXCascadeBuffer::~NuDEXCascadeBuffer(){
+
+  if(Type!=0){delete [] Type;}
+  if(Energy!=0){delete [] Energy;}
+  if(Time!=0){delete [] Time;}
+  if(Offset!=0){delete [] Offset;}
+}
+
+
+//Enlarge the arrays (if needed), keeping their content:
+void NuDEXCascadeBuffer::Reserve(int maxNCascades,int maxNParticles){
+
+  if(maxNParticles>MaxNParticles){
+    char* newType=new char[maxNParticles];
+    double* newEnergy=new double[maxNParticles];
+    double* newTime=new double[maxNParticles];
+    if(NParticles>0){
+      std::memcpy(newType,Type,NParticles*sizeof(char));
+      std::memcpy(newEnergy,Energy,NParticles*sizeof(double));
+      std::memcpy(newTime,Time,NParticles*sizeof(double));
+    }
+    if(Type!=0){delete [] Type; delete [] Energy; delete [] Time;}
+    Type=newType; Energy=newEnergy; Time=newTime;
+    MaxNParticles=maxNParticles;
+  }
+
+  if(maxNCascades>MaxNCascades){
+    int* newOffset=new int[maxNCascades+1];
+    if(Offset!=0){
+      std::memcpy(newOffset,Offset,(NCascades+1)*sizeof(int));
+      delete [] Offset;
+    }
+    Offset=newOffset;
+    MaxNCascades=maxNCascades;
+  }
+}
+
@@ -0,0 +1,167 @@
+
+#include "NuDEXCascadeLibrary.hh"
+#include <cstdio>
+
+
+
+NuDEXCascadeLibraryWriter::NuDEXCascadeLibraryWriter(){
+
+  memset(&theHeader,0,sizeof(theHeader));
+}
+
+
+NuDEXCascadeLibraryWriter::~NuDEXCascadeLibraryWriter(){
+
+  if(out.is_open()){
+    out.close();
+    remove(theTmpFileName.c_str());
+  }
+}
+
+
+int NuDEXCascadeLibraryWriter::Open(const char* fname,int Z,int A,int InitialLevel,double ExcitationEnergy,unsigned int seed){
+
+  theFileName=std::string(fname);
+  theTmpFileName=NuDEXGetTemporaryFileName(fname);
+  out.open(theTmpFileName.c_str(),std::ios::binary);
+  if(!out.good()){
+    std::cout<<" ######## Error opening file "<<theTmpFileName<<" ########"<<std::endl;
+    return -1;
+  }
+  memset(&theHeader,0,sizeof(theHeader));
+  memcpy(theHeader.magic,"NuDEXCAS",8);
+  theHeader.version=CASCADELIBRARY_BINARYVERSION;
+  theHeader.Z=Z; theHeader.A=A;
+  theHeader.InitialLevel=InitialLevel;
+  theHeader.ExcitationEnergy=ExcitationEnergy;
+  theHeader.Seed=seed;
+  Offset.clear();
+  Offset.push_back(0);
+
+  //The header is written again by Close():
+  out.write((const char*)&theHeader,sizeof(theHeader));
+
+  return 0;
+}
+
+
+int NuDEXCascadeLibraryWriter::AddCascades(NuDEXCascadeBuffer* theBuffer,double maxTime){
+
+  theParticles.resize(theBuffer->GetNParticles());
+  int nParticles=0;
+  for(int i_cas=0;i_cas<theBuffer->GetNCascades();i_cas++){
+    for(int i=theBuffer->Offset[i_cas];i<theBuffer->Offset[i_cas+1];i++){
+      if(maxTime>0 && theBuffer->Time[i]>=maxTime){continue;}
+      NuDEXCascadeLibraryParticle& theParticle=theParticles[nParticles++];
+      memset(&theParticle,0,sizeof(NuDEXCascadeLibraryParticle));
+      theParticle.Energy=(float)theBuffer->Energy[i];
+      theParticle.Time=(float)theBuffer->Time[i];
+      theParticle.Type=theBuffer->Type[i];
+    }
+    Offset.push_back(theHeader.NParticles+nParticles);
+  }
+  theParticles.resize(nParticles);
+  theHeader.NParticles+=nParticles;
+  out.write((const char*)theParticles.data(),theParticles.size()*sizeof(NuDEXCascadeLibraryParticle));
+  if(!out.good()){
+    std::cout<<" ######## Error writing file "<<theTmpFileName<<" ########"<<std::endl;
+    return -1;
+  }
+
+  return 0;
+}
+
+
+int NuDEXCascadeLibraryWriter::Close(){
+
+  theHeader.NCascades=(long long)Offset.size()-1;
+  theHeader.IndexOffset=sizeof(theHeader)+theHeader.NParticles*sizeof(NuDEXCascadeLibraryParticle);
+  //The index starts at a multiple of 8 bytes:
+  char padding[8];
+  memset(padding,0,sizeof(padding));
+  long long npad=(8-theHeader.IndexOffset%8)%8;
+  out.write(padding,npad);
+  theHeader.IndexOffset+=npad;
+  out.write((const char*)Offset.data(),Offset.size()*sizeof(long long));
+  out.seekp(0);
+  out.write((const char*)&theHeader,sizeof(theHeader));
+  if(!out.good()){
+    std::cout<<" ######## Error writing file "<<theTmpFileName<<" ########"<<std::endl;
+    out.close(); remove(theTmpFileName.c_str());
+    return -1;
+  }
+  out.close();
+  if(rename(theTmpFileName.c_str(),theFileName.c_str())!=0){
+    std::cout<<" ######## Error renaming "<<theTmpFileName<<" to "<<theFileName<<" ########"<<std::endl;
+    remove(theTmpFileName.c_str());
+    return -1;
+  }
+
+  return 0;
+}
+
+
+
+NuDEXCascadeLibrary::NuDEXCascadeLibrary(){
+
+  theData=0; theSize=0;
+  theHeader=0; theParticles=0; Offset=0;
+  NCascades=0;
+}
+
+
+NuDEXCascadeLibrary::~NuDEXCascadeLibrary(){
+
+  Close();
+}
+
+
+int NuDEXCascadeLibrary::Open(const char* fname){
+
+  Close();
+  size_t fsize;
+  const char* data=NuDEXMapFile(fname,fsize);
+  if(data==0){
+    std::cout<<" ######## Error opening file "<<fname<<" ########"<<std::endl;
+    return -1;
+  }
+
+  //Some checks, so the file can be read without any other one:
+  const NuDEXCascadeLibraryHeader* header=(const NuDEXCascadeLibraryHeader*)data;
+  bool isValid=(fsize>=sizeof(NuDEXCascadeLibraryHeader) && memcmp(header->magic,"NuDEXCAS",8)==0 && header->version==CASCADELIBRARY_BINARYVERSION);
+  if(isValid){
+    isValid=(header->NCascades>0 && header->NParticles>=0 && header->IndexOffset>=(long long)(sizeof(NuDEXCascadeLibraryHeader)+header->NParticles*sizeof(NuDEXCascadeLibraryParticle))
+	     && header->IndexOffset%8==0 && header->IndexOffset+(header->NCascades+1)*(long long)sizeof(long long)<=(long long)fsize);
+  }
+  if(isValid){
+    //All the cascades inside the particles array (index non-decreasing from 0 to NParticles):
+    const long long* index=(const long long*)(data+header->IndexOffset);
+    isValid=(index[0]==0 && index[header->NCascades]==header->NParticles);
+    for(long long i=0;isValid && i<header->NCascades;i++){
+      if(index[i+1]<index[i] || index[i+1]>header->NParticles){isValid=false;}
+    }
+  }
+  if(!isValid){
+    std::cout<<" ######## "<<fname<<" is not a valid cascade library ########"<<std::endl;
+    NuDEXUnmapBinaryFile(data,fsize);
+    return -1;
+  }
+
+  theData=data; theSize=fsize;
+  theHeader=header;
+  theParticles=(const NuDEXCascadeLibraryParticle*)(data+sizeof(NuDEXCascadeLibraryHeader));
+  Offset=(const long long*)(data+header->IndexOffset);
+  NCascades=header->NCascades;
+
+  return 0;
+}
+
+
+void NuDEXCascadeLibrary::Close(){
+
+  if(theData!=0){NuDEXUnmapBinaryFile(theData,theSize);}
+  theData=0; theSize=0;
+  theHeader=0; theParticles=0; Offset=0;
+  NCascades=0;
+}
+
@@ -0,0 +1,145 @@
+
+#include "NuDEXCascadeProducer.hh"
+
+
+
+NuDEXCascadeProducer::NuDEXCascadeProducer(NuDEXStatisticalNucleus* aNucleus,unsigned int seed,int queueSize){
+
+  theQueue=new NuDEXCascadeQueue(queueSize);
+  theSeed=seed;
+  theInitialLevel=-1;
+  theExcitationEnergy=-1.e-6;
+  NRealizations=0;
+  theBlockSize=1;
+  NextIndex=0;
+  if(aNucleus!=0){AddNucleus(aNucleus);}
+}
+
+
+NuDEXCascadeProducer::~NuDEXCascadeProducer(){
+
+  Stop();
+  delete theQueue;
+  for(size_t i=0;i<theRealizationAlias.size();i++){
+    if(theRealizationAlias[i]!=0){DeleteAliasTable(theRealizationAlias[i]);}
+  }
+}
+
+
+int NuDEXCascadeProducer::AddNucleus(NuDEXStatisticalNucleus* aNucleus,double weight,const NuDEXNeutronSpectrum* aSpectrum,int Realization){
+
+  if(theThreads.size()!=0 || aNucleus==0 || weight<0 || Realization<0){
+    std::cout<<" ######## Error: wrong nucleus for the NuDEXCascadeProducer (or already started) ########"<<std::endl;
+    NuDEXException(__FILE__,std::to_string(__LINE__).c_str(),"##### Error in NuDEX #####");
+  }
+  theNuclei.push_back(aNucleus);
+  theWeights.push_back(weight);
+  theSpectra.push_back(aSpectrum);
+  theRealizations.push_back(Realization);
+  if(Realization+1>NRealizations){NRealizations=Realization+1;}
+  return (int)theNuclei.size()-1;
+}
+
+
+void NuDEXCascadeProducer::Start(int nThreads){
+
+  if(theThreads.size()!=0){
+    std::cout<<" ######## Error: NuDEXCascadeProducer already started ########"<<std::endl;
+    NuDEXException(__FILE__,std::to_string(__LINE__).c_str(),"##### Error in NuDEX #####");
+  }
+
+  //Nuclei of each realization, and their weights:
+  theRealizationNuclei.assign(NRealizations,std::vector<int>());
+  theRealizationAlias.assign(NRealizations,(AliasTable*)0);
+  for(size_t i=0;i<theNuclei.size();i++){
+    theRealizationNuclei[theRealizations[i]].push_back((int)i);
+  }
+  for(int r=0;r<NRealizations;r++){
+    std::vector<double> cumulWeights;
+    for(size_t k=0;k<theRealizationNuclei[r].size();k++){
+      cumulWeights.push_back(theWeights[theRealizationNuclei[r][k]]+(k>0?cumulWeights[k-1]:0));
+    }
+    if(cumulWeights.size()==0 || cumulWeights.back()<=0){
+      std::cout<<" ######## Error: NuDEXCascadeProducer without nuclei for the realization "<<r<<" ########"<<std::endl;
+      NuDEXException(__FILE__,std::to_string(__LINE__).c_str(),"##### Error in NuDEX #####");
+    }
+    if(cumulWeights.size()>1){
+      theRealizationAlias[r]=CreateAliasTable(cumulWeights.data(),(int)cumulWeights.size());
+    }
+  }
+
+  if(nThreads<1){nThreads=1;}
+  for(int i=0;i<nThreads;i++){
+    theThreads.push_back(std::thread(&NuDEXCascadeProducer::ProduceCascades,this));
+  }
+}
+
+
+void NuDEXCascadeProducer::Stop(){
+
+  theQueue->Abort();
+  for(size_t i=0;i<theThreads.size();i++){
+    if(theThreads[i].joinable()){theThreads[i].join();}
+  }
+}
+
+
+unsigned int NuDEXCascadeProducer::GetCascadeSeed(long long index){
+
+  std::ostringstream key;
+  key<<"CASCADEPRODUCER SEED "<<theSeed<<" CASCADE "<<index;
+  return (unsigned int)(NuDEXHash(key.str())%4294967295ULL)+1;
+}
+
+
+//Nucleus of the cascade index: one of its realization, sampled from the weights with a seed which also depends only on index:
+int NuDEXCascadeProducer::SampleNucleus(long long index,NuDEXRandom* aRandom){
+
+  int r=(int)((index/theBlockSize)%NRealizations);
+  const std::vector<int>& nuclei=theRealizationNuclei[r];
+  if(theRealizationAlias[r]==0){return nuclei[0];}
+  std::ostringstream key;
+  key<<"CASCADEPRODUCER SEED "<<theSeed<<" NUCLEUS "<<index;
+  aRandom->SetSeed((unsigned int)(NuDEXHash(key.str())%4294967295ULL)+1);
+  return nuclei[SampleFromAliasTable(theRealizationAlias[r],aRandom->Uniform())];
+}
+
+
+void NuDEXCascadeProducer::ProduceCascades(){
+
+  std::vector<NuDEXCascadeSampler*> theSamplers(theNuclei.size());
+  for(size_t i=0;i<theNuclei.size();i++){
+    theSamplers[i]=new NuDEXCascadeSampler(theNuclei[i],theSeed);
+  }
+  NuDEXRandom theNucleusRandom(theSeed);
+  NuDEXCascadeBuffer* theCascade=0; //swapped with the one of the slot at each Push
+  while(true){
+    long long index=NextIndex.fetch_add(1);
+    int i_nucleus=SampleNucleus(index,&theNucleusRandom);
+    NuDEXCascadeSampler* theSampler=theSamplers[i_nucleus];
+    theSampler->SetSeed(GetCascadeSeed(index));
+    int InitialLevel=theInitialLevel;
+    double ExcitationEnergy=theExcitationEnergy;
+    if(theSpectra[i_nucleus]!=0){
+      NuDEXRandom* aRandom3=theSampler->GetRandom3();
+      double r1=aRandom3->Uniform(),r2=aRandom3->Uniform(),r3=aRandom3->Uniform();
+      theSpectra[i_nucleus]->Sample(r1,r2,r3,InitialLevel,ExcitationEnergy);
+    }
+    if(theCascade==0){theCascade=new NuDEXCascadeBuffer(1,100);}
+    theSampler->GenerateCascades(1,InitialLevel,ExcitationEnergy,theCascade); //without particles if it cannot be generated
+    if(!theQueue->Push(index,theCascade)){break;}
+  }
+  if(theCascade!=0){delete theCascade;}
+  for(size_t i=0;i<theSamplers.size();i++){
+    delete theSamplers[i];
+  }
+}
+
+
+void NuDEXCascadeProducer::PrintStatistics(std::ostream &out){
+
+  out<<" NuDEX cascade producer: "<<GetNThreads()<<" threads, "<<GetNNuclei()<<" nuclei, "<<theQueue->GetNPopped()<<" cascades taken, "
+     <<theQueue->GetDepth()<<"/"<<theQueue->GetNSlots()<<" ready in the queue, "
+     <<theQueue->GetNPopStalls()<<" consumer stalls (cascade not ready), "
+     <<theQueue->GetNPushStalls()<<" producer stalls (queue full)"<<std::endl;
+}
@@ -0,0 +1,78 @@
+
+#include "NuDEXCascadeQueue.hh"
+
+
+
+NuDEXCascadeQueue::NuDEXCascadeQueue(int nSlots){
+
+  if(nSlots<1){nSlots=1;}
+  NSlots=nSlots;
+  theSlots=new Slot[NSlots];
+  for(int i=0;i<NSlots;i++){
+    theSlots[i].Sequence.store(i);
+    theSlots[i].Cascade=0;
+  }
+  NPushed=0; NPopped=0; NPushStalls=0; NPopStalls=0;
+  Aborted=false;
+}
+
+
+NuDEXCascadeQueue::~NuDEXCascadeQueue(){
+
+  for(int i=0;i<NSlots;i++){
+    if(theSlots[i].Cascade!=0){delete theSlots[i].Cascade;}
+  }
+  delete [] theSlots;
+}
+
+
+bool NuDEXCascadeQueue::Push(long long index,NuDEXCascadeBuffer*& theCascade){
+
+  Slot& theSlot=theSlots[index%NSlots];
+  int nTries=0;
+  while(theSlot.Sequence.load(std::memory_order_acquire)!=index){
+    if(Aborted){return false;}
+    if(nTries==0){NPushStalls++;}
+    Wait(nTries);
+  }
+  std::swap(theSlot.Cascade,theCascade);
+  theSlot.Sequence.store(index+1,std::memory_order_release);
+  NPushed++;
+
+  return true;
+}
+
+
+bool NuDEXCascadeQueue::Pop(long long index,NuDEXCascadeBuffer*& theCascade){
+
+  if(Aborted){return false;}
+  Slot& theSlot=theSlots[index%NSlots];
+  int nTries=0;
+  while(theSlot.Sequence.load(std::memory_order_acquire)!=index+1){
+    if(Aborted){return false;}
+    if(nTries==0){NPopStalls++;}
+    Wait(nTries);
+  }
+  std::swap(theSlot.Cascade,theCascade);
+  theSlot.Sequence.store(index+NSlots,std::memory_order_release);
+  NPopped++;
+
+  return true;
+}
+
+
+void NuDEXCascadeQueue::Abort(){
+
+  Aborted=true;
+}
+
+
+//First spinning, then giving the core to other threads, and finally sleeping (the other side can be much slower):
+void NuDEXCascadeQueue::Wait(int& nTries){
+
+  nTries++;
+  if(nTries<64){return;}
+  if(nTries<256){std::this_thread::yield(); return;}
+  std::this_thread::sleep_for(std::chrono::microseconds(50));
+}
+
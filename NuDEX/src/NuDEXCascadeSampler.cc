@@ -0,0 +1,418 @@
+#include "NuDEXCascadeSampler.hh"
+
+
+
+
+NuDEXCascadeSampler::NuDEXCascadeSampler(NuDEXStatisticalNucleus* aNucleus,unsigned int seed){
+
+  if(aNucleus==0){
+    NuDEXException(__FILE__,std::to_string(__LINE__).c_str(),"##### Error in NuDEX #####");
+  }
+  theNucleus=aNucleus;
+  theNucleus->NAttachedSamplers++;
+  theRandom2=new NuDEXRandom(seed); //its seed is changed for each level
+  theRandom3=new NuDEXRandom(seed);
+  theRandom4=new NuDEXRandom(seed);
+  OwnRandomGenerators=true;
+  theICCProducts.Ne=0;
+  theICCProducts.Ng=0;
+  theSampledLevel=-1;
+  theSampledMultipolarity=-50;
+  CacheNLevels=0; theCachedRows=0; CachePrev=0; CacheNext=0;
+  CacheFirst=-1; CacheLast=-1; CacheMemory_MB=0; CacheNBRChanges=0;
+  theOwnBuffer=new NuDEXCascadeBuffer(1,100);
+}
+
+NuDEXCascadeSampler::NuDEXCascadeSampler(NuDEXStatisticalNucleus* aNucleus,NuDEXRandom* aRandom2,NuDEXRandom* aRandom3,NuDEXRandom* aRandom4){
+
+  if(aNucleus==0 || aRandom2==0 || aRandom3==0 || aRandom4==0){
+    NuDEXException(__FILE__,std::to_string(__LINE__).c_str(),"##### Error in NuDEX #####");
+  }
+  theNucleus=aNucleus;
+  theNucleus->NAttachedSamplers++;
+  theRandom2=aRandom2;
+  theRandom3=aRandom3;
+  theRandom4=aRandom4;
+  OwnRandomGenerators=false;
+  theICCProducts.Ne=0;
+  theICCProducts.Ng=0;
+  theSampledLevel=-1;
+  theSampledMultipolarity=-50;
+  CacheNLevels=0; theCachedRows=0; CachePrev=0; CacheNext=0;
+  CacheFirst=-1; CacheLast=-1; CacheMemory_MB=0; CacheNBRChanges=0;
+  theOwnBuffer=new NuDEXCascadeBuffer(1,100);
+}
+
+NuDEXCascadeSampler::~NuDEXCascadeSampler(){
+
+  theNucleus->NAttachedSamplers--;
+
+  if(OwnRandomGenerators){
+    delete theRandom2;
+    delete theRandom3;
+    delete theRandom4;
+  }
+  ClearBRCache();
+  delete theOwnBuffer;
+  if(theCachedRows!=0){
+    delete [] theCachedRows;
+    delete [] CachePrev;
+    delete [] CacheNext;
+  }
+}
+
+void NuDEXCascadeSampler::ClearBRCache(){
+
+  while(CacheFirst>=0){
+    int i_level=CacheFirst;
+    CacheFirst=CacheNext[i_level];
+    DeleteDecayIntensitiesRow(theCachedRows[i_level]);
+    theCachedRows[i_level]=0;
+  }
+  CacheLast=-1;
+  CacheMemory_MB=0;
+}
+
+void NuDEXCascadeSampler::SetSeed(unsigned int seed){
+
+  theRandom3->SetSeed(seed);
+  theRandom4->SetSeed(seed);
+}
+
+
+//If InitialLevel==-1 then we start from the thermal capture level
+//If ExcitationEnergy>0 then is the excitation energy of the nucleus
+//If ExcitationEnergy<0 then is a capture reaction of a neutron with energy -ExcitationEnergy
+// return Npar (number of particles emitted). If something goes wrong, returns negative value (for example negative energy transition, which could happen).
+int NuDEXCascadeSampler::GenerateCascade(int InitialLevel,double ExcitationEnergy,std::vector<char>& pType,std::vector<double>& pEnergy,std::vector<double>& pTime){
+
+  pType.clear();
+  pEnergy.clear();
+  pTime.clear();
+
+  theOwnBuffer->Clear();
+  int Npar=FillCascade(InitialLevel,ExcitationEnergy,theOwnBuffer);
+  for(int i=0;i<theOwnBuffer->NParticles;i++){
+    pType.push_back(theOwnBuffer->Type[i]);
+    pEnergy.push_back(theOwnBuffer->Energy[i]);
+    pTime.push_back(theOwnBuffer->Time[i]);
+  }
+  return Npar;
+}
+
+
+//Generate NCascades cascades and store them in theBuffer (its previous content is removed).
+//The random numbers are the same as calling NCascades times to GenerateCascade(...).
+//The cascades that could not be generated are stored without particles.
+// return the total number of particles stored in theBuffer
+int NuDEXCascadeSampler::GenerateCascades(int NCascades,int InitialLevel,double ExcitationEnergy,NuDEXCascadeBuffer* theBuffer){
+
+  if(theBuffer==0){
+    NuDEXException(__FILE__,std::to_string(__LINE__).c_str(),"##### Error in NuDEX #####");
+  }
+  theBuffer->Clear();
+  for(int i=0;i<NCascades;i++){
+    int Npar=FillCascade(InitialLevel,ExcitationEnergy,theBuffer);
+    if(Npar<0){theBuffer->DiscardOpenCascade();}
+    theBuffer->CloseCascade();
+  }
+  return theBuffer->NParticles;
+}
+
+
+//Add the particles of one cascade to theBuffer, after the ones already there (the cascade is not closed).
+// return Npar (number of particles emitted). If something goes wrong, returns negative value.
+int NuDEXCascadeSampler::FillCascade(int InitialLevel,double ExcitationEnergy,NuDEXCascadeBuffer* theBuffer){
+
+  if(!theNucleus->hasBeenInitialized){
+    std::cout<<" ############## Error: NuDEXCascadeSampler::GenerateCascade cannot be used before initializing the nucleus  ##############"<<std::endl;
+    NuDEXException(__FILE__,std::to_string(__LINE__).c_str(),"##### Error in NuDEX #####");
+  }
+
+  //The nucleus is only read from here:
+  const Level* theLevels=theNucleus->theLevels;
+  const KnownLevel* theKnownLevels=theNucleus->theKnownLevels;
+  int NKnownLevels=theNucleus->NKnownLevels;
+  int A_Int=theNucleus->A_Int;
+  double Sn=theNucleus->Sn;
+
+  if(ExcitationEnergy<0){
+    ExcitationEnergy=Sn-(A_Int-1.)/(double)A_Int*ExcitationEnergy;
+  }
+  if(ExcitationEnergy<=0){
+    return 0;
+  }
+
+  int Npar=0;
+  int f_level,multipol;
+  double alpha,E_trans,Exc_ene_i,Exc_ene_f; //icc factor, energy of the transition, initial/final excitation energy
+  double EmissionTime=0; //in seconds
+  int NTransition=0;
+
+  //Start:
+  int i_level=InitialLevel;
+  Exc_ene_i=ExcitationEnergy;
+
+
+  if(i_level==0){ //could happen
+    theBuffer->AddParticle('g',Exc_ene_i,0);
+    Npar++;
+  }
+
+  //Loop:
+  while(i_level!=0){
+
+    NTransition++;
+    //--------------------------------------------
+    //Sample final level:
+    if(i_level==-1){ //thermal level
+      if(!theNucleus->theThermalCaptureLevelCumulBR){
+	f_level=0;
+	std::cout<<" ############## NuDEX: WARNING, there are no thermal capture for ZA="<<A_Int+1000*theNucleus->Z_Int-1<<" , with Sn = "<<Sn<<" ##############"<<std::endl;
+      }
+      else{
+	//Sample final level:
+	double randnumber=theRandom3->Uniform();
+	if(theNucleus->BRSamplingOpt==1 && theNucleus->theThermalCaptureLevelAliasBR!=0){
+	  f_level=SampleFromAliasTable(theNucleus->theThermalCaptureLevelAliasBR,randnumber);
+	}
+	else{
+	  f_level=SampleFromCumulative(theNucleus->theThermalCaptureLevelCumulBR,theNucleus->NLevelsBelowThermalCaptureLevel,randnumber);
+	}
+	if(f_level>=0){
+	  multipol=theNucleus->GetMultipolarity(&theNucleus->theThermalCaptureLevel,&theNucleus->theLevels[f_level]);
+	}
+      }
+      if(f_level<0){
+	NuDEXException(__FILE__,std::to_string(__LINE__).c_str(),"##### Error in NuDEX #####");
+      }
+      Exc_ene_f=theLevels[f_level].Energy;
+    }
+    else if(i_level>0){
+      f_level=SampleFinalLevel(i_level,multipol,alpha,NTransition);
+    }
+    else{
+      NuDEXException(__FILE__,std::to_string(__LINE__).c_str(),"##### Error in NuDEX #####");
+    }
+    //--------------------------------------------
+
+    //Energy of the transition:
+    Exc_ene_f=theLevels[f_level].Energy;
+
+    //We sample the final energy if it is a band of levels:
+    if(theLevels[f_level].Width!=0){
+      Exc_ene_f+=theRandom3->Uniform(-theLevels[f_level].Width,+theLevels[f_level].Width);
+    }
+    E_trans=Exc_ene_i-Exc_ene_f;
+    if(E_trans<=0){
+      return -1;
+    }
+    //------------------------------------------------------------
+    //Emission time:
+    if(i_level<NKnownLevels && i_level>0){
+      if(theKnownLevels[i_level].T12>0){
+	EmissionTime+=theRandom3->Exp(theKnownLevels[i_level].T12/log(2));
+      }
+    }
+    //------------------------------------------------------------
+
+    //------------------------------------------------------------
+    //calculate electron conversion:
+    bool ele_conv=false;
+    if(theNucleus->ElectronConversionFlag>0){
+      if(i_level<NKnownLevels && i_level>0){ //ElectronConversionFlag=1,2
+	ele_conv=theNucleus->theICC->SampleInternalConversion(E_trans,multipol,theRandom4,&theICCProducts,alpha); //use the alpha value from the know level value
+      }
+      else if(theNucleus->ElectronConversionFlag==2){
+        ele_conv=theNucleus->theICC->SampleInternalConversion(E_trans,multipol,theRandom4,&theICCProducts); //calculate alpha (icc factor)
+      }
+    }
+    //------------------------------------------------------------
+
+    //------------------------------------------------------------
+    //Fill result:
+    if(ele_conv){
+      for(int i=0;i<theICCProducts.Ne;i++){
+	theBuffer->AddParticle('e',theICCProducts.Eele[i],EmissionTime);
+	Npar++;
+      }
+      for(int i=0;i<theICCProducts.Ng;i++){
+	theBuffer->AddParticle('g',theICCProducts.Egam[i],EmissionTime);
+	Npar++;
+      }
+    }
+    else{
+      theBuffer->AddParticle('g',E_trans,EmissionTime);
+      Npar++;
+    }
+    //------------------------------------------------------------
+    i_level=f_level;
+    Exc_ene_i=Exc_ene_f;
+  }
+
+  if(i_level!=0){
+    NuDEXException(__FILE__,std::to_string(__LINE__).c_str(),"##### Error in NuDEX #####");
+  }
+  return Npar;
+}
+
+
+
+
+int NuDEXCascadeSampler::SampleFinalLevel(int i_level,int& multipolarity,double &icc_fac,int nTransition){
+
+  if(i_level<=0 || i_level>=theNucleus->NLevels){
+    NuDEXException(__FILE__,std::to_string(__LINE__).c_str(),"##### Error in NuDEX #####");
+  }
+
+  Level* theLevels=theNucleus->theLevels;
+  const KnownLevel* theKnownLevels=theNucleus->theKnownLevels;
+  int BROpt=theNucleus->BROpt;
+
+  double randnumber=theRandom3->Uniform();
+
+  int i_knownLevel=-1;
+  if(i_level<theNucleus->NKnownLevels){ //then is a known level
+    i_knownLevel=i_level;
+  }
+  if(theLevels[i_level].KnownLevelID>0){ //then is in the unknown part, but we use it as a known level
+    if(theKnownLevels[theLevels[i_level].KnownLevelID].NGammas>0){
+      i_knownLevel=theLevels[i_level].KnownLevelID;
+    }
+  }
+
+  if(i_knownLevel>=0){//known part of the spectrum
+    theSampledLevel=-1;
+    for(int j=0;j<theKnownLevels[i_knownLevel].NGammas;j++){
+      if(theKnownLevels[i_knownLevel].cumulPtot[j]>randnumber){
+	multipolarity=theKnownLevels[i_knownLevel].multipolarity[j];
+	icc_fac=theKnownLevels[i_knownLevel].Icc[j];
+	return theKnownLevels[i_knownLevel].FinalLevelID[j];
+      }
+    }
+    std::cout<<randnumber<<"  "<<i_knownLevel<<"  "<<theKnownLevels[i_knownLevel].NGammas<<std::endl;
+    for(int j=0;j<theKnownLevels[i_knownLevel].NGammas;j++){
+      std::cout<<theKnownLevels[i_knownLevel].cumulPtot[j]<<std::endl;
+    }
+    NuDEXException(__FILE__,std::to_string(__LINE__).c_str(),"##### Error in NuDEX #####");
+  }
+  else{
+    icc_fac=-1;
+    //------------------------------------------------------------------------------
+    //If BROpt==1 or 2, then we store the BR, if not computed, or calculate the final level from it
+    //The same for the first transition if the BR have been stored by PrecomputeEntryBR, whatever BROpt is
+    if(BROpt==1 || (nTransition==1 && (BROpt==2 || theNucleus->TotalCumulBR[i_level].load(std::memory_order_acquire)!=0))){
+      //maybe the TotalGammaRho[i_level] and BR have not been computed yet (this is done by the nucleus):
+      SparseBR* cumulBR=theNucleus->GetTotalCumulBR(i_level,this);
+      int j;
+      if(theNucleus->BRSamplingOpt==1){
+	j=cumulBR->FinalLevel[SampleFromAliasTable(theNucleus->GetTotalAliasBR(i_level,this),randnumber)];
+      }
+      else{
+	j=SampleFromSparseBR(cumulBR,randnumber);
+      }
+      if(j>=0){
+	multipolarity=theNucleus->GetMultipolarity(&theLevels[i_level],&theLevels[j]);
+	return j;
+      }
+      NuDEXException(__FILE__,std::to_string(__LINE__).c_str(),"##### Error in NuDEX #####");
+    }
+    //------------------------------------------------------------------------------
+
+    //BROpt==0
+    //------------------------------------------------------------------------------
+    // If not, maybe the TotalGammaRho[i_level] has not been computed yet (this is done by the nucleus):
+    double TotGR=theNucleus->GetTotalGammaRho(i_level,this);
+    if(theNucleus->BRCacheSize_MB>0){ //the decay intensities are computed only once, while they are in the cache
+      if(TotGR<=0){
+	NuDEXException(__FILE__,std::to_string(__LINE__).c_str(),"##### Error in NuDEX #####");
+      }
+      bool isCached;
+      DecayIntensitiesRow* theRow=GetCachedDecayIntensities(i_level,isCached);
+      int j=SampleFromDecayIntensitiesRow(theRow,TotGR*randnumber,multipolarity);
+      if(!isCached){DeleteDecayIntensitiesRow(theRow);}
+      if(j<0 || multipolarity==-50){
+	NuDEXException(__FILE__,std::to_string(__LINE__).c_str(),"##### Error in NuDEX #####");
+      }
+      return j;
+    }
+    theSampledLevel=-1;
+    theNucleus->ComputeDecayIntensities(i_level,0,randnumber,TotGR,false,this); // here we compute the final level
+    multipolarity=theSampledMultipolarity;
+    return theSampledLevel;
+    //------------------------------------------------------------------------------
+  }
+
+  NuDEXException(__FILE__,std::to_string(__LINE__).c_str(),"##### Error in NuDEX #####");
+  return 0;
+}
+
+
+
+//Returns the decay intensities of the level, from the cache if they are there.
+//If they are too big to be stored in the cache isCached=false, and they have to be deleted after using them.
+DecayIntensitiesRow* NuDEXCascadeSampler::GetCachedDecayIntensities(int i_level,bool& isCached){
+
+  if(theCachedRows==0){
+    CacheNLevels=theNucleus->NLevels;
+    theCachedRows=new DecayIntensitiesRow*[CacheNLevels];
+    CachePrev=new int[CacheNLevels];
+    CacheNext=new int[CacheNLevels];
+    for(int i=0;i<CacheNLevels;i++){
+      theCachedRows[i]=0; CachePrev[i]=-1; CacheNext[i]=-1;
+    }
+    CacheNBRChanges=theNucleus->NBRChanges;
+  }
+  if(CacheNBRChanges!=theNucleus->NBRChanges){ //the BR of some levels have been changed
+    ClearBRCache();
+    CacheNBRChanges=theNucleus->NBRChanges;
+  }
+
+  DecayIntensitiesRow* theRow=theCachedRows[i_level];
+  if(theRow!=0){
+    //move it to the beginning of the list:
+    if(CacheFirst!=i_level){
+      CacheNext[CachePrev[i_level]]=CacheNext[i_level];
+      if(CacheNext[i_level]>=0){CachePrev[CacheNext[i_level]]=CachePrev[i_level];}
+      else{CacheLast=CachePrev[i_level];}
+      CachePrev[i_level]=-1;
+      CacheNext[i_level]=CacheFirst;
+      CachePrev[CacheFirst]=i_level;
+      CacheFirst=i_level;
+    }
+    isCached=true;
+    return theRow;
+  }
+
+  theRow=theNucleus->ComputeDecayIntensitiesRow(i_level,this);
+  double RowMemory_MB=GetDecayIntensitiesRowMemory_MB(theRow);
+  if(RowMemory_MB>theNucleus->BRCacheSize_MB){
+    isCached=false;
+    return theRow;
+  }
+
+  //remove the least recently used ones, until there is space:
+  while(CacheLast>=0 && CacheMemory_MB+RowMemory_MB>theNucleus->BRCacheSize_MB){
+    int j_level=CacheLast;
+    CacheLast=CachePrev[j_level];
+    if(CacheLast>=0){CacheNext[CacheLast]=-1;}
+    else{CacheFirst=-1;}
+    CacheMemory_MB-=GetDecayIntensitiesRowMemory_MB(theCachedRows[j_level]);
+    DeleteDecayIntensitiesRow(theCachedRows[j_level]);
+    theCachedRows[j_level]=0;
+    CachePrev[j_level]=-1; CacheNext[j_level]=-1;
+  }
+
+  //insert at the beginning:
+  theCachedRows[i_level]=theRow;
+  CachePrev[i_level]=-1;
+  CacheNext[i_level]=CacheFirst;
+  if(CacheFirst>=0){CachePrev[CacheFirst]=i_level;}
+  else{CacheLast=i_level;}
+  CacheFirst=i_level;
+  CacheMemory_MB+=RowMemory_MB;
+
+  isCached=true;
+  return theRow;
+}
+
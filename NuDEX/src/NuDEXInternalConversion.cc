@@ -1,23 +1,80 @@
 
 #include "NuDEXInternalConversion.hh"
+#include <vector>
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <memory>
+
+//-----------------------------------------------------------------------------------------------
+//Binary file: NuDEXBinaryHeader, ICCBinaryIndex[nZ] (sorted by Z) and then, for each Z, its NShells shells (0 is the total given by the data).
+//Each shell is an ICCBinaryShell followed by Eg[np], Icc_E[0..ICC_NMULTIP-1][np] and Icc_M[0..ICC_NMULTIP-1][np]
+struct ICCBinaryIndex{
+  int Z,NShells;
+  long long offset;
+};
+struct ICCBinaryShell{
+  double BindingEnergy;
+  int np,unused;
+  char OrbitalName[ICC_MAXORBITALNAME];
+};
+//-----------------------------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------------------------
+//Cache of the data already read (see SetDataCache), by file name and Z. The entries are shared, so the ones being copied
+//by some Init are not deleted when the cache is emptied:
+static std::atomic<bool> UseICCDataCache(false);
+static std::mutex theICCDataCacheMutex;
+static std::map<std::string,std::shared_ptr<const NuDEXInternalConversion> > theICCDataCache;
+//-----------------------------------------------------------------------------------------------
 
 
 
-//If alpha>0, use that value
 bool NuDEXInternalConversion::SampleInternalConversion(double Ene,int multipolarity,double alpha,bool CalculateProducts){
 
+  NuDEXICCProducts theProducts;
+  theProducts.Ne=0;
+  theProducts.Ng=0;
+  bool result=SampleInternalConversion(Ene,multipolarity,theRandom4,&theProducts,alpha,CalculateProducts);
+  Ne=theProducts.Ne;
+  Ng=theProducts.Ng;
+  for(int i=0;i<Ne;i++){Eele[i]=theProducts.Eele[i];}
+  for(int i=0;i<Ng;i++){Egam[i]=theProducts.Egam[i];}
+
+  return result;
+}
+
+void NuDEXInternalConversion::FillElectronHole(int i_shell){
+
+  NuDEXICCProducts theProducts;
+  theProducts.Ne=Ne;
+  theProducts.Ng=Ng;
+  for(int i=0;i<Ne;i++){theProducts.Eele[i]=Eele[i];}
+  for(int i=0;i<Ng;i++){theProducts.Egam[i]=Egam[i];}
+  FillElectronHole(i_shell,theRandom4,&theProducts);
+  Ne=theProducts.Ne;
+  Ng=theProducts.Ng;
+  for(int i=0;i<Ne;i++){Eele[i]=theProducts.Eele[i];}
+  for(int i=0;i<Ng;i++){Egam[i]=theProducts.Egam[i];}
+}
+
+
+//If alpha>0, use that value
+bool NuDEXInternalConversion::SampleInternalConversion(double Ene,int multipolarity,NuDEXRandom* aRandom,NuDEXICCProducts* theProducts,double alpha,bool CalculateProducts){
+
   if(theZ<MINZINTABLES){ //then we have no info
     if(alpha<0){
-      Ne=0;
-      Ng=0;
+      theProducts->Ne=0;
+      theProducts->Ng=0;
       return false;
     }
     else{
-      double rand=theRandom4->Uniform(0,alpha+1);
+      double rand=aRandom->Uniform(0,alpha+1);
       if(rand<alpha){ //then electron conversion
-	Ne=1;
-	Ng=0;
-	Eele[0]=Ene; //which is not correct, but we don't know the binding energy
+	theProducts->Ne=1;
+	theProducts->Ng=0;
+	theProducts->Eele[0]=Ene; //which is not correct, but we don't know the binding energy
 	return true;
       }
       return false;
@@ -25,8 +82,8 @@ bool NuDEXInternalConversion::SampleInternalConversion(double Ene,int multipolar
   }
 
 
-  Ne=0;
-  Ng=0;
+  theProducts->Ne=0;
+  theProducts->Ng=0;
 
   if(multipolarity==0){ //maybe it is better to return true ... ?? --> no
     //return true;
@@ -43,26 +100,36 @@ bool NuDEXInternalConversion::SampleInternalConversion(double Ene,int multipolar
     alpha=GetICC(Ene,multipolarity);
   }
 
-  double rand=theRandom4->Uniform(0,alpha+1);
+  double rand=aRandom->Uniform(0,alpha+1);
   if(rand<alpha){ //then electron conversion
     if(!CalculateProducts){return true;}
     //Select the orbital:
+    if(TableNPoints>0){
+      int i_orb=SampleOrbitalFromTable(Ene,multipolarity,rand/alpha);
+      if(i_orb>0){
+	theProducts->Ne=1;
+	theProducts->Eele[0]=Ene-BindingEnergy[i_orb];
+	FillElectronHole(i_orb,aRandom,theProducts);
+	if(theProducts->Eele[0]<0){theProducts->Eele[0]=0;}
+	return true;
+      }
+    }
     if(usegivenalpha){rand=rand*GetICC(Ene,multipolarity)/alpha;} //renormalize rand to our alpha
     double cumul=0;
     for(int i=1;i<NShells;i++){
       cumul+=GetICC(Ene,multipolarity,i);
       //std::cout<<Ene<<"  "<<multipolarity<<"  "<<i<<"  "<<GetICC(Ene,multipolarity,i)<<"  "<<rand-1<<std::endl;
       if(cumul>=rand || multipolarity==0){ //then is this orbital
-	Ne=1;
-	Eele[0]=Ene-BindingEnergy[i];
-	FillElectronHole(i); //now there is a hole there, in the filling procedure we emitt gammas and/or electrons
-	if(Eele[0]<0){
+	theProducts->Ne=1;
+	theProducts->Eele[0]=Ene-BindingEnergy[i];
+	FillElectronHole(i,aRandom,theProducts); //now there is a hole there, in the filling procedure we emitt gammas and/or electrons
+	if(theProducts->Eele[0]<0){
 	  std::cout<<" For Z = "<<theZ<<" and orbital "<<OrbitalName[i]<<" --> Ene = "<<Ene<<" and BindingEnergy = "<<BindingEnergy[i]<<std::endl;
 	  std::cout<<" Given alpha is "<<alpha<<" ("<<usegivenalpha<<"), rand = "<<rand<<" and tabulated alpha for Ene = "<<Ene<<" and mult = "<<multipolarity<<" is "<<GetICC(Ene,multipolarity)<<" -- cumul = "<<cumul<<std::endl;
 	  for(int j=1;j<=NShells;j++){
 	    std::cout<<j<<"  "<<GetICC(Ene,multipolarity,j)<<std::endl;
 	  }
-	  Eele[0]=0;
+	  theProducts->Eele[0]=0;
 	}
 	return true;
       }
@@ -72,8 +139,8 @@ bool NuDEXInternalConversion::SampleInternalConversion(double Ene,int multipolar
     for(int i=1;i<=NShells;i++){
       std::cout<<i<<"  "<<GetICC(Ene,multipolarity,i)<<std::endl;
     }
-    Ne=1;
-    Eele[0]=Ene-BindingEnergy[NShells-1];
+    theProducts->Ne=1;
+    theProducts->Eele[0]=Ene-BindingEnergy[NShells-1];
     return true;
   }
 
@@ -81,38 +148,20 @@ bool NuDEXInternalConversion::SampleInternalConversion(double Ene,int multipolar
 }
 
 
-void NuDEXInternalConversion::FillElectronHole(int i_shell){
+void NuDEXInternalConversion::FillElectronHole(int i_shell,NuDEXRandom* aRandom,NuDEXICCProducts* theProducts){
 
   //A very simplified version of the process (... and false). It can be done with accuracy with G4AtomicTransitionManager
 
-  double fluoyield=0;
-  if(i_shell==1){ //K-shell
-    //Hubbell et al. (1994) formula for the fluorescence yield:
-    double C0=0.0370,C1=0.03112,C2=5.44e-5,C3=-1.25e-6;
-    double w_fac=pow(C0+C1*theZ+C2*theZ*theZ+C3*theZ*theZ*theZ,4);
-    fluoyield=w_fac/(1.+w_fac);
-  }
-  else if(i_shell>=2 && i_shell<=4){ //L-shell
-    //Hubbell et al. (1994) formula for the fluorescence yield:
-    if(theZ>=3 && theZ<=36){
-      fluoyield=1.939e-8*pow(theZ,3.8874);
-    }
-    else if(theZ>36){
-      double C0=0.17765,C1=0.00298937,C2=8.91297e-5,C3=-2.67184e-7;
-      double w_fac=pow(C0+C1*theZ+C2*theZ*theZ+C3*theZ*theZ*theZ,4);
-      fluoyield=w_fac/(1.+w_fac);
-    }
-  }
+  double fluoyield=FluoYield[i_shell];
 
-
-  double rand=theRandom4->Uniform(0,1);
+  double rand=aRandom->Uniform(0,1);
   if(rand<fluoyield){ //gamma emission
-    Egam[Ng]=BindingEnergy[i_shell];
-    Ng++;
+    theProducts->Egam[theProducts->Ng]=BindingEnergy[i_shell];
+    theProducts->Ng++;
   }
   else{ //electron emission
-    Eele[Ne]=BindingEnergy[i_shell];
-    Ne++;
+    theProducts->Eele[theProducts->Ne]=BindingEnergy[i_shell];
+    theProducts->Ne++;
   }
 
 
@@ -139,6 +188,11 @@ double NuDEXInternalConversion::GetICC(double Ene,int multipolarity,int i_shell)
   //if(i_shell<0){i_shell=NShells;}
 
   if(i_shell<0){
+    if(TableNPoints>0 && multipolarity!=0){
+      double f;
+      int i_cell=GetTableCell(Ene,multipolarity,f);
+      if(i_cell>=0){return InterpolateTable(std::abs(multipolarity)-1+(multipolarity<0)*ICC_NMULTIP,i_cell,f);}
+    }
     double result=0;
     for(int i=1;i<NShells;i++){
       result+=GetICC(Ene,multipolarity,i);
@@ -174,6 +228,7 @@ double NuDEXInternalConversion::GetICC(double Ene,int multipolarity,int i_shell)
 NuDEXInternalConversion::NuDEXInternalConversion(int Z){
   theZ=Z;
   NShells=0;
+  Ne=0; Ng=0;
   for(int i=0;i<ICC_MAXNSHELLS;i++){
     Eg[i]=0; np[i]=0;  BindingEnergy[i]=0;
     for(int j=0;j<ICC_NMULTIP;j++){
@@ -181,6 +236,31 @@ NuDEXInternalConversion::NuDEXInternalConversion(int Z){
     }
   }
   theRandom4= new NuDEXRandom(1234567);
+
+  //Fluorescence yields, from the Hubbell et al. (1994) formulas:
+  for(int i=0;i<ICC_MAXNSHELLS;i++){
+    FluoYield[i]=0;
+  }
+  double C0=0.0370,C1=0.03112,C2=5.44e-5,C3=-1.25e-6;
+  double w_fac=pow(C0+C1*theZ+C2*theZ*theZ+C3*theZ*theZ*theZ,4);
+  FluoYield[1]=w_fac/(1.+w_fac); //K-shell
+  double fluoyieldL=0;
+  if(theZ>=3 && theZ<=36){
+    fluoyieldL=1.939e-8*pow(theZ,3.8874);
+  }
+  else if(theZ>36){
+    C0=0.17765; C1=0.00298937; C2=8.91297e-5; C3=-2.67184e-7;
+    w_fac=pow(C0+C1*theZ+C2*theZ*theZ+C3*theZ*theZ*theZ,4);
+    fluoyieldL=w_fac/(1.+w_fac);
+  }
+  for(int i=2;i<=4;i++){FluoYield[i]=fluoyieldL;} //L-shell
+
+  TableNPoints=0;
+  TableLogEmin=0; TableInvDLogE=0;
+  for(int i=0;i<2*ICC_NMULTIP;i++){
+    TableAlpha[i]=0; TableLogAlpha[i]=0; TableCumulFraction[i]=0;
+  }
+  TableExactCell=0;
 }
 
 
@@ -192,6 +272,12 @@ NuDEXInternalConversion::~NuDEXInternalConversion(){
       if(Icc_M[j][i]!=0){delete [] Icc_M[j][i];}
     }
   }
+  for(int i=0;i<2*ICC_NMULTIP;i++){
+    if(TableAlpha[i]!=0){delete [] TableAlpha[i];}
+    if(TableLogAlpha[i]!=0){delete [] TableLogAlpha[i];}
+    if(TableCumulFraction[i]!=0){delete [] TableCumulFraction[i];}
+  }
+  if(TableExactCell!=0){delete [] TableExactCell;}
   delete theRandom4;
 }
 
@@ -245,6 +331,70 @@ void NuDEXInternalConversion::Init(const char* fname){
     NuDEXException(__FILE__,std::to_string(__LINE__).c_str(),"##### Error in NuDEX #####");
   }
 
+  std::string cacheKey=std::string(fname)+" "+std::to_string(theZ);
+  if(UseICCDataCache){
+    std::shared_ptr<const NuDEXInternalConversion> theCachedData;
+    {
+      std::lock_guard<std::mutex> lock(theICCDataCacheMutex);
+      std::map<std::string,std::shared_ptr<const NuDEXInternalConversion> >::iterator it=theICCDataCache.find(cacheKey);
+      if(it!=theICCDataCache.end()){theCachedData=it->second;}
+    }
+    if(theCachedData){
+      CopyData(theCachedData.get());
+      return;
+    }
+  }
+
+  if(!ReadBinaryFile(NuDEXGetBinaryFileName(fname).c_str(),fname)){
+    ReadTextFile(fname);
+  }
+
+  MakeTotal();
+
+  if(UseICCDataCache){
+    NuDEXInternalConversion* theCopy=new NuDEXInternalConversion(theZ);
+    theCopy->CopyData(this);
+    std::shared_ptr<const NuDEXInternalConversion> theCachedData(theCopy);
+    std::lock_guard<std::mutex> lock(theICCDataCacheMutex);
+    if(UseICCDataCache && theICCDataCache.find(cacheKey)==theICCDataCache.end()){
+      theICCDataCache[cacheKey]=theCachedData;
+    }
+  }
+}
+
+
+//The entries still used by some Init are deleted when it finishes with them:
+void NuDEXInternalConversion::SetDataCache(bool useCache){
+
+  std::lock_guard<std::mutex> lock(theICCDataCacheMutex);
+  UseICCDataCache=useCache;
+  if(!useCache){
+    theICCDataCache.clear();
+  }
+}
+
+
+void NuDEXInternalConversion::CopyData(const NuDEXInternalConversion* other){
+
+  if(other->theZ!=theZ || NShells!=0){
+    NuDEXException(__FILE__,std::to_string(__LINE__).c_str(),"##### Error in NuDEX #####");
+  }
+  NShells=other->NShells;
+  for(int k=0;k<=NShells;k++){ //the total is in k=NShells
+    BindingEnergy[k]=other->BindingEnergy[k];
+    OrbitalName[k]=other->OrbitalName[k];
+    AllocateShell(k,other->np[k]);
+    memcpy(Eg[k],other->Eg[k],np[k]*sizeof(double));
+    for(int i=0;i<ICC_NMULTIP;i++){
+      memcpy(Icc_E[i][k],other->Icc_E[i][k],np[k]*sizeof(double));
+      memcpy(Icc_M[i][k],other->Icc_M[i][k],np[k]*sizeof(double));
+    }
+  }
+}
+
+
+void NuDEXInternalConversion::ReadTextFile(const char* fname){
+
   std::ifstream in(fname);
   if(!in.good()){
     std::cout<<" ################ Error opening "<<fname<<" ################"<<std::endl;
@@ -275,15 +425,10 @@ void NuDEXInternalConversion::Init(const char* fname){
 	double Eg_tmp[1000],Icc_E_tmp[ICC_NMULTIP][100],Icc_M_tmp[ICC_NMULTIP][100];
 	while(getline(in,word)){
 	  if(word.size()<100){
-	    np[orbindex]=np_tmp;
-	    Eg[orbindex]=new double[np_tmp];
+	    AllocateShell(orbindex,np_tmp);
 	    for(int j=0;j<np_tmp;j++){
 	      Eg[orbindex][j]=Eg_tmp[j];
 	    }
-	    for(int i=0;i<ICC_NMULTIP;i++){
-	      Icc_E[i][orbindex]=new double[np_tmp];
-	      Icc_M[i][orbindex]=new double[np_tmp];
-	    }
 	    for(int i=0;i<ICC_NMULTIP;i++){
 	      for(int j=0;j<np_tmp;j++){
 		Icc_E[i][orbindex][j]=Icc_E_tmp[i][j];
@@ -322,8 +467,17 @@ void NuDEXInternalConversion::Init(const char* fname){
     NuDEXException(__FILE__,std::to_string(__LINE__).c_str(),"##### Error in NuDEX #####");
   }
   in.close();
+}
 
-  MakeTotal();
+
+void NuDEXInternalConversion::AllocateShell(int orbindex,int npoints){
+
+  np[orbindex]=npoints;
+  Eg[orbindex]=new double[npoints];
+  for(int i=0;i<ICC_NMULTIP;i++){
+    Icc_E[i][orbindex]=new double[npoints];
+    Icc_M[i][orbindex]=new double[npoints];
+  }
 }
 
 
@@ -363,6 +517,112 @@ void NuDEXInternalConversion::MakeTotal(){
   
 }
 
+
+void NuDEXInternalConversion::Tabulate(int NPointsPerDecade){
+
+  if(theZ<MINZINTABLES || NShells<2 || NPointsPerDecade<=0){return;}
+
+  if(TableNPoints!=0){ //Tabulate only once
+    NuDEXException(__FILE__,std::to_string(__LINE__).c_str(),"##### Error in NuDEX #####");
+  }
+
+  //Same energy range as the total given by the data:
+  double Emin=Eg[0][0],Emax=Eg[0][np[0]-1];
+  if(Emin<=0 || Emax<=Emin){return;}
+  int nPoints=(int)(log10(Emax/Emin)*NPointsPerDecade)+2;
+  double LogEmin=log(Emin);
+  double DLogE=(log(Emax)-LogEmin)/(nPoints-1);
+  double* Ene=new double[nPoints];
+  for(int k=0;k<nPoints;k++){
+    Ene[k]=exp(LogEmin+k*DLogE);
+  }
+
+  //The cells containing a binding energy or the last energy of a shell are not interpolated:
+  TableExactCell=new bool[nPoints-1];
+  for(int k=0;k<nPoints-1;k++){TableExactCell[k]=false;}
+  for(int i=1;i<NShells;i++){
+    double Edisc[2]={BindingEnergy[i],Eg[i][np[i]-1]};
+    for(int j=0;j<2;j++){
+      if(Edisc[j]<=0){continue;}
+      int k0=(int)floor((log(Edisc[j])-LogEmin)/DLogE);
+      for(int k=k0-1;k<=k0+1;k++){ //one cell more at each side, because of the rounding
+	if(k>=0 && k<nPoints-1){TableExactCell[k]=true;}
+      }
+    }
+  }
+
+  //The values at the nodes are the ones of GetICC:
+  int nCumul=NShells-1;
+  for(int m=0;m<2*ICC_NMULTIP;m++){
+    int multipolarity=(m<ICC_NMULTIP)?(m+1):(-(m-ICC_NMULTIP)-1);
+    TableAlpha[m]=new double[nPoints];
+    TableLogAlpha[m]=new double[nPoints];
+    TableCumulFraction[m]=new double[nPoints*nCumul];
+    for(int k=0;k<nPoints;k++){
+      double* cumul=&TableCumulFraction[m][k*nCumul];
+      double total=0;
+      for(int i=1;i<NShells;i++){
+	total+=GetICC(Ene[k],multipolarity,i);
+	cumul[i-1]=total;
+      }
+      TableAlpha[m][k]=total;
+      TableLogAlpha[m][k]=0;
+      if(total>0){
+	TableLogAlpha[m][k]=log(total);
+	for(int i=0;i<nCumul;i++){cumul[i]/=total;}
+      }
+      cumul[nCumul-1]=1;
+    }
+  }
+  delete [] Ene;
+
+  TableLogEmin=LogEmin;
+  TableInvDLogE=1./DLogE;
+  TableNPoints=nPoints;
+}
+
+
+int NuDEXInternalConversion::GetTableCell(double Ene,int multipolarity,double& f){
+
+  if(TableNPoints==0 || multipolarity==0 || std::abs(multipolarity)>ICC_NMULTIP || !(Ene>0)){return -1;}
+  double x=(log(Ene)-TableLogEmin)*TableInvDLogE;
+  if(!(x>=0) || x>=TableNPoints-1){return -1;}
+  int i_cell=(int)x;
+  if(TableExactCell[i_cell]){return -1;}
+  f=x-i_cell;
+  return i_cell;
+}
+
+
+//log-log interpolation, or lin-log if alpha is 0 in one of the nodes
+double NuDEXInternalConversion::InterpolateTable(int i_mult,int i_cell,double f){
+
+  double a0=TableAlpha[i_mult][i_cell],a1=TableAlpha[i_mult][i_cell+1];
+  if(a0>0 && a1>0){
+    return exp(TableLogAlpha[i_mult][i_cell]+f*(TableLogAlpha[i_mult][i_cell+1]-TableLogAlpha[i_mult][i_cell]));
+  }
+  return a0+f*(a1-a0);
+}
+
+
+int NuDEXInternalConversion::SampleOrbitalFromTable(double Ene,int multipolarity,double relRand){
+
+  double f;
+  int i_cell=GetTableCell(Ene,multipolarity,f);
+  if(i_cell<0){return -1;}
+  int i_mult=std::abs(multipolarity)-1+(multipolarity<0)*ICC_NMULTIP;
+  if(TableAlpha[i_mult][i_cell]<=0 || TableAlpha[i_mult][i_cell+1]<=0){return -1;}
+
+  int nCumul=NShells-1;
+  double* cumul0=&TableCumulFraction[i_mult][i_cell*nCumul];
+  double* cumul1=cumul0+nCumul;
+  for(int i=0;i<nCumul-1;i++){
+    if(cumul0[i]+f*(cumul1[i]-cumul0[i])>=relRand){return i+1;}
+  }
+  return nCumul;
+}
+
+
 //if val>x[npmax] then ---> return 0
 double NuDEXInternalConversion::Interpolate(double val,int npoints,double* x,double* y){
 
@@ -397,3 +657,121 @@ double NuDEXInternalConversion::Interpolate(double val,int npoints,double* x,dou
   double result=exp(a0+a1*log(val));
   return result;
 }
+
+
+
+int NuDEXInternalConversion::MakeBinaryFile(const char* textfname,const char* binfname){
+
+  NuDEXBinaryHeader header;
+  if(NuDEXMakeBinaryHeader(&header,"NuDEXICC",ICC_BINARYVERSION,0,textfname)<0){
+    std::cout<<" ################ Error opening "<<textfname<<" ################"<<std::endl;
+    return -1;
+  }
+
+  //The Z values in the text file:
+  std::vector<int> theZs;
+  std::ifstream in(textfname);
+  std::string line;
+  while(getline(in,line)){
+    if(line.size()>2 && line[0]=='Z' && line[1]=='='){
+      int aZ=std::atoi(line.c_str()+2);
+      if(aZ>=MINZINTABLES){theZs.push_back(aZ);}
+    }
+  }
+  in.close();
+  std::sort(theZs.begin(),theZs.end());
+  theZs.erase(std::unique(theZs.begin(),theZs.end()),theZs.end());
+  int nZ=theZs.size();
+
+  std::ofstream out(binfname,std::ios::binary);
+  if(!out.good()){
+    std::cout<<" ################ Error opening "<<binfname<<" ################"<<std::endl;
+    return -1;
+  }
+  header.nEntries=nZ;
+  std::vector<ICCBinaryIndex> theIndex(nZ);
+  out.write((const char*)&header,sizeof(header));
+  out.write((const char*)theIndex.data(),nZ*sizeof(ICCBinaryIndex)); //filled at the end
+
+  //Each Z is read with the same code as Init, so the values are the same:
+  long long offset=sizeof(header)+nZ*sizeof(ICCBinaryIndex);
+  for(int k=0;k<nZ;k++){
+    NuDEXInternalConversion aICC(theZs[k]);
+    aICC.ReadTextFile(textfname);
+    theIndex[k].Z=theZs[k];
+    theIndex[k].NShells=aICC.NShells;
+    theIndex[k].offset=offset;
+    for(int i=0;i<aICC.NShells;i++){
+      ICCBinaryShell shell;
+      memset(&shell,0,sizeof(shell));
+      shell.BindingEnergy=aICC.BindingEnergy[i];
+      shell.np=aICC.np[i];
+      if(aICC.OrbitalName[i].size()>=ICC_MAXORBITALNAME){
+	std::cout<<" ################ Error: orbital name "<<aICC.OrbitalName[i]<<" is too long ################"<<std::endl;
+	return -1;
+      }
+      strcpy(shell.OrbitalName,aICC.OrbitalName[i].c_str());
+      out.write((const char*)&shell,sizeof(shell));
+      out.write((const char*)aICC.Eg[i],shell.np*sizeof(double));
+      for(int j=0;j<ICC_NMULTIP;j++){out.write((const char*)aICC.Icc_E[j][i],shell.np*sizeof(double));}
+      for(int j=0;j<ICC_NMULTIP;j++){out.write((const char*)aICC.Icc_M[j][i],shell.np*sizeof(double));}
+      offset+=sizeof(shell)+(1+2*ICC_NMULTIP)*shell.np*sizeof(double);
+    }
+  }
+  out.seekp(sizeof(header));
+  out.write((const char*)theIndex.data(),nZ*sizeof(ICCBinaryIndex));
+  if(!out.good()){
+    std::cout<<" ################ Error writing "<<binfname<<" ################"<<std::endl;
+    return -1;
+  }
+  out.close();
+
+  return 0;
+}
+
+
+bool NuDEXInternalConversion::ReadBinaryFile(const char* binfname,const char* textfname){
+
+  size_t fsize;
+  const char* data=NuDEXMapBinaryFile(binfname,"NuDEXICC",ICC_BINARYVERSION,textfname,fsize);
+  if(data==0){return false;}
+
+  const NuDEXBinaryHeader* header=(const NuDEXBinaryHeader*)data;
+  const ICCBinaryIndex* entry=0;
+  if(sizeof(NuDEXBinaryHeader)+header->nEntries*sizeof(ICCBinaryIndex)<=fsize){
+    const ICCBinaryIndex* theIndex=(const ICCBinaryIndex*)(data+sizeof(NuDEXBinaryHeader));
+    const ICCBinaryIndex* it=std::lower_bound(theIndex,theIndex+header->nEntries,theZ,[](const ICCBinaryIndex& a,int aZ){return a.Z<aZ;});
+    if(it!=theIndex+header->nEntries && it->Z==theZ && it->NShells>0 && it->NShells<ICC_MAXNSHELLS){entry=it;}
+  }
+
+  //Check that all the shells are inside the file, before allocating anything:
+  size_t offset=0;
+  if(entry!=0){
+    offset=entry->offset;
+    for(int i=0;i<entry->NShells && entry!=0;i++){
+      if(offset+sizeof(ICCBinaryShell)>fsize){entry=0; break;}
+      const ICCBinaryShell* shell=(const ICCBinaryShell*)(data+offset);
+      offset+=sizeof(ICCBinaryShell)+(1+2*ICC_NMULTIP)*(size_t)shell->np*sizeof(double);
+      if(shell->np<=0 || offset>fsize){entry=0;}
+    }
+  }
+
+  if(entry!=0){
+    NShells=entry->NShells;
+    offset=entry->offset;
+    for(int i=0;i<NShells;i++){
+      const ICCBinaryShell* shell=(const ICCBinaryShell*)(data+offset);
+      const double* values=(const double*)(data+offset+sizeof(ICCBinaryShell));
+      BindingEnergy[i]=shell->BindingEnergy;
+      OrbitalName[i]=std::string(shell->OrbitalName,strnlen(shell->OrbitalName,ICC_MAXORBITALNAME));
+      AllocateShell(i,shell->np);
+      memcpy(Eg[i],values,np[i]*sizeof(double)); values+=np[i];
+      for(int j=0;j<ICC_NMULTIP;j++){memcpy(Icc_E[j][i],values,np[i]*sizeof(double)); values+=np[i];}
+      for(int j=0;j<ICC_NMULTIP;j++){memcpy(Icc_M[j][i],values,np[i]*sizeof(double)); values+=np[i];}
+      offset+=sizeof(ICCBinaryShell)+(1+2*ICC_NMULTIP)*np[i]*sizeof(double);
+    }
+  }
+
+  NuDEXUnmapBinaryFile(data,fsize);
+  return (entry!=0);
+}
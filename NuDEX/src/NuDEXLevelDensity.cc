@@ -18,6 +18,18 @@ NuDEXLevelDensity::NuDEXLevelDensity(int aZ,int aA,int ldtype){
   Sn=-1; D0=-1; I0=-1000;
   Ed=0; 
   ainf_ldpar=0; gamma_ldpar=0; dW_ldpar=0; Delta_ldpar=0; T_ldpar=0; E0_ldpar=0; Ex_ldpar=0;
+
+  TableNSpins=0; TableNPoints=0; TableNBins=0;
+  TableDeltaE=0;
+  TableE=0; TableFirstPoint=0; TableRho=0; TableCumul=0;
+}
+
+NuDEXLevelDensity::~NuDEXLevelDensity(){
+
+  if(TableE!=0){delete [] TableE;}
+  if(TableFirstPoint!=0){delete [] TableFirstPoint;}
+  if(TableRho!=0){delete [] TableRho;}
+  if(TableCumul!=0){delete [] TableCumul;}
 }
 
 
@@ -305,6 +317,10 @@ double NuDEXLevelDensity::EstimateInverse(double LevDen_iMeV,double spin,bool pa
 
   double tolerance=0.001; //the result will have this relative tolerance. 0.01 means 1%
 
+  //Inside the tables, the level density is interpolated:
+  int spinx2,i;
+  double rho;
+
   double xmin=0;
   double xmax=1;
   while(GetLevelDensity(xmax,spin,parity)<LevDen_iMeV){
@@ -313,7 +329,13 @@ double NuDEXLevelDensity::EstimateInverse(double LevDen_iMeV,double spin,bool pa
 
   while(xmin/xmax<1-tolerance){
     double x0=(xmin+xmax)/2.;
-    if(GetLevelDensity(x0,spin,parity)<LevDen_iMeV){
+    if(GetTableCell(x0,spin,spinx2,i)){
+      rho=InterpolateCell(spinx2,i,x0);
+    }
+    else{
+      rho=GetLevelDensity(x0,spin,parity);
+    }
+    if(rho<LevDen_iMeV){
       xmin=x0;
     }
     else{
@@ -329,18 +351,119 @@ double NuDEXLevelDensity::EstimateInverse(double LevDen_iMeV,double spin,bool pa
 double NuDEXLevelDensity::Integrate(double Emin,double Emax,double spin,bool parity){
 
   int nb=1000;
+
+  //From the tables, in the same range as the trapezoidal rule below:
+  int spinx2,i1,i2;
+  double EmaxInt=Emin+(Emax-Emin)*nb/(double)(nb-1.);
+  if(GetTableCell(Emin,spin,spinx2,i1) && GetTableCell(EmaxInt,spin,spinx2,i2)){
+    double cumul1=TableCumul[spinx2*TableNPoints+i1]+IntegrateCell(spinx2,i1,Emin);
+    double cumul2=TableCumul[spinx2*TableNPoints+i2]+IntegrateCell(spinx2,i2,EmaxInt);
+    return cumul2-cumul1;
+  }
+
+  //Each point is evaluated once (y2 of one trapezoid is y1 of the next one):
   double Integral=0,x1,x2,y1,y2;
+  x1=Emin;
+  y1=GetLevelDensity(x1,spin,parity);
   for(int i=0;i<nb;i++){
-    x1=Emin+(Emax-Emin)*i/(double)(nb-1.);
     x2=Emin+(Emax-Emin)*(i+1.)/(double)(nb-1.);
-    y1=GetLevelDensity(x1,spin,parity);
     y2=GetLevelDensity(x2,spin,parity);
     Integral+=(y1+y2)/2.*(x2-x1);
+    x1=x2; y1=y2;
   }
 
   return Integral;
 }
 
+
+void NuDEXLevelDensity::Tabulate(double Emin,double Emax,int maxspinx2,int NPointsPerMeV){
+
+  if(TableE!=0){delete [] TableE; TableE=0;}
+  if(TableFirstPoint!=0){delete [] TableFirstPoint; TableFirstPoint=0;}
+  if(TableRho!=0){delete [] TableRho; TableRho=0;}
+  if(TableCumul!=0){delete [] TableCumul; TableCumul=0;}
+  if(Emax<=Emin || maxspinx2<0 || NPointsPerMeV<=0){return;}
+
+  //Energies:
+  TableDeltaE=1./NPointsPerMeV;
+  TableNBins=(int)((Emax-Emin)/TableDeltaE)+1;
+  std::vector<double> theE;
+  for(int j=0;j<=TableNBins;j++){
+    theE.push_back(Emin+j*TableDeltaE);
+  }
+  double SpecialE[4]={Delta_ldpar,Ed,Sn,Ex_ldpar};
+  double Elast=theE.back();
+  for(int k=0;k<4;k++){
+    if(SpecialE[k]>Emin+1.e-6 && SpecialE[k]<Elast){
+      theE.push_back(SpecialE[k]*(1.-1.e-12));
+      theE.push_back(SpecialE[k]);
+    }
+  }
+  std::sort(theE.begin(),theE.end());
+  TableNPoints=theE.size();
+  TableE=new double[TableNPoints];
+  for(int i=0;i<TableNPoints;i++){TableE[i]=theE[i];}
+  TableFirstPoint=new int[TableNBins+1];
+  int i_point=0;
+  for(int j=0;j<=TableNBins;j++){
+    while(i_point+1<TableNPoints && TableE[i_point+1]<=TableE[0]+j*TableDeltaE){i_point++;}
+    TableFirstPoint[j]=i_point;
+  }
+
+  //Level density and its integral:
+  TableNSpins=maxspinx2+1;
+  TableRho=new double[TableNSpins*TableNPoints];
+  TableCumul=new double[TableNSpins*TableNPoints];
+  for(int spinx2=0;spinx2<TableNSpins;spinx2++){
+    double* rho=&TableRho[spinx2*TableNPoints];
+    double* cumul=&TableCumul[spinx2*TableNPoints];
+    for(int i=0;i<TableNPoints;i++){
+      rho[i]=GetLevelDensity(TableE[i],spinx2/2.,true);
+    }
+    cumul[0]=0;
+    for(int i=1;i<TableNPoints;i++){
+      cumul[i]=cumul[i-1]+IntegrateCell(spinx2,i-1,TableE[i]);
+    }
+  }
+}
+
+
+bool NuDEXLevelDensity::GetTableCell(double ExcEnergy,double spin,int& spinx2,int& i){
+
+  if(TableRho==0){return false;}
+  spinx2=(int)(spin*2+0.01);
+  if(spinx2<0 || spinx2>=TableNSpins){return false;}
+  if(ExcEnergy<TableE[0] || ExcEnergy>TableE[TableNPoints-1]){return false;}
+  int j=(int)((ExcEnergy-TableE[0])/TableDeltaE);
+  if(j>TableNBins){j=TableNBins;}
+  i=TableFirstPoint[j];
+  while(i+1<TableNPoints-1 && TableE[i+1]<=ExcEnergy){i++;}
+  if(i>TableNPoints-2){i=TableNPoints-2;}
+  return true;
+}
+
+
+double NuDEXLevelDensity::InterpolateCell(int spinx2,int i,double ExcEnergy){
+
+  double rho1=TableRho[spinx2*TableNPoints+i],rho2=TableRho[spinx2*TableNPoints+i+1];
+  double x=(ExcEnergy-TableE[i])/(TableE[i+1]-TableE[i]);
+  if(rho1>0 && rho2>0){return rho1*exp(std::log(rho2/rho1)*x);}
+  return rho1+(rho2-rho1)*x;
+}
+
+
+double NuDEXLevelDensity::IntegrateCell(int spinx2,int i,double ExcEnergy){
+
+  double rho1=TableRho[spinx2*TableNPoints+i],rho2=TableRho[spinx2*TableNPoints+i+1];
+  double width=TableE[i+1]-TableE[i];
+  double dE=ExcEnergy-TableE[i];
+  if(rho1>0 && rho2>0 && rho1!=rho2){ //rho=rho1*exp(b*dE)
+    double b=std::log(rho2/rho1)/width;
+    return rho1*std::expm1(b*dE)/b;
+  }
+  return rho1*dE+(rho2-rho1)*dE*dE/(2.*width);
+}
+
 void NuDEXLevelDensity::PrintParameters(std::ostream &out){
 
   out<<" Level density type: "<<LDType<<std::endl;
@@ -0,0 +1,240 @@
+
+#include "NuDEXNeutronSpectrum.hh"
+#include <sstream>
+#include <cmath>
+#include <algorithm>
+
+
+
+NuDEXNeutronSpectrum::NuDEXNeutronSpectrum(NuDEXStatisticalNucleus* aNucleus){
+
+  theNucleus=aNucleus;
+  NBins=0;
+  ThermalEnergy=0;
+  theBinAlias=0;
+}
+
+
+NuDEXNeutronSpectrum::~NuDEXNeutronSpectrum(){
+
+  Clear();
+}
+
+
+void NuDEXNeutronSpectrum::Clear(){
+
+  if(theBinAlias!=0){DeleteAliasTable(theBinAlias); theBinAlias=0;}
+  for(size_t i=0;i<theStartingLevelAlias.size();i++){
+    if(theStartingLevelAlias[i]!=0){DeleteAliasTable(theStartingLevelAlias[i]);}
+  }
+  theStartingLevelAlias.clear();
+  theStartingLevels.clear();
+  theStartingLevelWeights.clear();
+  theBinEdges.clear();
+  theBinContents.clear();
+  NBins=0;
+}
+
+
+int NuDEXNeutronSpectrum::Init(int nBins,const double* binEdges,const double* content,double thermalEnergy,int nThreads){
+
+  Clear();
+  if(theNucleus==0 || !theNucleus->HasBeenInitialized()){
+    std::cout<<" ############## Error: NuDEXNeutronSpectrum needs an initialized nucleus ##############"<<std::endl;
+    return -1;
+  }
+  if(nBins<=0 || binEdges==0 || content==0){
+    std::cout<<" ############## Error: NuDEXNeutronSpectrum without bins ##############"<<std::endl;
+    return -1;
+  }
+  double total=0;
+  for(int i=0;i<nBins;i++){
+    if(binEdges[i]<0 || binEdges[i+1]<=binEdges[i] || content[i]<0){
+      std::cout<<" ############## Error: wrong bin "<<i<<" of the NuDEXNeutronSpectrum: ["<<binEdges[i]<<","<<binEdges[i+1]<<"] MeV, content "<<content[i]<<" ##############"<<std::endl;
+      return -1;
+    }
+    total+=content[i];
+  }
+  if(total<=0){
+    std::cout<<" ############## Error: NuDEXNeutronSpectrum with all the bins empty ##############"<<std::endl;
+    return -1;
+  }
+
+  NBins=nBins;
+  ThermalEnergy=thermalEnergy;
+  theBinEdges.assign(binEdges,binEdges+nBins+1);
+  theBinContents.assign(content,content+nBins);
+  std::vector<double> cumulContent(nBins);
+  for(int i=0;i<nBins;i++){
+    cumulContent[i]=content[i]+(i>0?cumulContent[i-1]:0);
+  }
+  theBinAlias=CreateAliasTable(cumulContent.data(),nBins);
+
+  //Starting levels of each bin (only of the ones which can be sampled):
+  theStartingLevels.resize(nBins);
+  theStartingLevelWeights.resize(nBins);
+  theStartingLevelAlias.resize(nBins,0);
+  std::vector<int> allLevels;
+  for(int i=0;i<nBins;i++){
+    if(content[i]<=0){continue;}
+    if(FindStartingLevels(i)<0){
+      Clear();
+      return -1;
+    }
+    for(size_t k=0;k<theStartingLevels[i].size();k++){
+      if(theStartingLevels[i][k]>0){allLevels.push_back(theStartingLevels[i][k]);}
+    }
+  }
+
+  //BR of the starting levels:
+  std::sort(allLevels.begin(),allLevels.end());
+  allLevels.erase(std::unique(allLevels.begin(),allLevels.end()),allLevels.end());
+  std::reverse(allLevels.begin(),allLevels.end()); //the highest levels (the most expensive ones) first
+  theNucleus->PrecomputeEntryBR(nThreads,allLevels);
+
+  return 0;
+}
+
+
+int NuDEXNeutronSpectrum::Init(const char* fname,double thermalEnergy,int nThreads){
+
+  std::ifstream in(fname);
+  if(!in.good()){
+    std::cout<<" ############## Error opening "<<fname<<" ##############"<<std::endl;
+    return -1;
+  }
+  std::vector<double> binEdges,content;
+  std::string line;
+  while(std::getline(in,line)){
+    if(line.find('#')!=std::string::npos){line=line.substr(0,line.find('#'));}
+    std::istringstream ss(line);
+    double emin,emax,c;
+    if(!(ss>>emin)){continue;} //empty line
+    if(!(ss>>emax>>c)){
+      std::cout<<" ############## Error reading "<<fname<<": "<<line<<" ##############"<<std::endl;
+      return -1;
+    }
+    if(binEdges.size()==0){
+      binEdges.push_back(emin);
+    }
+    else if(emin!=binEdges.back()){
+      std::cout<<" ############## Error reading "<<fname<<": the bins have to be consecutive ("<<emin<<" != "<<binEdges.back()<<") ##############"<<std::endl;
+      return -1;
+    }
+    binEdges.push_back(emax);
+    content.push_back(c);
+  }
+  in.close();
+
+  return Init((int)content.size(),binEdges.data(),content.data(),thermalEnergy,nThreads);
+}
+
+
+int NuDEXNeutronSpectrum::FindStartingLevels(int i_bin){
+
+  double Sn,I0;
+  theNucleus->GetSnAndI0(Sn,I0);
+  int A=theNucleus->GetA();
+  std::vector<int>& levels=theStartingLevels[i_bin];
+  std::vector<double>& weights=theStartingLevelWeights[i_bin];
+
+  if(theBinEdges[i_bin+1]<=ThermalEnergy){
+    levels.push_back(-1);
+    weights.push_back(1);
+  }
+  else{
+    //s-wave capture:
+    int spinx2[2]={-1,-1};
+    bool parity=true;
+    if(I0<=-100){
+      std::cout<<" ####### WARNING: unknown spin and parity of the target nucleus, the starting levels can have any spin and parity ############"<<std::endl;
+    }
+    else{
+      int I0x2=(int)(2*std::fabs(I0)+0.1);
+      spinx2[0]=I0x2+1;
+      spinx2[1]=I0x2-1; //-1 if I0=0
+      if(I0<0){parity=false;}
+    }
+    double Emin=Sn+(A-1.)/(double)A*theBinEdges[i_bin];
+    double Emax=Sn+(A-1.)/(double)A*theBinEdges[i_bin+1];
+    //The levels are sorted by energy:
+    int NLevels=theNucleus->GetNLevels();
+    int i_first=0,i_last=NLevels;
+    while(i_first<i_last){
+      int i_mid=(i_first+i_last)/2;
+      if(theNucleus->GetLevelEnergy(i_mid)<Emin){i_first=i_mid+1;}
+      else{i_last=i_mid;}
+    }
+    for(int i_level=i_first;i_level<NLevels;i_level++){
+      const Level* aLevel=theNucleus->GetLevel(i_level);
+      if(aLevel->Energy>=Emax){break;}
+      if(spinx2[0]>=0 && !(aLevel->parity==parity && (aLevel->spinx2==spinx2[0] || aLevel->spinx2==spinx2[1]))){continue;}
+      levels.push_back(i_level);
+      weights.push_back((aLevel->spinx2+1)*std::max(aLevel->NLevels,1));
+    }
+    if(levels.size()==0){ //the closest one
+      double Ecenter=(Emin+Emax)/2.;
+      int closest=-1;
+      for(int k=0;k<2;k++){
+	if(spinx2[k]<0){continue;}
+	int i_level=theNucleus->GetClosestLevel(Ecenter,spinx2[k],parity);
+	if(i_level>=0 && (closest<0 || std::fabs(theNucleus->GetLevelEnergy(i_level)-Ecenter)<std::fabs(theNucleus->GetLevelEnergy(closest)-Ecenter))){
+	  closest=i_level;
+	}
+      }
+      if(closest<0){ //there are no levels with the requested spin and parity
+	closest=theNucleus->GetClosestLevel(Ecenter,-1,parity);
+      }
+      if(closest<=0){
+	std::cout<<" ############## Error: no starting level for the neutron energies ["<<theBinEdges[i_bin]<<","<<theBinEdges[i_bin+1]<<"] MeV ##############"<<std::endl;
+	return -1;
+      }
+      levels.push_back(closest);
+      weights.push_back(1);
+    }
+  }
+
+  if(levels.size()>1){
+    std::vector<double> cumulWeights(weights.size());
+    for(size_t k=0;k<weights.size();k++){
+      cumulWeights[k]=weights[k]+(k>0?cumulWeights[k-1]:0);
+    }
+    theStartingLevelAlias[i_bin]=CreateAliasTable(cumulWeights.data(),(int)cumulWeights.size());
+  }
+  return 0;
+}
+
+
+int NuDEXNeutronSpectrum::Sample(double r1,double r2,double r3,int& InitialLevel,double& ExcitationEnergy) const{
+
+  int i_bin=SampleFromAliasTable(theBinAlias,r1);
+  double NeutronEnergy=theBinEdges[i_bin]+r2*(theBinEdges[i_bin+1]-theBinEdges[i_bin]);
+  const std::vector<int>& levels=theStartingLevels[i_bin];
+  if(theStartingLevelAlias[i_bin]!=0){
+    InitialLevel=levels[SampleFromAliasTable(theStartingLevelAlias[i_bin],r3)];
+  }
+  else{
+    InitialLevel=levels[0];
+  }
+  double Sn,I0;
+  theNucleus->GetSnAndI0(Sn,I0);
+  int A=theNucleus->GetA();
+  ExcitationEnergy=Sn+(A-1.)/(double)A*NeutronEnergy;
+  return i_bin;
+}
+
+
+void NuDEXNeutronSpectrum::PrintStartingLevels(std::ostream &out) const{
+
+  out<<" NuDEX neutron spectrum: "<<NBins<<" bins, from "<<theBinEdges[0]<<" to "<<theBinEdges[NBins]<<" MeV"<<std::endl;
+  for(int i=0;i<NBins;i++){
+    if(theBinContents[i]<=0){continue;}
+    out<<"   ["<<theBinEdges[i]<<","<<theBinEdges[i+1]<<"] MeV: ";
+    if(theStartingLevels[i].size()==1 && theStartingLevels[i][0]==-1){
+      out<<"thermal capture level"<<std::endl;
+    }
+    else{
+      out<<theStartingLevels[i].size()<<" starting levels (first one: "<<theStartingLevels[i][0]<<")"<<std::endl;
+    }
+  }
+}
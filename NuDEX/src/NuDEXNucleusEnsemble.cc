@@ -0,0 +1,97 @@
+
+#include "NuDEXNucleusEnsemble.hh"
+#include <atomic>
+#include <sstream>
+
+
+
+NuDEXNucleusEnsemble::NuDEXNucleusEnsemble(int Z,int A,int NRealizations){
+
+  if(NRealizations<1){
+    std::cout<<" ######## Error: a NuDEXNucleusEnsemble needs at least one realization ########"<<std::endl;
+    NuDEXException(__FILE__,std::to_string(__LINE__).c_str(),"##### Error in NuDEX #####");
+  }
+  Z_Int=Z; A_Int=A;
+  theSeed1=0; theSeed2=0;
+  for(int k=0;k<NRealizations;k++){
+    theRealizations.push_back(new NuDEXStatisticalNucleus(Z,A));
+  }
+}
+
+
+NuDEXNucleusEnsemble::~NuDEXNucleusEnsemble(){
+
+  //The realization 0 (with the shared data) the last one:
+  for(int k=(int)theRealizations.size()-1;k>=0;k--){
+    delete theRealizations[k];
+  }
+}
+
+
+int NuDEXNucleusEnsemble::Init(const char* dirname,const char* inputfname,unsigned int seed1,unsigned int seed2,int nThreads,int BRPrecomputeNThreads){
+
+  NuDEXStatisticalNucleus::SetLibraryDataCache(true);
+
+  //Realization 0:
+  NuDEXStatisticalNucleus* theFirst=theRealizations[0];
+  theFirst->SetSomeInitalParameters(-1,-1,-1,-1,0,0,-1,-1,seed1,seed2);
+  if(BRPrecomputeNThreads>0){theFirst->SetBRPrecomputeNThreads(BRPrecomputeNThreads);}
+  if(theFirst->Init(dirname,inputfname)<0){
+    std::cout<<" ######## Error initializing the realization 0 of Z="<<Z_Int<<", A="<<A_Int<<" from "<<dirname<<" ########"<<std::endl;
+    return -1;
+  }
+  unsigned int seed3;
+  theFirst->GetSeeds(theSeed1,theSeed2,seed3);
+
+  //The rest of them, in parallel:
+  int NRealizations=(int)theRealizations.size();
+  if(nThreads<1){nThreads=1;}
+  if(nThreads>NRealizations-1){nThreads=NRealizations-1;}
+  std::atomic<int> nextRealization(1),nErrors(0);
+  std::vector<std::thread> theThreads;
+  for(int i=0;i<nThreads;i++){
+    theThreads.push_back(std::thread([&,this](){
+      int k;
+      while((k=nextRealization++)<NRealizations){
+	unsigned int s1,s2;
+	GetRealizationSeeds(k,s1,s2);
+	NuDEXStatisticalNucleus* aNucleus=theRealizations[k];
+	aNucleus->SetSomeInitalParameters(-1,-1,-1,-1,0,0,-1,-1,s1,s2,seed3);
+	if(BRPrecomputeNThreads>0){aNucleus->SetBRPrecomputeNThreads(BRPrecomputeNThreads);}
+	aNucleus->SetSharedData(theFirst);
+	if(aNucleus->Init(dirname,inputfname)<0){
+	  std::cout<<" ######## Error initializing the realization "<<k<<" of Z="<<Z_Int<<", A="<<A_Int<<" from "<<dirname<<" ########"<<std::endl;
+	  nErrors++;
+	}
+      }
+    }));
+  }
+  for(size_t i=0;i<theThreads.size();i++){
+    theThreads[i].join();
+  }
+
+  if(nErrors>0){return -1;}
+  return 0;
+}
+
+
+void NuDEXNucleusEnsemble::GetRealizationSeeds(int k,unsigned int& seed1,unsigned int& seed2){
+
+  if(k==0){
+    seed1=theSeed1; seed2=theSeed2;
+    return;
+  }
+  std::ostringstream key1,key2;
+  key1<<"ENSEMBLE REALIZATION "<<k<<" SEED1 "<<theSeed1;
+  key2<<"ENSEMBLE REALIZATION "<<k<<" SEED2 "<<theSeed2;
+  seed1=(unsigned int)(NuDEXHash(key1.str())%4294967295ULL)+1;
+  seed2=(unsigned int)(NuDEXHash(key2.str())%4294967295ULL)+1;
+}
+
+
+int NuDEXNucleusEnsemble::GetRealizationOfEvent(long long iEvent,long long BlockSize) const{
+
+  if(BlockSize<1){BlockSize=1;}
+  if(iEvent<0){iEvent=0;}
+  return (int)((iEvent/BlockSize)%(long long)theRealizations.size());
+}
@@ -0,0 +1,111 @@
+
+#include "NuDEXNucleusRegistry.hh"
+
+
+std::mutex NuDEXNucleusRegistry::theMutex;
+std::map<std::string,std::shared_future<NuDEXStatisticalNucleus*> > NuDEXNucleusRegistry::theNuclei;
+std::map<std::string,std::shared_future<NuDEXNucleusEnsemble*> > NuDEXNucleusRegistry::theEnsembles;
+
+
+NuDEXStatisticalNucleus* NuDEXNucleusRegistry::GetNucleus(int Z,int A,const char* dirname,const char* inputfname,int BRPrecomputeNThreads,bool* newNucleus){
+
+  if(newNucleus!=0){*newNucleus=false;}
+  std::string key=MakeKey(Z,A,dirname,inputfname);
+
+  //The entry is inserted before Init, so a nucleus is never initialized twice, but the lock is released during Init.
+  //The calls for the same nucleus wait until the entry is ready:
+  std::unique_lock<std::mutex> lock(theMutex);
+  std::map<std::string,std::shared_future<NuDEXStatisticalNucleus*> >::iterator it=theNuclei.find(key);
+  if(it!=theNuclei.end()){
+    std::shared_future<NuDEXStatisticalNucleus*> theEntry=it->second;
+    lock.unlock();
+    return theEntry.get();
+  }
+  std::promise<NuDEXStatisticalNucleus*> thePromise; //if Init throws, the ones waiting get a std::future_error (broken promise)
+  theNuclei[key]=thePromise.get_future().share();
+  NuDEXStatisticalNucleus::SetLibraryDataCache(true);
+  lock.unlock();
+
+  NuDEXStatisticalNucleus* theNucleus=new NuDEXStatisticalNucleus(Z,A);
+  if(BRPrecomputeNThreads>0){theNucleus->SetBRPrecomputeNThreads(BRPrecomputeNThreads);}
+  if(theNucleus->Init(dirname,inputfname)<0){
+    std::cout<<" ######## Error initializing the nucleus Z="<<Z<<", A="<<A<<" from "<<dirname<<" ########"<<std::endl;
+    delete theNucleus;
+    theNucleus=0;
+  }
+  thePromise.set_value(theNucleus);
+  if(newNucleus!=0){*newNucleus=(theNucleus!=0);}
+
+  return theNucleus;
+}
+
+
+NuDEXNucleusEnsemble* NuDEXNucleusRegistry::GetEnsemble(int Z,int A,const char* dirname,int NRealizations,const char* inputfname,int nThreads,int BRPrecomputeNThreads,bool* newEnsemble){
+
+  if(newEnsemble!=0){*newEnsemble=false;}
+  std::ostringstream key;
+  key<<MakeKey(Z,A,dirname,inputfname)<<" REALIZATIONS "<<NRealizations;
+
+  //As in GetNucleus:
+  std::unique_lock<std::mutex> lock(theMutex);
+  std::map<std::string,std::shared_future<NuDEXNucleusEnsemble*> >::iterator it=theEnsembles.find(key.str());
+  if(it!=theEnsembles.end()){
+    std::shared_future<NuDEXNucleusEnsemble*> theEntry=it->second;
+    lock.unlock();
+    return theEntry.get();
+  }
+  std::promise<NuDEXNucleusEnsemble*> thePromise;
+  theEnsembles[key.str()]=thePromise.get_future().share();
+  lock.unlock();
+
+  NuDEXNucleusEnsemble* theEnsemble=new NuDEXNucleusEnsemble(Z,A,NRealizations);
+  if(theEnsemble->Init(dirname,inputfname,0,0,nThreads,BRPrecomputeNThreads)<0){
+    std::cout<<" ######## Error initializing the ensemble of Z="<<Z<<", A="<<A<<" from "<<dirname<<" ########"<<std::endl;
+    delete theEnsemble;
+    theEnsemble=0;
+  }
+  thePromise.set_value(theEnsemble);
+  if(newEnsemble!=0){*newEnsemble=(theEnsemble!=0);}
+
+  return theEnsemble;
+}
+
+
+//Only the nuclei whose Init has finished (successfully):
+int NuDEXNucleusRegistry::GetNNuclei(){
+
+  std::lock_guard<std::mutex> lock(theMutex);
+  int nNuclei=0;
+  for(std::map<std::string,std::shared_future<NuDEXStatisticalNucleus*> >::iterator it=theNuclei.begin();it!=theNuclei.end();++it){
+    if(it->second.wait_for(std::chrono::seconds(0))==std::future_status::ready && it->second.get()!=0){nNuclei++;}
+  }
+  return nNuclei;
+}
+
+
+//It waits for the nuclei and ensembles which are being initialized:
+void NuDEXNucleusRegistry::DeleteAll(){
+
+  std::lock_guard<std::mutex> lock(theMutex);
+  for(std::map<std::string,std::shared_future<NuDEXStatisticalNucleus*> >::iterator it=theNuclei.begin();it!=theNuclei.end();++it){
+    NuDEXStatisticalNucleus* theNucleus=it->second.get();
+    if(theNucleus!=0){delete theNucleus;}
+  }
+  theNuclei.clear();
+  for(std::map<std::string,std::shared_future<NuDEXNucleusEnsemble*> >::iterator it=theEnsembles.begin();it!=theEnsembles.end();++it){
+    NuDEXNucleusEnsemble* theEnsemble=it->second.get();
+    if(theEnsemble!=0){delete theEnsemble;}
+  }
+  theEnsembles.clear();
+  NuDEXStatisticalNucleus::SetLibraryDataCache(false);
+}
+
+
+std::string NuDEXNucleusRegistry::MakeKey(int Z,int A,const char* dirname,const char* inputfname){
+
+  std::ostringstream key;
+  key<<Z<<" "<<A<<" "<<dirname<<" ";
+  if(inputfname!=0){key<<inputfname;}
+  return key.str();
+}
+
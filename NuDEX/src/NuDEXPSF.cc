@@ -14,6 +14,8 @@ NuDEXPSF::NuDEXPSF(int aZ,int aA){
   ScaleFactor_E1=1;
   ScaleFactor_M1=1;
   ScaleFactor_E2=1;
+  theE1Grid=0; theM1Grid=0; theE2Grid=0;
+  nTerms[0]=0; nTerms[1]=0; nTerms[2]=0;
 }
 
 NuDEXPSF::~NuDEXPSF(){
@@ -23,6 +25,7 @@ NuDEXPSF::~NuDEXPSF(){
   if(y_M1!=0){delete [] y_M1;}
   if(x_E2!=0){delete [] x_E2;}
   if(y_E2!=0){delete [] y_E2;}
+  DeleteGrids();
 }
 
 
@@ -30,6 +33,14 @@ NuDEXPSF::~NuDEXPSF(){
 int NuDEXPSF::Init(const char* dirname,NuDEXLevelDensity* aLD,const char* inputfname,const char* defaultinputfname,int PSFflag){
 
   theLD=aLD;
+  TakePSFData(dirname,inputfname,defaultinputfname,PSFflag);
+  ResolvePSF();
+
+  return 0;
+}
+
+
+void NuDEXPSF::TakePSFData(const char* dirname,const char* inputfname,const char* defaultinputfname,int PSFflag){
 
   //Three options: very detailed model, if not --> gdr-parameters&errors-exp-MLO.dat (RIPL-3), if not --> theorethical values
 
@@ -39,25 +50,25 @@ int NuDEXPSF::Init(const char* dirname,NuDEXLevelDensity* aLD,const char* inputf
   //input:
   if(inputfname!=0){
     IsDone=TakePSFFromInputFile(inputfname);
-    if(IsDone){return 0;}
+    if(IsDone){return;}
   }
 
   //default input:
   if(defaultinputfname!=0){
     IsDone=TakePSFFromInputFile(defaultinputfname);
-    if(IsDone){return 0;}
+    if(IsDone){return;}
   }
 
   //Detailed model
   sprintf(fname,"%s/PSF/PSF_param.dat",dirname);
   IsDone=TakePSFFromDetailedParFile(fname);
-  if(IsDone){return 0;}
+  if(IsDone){return;}
 
   //IAEA - 2019 values:
   if(PSFflag==0){
     sprintf(fname,"%s/PSF/CRP_IAEA_SMLO_E1_v01.dat",dirname);
     IsDone=TakePSFFromIAEA01(fname);
-    if(IsDone){return 0;}
+    if(IsDone){return;}
   }
   else if(PSFflag!=1){
     NuDEXException(__FILE__,std::to_string(__LINE__).c_str(),"##### Error in NuDEX #####");
@@ -66,12 +77,12 @@ int NuDEXPSF::Init(const char* dirname,NuDEXLevelDensity* aLD,const char* inputf
   //RIPL-MLO values:
   sprintf(fname,"%s/PSF/gdr-parameters&errors-exp-MLO.dat",dirname);
   IsDone=TakePSFFromRIPL01(fname);
-  if(IsDone){return 0;}
+  if(IsDone){return;}
 
   //RIPL-Theorethical values:
   sprintf(fname,"%s/PSF/gdr-parameters-theor.dat",dirname);
   IsDone=TakePSFFromRIPL02(fname);
-  if(IsDone){return 0;}
+  if(IsDone){return;}
 
   //Theorethical values:
   // E1 for spherical nucleus:
@@ -86,8 +97,6 @@ int NuDEXPSF::Init(const char* dirname,NuDEXLevelDensity* aLD,const char* inputf
   s_E1[nR_E1]=120/3.141592*d*(A_Int-Z_Int)*Z_Int/(double)A_Int/G_E1[nR_E1];
   nR_E1++;
   GenerateM1AndE2FromE1();
-
-  return 0;
 }
 
 void  NuDEXPSF::GenerateM1AndE2FromE1(){
@@ -101,6 +110,7 @@ void  NuDEXPSF::GenerateM1AndE2FromE1(){
   nR_M1++;
 
   //f(E1)/f(M1) = 0.0588*A**0.878    at +-7 MeV
+  ResolvePSF();
   double fE1=GetE1(7,7);
   double fM1=GetM1(7,7);
   s_M1[0]=fE1/0.0588/pow(A_Int,0.878)/fM1;
@@ -317,6 +327,7 @@ bool NuDEXPSF::TakePSFFromInputFile(const char* fname){
     }
   }
   
+  ResolvePSF();
   Renormalize(); // if XX_normFac>0 --> renormalization of the PSF
 
   return result;
@@ -418,194 +429,368 @@ bool NuDEXPSF::TakePSFFromDetailedParFile(const char* fname){
 
 double NuDEXPSF::GetE1(double Eg,double ExcitationEnergy){
 
-  double result=0;
-  for(int i=0;i<nR_E1;i++){
-    if(PSFType_E1[i]==0){
-      result+=8.674E-8*SLO(Eg,E_E1[i],G_E1[i],s_E1[i]);
-    }
-    else if(PSFType_E1[i]==1){
-      result+=8.674E-8*EGLO(Eg,E_E1[i],G_E1[i],s_E1[i],ExcitationEnergy);
-    }
-    else if(PSFType_E1[i]==2){
-      result+=8.674E-8*SMLO(Eg,E_E1[i],G_E1[i],s_E1[i],ExcitationEnergy);
-    }
-    else if(PSFType_E1[i]==3){
-      result+=8.674E-8*GLO(Eg,E_E1[i],G_E1[i],s_E1[i],ExcitationEnergy);
-    }
-    else if(PSFType_E1[i]==4){
-      result+=8.674E-8*MGLO(Eg,E_E1[i],G_E1[i],s_E1[i],ExcitationEnergy);
-    }
-    else if(PSFType_E1[i]==5){
-      result+=8.674E-8*KMF(Eg,E_E1[i],G_E1[i],s_E1[i],ExcitationEnergy);
-    }
-    else if(PSFType_E1[i]==6){
-      result+=8.674E-8*GH(Eg,E_E1[i],G_E1[i],s_E1[i],ExcitationEnergy);
-    }
-    else if(PSFType_E1[i]==7){
-      result+=8.674E-8*MEGLO(Eg,E_E1[i],G_E1[i],s_E1[i],ExcitationEnergy,p1_E1[i],p1_E1[i]);
-    }
-    else if(PSFType_E1[i]==8){
-      result+=8.674E-8*MEGLO(Eg,E_E1[i],G_E1[i],s_E1[i],ExcitationEnergy,p1_E1[i],p2_E1[i]);
-    }
-    else if(PSFType_E1[i]==9){
-      result+=8.674E-8*MEGLO(Eg,E_E1[i],G_E1[i],s_E1[i],ExcitationEnergy,p1_E1[i],p1_E1[i],p2_E1[i]);
-    }
-    else if(PSFType_E1[i]==10){
-      result+=8.674E-8*MEGLO(Eg,E_E1[i],G_E1[i],s_E1[i],ExcitationEnergy,p1_E1[i],p2_E1[i],p3_E1[i]);
-    }
-    else if(PSFType_E1[i]==11){
-      result+=8.674E-8*SMLO_v2(Eg,E_E1[i],G_E1[i],s_E1[i],ExcitationEnergy);
-    }
-    else if(PSFType_E1[i]==20){
-      result+=8.674E-8*Gauss(Eg,E_E1[i],G_E1[i],s_E1[i]);
-    }
-    else if(PSFType_E1[i]==21){
-      result+=8.674E-8*Expo(Eg,E_E1[i],G_E1[i]);
-    }
-    else if(PSFType_E1[i]==40){
-      result+=EvaluateFunction(Eg,np_E1,x_E1,y_E1);
-    }
-    else if(PSFType_E1[i]==41){
-      result+=pow(10.,EvaluateFunction(Eg,np_E1,x_E1,y_E1));
-    }
-    else{
-      NuDEXException(__FILE__,std::to_string(__LINE__).c_str(),"##### Error in NuDEX #####");
-    }
+  double result;
+  if(theE1Grid!=0 && InterpolateGrid(theE1Grid,Eg,ExcitationEnergy,result)){
+    return result;
   }
+  return ComputeE1(Eg,ExcitationEnergy);
+}
 
-  if(result!=result){ // nan
-    NuDEXException(__FILE__,std::to_string(__LINE__).c_str(),"##### Error in NuDEX #####");
+double NuDEXPSF::GetM1(double Eg,double ExcitationEnergy){
+
+  double result;
+  if(theM1Grid!=0 && InterpolateGrid(theM1Grid,Eg,ExcitationEnergy,result)){
+    return result;
   }
+  return ComputeM1(Eg,ExcitationEnergy);
+}
 
-  return result*ScaleFactor_E1;
+double NuDEXPSF::GetE2(double Eg,double ExcitationEnergy){
+
+  double result;
+  if(theE2Grid!=0 && InterpolateGrid(theE2Grid,Eg,ExcitationEnergy,result)){
+    return result;
+  }
+  return ComputeE2(Eg,ExcitationEnergy);
 }
 
-double NuDEXPSF::GetM1(double Eg,double ExcitationEnergy){
 
-  double result=0;
-  for(int i=0;i<nR_M1;i++){
-    if(PSFType_M1[i]==0){
-      result+=8.674E-8*SLO(Eg,E_M1[i],G_M1[i],s_M1[i]);
-    }
-    else if(PSFType_M1[i]==1){
-      result+=8.674E-8*EGLO(Eg,E_M1[i],G_M1[i],s_M1[i],ExcitationEnergy);
-    }
-    else if(PSFType_M1[i]==2){
-      result+=8.674E-8*SMLO(Eg,E_M1[i],G_M1[i],s_M1[i],ExcitationEnergy);
-    }
-    else if(PSFType_M1[i]==3){
-      result+=8.674E-8*GLO(Eg,E_M1[i],G_M1[i],s_M1[i],ExcitationEnergy);
-    }
-    else if(PSFType_M1[i]==4){
-      result+=8.674E-8*MGLO(Eg,E_M1[i],G_M1[i],s_M1[i],ExcitationEnergy);
-    }
-    else if(PSFType_M1[i]==5){
-      result+=8.674E-8*KMF(Eg,E_M1[i],G_M1[i],s_M1[i],ExcitationEnergy);
-    }
-    else if(PSFType_M1[i]==6){
-      result+=8.674E-8*GH(Eg,E_M1[i],G_M1[i],s_M1[i],ExcitationEnergy);
-    }
-    else if(PSFType_M1[i]==7){
-      result+=8.674E-8*MEGLO(Eg,E_M1[i],G_M1[i],s_M1[i],ExcitationEnergy,p1_M1[i],p1_M1[i]);
-    }
-    else if(PSFType_M1[i]==8){
-      result+=8.674E-8*MEGLO(Eg,E_M1[i],G_M1[i],s_M1[i],ExcitationEnergy,p1_M1[i],p2_M1[i]);
-    }
-    else if(PSFType_M1[i]==9){
-      result+=8.674E-8*MEGLO(Eg,E_M1[i],G_M1[i],s_M1[i],ExcitationEnergy,p1_M1[i],p1_M1[i],p2_M1[i]);
-    }
-    else if(PSFType_M1[i]==10){
-      result+=8.674E-8*MEGLO(Eg,E_M1[i],G_M1[i],s_M1[i],ExcitationEnergy,p1_M1[i],p2_M1[i],p3_M1[i]);
-    }
-    else if(PSFType_M1[i]==11){
-      result+=8.674E-8*SMLO_v2(Eg,E_M1[i],G_M1[i],s_M1[i],ExcitationEnergy);
-    }
-    else if(PSFType_M1[i]==20){
-      result+=8.674E-8*Gauss(Eg,E_M1[i],G_M1[i],s_M1[i]);
-    }
-    else if(PSFType_M1[i]==21){
-      result+=8.674E-8*Expo(Eg,E_M1[i],G_M1[i]);
-    }
-    else if(PSFType_M1[i]==40){
-      result+=EvaluateFunction(Eg,np_M1,x_M1,y_M1);
-    }
-    else if(PSFType_M1[i]==41){
-      result+=pow(10.,EvaluateFunction(Eg,np_M1,x_M1,y_M1));
-    }
-    else{
-      NuDEXException(__FILE__,std::to_string(__LINE__).c_str(),"##### Error in NuDEX #####");
+//Same, for the n gamma energies in Eg[]:
+void NuDEXPSF::GetE1(int n,const double* Eg,double ExcitationEnergy,double* result){
+  GetPSF(1,theE1Grid,n,Eg,ExcitationEnergy,result);
+}
+
+void NuDEXPSF::GetM1(int n,const double* Eg,double ExcitationEnergy,double* result){
+  GetPSF(2,theM1Grid,n,Eg,ExcitationEnergy,result);
+}
+
+void NuDEXPSF::GetE2(int n,const double* Eg,double ExcitationEnergy,double* result){
+  GetPSF(3,theE2Grid,n,Eg,ExcitationEnergy,result);
+}
+
+void NuDEXPSF::GetPSF(int multipolarity,const PSFGrid* theGrid,int n,const double* Eg,double ExcitationEnergy,double* result){
+
+  if(theGrid==0){
+    EvaluatePSF(multipolarity,n,Eg,ExcitationEnergy,result);
+    return;
+  }
+  for(int k=0;k<n;k++){
+    if(!InterpolateGrid(theGrid,Eg[k],ExcitationEnergy,result[k])){
+      EvaluatePSF(multipolarity,1,&Eg[k],ExcitationEnergy,&result[k]);
     }
   }
+}
+
+
+//**********************************************************************************************************
+//**********************************************************************************************************
+//**********************************************************************************************************
 
-  if(result!=result){ // nan
+//Tabulate the PSF (after Init, so after Renormalize) for excitation energies up to ExMax.
+//The grid is refined until the relative interpolation error in the middle of the cells is below MaxRelError
+//From here, GetE1/GetM1/GetE2 interpolate in the grids, and compute the PSF only outside them.
+void NuDEXPSF::Tabulate(double ExMax,double MaxRelError,bool PrintSummary){
+
+  if(ExMax<=0 || MaxRelError<=0){
     NuDEXException(__FILE__,std::to_string(__LINE__).c_str(),"##### Error in NuDEX #####");
   }
+  DeleteGrids();
+
+  PSFGrid* E1Grid=CreateGrid(1,ExMax,MaxRelError);
+  PSFGrid* M1Grid=CreateGrid(2,ExMax,MaxRelError);
+  PSFGrid* E2Grid=CreateGrid(3,ExMax,MaxRelError);
+  theE1Grid=E1Grid; theM1Grid=M1Grid; theE2Grid=E2Grid;
 
-  return result*ScaleFactor_M1;
+  if(PrintSummary){std::cout<<" NuDEX: PSF of ZA="<<1000*Z_Int+A_Int<<" tabulated up to "<<ExMax<<" MeV. E1: "<<E1Grid->nEg<<"x"<<E1Grid->nEf<<" points (max. rel. error "<<E1Grid->MaxRelError<<"), M1: "<<M1Grid->nEg<<"x"<<M1Grid->nEf<<" points (max. rel. error "<<M1Grid->MaxRelError<<"), E2: "<<E2Grid->nEg<<"x"<<E2Grid->nEf<<" points (max. rel. error "<<E2Grid->MaxRelError<<")"<<std::endl;}
 }
 
-double NuDEXPSF::GetE2(double Eg,double ExcitationEnergy){
 
-  double result=0;
-  for(int i=0;i<nR_E2;i++){
-    if(PSFType_E2[i]==0){
-      result+=5.22E-8*SLO(Eg,E_E2[i],G_E2[i],s_E2[i]);
-    }
-    else if(PSFType_E2[i]==1){
-      result+=5.22E-8*EGLO(Eg,E_E2[i],G_E2[i],s_E2[i],ExcitationEnergy);
-    }
-    else if(PSFType_E2[i]==2){
-      result+=5.22E-8*SMLO(Eg,E_E2[i],G_E2[i],s_E2[i],ExcitationEnergy);
-    }
-    else if(PSFType_E2[i]==3){
-      result+=5.22E-8*GLO(Eg,E_E2[i],G_E2[i],s_E2[i],ExcitationEnergy);
-    }
-    else if(PSFType_E2[i]==4){
-      result+=5.22E-8*MGLO(Eg,E_E2[i],G_E2[i],s_E2[i],ExcitationEnergy);
-    }
-    else if(PSFType_E2[i]==5){
-      result+=5.22E-8*KMF(Eg,E_E2[i],G_E2[i],s_E2[i],ExcitationEnergy);
-    }
-    else if(PSFType_E2[i]==6){
-      result+=5.22E-8*GH(Eg,E_E2[i],G_E2[i],s_E2[i],ExcitationEnergy);
-    }
-    else if(PSFType_E2[i]==7){
-      result+=5.22E-8*MEGLO(Eg,E_E2[i],G_E2[i],s_E2[i],ExcitationEnergy,p1_E2[i],p1_E2[i]);
-    }
-    else if(PSFType_E2[i]==8){
-      result+=5.22E-8*MEGLO(Eg,E_E2[i],G_E2[i],s_E2[i],ExcitationEnergy,p1_E2[i],p2_E2[i]);
-    }
-    else if(PSFType_E2[i]==9){
-      result+=5.22E-8*MEGLO(Eg,E_E2[i],G_E2[i],s_E2[i],ExcitationEnergy,p1_E2[i],p1_E2[i],p2_E2[i]);
+//multipolarity: 1,2,3 --> E1,M1,E2
+double NuDEXPSF::ComputePSF(int multipolarity,double Eg,double ExcitationEnergy){
+
+  double result;
+  EvaluatePSF(multipolarity,1,&Eg,ExcitationEnergy,&result);
+  return result;
+}
+
+
+//Some PSF types do not depend on the excitation energy, and then the grid has only one dimension (nEf=1)
+bool NuDEXPSF::DependsOnExcitationEnergy(int multipolarity){
+
+  int nR=nR_E1; int* PSFType=PSFType_E1;
+  if(multipolarity==2){nR=nR_M1; PSFType=PSFType_M1;}
+  else if(multipolarity==3){nR=nR_E2; PSFType=PSFType_E2;}
+  for(int i=0;i<nR;i++){
+    if(PSFType[i]!=0 && PSFType[i]!=20 && PSFType[i]!=21 && PSFType[i]!=40 && PSFType[i]!=41){
+      return true;
     }
-    else if(PSFType_E2[i]==10){
-      result+=5.22E-8*MEGLO(Eg,E_E2[i],G_E2[i],s_E2[i],ExcitationEnergy,p1_E2[i],p2_E2[i],p3_E2[i]);
+  }
+  return false;
+}
+
+
+PSFGrid* NuDEXPSF::CreateGrid(int multipolarity,double ExMax,double MaxRelError){
+
+  double Egmin=0.001; //below 1 keV the PSF is computed
+  double Step0=0.1; //initial step of the grid, in MeV
+  int MaxNPoints=2097152; //maximum number of points of the grid (16 MB)
+  int L=1; //multipolarity order
+  if(multipolarity==3){L=2;}
+
+  int nIntEg=(int)((ExMax-Egmin)/Step0)+1;
+  int nIntEf=0;
+  if(DependsOnExcitationEnergy(multipolarity)){nIntEf=(int)(ExMax/Step0)+1;}
+
+  PSFGrid* theGrid=new PSFGrid();
+  theGrid->Value=0;
+  while(true){
+    //--------------------------------------------------------
+    //Fill the grid:
+    theGrid->nEg=nIntEg+1;
+    theGrid->nEf=nIntEf+1;
+    theGrid->Egmin=Egmin;
+    theGrid->dEg=(ExMax-Egmin)/nIntEg;
+    theGrid->dEf=0;
+    if(nIntEf>0){theGrid->dEf=ExMax/nIntEf;}
+    if(theGrid->Value!=0){delete [] theGrid->Value;}
+    theGrid->Value=new double[theGrid->nEg*theGrid->nEf];
+    double MaxStrength=0; //maximum of Eg**(2L+1)*PSF
+    for(int j=0;j<theGrid->nEf;j++){
+      double Ef=j*theGrid->dEf;
+      for(int i=0;i<theGrid->nEg;i++){
+	double Eg=Egmin+i*theGrid->dEg;
+	double val=ComputePSF(multipolarity,Eg,Eg+Ef);
+	theGrid->Value[j*theGrid->nEg+i]=val;
+	double strength=std::fabs(val)*std::pow(Eg,2*L+1);
+	if(strength>MaxStrength){MaxStrength=strength;}
+      }
     }
-    else if(PSFType_E2[i]==11){
-      result+=5.22E-8*SMLO_v2(Eg,E_E2[i],G_E2[i],s_E2[i],ExcitationEnergy);
+    //--------------------------------------------------------
+
+    //--------------------------------------------------------
+    //Relative errors in the middle of the cells, only where Eg+Ef<=ExMax.
+    //Points where Eg**(2L+1)*PSF is negligible (<1e-6 of the maximum) do not contribute to the decay, and the error is taken relative to this limit:
+    double ErrEg=0,ErrEf=0;
+    for(int j=0;j<theGrid->nEf;j++){
+      for(int i=0;i<nIntEg;i++){
+	for(int k=0;k<3;k++){ //k=0: middle in Eg, k=1: middle in Ef, k=2: center
+	  if(nIntEf==0 && k>0){break;}
+	  if(j==nIntEf && k>0){break;}
+	  double Eg=Egmin+(i+(k!=1)*0.5)*theGrid->dEg;
+	  double Ef=(j+(k!=0)*0.5)*theGrid->dEf;
+	  if(Eg+Ef>ExMax){continue;}
+	  double val=ComputePSF(multipolarity,Eg,Eg+Ef);
+	  double intval=0;
+	  InterpolateGrid(theGrid,Eg,Eg+Ef,intval);
+	  double err=std::fabs(intval-val)/std::max(std::fabs(val),1.e-6*MaxStrength/std::pow(Eg,2*L+1));
+	  if(k!=1 && err>ErrEg){ErrEg=err;}
+	  if(k!=0 && err>ErrEf){ErrEf=err;}
+	}
+      }
     }
-    else if(PSFType_E2[i]==20){
-      result+=5.22E-8*Gauss(Eg,E_E2[i],G_E2[i],s_E2[i]);
+    theGrid->MaxRelError=std::max(ErrEg,ErrEf);
+    //--------------------------------------------------------
+
+    //--------------------------------------------------------
+    //Refine, if needed:
+    if(theGrid->MaxRelError<=MaxRelError){break;}
+    int newnIntEg=nIntEg,newnIntEf=nIntEf;
+    if(ErrEg>MaxRelError){newnIntEg*=2;}
+    if(ErrEf>MaxRelError){newnIntEf*=2;}
+    if((double)(newnIntEg+1)*(newnIntEf+1)>MaxNPoints){
+      std::cout<<" ############## NuDEX: WARNING, the PSF of ZA="<<1000*Z_Int+A_Int<<" cannot be tabulated with a relative error smaller than "<<MaxRelError<<" ("<<theGrid->MaxRelError<<" reached) ##############"<<std::endl;
+      break;
     }
-    else if(PSFType_E2[i]==21){
-      result+=5.22E-8*Expo(Eg,E_E2[i],G_E2[i]);
+    nIntEg=newnIntEg; nIntEf=newnIntEf;
+    //--------------------------------------------------------
+  }
+
+  return theGrid;
+}
+
+
+//Bilinear interpolation in (Eg,Ef). Returns false if (Eg,Ef) is out of the grid
+bool NuDEXPSF::InterpolateGrid(const PSFGrid* theGrid,double Eg,double ExcitationEnergy,double& result){
+
+  double x=(Eg-theGrid->Egmin)/theGrid->dEg;
+  if(!(x>=0) || x>=theGrid->nEg-1){return false;}
+  int i=(int)x;
+  double fx=x-i;
+  const double* val=theGrid->Value+i;
+  if(theGrid->nEf==1){
+    result=val[0]+fx*(val[1]-val[0]);
+    return true;
+  }
+
+  double y=(ExcitationEnergy-Eg)/theGrid->dEf;
+  if(!(y>=0) || y>=theGrid->nEf-1){return false;}
+  int j=(int)y;
+  double fy=y-j;
+  val+=j*theGrid->nEg;
+  double val0=val[0]+fx*(val[1]-val[0]);
+  double val1=val[theGrid->nEg]+fx*(val[theGrid->nEg+1]-val[theGrid->nEg]);
+  result=val0+fy*(val1-val0);
+  return true;
+}
+
+
+void NuDEXPSF::DeleteGrids(){
+
+  PSFGrid* theGrids[3]={theE1Grid,theM1Grid,theE2Grid};
+  for(int i=0;i<3;i++){
+    if(theGrids[i]!=0){
+      delete [] theGrids[i]->Value;
+      delete theGrids[i];
     }
-    else if(PSFType_E2[i]==40){
-      result+=EvaluateFunction(Eg,np_E2,x_E2,y_E2);
+  }
+  theE1Grid=0; theM1Grid=0; theE2Grid=0;
+}
+
+
+//**********************************************************************************************************
+//**********************************************************************************************************
+//**********************************************************************************************************
+
+
+//Resolve the type of each PSF term once, so the evaluation of the PSF does not need to check it.
+//It has to be called each time the PSF parameters change.
+void NuDEXPSF::ResolvePSF(){
+
+  for(int m=0;m<3;m++){
+    int nR=nR_E1; int* PSFType=PSFType_E1;
+    double *E=E_E1,*G=G_E1,*s=s_E1,*p1=p1_E1,*p2=p2_E1,*p3=p3_E1;
+    int np=np_E1; double *x=x_E1,*y=y_E1;
+    if(m==1){
+      nR=nR_M1; PSFType=PSFType_M1; E=E_M1; G=G_M1; s=s_M1; p1=p1_M1; p2=p2_M1; p3=p3_M1; np=np_M1; x=x_M1; y=y_M1;
     }
-    else if(PSFType_E2[i]==41){
-      result+=pow(10.,EvaluateFunction(Eg,np_E2,x_E2,y_E2));
+    else if(m==2){
+      nR=nR_E2; PSFType=PSFType_E2; E=E_E2; G=G_E2; s=s_E2; p1=p1_E2; p2=p2_E2; p3=p3_E2; np=np_E2; x=x_E2; y=y_E2;
     }
-    else{
-      NuDEXException(__FILE__,std::to_string(__LINE__).c_str(),"##### Error in NuDEX #####");
+    nTerms[m]=nR;
+    for(int i=0;i<nR;i++){
+      PSFTerm* term=&theTerms[m][i];
+      term->Norm=8.674E-8;
+      if(m==2){term->Norm=5.22E-8;}
+      term->Er=E[i]; term->Gr=G[i]; term->sr=s[i];
+      term->k1=0; term->k2=0; term->Temp=-1; term->Opt=0;
+      term->np=np; term->x=x; term->y=y;
+      switch(PSFType[i]){
+      case 0: term->Shape=&NuDEXPSF::Shape_SLO; break;
+      case 1: term->Shape=&NuDEXPSF::Shape_EGLO_GLO_MGLO; term->Opt=0; break;
+      case 2: term->Shape=&NuDEXPSF::Shape_SMLO; break;
+      case 3: term->Shape=&NuDEXPSF::Shape_EGLO_GLO_MGLO; term->Opt=1; break;
+      case 4: term->Shape=&NuDEXPSF::Shape_EGLO_GLO_MGLO; term->Opt=2; break;
+      case 5: term->Shape=&NuDEXPSF::Shape_KMF; break;
+      case 6: term->Shape=&NuDEXPSF::Shape_GH; break;
+      case 7: term->Shape=&NuDEXPSF::Shape_MEGLO; term->k1=p1[i]; term->k2=p1[i]; break;
+      case 8: term->Shape=&NuDEXPSF::Shape_MEGLO; term->k1=p1[i]; term->k2=p2[i]; break;
+      case 9: term->Shape=&NuDEXPSF::Shape_MEGLO; term->k1=p1[i]; term->k2=p1[i]; term->Temp=p2[i]; break;
+      case 10: term->Shape=&NuDEXPSF::Shape_MEGLO; term->k1=p1[i]; term->k2=p2[i]; term->Temp=p3[i]; break;
+      case 11: term->Shape=&NuDEXPSF::Shape_SMLO_v2; break;
+      case 20: term->Shape=&NuDEXPSF::Shape_Gauss; break;
+      case 21: term->Shape=&NuDEXPSF::Shape_Expo; break;
+      case 40: term->Shape=&NuDEXPSF::Shape_Pointwise; break;
+      case 41: term->Shape=&NuDEXPSF::Shape_PointwiseLog; break;
+      default:
+	NuDEXException(__FILE__,std::to_string(__LINE__).c_str(),"##### Error in NuDEX #####");
+      }
     }
   }
+}
+
+
+//multipolarity: 1,2,3 --> E1,M1,E2
+//The PSF is evaluated for the n gamma energies in Eg[], and stored in result[]
+void NuDEXPSF::EvaluatePSF(int multipolarity,int n,const double* Eg,double ExcitationEnergy,double* result){
+
+  int m=multipolarity-1;
+  double ScaleFactor=ScaleFactor_E1;
+  if(m==1){ScaleFactor=ScaleFactor_M1;}
+  else if(m==2){ScaleFactor=ScaleFactor_E2;}
+  else if(m!=0){
+    NuDEXException(__FILE__,std::to_string(__LINE__).c_str(),"##### Error in NuDEX #####");
+  }
+
+  for(int k=0;k<n;k++){result[k]=0;}
+  for(int i=0;i<nTerms[m];i++){
+    (this->*theTerms[m][i].Shape)(n,Eg,ExcitationEnergy,theTerms[m][i],result);
+  }
 
-  if(result!=result){ // nan
+  double sum=0;
+  for(int k=0;k<n;k++){sum+=result[k];}
+  if(sum!=sum){ // nan
     NuDEXException(__FILE__,std::to_string(__LINE__).c_str(),"##### Error in NuDEX #####");
   }
 
-  return result*ScaleFactor_E2;
+  for(int k=0;k<n;k++){result[k]*=ScaleFactor;}
+}
+
+
+double NuDEXPSF::ComputeE1(double Eg,double ExcitationEnergy){
+
+  double result;
+  EvaluatePSF(1,1,&Eg,ExcitationEnergy,&result);
+  return result;
+}
+
+double NuDEXPSF::ComputeM1(double Eg,double ExcitationEnergy){
+
+  double result;
+  EvaluatePSF(2,1,&Eg,ExcitationEnergy,&result);
+  return result;
+}
+
+double NuDEXPSF::ComputeE2(double Eg,double ExcitationEnergy){
+
+  double result;
+  EvaluatePSF(3,1,&Eg,ExcitationEnergy,&result);
+  return result;
+}
+
+
+//Each shape adds its contribution for the n gamma energies to result[]:
+void NuDEXPSF::Shape_SLO(int n,const double* Eg,double,const PSFTerm& term,double* result){
+  for(int k=0;k<n;k++){result[k]+=term.Norm*SLO(Eg[k],term.Er,term.Gr,term.sr);}
+}
+
+void NuDEXPSF::Shape_EGLO_GLO_MGLO(int n,const double* Eg,double ExcitationEnergy,const PSFTerm& term,double* result){
+  for(int k=0;k<n;k++){result[k]+=term.Norm*EGLO_GLO_MGLO(Eg[k],term.Er,term.Gr,term.sr,ExcitationEnergy,term.Opt);}
+}
+
+void NuDEXPSF::Shape_SMLO(int n,const double* Eg,double ExcitationEnergy,const PSFTerm& term,double* result){
+  for(int k=0;k<n;k++){result[k]+=term.Norm*SMLO(Eg[k],term.Er,term.Gr,term.sr,ExcitationEnergy);}
+}
+
+void NuDEXPSF::Shape_KMF(int n,const double* Eg,double ExcitationEnergy,const PSFTerm& term,double* result){
+  for(int k=0;k<n;k++){result[k]+=term.Norm*KMF(Eg[k],term.Er,term.Gr,term.sr,ExcitationEnergy);}
+}
+
+void NuDEXPSF::Shape_GH(int n,const double* Eg,double ExcitationEnergy,const PSFTerm& term,double* result){
+  for(int k=0;k<n;k++){result[k]+=term.Norm*GH(Eg[k],term.Er,term.Gr,term.sr,ExcitationEnergy);}
+}
+
+void NuDEXPSF::Shape_MEGLO(int n,const double* Eg,double ExcitationEnergy,const PSFTerm& term,double* result){
+  for(int k=0;k<n;k++){result[k]+=term.Norm*MEGLO(Eg[k],term.Er,term.Gr,term.sr,ExcitationEnergy,term.k1,term.k2,term.Temp);}
+}
+
+void NuDEXPSF::Shape_SMLO_v2(int n,const double* Eg,double ExcitationEnergy,const PSFTerm& term,double* result){
+  for(int k=0;k<n;k++){result[k]+=term.Norm*SMLO_v2(Eg[k],term.Er,term.Gr,term.sr,ExcitationEnergy);}
+}
+
+void NuDEXPSF::Shape_Gauss(int n,const double* Eg,double,const PSFTerm& term,double* result){
+  for(int k=0;k<n;k++){result[k]+=term.Norm*Gauss(Eg[k],term.Er,term.Gr,term.sr);}
+}
+
+void NuDEXPSF::Shape_Expo(int n,const double* Eg,double,const PSFTerm& term,double* result){
+  for(int k=0;k<n;k++){result[k]+=term.Norm*Expo(Eg[k],term.Er,term.Gr);}
+}
+
+void NuDEXPSF::Shape_Pointwise(int n,const double* Eg,double,const PSFTerm& term,double* result){
+  for(int k=0;k<n;k++){result[k]+=EvaluateFunction(Eg[k],term.np,term.x,term.y);}
+}
+
+void NuDEXPSF::Shape_PointwiseLog(int n,const double* Eg,double,const PSFTerm& term,double* result){
+  for(int k=0;k<n;k++){result[k]+=pow(10.,EvaluateFunction(Eg[k],term.np,term.x,term.y));}
 }
 
 
@@ -884,13 +1069,8 @@ double NuDEXPSF::EvaluateFunction(double xval,int np,double* x,double* y){
   if(xval>x[np-1]){return y[np-1];}
 
   double m,b;
-  int i_eval=np-1;
-  for(int i=1;i<np;i++){
-    if(x[i]>=xval){
-      i_eval=i;
-      break;
-    }
-  }
+  int i_eval=std::lower_bound(x+1,x+np,xval)-x; //first point with x[i]>=xval
+  if(i_eval>np-1){i_eval=np-1;}
 
   m=(y[i_eval]-y[i_eval-1])/(x[i_eval]-x[i_eval-1]);
   b=y[i_eval]-m*x[i_eval];
@@ -1,10 +1,11 @@
 
 #include "NuDEXRandom.hh"
+#include <sstream>
 
 #if COMPILATIONTYPE == 1
 //==============================================================================
 NuDEXRandom::NuDEXRandom(unsigned int seed){
-  theRandom=new TRandom2(seed);
+  theRandom=new NuDEXTRandom2(seed);
 }
 NuDEXRandom::~NuDEXRandom(){
   delete theRandom;
@@ -30,6 +31,21 @@ double NuDEXRandom::Gaus(double mean,double sigma){
 int NuDEXRandom::Poisson(double mean){
   return theRandom->Poisson(mean);
 }
+std::string NuDEXRandom::GetState(){
+  unsigned int state[3];
+  theRandom->GetState(state);
+  std::ostringstream out;
+  out<<state[0]<<" "<<state[1]<<" "<<state[2];
+  return out.str();
+}
+bool NuDEXRandom::SetState(const std::string& state){
+  unsigned int newState[3];
+  std::istringstream in(state);
+  in>>newState[0]>>newState[1]>>newState[2];
+  if(in.fail()){return false;}
+  theRandom->SetState(newState);
+  return true;
+}
 //==============================================================================
 void NuDEXException(const char* originOfException, const char* exceptionCode,const char* ){
   std::cout<<" ############## Error in "<<originOfException<<", line "<<exceptionCode<<" ##############"<<std::endl; exit(1);
@@ -76,9 +92,54 @@ double NuDEXRandom::Gaus(double mean,double sigma){
 int NuDEXRandom::Poisson(double mean){
   return theRandPoisson->fire(mean);
 }
+std::string NuDEXRandom::GetState(){
+  std::ostringstream out;
+  theEngine->put(out);
+  theRandFlat->put(out);
+  theRandGauss->put(out);
+  return out.str();
+}
+bool NuDEXRandom::SetState(const std::string& state){
+  std::istringstream in(state);
+  theEngine->get(in);
+  theRandFlat->get(in);
+  theRandGauss->get(in);
+  return !in.fail();
+}
 //==============================================================================
 void NuDEXException(const char* originOfException, const char* exceptionCode,const char* description){
   G4Exception(originOfException,exceptionCode,FatalException,description);
 }
 //==============================================================================
 #endif
+
+
+//==============================================================================
+//Same for ROOT and GEANT4, from Uniform and Gaus:
+//Gamma distribution, with the method of G. Marsaglia and W. Tsang, ACM Trans. Math. Softw. 26 (2000) 363
+double NuDEXRandom::Gamma(double shape,double scale){
+
+  if(shape<=0 || scale<=0){
+    NuDEXException(__FILE__,std::to_string(__LINE__).c_str(),"##### Error in NuDEX #####");
+  }
+  if(shape<1){ //Gamma(shape)=Gamma(shape+1)*U^(1/shape)
+    double u=Uniform();
+    while(u==0){u=Uniform();}
+    return Gamma(shape+1,scale)*std::pow(u,1./shape);
+  }
+  double d=shape-1./3.,c=1./std::sqrt(9.*d);
+  while(true){
+    double x=Gaus(0,1);
+    double v=1+c*x;
+    if(v<=0){continue;}
+    v=v*v*v;
+    double u=Uniform();
+    if(u<1-0.0331*x*x*x*x){return scale*d*v;}
+    if(u>0 && std::log(u)<0.5*x*x+d*(1-v+std::log(v))){return scale*d*v;}
+  }
+}
+
+double NuDEXRandom::ChiSquare(double nu){
+  return Gamma(nu/2.,2.);
+}
+//==============================================================================
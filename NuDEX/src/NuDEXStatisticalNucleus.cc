@@ -1,6 +1,19 @@
 
 
 #include "NuDEXStatisticalNucleus.hh"
+#include "NuDEXCascadeSampler.hh"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#include <map>
+#include <mutex>
+
+//Known levels files already read (see SetLibraryDataCache): their binary files, memory mapped (or made in memory from the text files):
+static std::atomic<bool> UseKnownLevelsCache(false);
+static std::mutex theKnownLevelsCacheMutex;
+static std::map<std::string,std::shared_ptr<const NuDEXFileData> > theKnownLevelsCache;
 
 
 
@@ -11,12 +24,23 @@ NuDEXStatisticalNucleus::NuDEXStatisticalNucleus(int Z,int A){
   //Can be changed with NuDEXStatisticalNucleus::SetSomeInitalParameters(...)
   LevelDensityType=-1;
   PSFflag=-1;
+  PSFTabulationError=-1;
+  Verbosity=1;
+  ICCTablePointsPerDecade=-1;
+  LDTablePointsPerMeV=-1;
+  LevelSchemeNThreads=-1;
   maxspinx2=-1;
   MinLevelsPerBand=-1;
   BandWidth=0;
   MaxExcEnergy=0;
   BROpt=-1;
   SampleGammaWidths=-1;
+  BRSamplingOpt=-1;
+  BRStorageOpt=-1;
+  BRMemoryBudget_MB=0; BRMemoryDense_MB=0;
+  BRCacheSize_MB=-1;
+  BRPrecomputeNThreads=-1;
+  NBRChanges=0;
 
   //The default values for these flags are in NuDEXStatisticalNucleus::Init(...)
   //Can be changed via NuDEXStatisticalNucleus::SetInitialParameters02(...):
@@ -29,8 +53,12 @@ NuDEXStatisticalNucleus::NuDEXStatisticalNucleus(int Z,int A){
   hasBeenInitialized=false;
   NBands=-1;
   theLevels=0;
+  theLevelsSoA.Energy=0; theLevelsSoA.LowEdge=0; theLevelsSoA.HighEdge=0; theLevelsSoA.spinx2=0; theLevelsSoA.parity=0;
+  NClasses=0; NClassSpins=0;
+  theLevelClass=0; theClassMultipolarities=0; theClassLevels=0; theClassEnergies=0; theReachableLevels=0;
   theKnownLevels=0;
   NKnownLevels=0; NUnknownLevels=0; NLevels=0; KnownLevelsVectorSize=0;
+  theKnownLevelsIntPool=0; theKnownLevelsDoublePool=0;
   theRandom1=0;
   theRandom2=0;
   theRandom3=0;
@@ -39,7 +67,12 @@ NuDEXStatisticalNucleus::NuDEXStatisticalNucleus(int Z,int A){
   thePSF=0;
   TotalGammaRho=0;
   theThermalCaptureLevelCumulBR=0;
+  theThermalCaptureLevelAliasBR=0;
   TotalCumulBR=0;
+  TotalAliasBR=0;
+  theDefaultSampler=0;
+  NAttachedSamplers=0;
+  theSharedDataNucleus=0;
 
   Z_Int=Z;
   A_Int=A;
@@ -92,13 +125,12 @@ void NuDEXStatisticalNucleus::SetSomeInitalParameters(int LDtype,int PSFFlag,dou
 
 NuDEXStatisticalNucleus::~NuDEXStatisticalNucleus(){
 
+  if(theDefaultSampler!=0){delete theDefaultSampler;}
   if(theLevels!=0){delete [] theLevels;}
+  DeleteLevelsSoA();
+  DeleteSpinParityClasses();
   for(int i=0;i<KnownLevelsVectorSize;i++){
-    if(theKnownLevels[i].Ndecays>0){
-      delete [] theKnownLevels[i].decayFraction;
-      //delete [] theKnownLevels[i].decayMode;
-    }
-    if(theKnownLevels[i].NGammas>0){
+    if(theKnownLevels[i].NGammas>0 && !theKnownLevels[i].GammasInPool){
       delete [] theKnownLevels[i].FinalLevelID;
       delete [] theKnownLevels[i].multipolarity;
       delete [] theKnownLevels[i].Eg;
@@ -109,20 +141,29 @@ NuDEXStatisticalNucleus::~NuDEXStatisticalNucleus(){
     }
   }
   if(theKnownLevels!=0){delete [] theKnownLevels;}
+  if(theKnownLevelsIntPool!=0){delete [] theKnownLevelsIntPool;}
+  if(theKnownLevelsDoublePool!=0){delete [] theKnownLevelsDoublePool;}
   if(theRandom1!=0){delete theRandom1;}
   if(theRandom2!=0){delete theRandom2;}
   if(theRandom3!=0){delete theRandom3;}
-  if(theLD!=0){delete theLD;}
+  if(theLD!=0 && theSharedDataNucleus==0){delete theLD;}
   if(theICC!=0){delete theICC;}
-  if(thePSF!=0){delete thePSF;}
+  if(thePSF!=0 && theSharedDataNucleus==0){delete thePSF;}
   if(TotalGammaRho!=0){delete [] TotalGammaRho;}
   if(theThermalCaptureLevelCumulBR!=0){delete [] theThermalCaptureLevelCumulBR;}
+  if(theThermalCaptureLevelAliasBR!=0){DeleteAliasTable(theThermalCaptureLevelAliasBR);}
   if(TotalCumulBR!=0){
     for(int i=0;i<NLevels;i++){
-      if(TotalCumulBR[i]!=0){delete [] TotalCumulBR[i];}
+      if(TotalCumulBR[i]!=0){DeleteSparseBR(TotalCumulBR[i]);}
     }
     delete [] TotalCumulBR;
   }
+  if(TotalAliasBR!=0){
+    for(int i=0;i<NLevels;i++){
+      if(TotalAliasBR[i]!=0){DeleteAliasTable(TotalAliasBR[i]);}
+    }
+    delete [] TotalAliasBR;
+  }
 }
 
 
@@ -145,11 +186,22 @@ int NuDEXStatisticalNucleus::Init(const char* dirname,const char* inputfname){
   sprintf(fname,"%s/GeneralStatNuclParameters.dat",dirname);
   check=ReadGeneralStatNuclParameters(fname); if(check<0){return -1;}
 
+  //The BR memory is reported only if some option about it has been set:
+  bool ReportBRMemory=(BRStorageOpt>=0 || BRCacheSize_MB>0 || BRPrecomputeNThreads>0);
+
   //Some default, if not initialized yet:
   if(ElectronConversionFlag<0){ElectronConversionFlag=2;} // All EC
   if(KnownLevelsFlag<0){KnownLevelsFlag=1;} //Use all known levels
   if(PrimaryGammasIntensityNormFactor<0){PrimaryGammasIntensityNormFactor=1;}
   if(PrimaryGammasEcut<0){PrimaryGammasEcut=0;} 
+  if(BRSamplingOpt<0){BRSamplingOpt=0;} //binary search
+  if(BRStorageOpt<0){BRStorageOpt=0;} //double
+  if(BRCacheSize_MB<0){BRCacheSize_MB=0;} //no cache
+  if(BRPrecomputeNThreads<0){BRPrecomputeNThreads=0;} //BR computed when needed
+  if(PSFTabulationError<0){PSFTabulationError=0;} //PSF not tabulated
+  if(ICCTablePointsPerDecade<0){ICCTablePointsPerDecade=0;} //ICC not tabulated
+  if(LDTablePointsPerMeV<0){LDTablePointsPerMeV=0;} //LD not tabulated
+  if(LevelSchemeNThreads<0){LevelSchemeNThreads=0;} //all the unknown levels generated with theRandom1
   if(Ecrit<0){
     sprintf(fname,"%s/KnownLevels/levels-param.data",dirname);
     check=ReadEcrit(fname); if(check<0){return -1;}
@@ -157,20 +209,117 @@ int NuDEXStatisticalNucleus::Init(const char* dirname,const char* inputfname){
 
   
   //Level density:
-  theLD=new NuDEXLevelDensity(Z_Int,A_Int,LevelDensityType);
-  check=theLD->ReadLDParameters(dirname,inputfname,definputfn); //if(check<0){return -1;}
-  LevelDensityType=theLD->GetLDType(); //because it can be changed by inputfname or due to lack of data
+  if(theSharedDataNucleus!=0){
+    theLD=theSharedDataNucleus->theLD;
+    LevelDensityType=theSharedDataNucleus->LevelDensityType;
+    check=(theLD!=0)?0:-1;
+  }
+  else{
+    theLD=new NuDEXLevelDensity(Z_Int,A_Int,LevelDensityType);
+    check=theLD->ReadLDParameters(dirname,inputfname,definputfn); //if(check<0){return -1;}
+    LevelDensityType=theLD->GetLDType(); //because it can be changed by inputfname or due to lack of data
+  }
   if(check<0){
-    delete theLD; theLD=0;
+    if(theSharedDataNucleus==0){delete theLD;}
+    theLD=0;
     Sn=-1; D0=-1; I0=-1000;
   }
   else{
     theLD->GetSnD0I0Vals(Sn,D0,I0);
   }
+  //-------------------------------------------------------------------
+
+  //Level scheme, from a snapshot if there is one (then, also the known levels, the BR of the thermal capture level and the stored BR):
+  std::string snapshotKey,snapshotfname;
+  bool FromSnapshot=false;
+  if(theSnapshotDir.size()>0){
+    snapshotKey=MakeSnapshotKey(inputfname,definputfn);
+    snapshotfname=GetSnapshotFileName(snapshotKey);
+    FromSnapshot=(ReadSnapshot(snapshotfname.c_str(),snapshotKey)==0);
+  }
+  if(FromSnapshot){
+    MakeSomeParameterChecks01();
+  }
+  else{
+    check=BuildLevelScheme(dirname); if(check<0){return -1;}
+  }
+  FillLevelsSoA();
+  CreateSpinParityClasses();
+
+  //Internal conversion:
+  theICC=new NuDEXInternalConversion(Z_Int);
+  sprintf(fname,"%s/ICC_factors.dat",dirname);
+  theICC->Init(fname);
+  if(ICCTablePointsPerDecade>0){theICC->Tabulate(ICCTablePointsPerDecade);}
+  theICC->SetRandom4Seed(theRandom3->GetSeed()); //same seed as for generating the cascades
+
+  //PSF:
+  if(theSharedDataNucleus!=0){
+    thePSF=theSharedDataNucleus->thePSF; //tabulated (if so) up to the levels of theSharedDataNucleus, computed above them
+  }
+  else{
+    thePSF=new NuDEXPSF(Z_Int,A_Int);
+    thePSF->Init(dirname,theLD,inputfname,definputfn,PSFflag);
+  }
+  if(PSFTabulationError>0 && theSharedDataNucleus==0){
+    double ExMax=std::max(Sn,MaxExcEnergy);
+    if(NLevels>0){ExMax=std::max(ExMax,theLevels[NLevels-1].Energy+theLevels[NLevels-1].Width);}
+    thePSF->Tabulate(ExMax,PSFTabulationError,Verbosity>1);
+  }
+
+  //We compute the missing BR in the known part of the level scheme:
+  if(!FromSnapshot){
+    ComputeKnownLevelsMissingBR();
+  }
+
+  //Init TotalGammaRho:
+  if(!FromSnapshot){
+    TotalGammaRho=new std::atomic<double>[NLevels];
+    for(int i=0;i<NLevels;i++){
+      TotalGammaRho[i]=-1;
+    }
+  }
+
+  //Thermal capture level:
+  if(Sn>0 && NLevels>1 && !FromSnapshot){
+    CreateThermalCaptureLevel();
+    GenerateThermalCaptureLevelBR(dirname);
+  }
+
+  //Init TotalCumulBR. With BROpt==0 only the BR of the levels given to PrecomputeEntryBR are stored there:
+  if(BROpt==1 || BROpt==2){
+    ComputeBRMemoryBudget();
+    if(ReportBRMemory && Verbosity>0){std::cout<<" NuDEX: the BR of ZA="<<1000*Z_Int+A_Int<<" will need up to "<<BRMemoryBudget_MB<<" MB ("<<BRMemoryDense_MB<<" MB if all the transitions were stored)"<<std::endl;}
+  }
+  if(TotalCumulBR==0){
+    TotalCumulBR=new std::atomic<SparseBR*>[NLevels];
+    for(int i=0;i<NLevels;i++){
+      TotalCumulBR[i]=0;
+    }
+  }
+  TotalAliasBR=new std::atomic<AliasTable*>[NLevels];
+  for(int i=0;i<NLevels;i++){
+    TotalAliasBR[i]=0;
+  }
+
+  if(BRPrecomputeNThreads>0){
+    PrecomputeBR(BRPrecomputeNThreads);
+  }
+
+  if(theSnapshotDir.size()>0 && !FromSnapshot){
+    WriteSnapshot(snapshotfname.c_str(),snapshotKey);
+  }
+
+  return 0;
+}
+
+
+int NuDEXStatisticalNucleus::BuildLevelScheme(const char* dirname){
 
   //Known level sheme:
+  char fname[1000];
   sprintf(fname,"%s/KnownLevels/z%03d.dat",dirname,Z_Int);
-  check=ReadKnownLevels(fname); if(check<0){return -1;}  //here we get/crosscheck Sn
+  int check=ReadKnownLevels(fname); if(check<0){return -1;}  //here we get/crosscheck Sn
   I0=TakeTargetNucleiI0(fname,check); if(check<0){return -1;} //if no I0 --> out
 
   if(MaxExcEnergy<=0){
@@ -187,7 +336,6 @@ int NuDEXStatisticalNucleus::Init(const char* dirname,const char* inputfname){
     std::cout<<" ###### WARNING: No level density and level scheme not complete for ZA="<<1000*Z_Int+A_Int<<" --> Ecrit="<<Ecrit<<" MeV and MaxExcEnergy = "<<MaxExcEnergy<<" MeV ######"<<std::endl;
     return -1;
   }
-  //-------------------------------------------------------------------
 
   //------------------------------------------------------------------- 
   //Init some variables:
@@ -211,6 +359,11 @@ int NuDEXStatisticalNucleus::Init(const char* dirname,const char* inputfname){
   //Make some checks:
   MakeSomeParameterChecks01();
 
+  //Level density tables, from E_unk_min up to the last energy used by NuDEXLevelDensity::Integrate:
+  if(LDTablePointsPerMeV>0 && theLD!=0 && E_unk_min<E_unk_max && theSharedDataNucleus==0){ //if shared, already tabulated in the same range
+    theLD->Tabulate(E_unk_min,E_unk_max+0.01*(E_unk_max-E_unk_min)+1./LDTablePointsPerMeV,maxspinx2,LDTablePointsPerMeV);
+  }
+
   //Level scheme:
   //std::cout<<" creating level scheme ..."<<std::endl;
   CreateLevelScheme();
@@ -225,39 +378,6 @@ int NuDEXStatisticalNucleus::Init(const char* dirname,const char* inputfname){
     theLevels[NLevels-1-i].seed=theRandom2->Integer(4294967295)+1;
   }
 
-  //Internal conversion:
-  theICC=new NuDEXInternalConversion(Z_Int);
-  sprintf(fname,"%s/ICC_factors.dat",dirname);
-  theICC->Init(fname);
-  theICC->SetRandom4Seed(theRandom3->GetSeed()); //same seed as for generating the cascades
-
-  //PSF:
-  thePSF=new NuDEXPSF(Z_Int,A_Int);
-  thePSF->Init(dirname,theLD,inputfname,definputfn,PSFflag);
-
-  //We compute the missing BR in the known part of the level scheme:
-  ComputeKnownLevelsMissingBR();
-
-  //Init TotalGammaRho:
-  TotalGammaRho=new double[NLevels];
-  for(int i=0;i<NLevels-1;i++){
-    TotalGammaRho[i]=-1;
-  }
-
-  //Thermal capture level:
-  if(Sn>0 && NLevels>1){
-    CreateThermalCaptureLevel();
-    GenerateThermalCaptureLevelBR(dirname);
-  }
-
-  //Init TotalCumulBR, if BROpt==1,2
-  if(BROpt==1 || BROpt==2){
-    TotalCumulBR=new double*[NLevels];
-    for(int i=0;i<NLevels;i++){
-      TotalCumulBR[i]=0;
-    }
-  }
-
   return 0;
 }
 
@@ -280,7 +400,31 @@ void NuDEXStatisticalNucleus::MakeSomeParameterChecks01(){
     std::cout<<" ############## Error, BROpt cannot be set to: "<<BROpt<<" ##############"<<std::endl; NuDEXException(__FILE__,std::to_string(__LINE__).c_str(),"##### Error in NuDEX #####");
   }
 
-  if(SampleGammaWidths<0 || SampleGammaWidths>1){
+  if(BRSamplingOpt<0 || BRSamplingOpt>1){
+    std::cout<<" ############## Error, BRSamplingOpt cannot be set to: "<<BRSamplingOpt<<" ##############"<<std::endl; NuDEXException(__FILE__,std::to_string(__LINE__).c_str(),"##### Error in NuDEX #####");
+  }
+
+  if(BRStorageOpt<0 || BRStorageOpt>1){
+    std::cout<<" ############## Error, BRStorageOpt cannot be set to: "<<BRStorageOpt<<" ##############"<<std::endl; NuDEXException(__FILE__,std::to_string(__LINE__).c_str(),"##### Error in NuDEX #####");
+  }
+
+  if(PSFTabulationError<0 || PSFTabulationError>=1){
+    std::cout<<" ############## Error, PSFTabulationError cannot be set to: "<<PSFTabulationError<<" ##############"<<std::endl; NuDEXException(__FILE__,std::to_string(__LINE__).c_str(),"##### Error in NuDEX #####");
+  }
+
+  if(ICCTablePointsPerDecade<0){
+    std::cout<<" ############## Error, ICCTablePointsPerDecade cannot be set to: "<<ICCTablePointsPerDecade<<" ##############"<<std::endl; NuDEXException(__FILE__,std::to_string(__LINE__).c_str(),"##### Error in NuDEX #####");
+  }
+
+  if(LDTablePointsPerMeV<0){
+    std::cout<<" ############## Error, LDTablePointsPerMeV cannot be set to: "<<LDTablePointsPerMeV<<" ##############"<<std::endl; NuDEXException(__FILE__,std::to_string(__LINE__).c_str(),"##### Error in NuDEX #####");
+  }
+
+  if(LevelSchemeNThreads<0){
+    std::cout<<" ############## Error, LevelSchemeNThreads cannot be set to: "<<LevelSchemeNThreads<<" ##############"<<std::endl; NuDEXException(__FILE__,std::to_string(__LINE__).c_str(),"##### Error in NuDEX #####");
+  }
+
+  if(SampleGammaWidths<0 || SampleGammaWidths>2){
     std::cout<<" ############## Error, SampleGammaWidths cannot be set to: "<<SampleGammaWidths<<" ##############"<<std::endl; NuDEXException(__FILE__,std::to_string(__LINE__).c_str(),"##### Error in NuDEX #####");
   }
   
@@ -313,221 +457,127 @@ void NuDEXStatisticalNucleus::MakeSomeParameterChecks01(){
 // return Npar (number of particles emitted). If something goes wrong, returns negative value (for example negative energy transition, which could happen).
 int NuDEXStatisticalNucleus::GenerateCascade(int InitialLevel,double ExcitationEnergy,std::vector<char>& pType,std::vector<double>& pEnergy,std::vector<double>& pTime){
 
-  pType.clear();
-  pEnergy.clear();
-  pTime.clear();
-  
-  if(ExcitationEnergy<0){
-    ExcitationEnergy=Sn-(A_Int-1.)/(double)A_Int*ExcitationEnergy;
+  //The cascades are generated by a NuDEXCascadeSampler, which uses the random generators of this class:
+  if(theDefaultSampler==0){
+    theDefaultSampler=new NuDEXCascadeSampler(this,theRandom2,theRandom3,theICC->GetRandom4());
   }
-  if(ExcitationEnergy<=0){
-    return 0;
-  }
-
-  int Npar=0;
-  int f_level,multipol;
-  double alpha,E_trans,Exc_ene_i,Exc_ene_f; //icc factor, energy of the transition, initial/final excitation energy
-  double EmissionTime=0; //in seconds
-  int NTransition=0;
-  //double TotalCascadeEnergy1=0,TotalCascadeEnergy2=0;
-  
-  //Start:
-  int i_level=InitialLevel;
-  Exc_ene_i=ExcitationEnergy;
+  return theDefaultSampler->GenerateCascade(InitialLevel,ExcitationEnergy,pType,pEnergy,pTime);
+}
 
+int NuDEXStatisticalNucleus::GenerateCascades(int NCascades,int InitialLevel,double ExcitationEnergy,NuDEXCascadeBuffer* theBuffer){
 
-  if(i_level==0){ //could happen
-    pType.push_back('g');
-    pEnergy.push_back(Exc_ene_i);
-    pTime.push_back(0);
-    Npar++;
+  if(theDefaultSampler==0){
+    theDefaultSampler=new NuDEXCascadeSampler(this,theRandom2,theRandom3,theICC->GetRandom4());
   }
-  
-  //Loop:
-  while(i_level!=0){
-
-    NTransition++;
-    //--------------------------------------------
-    //Sample final level:
-    if(i_level==-1){ //thermal level
-      if(!theThermalCaptureLevelCumulBR){
-	f_level=0;
-	std::cout<<" ############## NuDEX: WARNING, there are no thermal capture for ZA="<<A_Int+1000*Z_Int-1<<" , with Sn = "<<Sn<<" ##############"<<std::endl; 
-      }
-      else{
-	//Sample final level:
-	double randnumber=theRandom3->Uniform();
-	f_level=-1;
-	for(int i=0;i<NLevelsBelowThermalCaptureLevel;i++){
-	  if(theThermalCaptureLevelCumulBR[i]>randnumber){
-	    multipol=GetMultipolarity(&theThermalCaptureLevel,&theLevels[i]);
-	    f_level=i;
-	    break;
-	  }
-	}
-      }
-      if(f_level<0){
-	NuDEXException(__FILE__,std::to_string(__LINE__).c_str(),"##### Error in NuDEX #####");
-      }
-      Exc_ene_f=theLevels[f_level].Energy;
-    }
-    else if(i_level>0){
-      f_level=SampleFinalLevel(i_level,multipol,alpha,NTransition);
-    }
-    else{
-      NuDEXException(__FILE__,std::to_string(__LINE__).c_str(),"##### Error in NuDEX #####");
-    }
-    //--------------------------------------------
+  return theDefaultSampler->GenerateCascades(NCascades,InitialLevel,ExcitationEnergy,theBuffer);
+}
 
-    //Energy of the transition:
-    Exc_ene_f=theLevels[f_level].Energy;
 
-    //We sample the final energy if it is a band of levels:
-    if(theLevels[f_level].Width!=0){
-      Exc_ene_f+=theRandom3->Uniform(-theLevels[f_level].Width,+theLevels[f_level].Width);
-    }
-    E_trans=Exc_ene_i-Exc_ene_f;
-    if(E_trans<=0){
-      //std::cout<<"Exc_ene_i = "<<Exc_ene_i<<"  Exc_ene_f = "<<Exc_ene_f<<std::endl;
-      //std::cout<<" ####### WARNING: E_trans = "<<E_trans<<" for i="<<i_level<<" with E = "<<theLevels[std::max(i_level,0)].Energy<<" to  f="<<f_level<<" with E = "<<theLevels[f_level].Energy<<" ########"<<std::endl;  
-      return -1;
-    }
-    //------------------------------------------------------------
-    //Emission time:
-    if(i_level<NKnownLevels && i_level>0){
-      if(theKnownLevels[i_level].T12>0){
-	EmissionTime+=theRandom3->Exp(theKnownLevels[i_level].T12/log(2));
-      }
-    }
-    //------------------------------------------------------------
+//The BR of the levels in the unknown part of the level scheme are computed the first time they are needed.
+//This could happen from several threads at the same time (each of them with its own NuDEXCascadeSampler):
+//the values obtained do not depend on the thread (theRandom2 is seeded with the seed of the level), so the first one to finish is stored.
+//Only the non-zero BR are stored.
+SparseBR* NuDEXStatisticalNucleus::GetTotalCumulBR(int i_level,NuDEXCascadeSampler* theSampler){
 
-    //------------------------------------------------------------
-    //calculate electron conversion:
-    bool ele_conv=false;
-    if(ElectronConversionFlag>0){
-      if(i_level<NKnownLevels && i_level>0){ //ElectronConversionFlag=1,2
-	ele_conv=theICC->SampleInternalConversion(E_trans,multipol,alpha); //use the alpha value from the know level value
-      }
-      else if(ElectronConversionFlag==2){
-        ele_conv=theICC->SampleInternalConversion(E_trans,multipol); //calculate alpha (icc factor)
-      }
-    }
-    //------------------------------------------------------------
-    //std::cout<<" ---- "<<Exc_ene_i<<"  "<<Exc_ene_f<<"  "<<E_trans<<"  "<<multipol<<"  "<<ele_conv<<std::endl;
-    //TotalCascadeEnergy1+=E_trans;
-    
-    //------------------------------------------------------------
-    //Fill result:
-    if(ele_conv){
-      for(int i=0;i<theICC->Ne;i++){
-	pType.push_back('e');
-	pEnergy.push_back(theICC->Eele[i]);
-	pTime.push_back(EmissionTime);
-	Npar++;
-      }
-      for(int i=0;i<theICC->Ng;i++){
-	pType.push_back('g');
-	pEnergy.push_back(theICC->Egam[i]);
-	pTime.push_back(EmissionTime);	
-	Npar++;
-      }
+  SparseBR* cumulBR=TotalCumulBR[i_level].load(std::memory_order_acquire);
+  if(cumulBR==0){
+    double* denseCumulBR=new double[i_level];
+    double newTotalGammaRho=ComputeDecayIntensities(i_level,denseCumulBR,-1,-1,false,theSampler);
+    SparseBR* newCumulBR=CreateSparseBR(denseCumulBR,i_level,BRStorageOpt==1);
+    delete [] denseCumulBR;
+    if(TotalCumulBR[i_level].compare_exchange_strong(cumulBR,newCumulBR,std::memory_order_acq_rel)){
+      TotalGammaRho[i_level].store(newTotalGammaRho,std::memory_order_release);
+      cumulBR=newCumulBR;
     }
-    else{
-      pType.push_back('g');
-      pEnergy.push_back(E_trans);
-      pTime.push_back(EmissionTime);	      
-      Npar++;
+    else{ //another thread has done it before
+      DeleteSparseBR(newCumulBR);
     }
-    //------------------------------------------------------------
-    i_level=f_level;
-    Exc_ene_i=Exc_ene_f;
   }
-
-  //for(int i=0;i<Npar;i++){TotalCascadeEnergy2+=pEnergy[i];}
-  //std::cout<<" Total energy: "<<TotalCascadeEnergy1<<"  "<<TotalCascadeEnergy2<<std::endl; getchar();
-  
-  
-  if(i_level!=0){
-    NuDEXException(__FILE__,std::to_string(__LINE__).c_str(),"##### Error in NuDEX #####");
-  }
-  return Npar;
+  return cumulBR;
 }
 
+//Alias tables are built from the cumulative BR, the first time they are needed:
+AliasTable* NuDEXStatisticalNucleus::GetTotalAliasBR(int i_level,NuDEXCascadeSampler* theSampler){
 
-
-
-int NuDEXStatisticalNucleus::SampleFinalLevel(int i_level,int& multipolarity,double &icc_fac,int nTransition){
-
-  if(i_level<=0 || i_level>=NLevels){
-    NuDEXException(__FILE__,std::to_string(__LINE__).c_str(),"##### Error in NuDEX #####");
+  AliasTable* aliasBR=TotalAliasBR[i_level].load(std::memory_order_acquire);
+  if(aliasBR==0){
+    AliasTable* newAliasBR=CreateAliasTable(GetTotalCumulBR(i_level,theSampler));
+    if(TotalAliasBR[i_level].compare_exchange_strong(aliasBR,newAliasBR,std::memory_order_acq_rel)){
+      aliasBR=newAliasBR;
+    }
+    else{ //another thread has done it before
+      DeleteAliasTable(newAliasBR);
+    }
   }
+  return aliasBR;
+}
 
-  double randnumber=theRandom3->Uniform();
+//Same loop as in ComputeDecayIntensities(i_level), but keeping the partial sums of the allowed transitions:
+DecayIntensitiesRow* NuDEXStatisticalNucleus::ComputeDecayIntensitiesRow(int i_level,NuDEXCascadeSampler* theSampler,bool AllowE1){
 
-  int i_knownLevel=-1;
-  if(i_level<NKnownLevels){ //then is a known level
-    i_knownLevel=i_level;
-  }
-  if(theLevels[i_level].KnownLevelID>0){ //then is in the unknown part, but we use it as a known level
-    if(theKnownLevels[theLevels[i_level].KnownLevelID].NGammas>0){
-      i_knownLevel=theLevels[i_level].KnownLevelID;
+  NuDEXRandom* aRandom2=theRandom2;
+  if(theSampler!=0){aRandom2=theSampler->theRandom2;}
+  aRandom2->SetSeed(theLevels[i_level].seed);
+
+  int* FinalLevel=new int[i_level];
+  double* SumGammaRho=new double[i_level];
+  double* GammaRhoMult=new double[3*i_level];
+  int N=0;
+  double thisTotalGammaRho=0;
+  int Allowed[PSFBLOCKSIZE];
+  double PSFValues[3*PSFBLOCKSIZE];
+  int nFinal=i_level;
+  const int* FinalLevels=0;
+  if(!AllowE1){FinalLevels=GetReachableLevels(i_level,nFinal);}
+  for(int p=0;p<nFinal;p++){
+    int j=(FinalLevels!=0)?FinalLevels[p]:p;
+    if(p%PSFBLOCKSIZE==0){
+      ComputeTransitionsPSF(i_level,(FinalLevels!=0)?&FinalLevels[p]:0,p,std::min(PSFBLOCKSIZE,nFinal-p),AllowE1,Allowed,PSFValues);
+    }
+    int k=p%PSFBLOCKSIZE;
+    double GammaRho=ComputeTransitionIntensity(i_level,j,Allowed[k],&PSFValues[3*k],aRandom2,&GammaRhoMult[3*N]);
+    if(GammaRho>0){
+      thisTotalGammaRho+=GammaRho;
+      FinalLevel[N]=j;
+      SumGammaRho[N]=thisTotalGammaRho;
+      N++;
     }
   }
 
-  if(i_knownLevel>=0){//known part of the spectrum
-    theSampledLevel=-1;
-    for(int j=0;j<theKnownLevels[i_knownLevel].NGammas;j++){
-      if(theKnownLevels[i_knownLevel].cumulPtot[j]>randnumber){
-	multipolarity=theKnownLevels[i_knownLevel].multipolarity[j];
-	icc_fac=theKnownLevels[i_knownLevel].Icc[j];
-	return theKnownLevels[i_knownLevel].FinalLevelID[j];
-      }
-    }
-    std::cout<<randnumber<<"  "<<i_knownLevel<<"  "<<theKnownLevels[i_knownLevel].NGammas<<std::endl;
-    for(int j=0;j<theKnownLevels[i_knownLevel].NGammas;j++){
-      std::cout<<theKnownLevels[i_knownLevel].cumulPtot[j]<<std::endl;
-    }
-    NuDEXException(__FILE__,std::to_string(__LINE__).c_str(),"##### Error in NuDEX #####");
+  if(thisTotalGammaRho==0 && !AllowE1){ //If there are no allowed transitions (see ComputeDecayIntensities)
+    delete [] FinalLevel; delete [] SumGammaRho; delete [] GammaRhoMult;
+    return ComputeDecayIntensitiesRow(i_level,theSampler,true);
   }
-  else{
-    icc_fac=-1;
-    //------------------------------------------------------------------------------
-    //If BROpt==1 or 2, then we store the BR, if not computed, or calculate the final level from it
-    if(BROpt==1 || (BROpt==2 && nTransition==1)){
-      //maybe the TotalGammaRho[i_level] and BR have not been computed yet:
-      if(TotalCumulBR[i_level]==0){
-	TotalCumulBR[i_level]=new double[i_level];
-	TotalGammaRho[i_level]=ComputeDecayIntensities(i_level,TotalCumulBR[i_level]);
-      }
-      for(int j=0;j<i_level;j++){
-	if(TotalCumulBR[i_level][j]>randnumber){
-	  multipolarity=GetMultipolarity(&theLevels[i_level],&theLevels[j]);
-	  return j;
-	}
-      }
-      NuDEXException(__FILE__,std::to_string(__LINE__).c_str(),"##### Error in NuDEX #####");
-    }
-    //------------------------------------------------------------------------------
 
-    //BROpt==0
-    //------------------------------------------------------------------------------
-    // If not, maybe the TotalGammaRho[i_level] has not been computed yet:
-    if(TotalGammaRho[i_level]<0){//not computed, we compute it:
-      TotalGammaRho[i_level]=ComputeDecayIntensities(i_level);
-    }
-    theSampledLevel=-1;
-    ComputeDecayIntensities(i_level,0,randnumber); // here we compute the final level
-    multipolarity=theSampledMultipolarity;
-    return theSampledLevel;
-    //------------------------------------------------------------------------------
+  DecayIntensitiesRow* a=new DecayIntensitiesRow;
+  a->N=N;
+  a->FinalLevel=new int[N];
+  a->SumGammaRho=new double[N];
+  a->GammaRhoMult=new double[3*N];
+  for(int k=0;k<N;k++){
+    a->FinalLevel[k]=FinalLevel[k];
+    a->SumGammaRho[k]=SumGammaRho[k];
+    for(int m=0;m<3;m++){a->GammaRhoMult[3*k+m]=GammaRhoMult[3*k+m];}
   }
+  delete [] FinalLevel; delete [] SumGammaRho; delete [] GammaRhoMult;
 
-  NuDEXException(__FILE__,std::to_string(__LINE__).c_str(),"##### Error in NuDEX #####");
-  return 0;
+  return a;
+}
+
+double NuDEXStatisticalNucleus::GetTotalGammaRho(int i_level,NuDEXCascadeSampler* theSampler){
+
+  double totalGammaRho=TotalGammaRho[i_level].load(std::memory_order_acquire);
+  if(totalGammaRho<0){//not computed, we compute it:
+    totalGammaRho=ComputeDecayIntensities(i_level,0,-1,-1,false,theSampler);
+    TotalGammaRho[i_level].store(totalGammaRho,std::memory_order_release);
+  }
+  return totalGammaRho;
 }
 
 void NuDEXStatisticalNucleus::ChangeLevelSpinParityAndBR(int i_level,int newspinx2,bool newParity,int nlevels,double width,unsigned int seed){
 
+  CheckNoAttachedSamplers();
+
   if(i_level==-1){ //change BR of thermal, ignore arguments
     if(Sn>0 && NLevels>1){
       CreateThermalCaptureLevel(seed);
@@ -548,6 +598,7 @@ void NuDEXStatisticalNucleus::ChangeLevelSpinParityAndBR(int i_level,int newspin
     //NuDEXException(__FILE__,std::to_string(__LINE__).c_str(),"##### Error in NuDEX #####");
   }
 
+  bool ClassChanged=(theLevels[i_level].spinx2!=newspinx2 || theLevels[i_level].parity!=newParity);
   theLevels[i_level].spinx2=newspinx2;
   theLevels[i_level].parity=newParity;
   if(seed>0){
@@ -562,23 +613,50 @@ void NuDEXStatisticalNucleus::ChangeLevelSpinParityAndBR(int i_level,int newspin
   if(width>=0){
     theLevels[i_level].Width=width;
   }
+  UpdateLevelsSoA(i_level);
+  if(ClassChanged){CreateSpinParityClasses();}
+  NBRChanges++;
 
   if(TotalGammaRho[i_level]>=0){ //then we have to change TotalGammaRho[i_level]
     double* br_vector=0;
-    if(TotalCumulBR!=0){
-      br_vector=TotalCumulBR[i_level];
+    if(TotalCumulBR!=0 && TotalCumulBR[i_level]!=0){
+      br_vector=new double[i_level];
     }
     TotalGammaRho[i_level]=ComputeDecayIntensities(i_level,br_vector);
+    if(br_vector!=0){
+      DeleteSparseBR(TotalCumulBR[i_level]);
+      TotalCumulBR[i_level]=CreateSparseBR(br_vector,i_level,BRStorageOpt==1);
+      delete [] br_vector;
+    }
+    if(TotalAliasBR!=0 && TotalAliasBR[i_level]!=0){ //re-built now from the new BR, so it is never older than TotalCumulBR[i_level]
+      DeleteAliasTable(TotalAliasBR[i_level]);
+      TotalAliasBR[i_level]=0;
+      if(TotalCumulBR[i_level]!=0){
+	TotalAliasBR[i_level]=CreateAliasTable(TotalCumulBR[i_level]);
+      }
+    }
   }
 
 }
 
 
+//The BR rows and alias tables are deleted and re-built in place when changing a level, so no other sampler than
+//theDefaultSampler (used from the thread which calls the Change... methods) can be attached to the nucleus:
+void NuDEXStatisticalNucleus::CheckNoAttachedSamplers(){
+
+  int NOtherSamplers=NAttachedSamplers.load()-(theDefaultSampler!=0?1:0);
+  if(NOtherSamplers>0){
+    std::cout<<" ############## Error: the BR of the nucleus cannot be changed when there are NuDEXCascadeSampler or NuDEXCascadeProducer using it ("<<NOtherSamplers<<") ##############"<<std::endl;
+    NuDEXException(__FILE__,std::to_string(__LINE__).c_str(),"##### Error in NuDEX #####");
+  }
+}
+
 //if randnumber<0, return the total TotalGammaRho, and if cumulativeBR!=0, the corresponding cumulativeBR vector is calculated
 //if randnumber>0, it is assumed that TotalGammaRho has been already computed 
 //          (in the TotalGammaRho[] array or in the TotGR argument) and is used to sample the transition
-//     The result is stored in theSampledLevel and theSampledMultipolarity variables
-double NuDEXStatisticalNucleus::ComputeDecayIntensities(int i_level,double* cumulativeBR,double randnumber,double TotGR,bool AllowE1){
+//     The result is stored in theSampler->theSampledLevel and theSampler->theSampledMultipolarity variables
+//If theSampler!=0, its theRandom2 is used instead of the one of this class
+double NuDEXStatisticalNucleus::ComputeDecayIntensities(int i_level,double* cumulativeBR,double randnumber,double TotGR,bool AllowE1,NuDEXCascadeSampler* theSampler){
 
   bool  ComputeAlsoBR=false;
   if(cumulativeBR!=0){ComputeAlsoBR=true;}
@@ -589,6 +667,9 @@ double NuDEXStatisticalNucleus::ComputeDecayIntensities(int i_level,double* cumu
     NuDEXException(__FILE__,std::to_string(__LINE__).c_str(),"##### Error in NuDEX #####");
   }
   if(randnumber>0){
+    if(theSampler==0){
+      NuDEXException(__FILE__,std::to_string(__LINE__).c_str(),"##### Error in NuDEX #####");
+    }
     ComputeAlsoBR=false;
     if(TotGR<=0){
       TotGR=TotalGammaRho[i_level];
@@ -599,116 +680,39 @@ double NuDEXStatisticalNucleus::ComputeDecayIntensities(int i_level,double* cumu
   }
   //-------------------------------------------------------------------------------------
 
-  theRandom2->SetSeed(theLevels[i_level].seed);
+  NuDEXRandom* aRandom2=theRandom2;
+  if(theSampler!=0){aRandom2=theSampler->theRandom2;}
+  aRandom2->SetSeed(theLevels[i_level].seed);
+  int sampledMultipolarity=-50;
   double thisTotalGammaRho=0;
-  for(int j=0;j<i_level;j++){
+  double GammaRhoMult[3];
+  int Allowed[PSFBLOCKSIZE]; //the PSF are computed in blocks of PSFBLOCKSIZE transitions
+  double PSFValues[3*PSFBLOCKSIZE];
+  //Only the levels of the spin-parity classes reachable from i_level are visited (all of them if AllowE1). The rest have BR=0:
+  int nFinal=i_level;
+  const int* FinalLevels=0;
+  if(!AllowE1){FinalLevels=GetReachableLevels(i_level,nFinal);}
+  if(ComputeAlsoBR && nFinal<i_level){
+    for(int j=0;j<i_level;j++){cumulativeBR[j]=0;}
+  }
+  for(int p=0;p<nFinal;p++){
+    int j=(FinalLevels!=0)?FinalLevels[p]:p;
+    if(p%PSFBLOCKSIZE==0){
+      ComputeTransitionsPSF(i_level,(FinalLevels!=0)?&FinalLevels[p]:0,p,std::min(PSFBLOCKSIZE,nFinal-p),AllowE1,Allowed,PSFValues);
+    }
+    int k=p%PSFBLOCKSIZE;
+    double GammaRho=ComputeTransitionIntensity(i_level,j,Allowed[k],&PSFValues[3*k],aRandom2,GammaRhoMult);
     //If "solape" then zero:
-    if(theLevels[i_level].Energy-theLevels[i_level].Width<=theLevels[j].Energy+theLevels[j].Width){
+    if(GammaRho<0){
       thisTotalGammaRho+=0; //not cecessary, but for understanding ...
       if(ComputeAlsoBR){
 	cumulativeBR[j]=0;
       }
     }
     else{
-      double Eg=theLevels[i_level].Energy-theLevels[j].Energy;
-
-      //------------------------------------------------------------------
-      //Check which are allowed transitions:
-      bool E1allowed=true,M1allowed=true,E2allowed=true;
-      int Lmin=std::abs(theLevels[i_level].spinx2-theLevels[j].spinx2)/2;
-      int Lmax=(theLevels[i_level].spinx2+theLevels[j].spinx2)/2;
-      if(theLevels[i_level].parity==theLevels[j].parity){
-	E1allowed=false;
-      }
-      else{
-	M1allowed=false; E2allowed=false;
+      if(randnumber>=0){
+	sampledMultipolarity=SampleMultipolarity(thisTotalGammaRho,GammaRhoMult,TotGR*randnumber);
       }
-      if(Lmin>1 || Lmax<1){
-	E1allowed=false; M1allowed=false; 
-      }
-      if(Lmin>2 || Lmax<2){
-	E2allowed=false; 
-      }
-      if(AllowE1){E1allowed=true;}
-      //------------------------------------------------------------------
-
-      double GammaRho=0,Sumrand2;
-      theSampledMultipolarity=-50;
-      int RealNTransitions=theLevels[i_level].NLevels*theLevels[j].NLevels;
-
-      double rand;
-      double MaxNSamplesForChi2=1000;
-
-      if(E1allowed){
-	Sumrand2=RealNTransitions;
-	if(SampleGammaWidths==1){ //Porter-Thomas fluctuations
-	  Sumrand2=0;
-	  if(RealNTransitions>MaxNSamplesForChi2){
-	    Sumrand2=RealNTransitions*theRandom2->Gaus(1,sqrt(2./RealNTransitions));
-	  }
-	  else{
-	    for(int ntr=0;ntr<RealNTransitions;ntr++){
-	      rand=theRandom2->Gaus(0,1);
-	      Sumrand2+=rand*rand;
-	    }
-	  }
-	}
-	GammaRho+=Sumrand2*Eg*Eg*Eg*thePSF->GetE1(Eg,theLevels[i_level].Energy);
-	if(randnumber>=0){
-	  if(thisTotalGammaRho+GammaRho>=TotGR*randnumber){
-	    theSampledMultipolarity=1;
-	  }
-	}
-      }
-      if(M1allowed){
-	Sumrand2=RealNTransitions;
-	if(SampleGammaWidths==1){ //Porter-Thomas fluctuations
-	  Sumrand2=0;
-	  if(RealNTransitions>MaxNSamplesForChi2){
-	    Sumrand2=RealNTransitions*theRandom2->Gaus(1,sqrt(2./RealNTransitions));
-	  }
-	  else{
-	    for(int ntr=0;ntr<RealNTransitions;ntr++){
-	      rand=theRandom2->Gaus(0,1);
-	      Sumrand2+=rand*rand;
-	    }
-	  }
-	}
-	GammaRho+=Sumrand2*Eg*Eg*Eg*thePSF->GetM1(Eg,theLevels[i_level].Energy);
-	if(randnumber>=0){
-	  if(thisTotalGammaRho+GammaRho>=TotGR*randnumber){
-	    theSampledMultipolarity=-1;
-	  }
-	}
-      }
-      if(E2allowed){
-	Sumrand2=RealNTransitions;
-	if(SampleGammaWidths==1){ //Porter-Thomas fluctuations
-	  Sumrand2=0;
-	  if(RealNTransitions>MaxNSamplesForChi2){
-	    Sumrand2=RealNTransitions*theRandom2->Gaus(1,sqrt(2./RealNTransitions));
-	  }
-	  else{
-	    for(int ntr=0;ntr<RealNTransitions;ntr++){
-	      rand=theRandom2->Gaus(0,1);
-	      Sumrand2+=rand*rand;
-	    }
-	  }
-	}
-	GammaRho+=Sumrand2*Eg*Eg*Eg*Eg*Eg*thePSF->GetE2(Eg,theLevels[i_level].Energy);
-	if(randnumber>=0){
-	  if(thisTotalGammaRho+GammaRho>=TotGR*randnumber && theSampledMultipolarity<-10){
-	    theSampledMultipolarity=2;
-	  }
-	}
-      }
-
-      /*
-      if(i_level==NLevels-1 && j<10){
-	std::cout<<j<<"   "<<GammaRho<<"  "<<E1allowed<<"  "<<M1allowed<<"  "<<E2allowed<<"   "<<GammaRho/Eg/Eg/Eg/thePSF->GetE1(Eg,theLevels[i_level].Energy)<<std::endl;
-      }
-      */
-
       thisTotalGammaRho+=GammaRho;
       if(ComputeAlsoBR){
 	cumulativeBR[j]=GammaRho;
@@ -716,17 +720,18 @@ double NuDEXStatisticalNucleus::ComputeDecayIntensities(int i_level,double* cumu
     }
 
     if(randnumber>=0 && thisTotalGammaRho>=TotGR*randnumber){
-      if(theSampledMultipolarity==-50){
+      if(sampledMultipolarity==-50){
 	NuDEXException(__FILE__,std::to_string(__LINE__).c_str(),"##### Error in NuDEX #####");
       }
-      theSampledLevel=j;
+      theSampler->theSampledLevel=j;
+      theSampler->theSampledMultipolarity=sampledMultipolarity;
       return -1;
     }
   }
 
   //If there are no allowed transitions:
   if(randnumber>=0 && thisTotalGammaRho==0){ //if randnumber>0 then TotalGammaRho[i_lev] has been already computed allowing E1 transitions
-    return ComputeDecayIntensities(i_level,0,randnumber,TotGR,true);
+    return ComputeDecayIntensities(i_level,0,randnumber,TotGR,true,theSampler);
   }
 
   if(randnumber>=0){ //then we should not be here
@@ -749,13 +754,226 @@ double NuDEXStatisticalNucleus::ComputeDecayIntensities(int i_level,double* cumu
   else{
     //std::cout<<" ############### WARNING: total GammaRho for level "<<i_level<<" is "<<thisTotalGammaRho<<". We recalculate it allowing all transitions and assuming the E1 PSF ###############"<<std::endl; 
     //NuDEXException(__FILE__,std::to_string(__LINE__).c_str(),"##### Error in NuDEX #####");
-    thisTotalGammaRho=ComputeDecayIntensities(i_level,cumulativeBR,-1,-1,true);
+    thisTotalGammaRho=ComputeDecayIntensities(i_level,cumulativeBR,-1,-1,true,theSampler);
   }
 
   return thisTotalGammaRho;
 }
 
 
+//Allowed multipolarities of the n transitions from i_level to j0,...,j0+n-1: 1 (E1) + 2 (M1) + 4 (E2). If the levels overlap, -1
+//Also the gamma energies, Eg[k]=E(i_level)-E(j0+k)
+//Selection rules (Lmin=|Ji-Jf|, Lmax=Ji+Jf): E1 if different parity and Lmin<=1<=Lmax (or if AllowE1),
+//M1 if same parity and Lmin<=1<=Lmax, E2 if same parity and Lmin<=2<=Lmax.
+//Computed over theLevelsSoA, 8 (AVX-512) or 4 (AVX2) final levels at a time if compiled for them, the rest one by one.
+//The GammaRho of the transitions is not vectorized: it is computed in ComputeTransitionIntensity, one transition at a time,
+//because the Porter-Thomas fluctuations are sampled in sequence from aRandom2.
+void NuDEXStatisticalNucleus::ComputeAllowedMultipolarities(int i_level,int j0,int n,bool AllowE1,int* Allowed,double* Eg){
+
+  const double* Energy=&theLevelsSoA.Energy[j0];
+  const double* HighEdge=&theLevelsSoA.HighEdge[j0];
+  const int* spinx2=&theLevelsSoA.spinx2[j0];
+  const int* parity=&theLevelsSoA.parity[j0];
+  double Ei=theLevelsSoA.Energy[i_level];
+  double LowEdge_i=theLevelsSoA.LowEdge[i_level];
+  int si=theLevelsSoA.spinx2[i_level];
+  int pi=theLevelsSoA.parity[i_level];
+
+  int k=0;
+#if defined(__AVX2__)
+  //Integer part, the same for AVX-512 and AVX2 (4 or 8 levels, as 32-bit ints):
+  const __m128i vsi4=_mm_set1_epi32(si),vpi4=_mm_set1_epi32(pi),vAllowE1_4=_mm_set1_epi32(AllowE1?-1:0);
+#if defined(__AVX512F__)
+  const __m512d vEi8=_mm512_set1_pd(Ei),vLowEdge8=_mm512_set1_pd(LowEdge_i);
+  const __m256i vsi8=_mm256_set1_epi32(si),vpi8=_mm256_set1_epi32(pi),vAllowE1_8=_mm256_set1_epi32(AllowE1?-1:0);
+  const __m256i LaneBits=_mm256_setr_epi32(1,2,4,8,16,32,64,128);
+  for(;k+8<=n;k+=8){
+    _mm512_storeu_pd(&Eg[k],_mm512_sub_pd(vEi8,_mm512_loadu_pd(&Energy[k])));
+    __mmask8 overlap=_mm512_cmp_pd_mask(vLowEdge8,_mm512_loadu_pd(&HighEdge[k]),_CMP_LE_OQ);
+    __m256i vOverlap=_mm256_cmpeq_epi32(_mm256_and_si256(_mm256_set1_epi32(overlap),LaneBits),LaneBits);
+    __m256i sj=_mm256_loadu_si256((const __m256i*)&spinx2[k]);
+    __m256i d=_mm256_abs_epi32(_mm256_sub_epi32(vsi8,sj));
+    __m256i sum=_mm256_add_epi32(vsi8,sj);
+    __m256i same=_mm256_cmpeq_epi32(vpi8,_mm256_loadu_si256((const __m256i*)&parity[k]));
+    __m256i L1=_mm256_and_si256(_mm256_cmpgt_epi32(_mm256_set1_epi32(4),d),_mm256_cmpgt_epi32(sum,_mm256_set1_epi32(1)));
+    __m256i L2=_mm256_and_si256(_mm256_cmpgt_epi32(_mm256_set1_epi32(6),d),_mm256_cmpgt_epi32(sum,_mm256_set1_epi32(3)));
+    __m256i E1=_mm256_or_si256(_mm256_andnot_si256(same,L1),vAllowE1_8);
+    __m256i M1=_mm256_and_si256(same,L1);
+    __m256i E2=_mm256_and_si256(same,L2);
+    __m256i a=_mm256_or_si256(_mm256_and_si256(E1,_mm256_set1_epi32(1)),_mm256_or_si256(_mm256_and_si256(M1,_mm256_set1_epi32(2)),_mm256_and_si256(E2,_mm256_set1_epi32(4))));
+    _mm256_storeu_si256((__m256i*)&Allowed[k],_mm256_blendv_epi8(a,_mm256_set1_epi32(-1),vOverlap));
+  }
+#endif
+  const __m256d vEi4=_mm256_set1_pd(Ei),vLowEdge4=_mm256_set1_pd(LowEdge_i);
+  const __m256i EvenLanes=_mm256_setr_epi32(0,2,4,6,1,3,5,7);
+  for(;k+4<=n;k+=4){
+    _mm256_storeu_pd(&Eg[k],_mm256_sub_pd(vEi4,_mm256_loadu_pd(&Energy[k])));
+    __m256d overlap=_mm256_cmp_pd(vLowEdge4,_mm256_loadu_pd(&HighEdge[k]),_CMP_LE_OQ);
+    __m128i vOverlap=_mm256_castsi256_si128(_mm256_permutevar8x32_epi32(_mm256_castpd_si256(overlap),EvenLanes));
+    __m128i sj=_mm_loadu_si128((const __m128i*)&spinx2[k]);
+    __m128i d=_mm_abs_epi32(_mm_sub_epi32(vsi4,sj));
+    __m128i sum=_mm_add_epi32(vsi4,sj);
+    __m128i same=_mm_cmpeq_epi32(vpi4,_mm_loadu_si128((const __m128i*)&parity[k]));
+    __m128i L1=_mm_and_si128(_mm_cmplt_epi32(d,_mm_set1_epi32(4)),_mm_cmpgt_epi32(sum,_mm_set1_epi32(1)));
+    __m128i L2=_mm_and_si128(_mm_cmplt_epi32(d,_mm_set1_epi32(6)),_mm_cmpgt_epi32(sum,_mm_set1_epi32(3)));
+    __m128i E1=_mm_or_si128(_mm_andnot_si128(same,L1),vAllowE1_4);
+    __m128i M1=_mm_and_si128(same,L1);
+    __m128i E2=_mm_and_si128(same,L2);
+    __m128i a=_mm_or_si128(_mm_and_si128(E1,_mm_set1_epi32(1)),_mm_or_si128(_mm_and_si128(M1,_mm_set1_epi32(2)),_mm_and_si128(E2,_mm_set1_epi32(4))));
+    _mm_storeu_si128((__m128i*)&Allowed[k],_mm_blendv_epi8(a,_mm_set1_epi32(-1),vOverlap));
+  }
+#endif
+  //Scalar loop (all the levels if there is no AVX2):
+  for(;k<n;k++){
+    Eg[k]=Ei-Energy[k];
+    int d=std::abs(si-spinx2[k]),sum=si+spinx2[k];
+    bool same=(pi==parity[k]);
+    bool L1=(d<4 && sum>1),L2=(d<6 && sum>3);
+    bool E1allowed=((!same && L1) || AllowE1),M1allowed=(same && L1),E2allowed=(same && L2);
+    Allowed[k]=(E1allowed?1:0)+(M1allowed?2:0)+(E2allowed?4:0);
+    //If "solape" then -1:
+    if(LowEdge_i<=HighEdge[k]){Allowed[k]=-1;}
+  }
+}
+
+
+//Same, for the final levels FinalLevels[0,...,n-1], all of them in classes reachable from i_level (see GetReachableLevels)
+//The allowed multipolarities are taken from theClassMultipolarities
+void NuDEXStatisticalNucleus::ComputeAllowedMultipolarities(int i_level,const int* FinalLevels,int n,int* Allowed,double* Eg){
+
+  const int* ClassMultipolarities=&theClassMultipolarities[(theLevelsSoA.parity[i_level]*NClassSpins+theLevelsSoA.spinx2[i_level])*NClasses];
+  double Ei=theLevelsSoA.Energy[i_level];
+  double LowEdge_i=theLevelsSoA.LowEdge[i_level];
+  for(int k=0;k<n;k++){
+    int j=FinalLevels[k];
+    Eg[k]=Ei-theLevelsSoA.Energy[j];
+    Allowed[k]=ClassMultipolarities[theLevelClass[j]];
+    //If "solape" then -1:
+    if(LowEdge_i<=theLevelsSoA.HighEdge[j]){Allowed[k]=-1;}
+  }
+}
+
+
+//Allowed multipolarities and PSF values of the n transitions from i_level to FinalLevels[0,...,n-1] or, if FinalLevels==0, to j0,...,j0+n-1
+//The PSF of each multipolarity is evaluated at once for all the transitions where it is allowed
+//PSFValues[3*k+0,1,2] are the E1, M1 and E2 PSF of the k-th transition (only if allowed)
+void NuDEXStatisticalNucleus::ComputeTransitionsPSF(int i_level,const int* FinalLevels,int j0,int n,bool AllowE1,int* Allowed,double* PSFValues){
+
+  if(n>PSFBLOCKSIZE){
+    NuDEXException(__FILE__,std::to_string(__LINE__).c_str(),"##### Error in NuDEX #####");
+  }
+  double Eg[3][PSFBLOCKSIZE],PSF[PSFBLOCKSIZE],EgBlock[PSFBLOCKSIZE];
+  int Index[3][PSFBLOCKSIZE];
+  int nE1=0,nM1=0,nE2=0;
+  double Ei=theLevels[i_level].Energy;
+  if(FinalLevels!=0){
+    ComputeAllowedMultipolarities(i_level,FinalLevels,n,Allowed,EgBlock);
+  }
+  else{
+    ComputeAllowedMultipolarities(i_level,j0,n,AllowE1,Allowed,EgBlock);
+  }
+  for(int k=0;k<n;k++){
+    int allowed=Allowed[k];
+    if(allowed<=0){continue;}
+    double eg=EgBlock[k];
+    //the values are always written, but only counted if allowed:
+    Eg[0][nE1]=eg; Index[0][nE1]=k; nE1+=(allowed&1);
+    Eg[1][nM1]=eg; Index[1][nM1]=k; nM1+=(allowed>>1)&1;
+    Eg[2][nE2]=eg; Index[2][nE2]=k; nE2+=(allowed>>2)&1;
+  }
+  int nEval[3]={nE1,nM1,nE2};
+  for(int m=0;m<3;m++){
+    if(nEval[m]==0){continue;}
+    if(m==0){thePSF->GetE1(nEval[m],Eg[m],Ei,PSF);}
+    else if(m==1){thePSF->GetM1(nEval[m],Eg[m],Ei,PSF);}
+    else{thePSF->GetE2(nEval[m],Eg[m],Ei,PSF);}
+    for(int k=0;k<nEval[m];k++){
+      PSFValues[3*Index[m][k]+m]=PSF[k];
+    }
+  }
+}
+
+
+//GammaRho of the transition from i_level to j_level (if the levels overlap, Allowed=-1, returns -1)
+//Allowed and PSFValues come from ComputeTransitionsPSF
+//GammaRhoMult[0,1,2] are the partial sums after adding the E1, M1 and E2 contributions (-1 if not allowed)
+//The Porter-Thomas fluctuations are sampled with aRandom2, in the same order for each transition.
+double NuDEXStatisticalNucleus::ComputeTransitionIntensity(int i_level,int j_level,int Allowed,const double* PSFValues,NuDEXRandom* aRandom2,double* GammaRhoMult){
+
+  GammaRhoMult[0]=-1; GammaRhoMult[1]=-1; GammaRhoMult[2]=-1;
+  if(Allowed<=0){
+    return Allowed; //-1 if the levels overlap, 0 if there are no allowed multipolarities
+  }
+  double Eg=theLevels[i_level].Energy-theLevels[j_level].Energy;
+  bool E1allowed=(Allowed&1),M1allowed=(Allowed&2),E2allowed=(Allowed&4);
+
+  double GammaRho=0,Sumrand2;
+  int RealNTransitions=theLevels[i_level].NLevels*theLevels[j_level].NLevels;
+
+  if(E1allowed){
+    Sumrand2=SampleSumOfWidths(RealNTransitions,aRandom2);
+    GammaRho+=Sumrand2*Eg*Eg*Eg*PSFValues[0];
+    GammaRhoMult[0]=GammaRho;
+  }
+  if(M1allowed){
+    Sumrand2=SampleSumOfWidths(RealNTransitions,aRandom2);
+    GammaRho+=Sumrand2*Eg*Eg*Eg*PSFValues[1];
+    GammaRhoMult[1]=GammaRho;
+  }
+  if(E2allowed){
+    Sumrand2=SampleSumOfWidths(RealNTransitions,aRandom2);
+    GammaRho+=Sumrand2*Eg*Eg*Eg*Eg*Eg*PSFValues[2];
+    GammaRhoMult[2]=GammaRho;
+  }
+
+  return GammaRho;
+}
+
+//Sum of the (relative) widths of the RealNTransitions transitions between two bands of levels, for one multipolarity:
+//SampleGammaWidths=0: no fluctuations, the sum is RealNTransitions
+//SampleGammaWidths=1: Porter-Thomas fluctuations, sum of RealNTransitions squared Gaussians (Gaussian approximation above MaxNSamplesForChi2)
+//SampleGammaWidths=2: Porter-Thomas fluctuations, the sum sampled directly from a chi-squared distribution with RealNTransitions degrees of freedom
+double NuDEXStatisticalNucleus::SampleSumOfWidths(int RealNTransitions,NuDEXRandom* aRandom2){
+
+  double Sumrand2=RealNTransitions;
+  double rand;
+  double MaxNSamplesForChi2=1000;
+  if(SampleGammaWidths==1){ //Porter-Thomas fluctuations
+    Sumrand2=0;
+    if(RealNTransitions>MaxNSamplesForChi2){
+      Sumrand2=RealNTransitions*aRandom2->Gaus(1,sqrt(2./RealNTransitions));
+    }
+    else{
+      for(int ntr=0;ntr<RealNTransitions;ntr++){
+	rand=aRandom2->Gaus(0,1);
+	Sumrand2+=rand*rand;
+      }
+    }
+  }
+  else if(SampleGammaWidths==2){ //Porter-Thomas fluctuations, O(1) for any RealNTransitions
+    Sumrand2=aRandom2->ChiSquare(RealNTransitions);
+  }
+  return Sumrand2;
+}
+
+//Multipolarity of the transition, if the sampled value (TotGR*randnumber) falls in it.
+//PreviousGammaRho is the sum of the GammaRho of the previous transitions. Returns -50 if not sampled.
+int SampleMultipolarity(double PreviousGammaRho,const double* GammaRhoMult,double SampledGammaRho){
+
+  int multipolarity=-50;
+  if(GammaRhoMult[0]>=0 && PreviousGammaRho+GammaRhoMult[0]>=SampledGammaRho){
+    multipolarity=1;
+  }
+  if(GammaRhoMult[1]>=0 && PreviousGammaRho+GammaRhoMult[1]>=SampledGammaRho){
+    multipolarity=-1;
+  }
+  if(GammaRhoMult[2]>=0 && PreviousGammaRho+GammaRhoMult[2]>=SampledGammaRho && multipolarity<-10){
+    multipolarity=2;
+  }
+  return multipolarity;
+}
+
+
 //retrieves the "lowest" allowed multipolarity:
 int NuDEXStatisticalNucleus::GetMultipolarity(Level* theInitialLevel,Level* theFinalLevel){
 
@@ -791,6 +1009,15 @@ int NuDEXStatisticalNucleus::GetClosestLevel(double Energy,int spinx2,bool parit
 
   //std::cout<<" XXX finding closest level of spin "<<spinx2/2.<<" and parity "<<parity<<" to "<<Energy<<" MeV"<<std::endl;
 
+  //With spin-parity classes, binary search in the levels of this class:
+  if(spinx2>=0 && NClasses>0){
+    if(spinx2>=NClassSpins){return -1;}
+    int c=(parity?1:0)*NClassSpins+spinx2;
+    int i=FindClosestEnergy(theClassEnergies[c].data(),(int)theClassEnergies[c].size(),Energy);
+    if(i<0){return -1;}
+    return theClassLevels[c][i];
+  }
+
   //------------------------------------------------------------------------------
   // We try to go closer to the solution, otherwise it takes too much time:
   int i_down=0,i_up=NLevels-1;
@@ -936,21 +1163,19 @@ void NuDEXStatisticalNucleus::CreateLevelScheme(){
 
   //The known levels have been read already
   NLevels=-1;
-  Level* theUnkonwnLevels=0;
+  std::vector<Level> theUnkonwnLevels;
   if(E_unk_min>=E_unk_max){//Then we know all the level scheme
     NUnknownLevels=0; //will be updated to 1 when creating the capture level
   }
   else{
     //===================================================================
     //Unknown levels:
-    int maxarraysize=EstimateNumberOfLevelsToFill()*1.1/2.+10000;
-    do{
-      maxarraysize*=2;
-      if(theUnkonwnLevels!=0){delete [] theUnkonwnLevels;}
-      //std::cout<<" Max array size of "<<maxarraysize<<std::endl;
-      theUnkonwnLevels=new Level[maxarraysize];
-      NUnknownLevels=GenerateAllUnknownLevels(theUnkonwnLevels,maxarraysize);
-    }while(NUnknownLevels<0);
+    if(LevelSchemeNThreads>0){
+      NUnknownLevels=GenerateAllUnknownLevelsInParallel(theUnkonwnLevels,LevelSchemeNThreads);
+    }
+    else{
+      NUnknownLevels=GenerateAllUnknownLevels(theUnkonwnLevels);
+    }
     //===================================================================
   }
 
@@ -965,7 +1190,6 @@ void NuDEXStatisticalNucleus::CreateLevelScheme(){
   for(int i=0;i<NUnknownLevels;i++){
     CopyLevel(&theUnkonwnLevels[i],&theLevels[NKnownLevels+i]);
   }
-  delete [] theUnkonwnLevels;
   //===================================================================
 
   //Final check:
@@ -978,7 +1202,7 @@ void NuDEXStatisticalNucleus::CreateLevelScheme(){
     }
   }
 
-  std::cout<<" NuDEX: Generated statistical nucleus for ZA="<<Z_Int*1000+A_Int<<" up to "<<theLevels[NLevels-1].Energy<<" MeV, with "<<NLevels<<" levels in total: "<<NKnownLevels<<" from the database and "<<NUnknownLevels<<" from statistical models, including bands (without bands --> "<<TotalNIndividualLevels<<" levels). "<<std::endl;
+  if(Verbosity>0){std::cout<<" NuDEX: Generated statistical nucleus for ZA="<<Z_Int*1000+A_Int<<" up to "<<theLevels[NLevels-1].Energy<<" MeV, with "<<NLevels<<" levels in total: "<<NKnownLevels<<" from the database and "<<NUnknownLevels<<" from statistical models, including bands (without bands --> "<<TotalNIndividualLevels<<" levels). "<<std::endl;}
   
 }
 
@@ -1015,7 +1239,7 @@ void NuDEXStatisticalNucleus::CreateThermalCaptureLevel(unsigned int seed){
   
 }
 
-int NuDEXStatisticalNucleus::GenerateLevelsInSmallRange(double Emin,double Emax,int spinx2,bool parity,Level* someLevels,int MaxNLevelsToFill){
+int NuDEXStatisticalNucleus::GenerateLevelsInSmallRange(double Emin,double Emax,int spinx2,bool parity,std::vector<Level>& someLevels,NuDEXRandom* aRandom1){
 
   //If A_Int even/odd --> spinx2 (spin_val*2) should be even/odd
   if(((A_Int+spinx2)%2)!=0){
@@ -1028,29 +1252,26 @@ int NuDEXStatisticalNucleus::GenerateLevelsInSmallRange(double Emin,double Emax,
   //Sample total number of levels: ????????
   int thisNLevels=0;
   if(meanNLevels>0){
-    thisNLevels=theRandom1->Poisson(meanNLevels);
-  }
-
-  if(thisNLevels>=MaxNLevelsToFill){
-    std::cout<<" Warning: not enough space to fill levels "<<std::endl;
-    return -1;
+    thisNLevels=aRandom1->Poisson(meanNLevels);
   }
 
   //Distribute the levels in the energy interval: ??????
+  Level aLevel;
   for(int i=0;i<thisNLevels;i++){
-    someLevels[i].Energy=theRandom1->Uniform(Emin,Emax);
-    someLevels[i].spinx2=spinx2;
-    someLevels[i].parity=parity;
-    someLevels[i].seed=0;
-    someLevels[i].KnownLevelID=-1;
-    someLevels[i].NLevels=1;
-    someLevels[i].Width=0;
+    aLevel.Energy=aRandom1->Uniform(Emin,Emax);
+    aLevel.spinx2=spinx2;
+    aLevel.parity=parity;
+    aLevel.seed=0;
+    aLevel.KnownLevelID=-1;
+    aLevel.NLevels=1;
+    aLevel.Width=0;
+    someLevels.push_back(aLevel);
   }
 
   return thisNLevels;
 }
 
-int NuDEXStatisticalNucleus::GenerateLevelsInBigRange(double Emin,double Emax,int spinx2,bool parity,Level* someLevels,int MaxNLevelsToFill){
+int NuDEXStatisticalNucleus::GenerateLevelsInBigRange(double Emin,double Emax,int spinx2,bool parity,std::vector<Level>& someLevels,NuDEXRandom* aRandom1){
 
   int TotalNLevels=0;
   int NIntervals=1000;
@@ -1071,16 +1292,12 @@ int NuDEXStatisticalNucleus::GenerateLevelsInBigRange(double Emin,double Emax,in
       double LevDen2=theLD->GetLevelDensity(meanene+1./LevDen1,spinx2/2.,parity);
       if(LevDen2/LevDen1<WignerRatioThreshold){ //then apply Wigner
 	//std::cout<<" Wigner way to generate levels abobe "<<emin<<", being E_unk_min = "<<E_unk_min<<std::endl;
-	int newExtraLevels=GenerateWignerLevels(emin,Emax,spinx2,parity,&(someLevels[TotalNLevels]),MaxNLevelsToFill-TotalNLevels);
-	if(newExtraLevels<0){return -1;}
-	TotalNLevels+=newExtraLevels;
+	TotalNLevels+=GenerateWignerLevels(emin,Emax,spinx2,parity,someLevels,aRandom1);
 	break;
       }
     }
     //then use Poisson:
-    int newExtraLevels=GenerateLevelsInSmallRange(emin,emax,spinx2,parity,&(someLevels[TotalNLevels]),MaxNLevelsToFill-TotalNLevels);
-    if(newExtraLevels<0){return -1;}
-    TotalNLevels+=newExtraLevels;
+    TotalNLevels+=GenerateLevelsInSmallRange(emin,emax,spinx2,parity,someLevels,aRandom1);
   }
 
   return TotalNLevels;
@@ -1088,7 +1305,7 @@ int NuDEXStatisticalNucleus::GenerateLevelsInBigRange(double Emin,double Emax,in
 
 
 //Wigner law: p(x)=pi/2*rho*x*exp(-pi/4*rho*rho*x*x), where x is the energy distance between two levels of the same spin and parity
-int NuDEXStatisticalNucleus::GenerateWignerLevels(double Emin,double Emax,int spinx2,bool parity,Level* someLevels,int MaxNLevelsToFill){
+int NuDEXStatisticalNucleus::GenerateWignerLevels(double Emin,double Emax,int spinx2,bool parity,std::vector<Level>& someLevels,NuDEXRandom* aRandom1){
 
   //If A_Int even/odd --> spinx2 (spin_val*2) should be even/odd
   if(((A_Int+spinx2)%2)!=0){
@@ -1097,26 +1314,23 @@ int NuDEXStatisticalNucleus::GenerateWignerLevels(double Emin,double Emax,int sp
 
   int TotalNLevels=0;
 
+  Level aLevel;
   double previousELevel=Emin,nextELevel;
   while(previousELevel<Emax){
     double LevDen=theLD->GetLevelDensity(previousELevel,spinx2/2.,parity); //levels/MeV
-    double arandgamma=theRandom1->Uniform();
+    double arandgamma=aRandom1->Uniform();
     double DeltaEMultipliedByLevDen=sqrt(-4./3.141592*log(1.-arandgamma));
     nextELevel=previousELevel+DeltaEMultipliedByLevDen/LevDen;
     if(nextELevel<Emax){
-      someLevels[TotalNLevels].Energy=nextELevel;
-      someLevels[TotalNLevels].spinx2=spinx2;
-      someLevels[TotalNLevels].parity=parity;
-      someLevels[TotalNLevels].seed=0;
-      someLevels[TotalNLevels].KnownLevelID=-1;
-      someLevels[TotalNLevels].NLevels=1;
-      someLevels[TotalNLevels].Width=0;
+      aLevel.Energy=nextELevel;
+      aLevel.spinx2=spinx2;
+      aLevel.parity=parity;
+      aLevel.seed=0;
+      aLevel.KnownLevelID=-1;
+      aLevel.NLevels=1;
+      aLevel.Width=0;
+      someLevels.push_back(aLevel);
       TotalNLevels++;
-      if(TotalNLevels>=MaxNLevelsToFill){
-	std::cout<<" Warning: not enough space to fill levels "<<std::endl;
-	//NuDEXException(__FILE__,std::to_string(__LINE__).c_str(),"##### Error in NuDEX #####");
-	return -1;
-      }
     }
     previousELevel=nextELevel;
   }
@@ -1127,7 +1341,7 @@ int NuDEXStatisticalNucleus::GenerateWignerLevels(double Emin,double Emax,int sp
 
 
 //We genereate the levels directly in bands, not individually:
-int NuDEXStatisticalNucleus::GenerateBandLevels(int bandmin,int bandmax,int spinx2,bool parity,Level* someLevels,int MaxNLevelsToFill){
+int NuDEXStatisticalNucleus::GenerateBandLevels(int bandmin,int bandmax,int spinx2,bool parity,std::vector<Level>& someLevels,NuDEXRandom* aRandom1){
 
   //If A_Int even/odd --> spinx2 (spin_val*2) should be even/odd
   if(((A_Int+spinx2)%2)!=0){
@@ -1142,28 +1356,25 @@ int NuDEXStatisticalNucleus::GenerateBandLevels(int bandmin,int bandmax,int spin
     NuDEXException(__FILE__,std::to_string(__LINE__).c_str(),"##### Error in NuDEX #####");
   }
 
+  Level aLevel;
   for(int i=bandmin;i<=bandmax;i++){
     double emin=Emin+(Emax-Emin)*i/(double)NBands;
     double emax=Emin+(Emax-Emin)*(i+1.)/(double)NBands;
     double AverageNumberOfLevels=theLD->Integrate(emin,emax,spinx2/2.,parity);
     int NumberOfLevelsInThisBand=0;
     if(AverageNumberOfLevels>0){
-      NumberOfLevelsInThisBand=theRandom1->Poisson(AverageNumberOfLevels);
+      NumberOfLevelsInThisBand=aRandom1->Poisson(AverageNumberOfLevels);
     }
     if(NumberOfLevelsInThisBand>0){
-      someLevels[TotalNLevels].Energy=(emax+emin)/2.;
-      someLevels[TotalNLevels].spinx2=spinx2;
-      someLevels[TotalNLevels].parity=parity;
-      someLevels[TotalNLevels].seed=0;
-      someLevels[TotalNLevels].KnownLevelID=-1;
-      someLevels[TotalNLevels].NLevels=NumberOfLevelsInThisBand;
-      someLevels[TotalNLevels].Width=emax-emin;
+      aLevel.Energy=(emax+emin)/2.;
+      aLevel.spinx2=spinx2;
+      aLevel.parity=parity;
+      aLevel.seed=0;
+      aLevel.KnownLevelID=-1;
+      aLevel.NLevels=NumberOfLevelsInThisBand;
+      aLevel.Width=emax-emin;
+      someLevels.push_back(aLevel);
       TotalNLevels++;
-      if(TotalNLevels>=MaxNLevelsToFill){
-	std::cout<<" Warning: not enough space to fill levels "<<std::endl;
-	//NuDEXException(__FILE__,std::to_string(__LINE__).c_str(),"##### Error in NuDEX #####");
-	return -1;
-      }
     }
   }
 
@@ -1172,163 +1383,199 @@ int NuDEXStatisticalNucleus::GenerateBandLevels(int bandmin,int bandmax,int spin
 
 
 
-int NuDEXStatisticalNucleus::GenerateAllUnknownLevels(Level* someLevels,int MaxNLevelsToFill){
+int NuDEXStatisticalNucleus::GenerateAllUnknownLevels(std::vector<Level>& someLevels){
 
-  int TotalNLevels=0,NLev;
   if(E_unk_min>=E_unk_max){return 0;}
 
   for(int spinx2=0;spinx2<=maxspinx2;spinx2++){
     for(int ipar=0;ipar<2;ipar++){
       //If A_Int even/odd --> spinx2 (spin_val*2) should be even/odd
       if(((A_Int+spinx2)%2)==0){
-	//----------------------------------------------------------------------------------------------------------------------
 	bool parity=true;
 	if(ipar==1){parity=false;}
+	GenerateUnknownLevels(spinx2,parity,someLevels,theRandom1);
+      }
+    }
+  }
+
+
+  //Order levels by energy (stable, so levels with the same energy keep the order in which they have been generated):
+  std::stable_sort(someLevels.begin(),someLevels.end(),LevelEnergyLess);
 
-	//We create random levels between E_unk_min and E_unk_max
-	//We will create the levels one by one at low energies and directly in bands at higher energies
-	//The limit between the two ranges will be given by E_lim_onebyone
-	double Emin=E_unk_min;
-	double Emax=E_unk_max;
-	double E_lim_onebyone=2.*E_unk_max;
-	int i_Band_E_lim_onebyone=NBands+1; // band corresponding to E_lim_onebyone
+  return (int)someLevels.size();
+}
+
+int NuDEXStatisticalNucleus::GenerateUnknownLevels(int spinx2,bool parity,std::vector<Level>& someLevels,NuDEXRandom* aRandom1){
+
+  int FirstLevel=(int)someLevels.size();
+
+  //We create random levels between E_unk_min and E_unk_max
+  //We will create the levels one by one at low energies and directly in bands at higher energies
+  //The limit between the two ranges will be given by E_lim_onebyone
+  double Emin=E_unk_min;
+  double Emax=E_unk_max;
+  double E_lim_onebyone=2.*E_unk_max;
+  int i_Band_E_lim_onebyone=NBands+1; // band corresponding to E_lim_onebyone
 
-	//----------------------------------------------------
-	//Calculate E_lim_onebyone:
+  //----------------------------------------------------
+  //Calculate E_lim_onebyone:
 #ifndef GENERATEEXPLICITLYALLLEVELSCHEME
-	if(NBands>0){
-	  if(MinLevelsPerBand<=0){ // All the level scheme in bands
-	    E_lim_onebyone=0;
-	    i_Band_E_lim_onebyone=0;
-	  }
-	  else{
-	    double bandwidth=(Emax_bands-Emin_bands)/NBands;
-	    double rho_lim_onebyone=3.*(MinLevelsPerBand+10.)/bandwidth; // above this energy we start the creation of bands without sampling the levels one by one
-	    E_lim_onebyone=theLD->EstimateInverse(rho_lim_onebyone,spinx2/2.,parity);
-	  }
-	}
-	if(E_unk_max-Emax_bands>0.001){ //then E_unk_max>Emax_bands and we generate all the levels explicitly
-	  E_lim_onebyone=2.*E_unk_max;
-	  i_Band_E_lim_onebyone=NBands+1;
-	}
+  if(NBands>0){
+    if(MinLevelsPerBand<=0){ // All the level scheme in bands
+      E_lim_onebyone=0;
+      i_Band_E_lim_onebyone=0;
+    }
+    else{
+      double bandwidth=(Emax_bands-Emin_bands)/NBands;
+      double rho_lim_onebyone=3.*(MinLevelsPerBand+10.)/bandwidth; // above this energy we start the creation of bands without sampling the levels one by one
+      E_lim_onebyone=theLD->EstimateInverse(rho_lim_onebyone,spinx2/2.,parity);
+    }
+  }
+  if(E_unk_max-Emax_bands>0.001){ //then E_unk_max>Emax_bands and we generate all the levels explicitly
+    E_lim_onebyone=2.*E_unk_max;
+    i_Band_E_lim_onebyone=NBands+1;
+  }
 
-	// E_lim_onebyone should be in a limit between two bands:
-	if(E_lim_onebyone>E_unk_min && E_lim_onebyone<E_unk_max){
-	  for(int i=0;i<NBands;i++){
-	    double elow_band=Emin_bands+(Emax_bands-Emin_bands)*i/(double)NBands;
-	    if(elow_band>E_lim_onebyone){
-	      E_lim_onebyone=elow_band;
-	      i_Band_E_lim_onebyone=i;
-	      break;
-	    }
-	  }
-	}
+  // E_lim_onebyone should be in a limit between two bands:
+  if(E_lim_onebyone>E_unk_min && E_lim_onebyone<E_unk_max){
+    for(int i=0;i<NBands;i++){
+      double elow_band=Emin_bands+(Emax_bands-Emin_bands)*i/(double)NBands;
+      if(elow_band>E_lim_onebyone){
+	E_lim_onebyone=elow_band;
+	i_Band_E_lim_onebyone=i;
+	break;
+      }
+    }
+  }
 #endif
-	//----------------------------------------------------
+  //----------------------------------------------------
 
 
-	if(E_lim_onebyone>E_unk_min){ //then we have to create some of the levels one by one
-	  if(E_lim_onebyone<Emax){
-	    Emax=E_lim_onebyone;
-	  }
-	  NLev=GenerateLevelsInBigRange(Emin,Emax,spinx2,parity,&(someLevels[TotalNLevels]),MaxNLevelsToFill-TotalNLevels);
-	  if(NLev<0){return -1;}
-	  if(NBands>0 && NLev>0){
-	    NLev=CreateBandsFromLevels(NLev,&(someLevels[TotalNLevels]),spinx2,parity);
-	  }
-	  TotalNLevels+=NLev;
-	}
+  if(E_lim_onebyone>E_unk_min){ //then we have to create some of the levels one by one
+    if(E_lim_onebyone<Emax){
+      Emax=E_lim_onebyone;
+    }
+    int NLev=GenerateLevelsInBigRange(Emin,Emax,spinx2,parity,someLevels,aRandom1);
+    if(NBands>0 && NLev>0){
+      CreateBandsFromLevels(someLevels,FirstLevel,spinx2,parity);
+    }
+  }
 
-	if(i_Band_E_lim_onebyone<NBands){ //then we have to create some of the levels directly with bands
-	  NLev=GenerateBandLevels(i_Band_E_lim_onebyone,NBands-1,spinx2,parity,&(someLevels[TotalNLevels]),MaxNLevelsToFill-TotalNLevels);
-	  if(NLev<0){return -1;}
-	  TotalNLevels+=NLev;
-	}
-	//----------------------------------------------------------------------------------------------------------------------
+  if(i_Band_E_lim_onebyone<NBands){ //then we have to create some of the levels directly with bands
+    GenerateBandLevels(i_Band_E_lim_onebyone,NBands-1,spinx2,parity,someLevels,aRandom1);
+  }
+
+  return (int)someLevels.size()-FirstLevel;
+}
+
+//Each spin and parity has its own random numbers, so they can be generated in any order and by any thread.
+//The levels of each spin and parity are put together in the same order as in GenerateAllUnknownLevels, and then sorted.
+int NuDEXStatisticalNucleus::GenerateAllUnknownLevelsInParallel(std::vector<Level>& someLevels,int nThreads){
+
+  if(E_unk_min>=E_unk_max){return 0;}
+  if(nThreads<1){nThreads=1;}
+
+  int NBlocks=2*(maxspinx2+1); //spinx2*2+ipar
+  std::vector<std::vector<Level> > blockLevels(NBlocks);
+
+  std::atomic<int> nextBlock(0);
+  std::vector<std::thread> theThreads;
+  for(int i=0;i<nThreads;i++){
+    theThreads.push_back(std::thread([this,&nextBlock,&blockLevels,NBlocks](){
+      int iblock;
+      while((iblock=nextBlock++)<NBlocks){
+	int spinx2=iblock/2;
+	bool parity=true;
+	if(iblock%2==1){parity=false;}
+	if(((A_Int+spinx2)%2)!=0){continue;}
+	NuDEXRandom aRandom1(GetLevelSchemeSubstreamSeed(spinx2,parity));
+	GenerateUnknownLevels(spinx2,parity,blockLevels[iblock],&aRandom1);
       }
-    }
+    }));
+  }
+  for(int i=0;i<nThreads;i++){
+    theThreads[i].join();
   }
 
+  size_t TotalNLevels=someLevels.size();
+  for(int i=0;i<NBlocks;i++){TotalNLevels+=blockLevels[i].size();}
+  someLevels.reserve(TotalNLevels);
+  for(int i=0;i<NBlocks;i++){
+    someLevels.insert(someLevels.end(),blockLevels[i].begin(),blockLevels[i].end());
+    std::vector<Level>().swap(blockLevels[i]);
+  }
 
   //Order levels by energy:
-  qsort(someLevels,TotalNLevels,sizeof(Level), ComparisonLevels);
+  std::stable_sort(someLevels.begin(),someLevels.end(),LevelEnergyLess);
 
-  return TotalNLevels;
+  return (int)someLevels.size();
+}
+
+unsigned int NuDEXStatisticalNucleus::GetLevelSchemeSubstreamSeed(int spinx2,bool parity){
+
+  std::ostringstream name;
+  name<<"LEVELSCHEME SEED1 "<<seed1<<" SPINX2 "<<spinx2<<" PARITY "<<parity;
+  return (unsigned int)(NuDEXHash(name.str())%4294967295ULL)+1; //never 0
 }
 
 //Junta varios niveles en uno solo, creando distintas bandas, para un spin y paridad determinados.
-//Entiende que no hay otros spines ni paridades. Si hay otros, peta.
-//Devuelve el numero de niveles actualizado.
-int NuDEXStatisticalNucleus::CreateBandsFromLevels(int thisNLevels,Level* someLevels,int spinx2,bool parity){
+//Entiende que no hay otros spines ni paridades (desde FirstLevel). Si hay otros, peta.
+//Devuelve el numero de niveles actualizado (desde FirstLevel).
+int NuDEXStatisticalNucleus::CreateBandsFromLevels(std::vector<Level>& someLevels,int FirstLevel,int spinx2,bool parity){
 
   double Emin=Emin_bands;
   double Emax=Emax_bands;
-
-  Level* theBandLevels=new Level[NBands]; 
-  for(int i=0;i<NBands;i++){
-    double emin=Emin+(Emax-Emin)*i/(double)NBands;
-    double emax=Emin+(Emax-Emin)*(i+1.)/(double)NBands;
-    theBandLevels[i].Energy=(emax+emin)/2.;
-    theBandLevels[i].spinx2=spinx2;
-    theBandLevels[i].parity=parity;
-    theBandLevels[i].seed=0;
-    theBandLevels[i].KnownLevelID=-1;
-    theBandLevels[i].NLevels=0;
-    theBandLevels[i].Width=emax-emin;
-    int NLevelsInThisBand=0;
-    for(int j=0;j<thisNLevels;j++){
-      if(someLevels[j].spinx2!=spinx2 || someLevels[j].parity!=parity){
-	NuDEXException(__FILE__,std::to_string(__LINE__).c_str(),"##### Error in NuDEX #####");
-      }
-      if(someLevels[j].Energy>=emin && someLevels[j].Energy<=emax){
-	NLevelsInThisBand+=someLevels[j].NLevels;
-      }
+  int thisNLevels=(int)someLevels.size()-FirstLevel;
+
+  //Band of each level (the first one with emin<=E<=emax), in a single loop over the levels:
+  std::vector<int> theBand(thisNLevels,-1);
+  std::vector<int> NLevelsInBand(NBands,0);
+  for(int j=0;j<thisNLevels;j++){
+    Level* aLevel=&someLevels[FirstLevel+j];
+    if(aLevel->spinx2!=spinx2 || aLevel->parity!=parity){
+      NuDEXException(__FILE__,std::to_string(__LINE__).c_str(),"##### Error in NuDEX #####");
     }
-    if(NLevelsInThisBand>=MinLevelsPerBand){
-      for(int j=0;j<thisNLevels;j++){
-	if(someLevels[j].Energy>=emin && someLevels[j].Energy<=emax){
-	  theBandLevels[i].NLevels+=someLevels[j].NLevels;
-	  someLevels[j].Energy=-1;
-	}
-      }
+    double ene=aLevel->Energy;
+    int i=(int)((ene-Emin)/(Emax-Emin)*NBands);
+    if(i<0){i=0;}
+    if(i>NBands-1){i=NBands-1;}
+    while(i>0 && ene<=Emin+(Emax-Emin)*i/(double)NBands){i--;}
+    while(i<NBands-1 && ene>Emin+(Emax-Emin)*(i+1.)/(double)NBands){i++;}
+    if(ene>=Emin+(Emax-Emin)*i/(double)NBands && ene<=Emin+(Emax-Emin)*(i+1.)/(double)NBands){
+      theBand[j]=i;
+      NLevelsInBand[i]+=aLevel->NLevels;
     }
   }
 
-  int FinalNBands=NBands;
-
-  //Eliminate bands with cero levels:
-  for(int i=0;i<FinalNBands;i++){
-    if(theBandLevels[i].NLevels==0){
-      if(i!=FinalNBands-1){
-	CopyLevel(&theBandLevels[FinalNBands-1],&theBandLevels[i]);
-      }
-      i--;
-      FinalNBands--;
-    }
-  }
-
-  //Replace levels with bands and update number of levels:
-  int NbandsCopied=0;
-  for(int i=0;i<thisNLevels;i++){
-    if(someLevels[i].Energy<0){ 
-      if(NbandsCopied<FinalNBands){ //this level is replaced by a band
-	CopyLevel(&theBandLevels[NbandsCopied],&someLevels[i]);
-	NbandsCopied++;
-      }
-      else{ //there is no band to replace. Copy the last level here
-	CopyLevel(&someLevels[thisNLevels-1],&someLevels[i]);
-	i--;
-	thisNLevels--;
-      }
+  //Levels which are not inside a band:
+  int NLev=0;
+  for(int j=0;j<thisNLevels;j++){
+    if(theBand[j]<0 || NLevelsInBand[theBand[j]]<MinLevelsPerBand){
+      if(NLev!=j){CopyLevel(&someLevels[FirstLevel+j],&someLevels[FirstLevel+NLev]);}
+      NLev++;
     }
   }
+  someLevels.resize(FirstLevel+NLev);
 
-  //Simple check:
-  if(NbandsCopied!=FinalNBands){
-    NuDEXException(__FILE__,std::to_string(__LINE__).c_str(),"##### Error in NuDEX #####");
-  }
-  delete [] theBandLevels;
-  return thisNLevels;
+  //Bands (without bands with cero levels):
+  Level aBand;
+  for(int i=0;i<NBands;i++){
+    if(NLevelsInBand[i]>0 && NLevelsInBand[i]>=MinLevelsPerBand){
+      double emin=Emin+(Emax-Emin)*i/(double)NBands;
+      double emax=Emin+(Emax-Emin)*(i+1.)/(double)NBands;
+      aBand.Energy=(emax+emin)/2.;
+      aBand.spinx2=spinx2;
+      aBand.parity=parity;
+      aBand.seed=0;
+      aBand.KnownLevelID=-1;
+      aBand.NLevels=NLevelsInBand[i];
+      aBand.Width=emax-emin;
+      someLevels.push_back(aBand);
+      NLev++;
+    }
+  }
+
+  return NLev;
 }
 
 
@@ -1342,6 +1589,20 @@ int NuDEXStatisticalNucleus::InsertHighEnergyKnownLevels(){
     HasBeenInserted[i]=false;
   }
 
+  //Unknown levels of each spin and parity (sorted by energy), to find the closest one to each known level with a binary search:
+  int NSpins=0;
+  for(int j=NKnownLevels;j<NLevels-1;j++){
+    if(theLevels[j].spinx2+1>NSpins){NSpins=theLevels[j].spinx2+1;}
+  }
+  std::vector<std::vector<int> > classLevelIDs(2*NSpins);
+  std::vector<std::vector<double> > classEnergies(2*NSpins);
+  for(int j=NKnownLevels;j<NLevels-1;j++){
+    if(theLevels[j].spinx2<0){continue;}
+    int c=(theLevels[j].parity?1:0)*NSpins+theLevels[j].spinx2;
+    classLevelIDs[c].push_back(j);
+    classEnergies[c].push_back(theLevels[j].Energy); //these don't change when a level is replaced by a known level
+  }
+
   for(int kk=0;kk<2;kk++){ //loop two times: first levels with NGammas>0, then the rest ...
     for(int k=1;k<5;k++){ //loop in the distance between levels condition
       double MaxEnergyDistance=0.1*k; //The level to replace should be close to it, so first we try with X MeV and then 2X MeV ...
@@ -1353,16 +1614,32 @@ int NuDEXStatisticalNucleus::InsertHighEnergyKnownLevels(){
 	  int thespinx2=theKnownLevels[i].spinx2;
 	  bool thepar=theKnownLevels[i].parity;
 	  int unknownLevelID=-1;
-	  for(int j=NKnownLevels;j<NLevels-1;j++){ // loop in the unknown levels
-	    if(theLevels[j].spinx2==thespinx2 && theLevels[j].parity==thepar){
-	      EnergyDistance=std::fabs(theKnownLevels[i].Energy-theLevels[j].Energy);
-	      if((EnergyDistance<MinEnergyDistance || MinEnergyDistance<0) && EnergyDistance<MaxEnergyDistance && theLevels[j].KnownLevelID<0){
+	  if(thespinx2>=0 && thespinx2<NSpins){
+	    int c=(thepar?1:0)*NSpins+thespinx2;
+	    const std::vector<int>& ids=classLevelIDs[c];
+	    const std::vector<double>& ene=classEnergies[c];
+	    int n=(int)ene.size();
+	    int i_up=(int)(std::upper_bound(ene.begin(),ene.end(),theKnownLevels[i].Energy)-ene.begin());
+	    int i_down=i_up-1;
+	    //Closest levels below and above which have not been replaced yet by a known level (the first one if several have the same energy):
+	    while(i_down>=0 && theLevels[ids[i_down]].KnownLevelID>=0){i_down--;}
+	    while(i_up<n && theLevels[ids[i_up]].KnownLevelID>=0){i_up++;}
+	    for(int j=i_down-1;j>=0 && ene[j]==ene[i_down];j--){
+	      if(theLevels[ids[j]].KnownLevelID<0){i_down=j;}
+	    }
+	    if(i_down>=0){
+	      EnergyDistance=std::fabs(theKnownLevels[i].Energy-ene[i_down]);
+	      if(EnergyDistance<MaxEnergyDistance){
+		MinEnergyDistance=EnergyDistance;
+		unknownLevelID=ids[i_down];
+	      }
+	    }
+	    if(i_up<n){
+	      EnergyDistance=std::fabs(theKnownLevels[i].Energy-ene[i_up]);
+	      if((EnergyDistance<MinEnergyDistance || MinEnergyDistance<0) && EnergyDistance<MaxEnergyDistance){
 		MinEnergyDistance=EnergyDistance;
-		unknownLevelID=j;
+		unknownLevelID=ids[i_up];
 	      }
-	      //else if(EnergyDistance>MinEnergyDistance && MinEnergyDistance>0){
-	      //break;
-	      //}
 	    }
 	  }
 	  if(unknownLevelID>0 && theLevels[unknownLevelID].NLevels==1){ //then we replace the stat-level by the known level:
@@ -1379,7 +1656,9 @@ int NuDEXStatisticalNucleus::InsertHighEnergyKnownLevels(){
   delete [] HasBeenInserted;
 
   //We re-order the levels:
-  qsort(theLevels,NLevels,sizeof(Level), ComparisonLevels);
+  std::stable_sort(theLevels,theLevels+NLevels,LevelEnergyLess);
+  std::vector<double> levelEnergies(NLevels);
+  for(int i=0;i<NLevels;i++){levelEnergies[i]=theLevels[i].Energy;}
 
 
 
@@ -1393,16 +1672,8 @@ int NuDEXStatisticalNucleus::InsertHighEnergyKnownLevels(){
 	if(theKnownLevels[knownID].FinalLevelID[j]>=NKnownLevels){//this cannot be
 	  //-----------------------------------------------------
 	  int i_finalknownlevel=theKnownLevels[knownID].FinalLevelID[j];
-	  double MinEnergyDistance=-1;
-	  int i_statlevel=-1;
-	  for(int k=0;k<i;k++){
-	    double EnergyDistance=std::fabs(theKnownLevels[i_finalknownlevel].Energy-theLevels[k].Energy);
-	    if(EnergyDistance<MinEnergyDistance || MinEnergyDistance<0){
-	      MinEnergyDistance=EnergyDistance;
-	      i_statlevel=k;
-	    }
-	  }
-	  if(MinEnergyDistance<0){
+	  int i_statlevel=FindClosestEnergy(levelEnergies.data(),i,theKnownLevels[i_finalknownlevel].Energy); //closest level below level i
+	  if(i_statlevel<0){
 	    NuDEXException(__FILE__,std::to_string(__LINE__).c_str(),"##### Error in NuDEX #####");
 	  }
 	  //std::cout<<" Final known level "<<i_finalknownlevel<<" with E = "<<theKnownLevels[i_finalknownlevel].Energy<<" has been replaced by final level "<<i_statlevel<<" with E = "<<theLevels[i_statlevel].Energy<<std::endl;
@@ -1429,68 +1700,131 @@ int NuDEXStatisticalNucleus::InsertHighEnergyKnownLevels(){
 
 
 
-int NuDEXStatisticalNucleus::EstimateNumberOfLevelsToFill(){
-
-  if(E_unk_min>=E_unk_max){return 0;}
+//Copy of theLevels as a structure of arrays. Has to be called each time theLevels changes:
+void NuDEXStatisticalNucleus::FillLevelsSoA(){
 
-#ifndef GENERATEEXPLICITLYALLLEVELSCHEME
-  if(BandWidth>0){
-    return maxspinx2*NBands*MinLevelsPerBand;
+  DeleteLevelsSoA();
+  if(NLevels<=0){return;}
+  theLevelsSoA.Energy=new double[NLevels];
+  theLevelsSoA.LowEdge=new double[NLevels];
+  theLevelsSoA.HighEdge=new double[NLevels];
+  theLevelsSoA.spinx2=new int[NLevels];
+  theLevelsSoA.parity=new int[NLevels];
+  for(int i=0;i<NLevels;i++){
+    UpdateLevelsSoA(i);
   }
-#endif
+}
 
-  double Emin=E_unk_min;
-  double Emax=E_unk_max;
-  double TotalNLevels=0;
-  double TotalNLevelsInsideBands=0;
-  double MaxNLevelsWithSameSpinAndParity=0;
-  double emin,emax,meanEnergy,LevDen,meanNLevels;
-  int NIntervals=1000;
-  for(int spinx2=0;spinx2<=maxspinx2;spinx2++){
-    double TotalNLevesWithSameSpin=0;
-    for(int i=0;i<NIntervals;i++){
-      emin=Emin+(Emax-Emin)*i/(double)NIntervals;
-      emax=Emin+(Emax-Emin)*(i+1)/(double)NIntervals;
-      meanEnergy=(emax+emin)/2.;
-
-      //Positive parity:
-      LevDen=theLD->GetLevelDensity(meanEnergy,spinx2/2.,true); //levels/MeV
-      meanNLevels=LevDen*(emax-emin); 
-      TotalNLevels+=meanNLevels;
-      TotalNLevesWithSameSpin+=meanNLevels;
-      if(NBands>0 && meanEnergy>Emin_bands && meanEnergy<Emax_bands){ //if there are bands and these levels go inside:
-	TotalNLevelsInsideBands+=meanNLevels;
-      }
+void NuDEXStatisticalNucleus::UpdateLevelsSoA(int i_level){
 
+  theLevelsSoA.Energy[i_level]=theLevels[i_level].Energy;
+  theLevelsSoA.LowEdge[i_level]=theLevels[i_level].Energy-theLevels[i_level].Width;
+  theLevelsSoA.HighEdge[i_level]=theLevels[i_level].Energy+theLevels[i_level].Width;
+  theLevelsSoA.spinx2[i_level]=theLevels[i_level].spinx2;
+  theLevelsSoA.parity[i_level]=(theLevels[i_level].parity?1:0);
+}
 
-      //Negative parity:
-      LevDen=theLD->GetLevelDensity(meanEnergy,spinx2/2.,false); //levels/MeV
-      meanNLevels=LevDen*(emax-emin);
-      TotalNLevels+=meanNLevels;
-      TotalNLevesWithSameSpin+=meanNLevels;
-      if(NBands>0 && meanEnergy>Emin_bands && meanEnergy<Emax_bands){ //if there are bands and these levels go inside:
-	TotalNLevelsInsideBands+=meanNLevels;
-      }
+void NuDEXStatisticalNucleus::DeleteLevelsSoA(){
+
+  if(theLevelsSoA.Energy!=0){delete [] theLevelsSoA.Energy;}
+  if(theLevelsSoA.LowEdge!=0){delete [] theLevelsSoA.LowEdge;}
+  if(theLevelsSoA.HighEdge!=0){delete [] theLevelsSoA.HighEdge;}
+  if(theLevelsSoA.spinx2!=0){delete [] theLevelsSoA.spinx2;}
+  if(theLevelsSoA.parity!=0){delete [] theLevelsSoA.parity;}
+  theLevelsSoA.Energy=0; theLevelsSoA.LowEdge=0; theLevelsSoA.HighEdge=0; theLevelsSoA.spinx2=0; theLevelsSoA.parity=0;
+}
 
+//Groups the levels by spin-parity class, and computes which classes can be reached from each one (E1, M1 or E2).
+//Then ComputeDecayIntensities only visits the levels of the reachable classes.
+void NuDEXStatisticalNucleus::CreateSpinParityClasses(){
+
+  DeleteSpinParityClasses();
+  int maxspinx2found=0;
+  for(int i=0;i<NLevels;i++){
+    if(theLevels[i].spinx2<0){return;} //no classes, all the levels will be visited
+    if(theLevels[i].spinx2>maxspinx2found){maxspinx2found=theLevels[i].spinx2;}
+  }
+  if(NLevels<=0){return;}
+  NClassSpins=maxspinx2found+1;
+  NClasses=2*NClassSpins;
+
+  theClassMultipolarities=new int[NClasses*NClasses];
+  for(int c1=0;c1<NClasses;c1++){
+    int spinx2_1=c1%NClassSpins,parity_1=c1/NClassSpins;
+    for(int c2=0;c2<NClasses;c2++){
+      int spinx2_2=c2%NClassSpins,parity_2=c2/NClassSpins;
+      //Same selection rules as in ComputeAllowedMultipolarities:
+      int d=std::abs(spinx2_1-spinx2_2),sum=spinx2_1+spinx2_2;
+      bool same=(parity_1==parity_2);
+      bool L1=(d<4 && sum>1),L2=(d<6 && sum>3);
+      theClassMultipolarities[c1*NClasses+c2]=((!same && L1)?1:0)+((same && L1)?2:0)+((same && L2)?4:0);
+    }
+  }
+
+  theLevelClass=new int[NLevels];
+  theClassLevels=new std::vector<int>[NClasses];
+  theClassEnergies=new std::vector<double>[NClasses];
+  theReachableLevels=new std::vector<int>[NClasses];
+  for(int i=0;i<NLevels;i++){
+    theLevelClass[i]=(theLevels[i].parity?1:0)*NClassSpins+theLevels[i].spinx2;
+    theClassLevels[theLevelClass[i]].push_back(i);
+    theClassEnergies[theLevelClass[i]].push_back(theLevels[i].Energy);
+  }
+  //Also for the empty classes, because the thermal capture level can be in one of them (see GenerateThermalCaptureLevelBR):
+  for(int c1=0;c1<NClasses;c1++){
+    for(int i=0;i<NLevels;i++){
+      if(theClassMultipolarities[c1*NClasses+theLevelClass[i]]>0){
+	theReachableLevels[c1].push_back(i);
+      }
     }
-    if(MaxNLevelsWithSameSpinAndParity<TotalNLevesWithSameSpin){MaxNLevelsWithSameSpinAndParity=TotalNLevesWithSameSpin;}
   }
+}
 
-  MaxNLevelsWithSameSpinAndParity/=2.;
+void NuDEXStatisticalNucleus::DeleteSpinParityClasses(){
 
-  if(TotalNLevelsInsideBands>0){
-    //then there are some levels inside bands and the amount of levels needed will be reduced:
-    double TotalNLevelsOutsideBands=TotalNLevels-TotalNLevelsInsideBands;
-    double MaxNLevelsNeededForBands=NBands*maxspinx2*MinLevelsPerBand;
-    TotalNLevels=MaxNLevelsWithSameSpinAndParity+TotalNLevelsOutsideBands+MaxNLevelsNeededForBands;
-  }
+  if(theLevelClass!=0){delete [] theLevelClass;}
+  if(theClassMultipolarities!=0){delete [] theClassMultipolarities;}
+  if(theClassLevels!=0){delete [] theClassLevels;}
+  if(theClassEnergies!=0){delete [] theClassEnergies;}
+  if(theReachableLevels!=0){delete [] theReachableLevels;}
+  theLevelClass=0; theClassMultipolarities=0; theClassLevels=0; theClassEnergies=0; theReachableLevels=0;
+  NClasses=0; NClassSpins=0;
+}
 
-  return (int)TotalNLevels;
+//Levels below i_level that can be reached from it with E1, M1 or E2 transitions (sorted).
+//Returns 0 if there are no spin-parity classes, and then all the levels below i_level have to be visited.
+const int* NuDEXStatisticalNucleus::GetReachableLevels(int i_level,int& nReachable){
+
+  nReachable=i_level;
+  if(NClasses==0){return 0;}
+  //The class is taken from theLevelsSoA, because theLevels[i_level] can be (temporarily) the thermal capture level:
+  int spinx2=theLevelsSoA.spinx2[i_level];
+  if(spinx2<0 || spinx2>=NClassSpins){return 0;}
+  const std::vector<int>& theList=theReachableLevels[theLevelsSoA.parity[i_level]*NClassSpins+spinx2];
+  nReachable=std::lower_bound(theList.begin(),theList.end(),i_level)-theList.begin();
+  if(nReachable==0){return 0;}
+  return &theList[0];
 }
 
 
 double NuDEXStatisticalNucleus::TakeTargetNucleiI0(const char* fname,int& check){
 
+  //From the binary copy of the file, if it is there:
+  std::shared_ptr<const NuDEXFileData> theFile=GetKnownLevelsFile(fname);
+  if(theFile){
+    const KnownNucleusRecord* nucleus=FindKnownNucleus(theFile->data,theFile->size,Z_Int,A_Int-1);
+    double spin=0,par=0;
+    check=-1;
+    if(nucleus!=0 && nucleus->NLevels>0){
+      const KnownLevelRecord* level=(const KnownLevelRecord*)(theFile->data+nucleus->offset);
+      spin=std::fabs(level->spin); // some spins are negative ???
+      par=level->parity;
+      check=0;
+    }
+    if(par<0){return -spin;}
+    return spin;
+  }
+
   std::ifstream in(fname);
   if(!in.good()){
     std::cout<<" ######## Error opening file "<<fname<<" ########"<<std::endl;
@@ -1519,59 +1853,178 @@ double NuDEXStatisticalNucleus::TakeTargetNucleiI0(const char* fname,int& check)
   in.get(buffer,6);   spin=std::fabs(atof(buffer)); // some spins are negative ???
   in.get(buffer,4);   par=atof(buffer); 
 
-  in.close();
+  in.close();
+
+  if(par<0){return -spin;}
+
+  return spin;
+}
+
+double NuDEXStatisticalNucleus::ReadKnownLevels(const char* fname){
+
+  //From the binary copy of the file, if it is there (it is held until the levels have been filled, even if the cache is emptied meanwhile):
+  std::shared_ptr<const NuDEXFileData> theFile=GetKnownLevelsFile(fname);
+  if(theFile){
+    const KnownNucleusRecord* nucleus=FindKnownNucleus(theFile->data,theFile->size,Z_Int,A_Int);
+    if(nucleus!=0){
+      const KnownLevelRecord* levels=(const KnownLevelRecord*)(theFile->data+nucleus->offset);
+      const KnownGammaRecord* gammas=(const KnownGammaRecord*)(levels+nucleus->NLevels);
+      const KnownDecayRecord* decays=(const KnownDecayRecord*)(gammas+nucleus->NGammas);
+      FillKnownLevels(nucleus->Sn,nucleus->NLevels,levels,gammas,decays,fname);
+    }
+    if(nucleus==0){return -1;}
+    return 0;
+  }
+
+  std::ifstream in(fname);
+  if(!in.good()){
+    std::cout<<" ######## Error opening file "<<fname<<" ########"<<std::endl;
+    NuDEXException(__FILE__,std::to_string(__LINE__).c_str(),"##### Error in NuDEX #####");
+  }
+
+  char buffer[1000];
+  int aZ,aA,nLevels=0;
+  double newSn=0;
+  while(in.get(buffer,6)){
+    in.get(buffer,6); aA=atoi(buffer);
+    in.get(buffer,6); aZ=atoi(buffer);
+    if(aZ==Z_Int && aA==A_Int){
+      in.get(buffer,6); nLevels=atoi(buffer);
+      in.get(buffer,16);
+      in.get(buffer,13); newSn=atof(buffer);
+      break;
+    }
+    in.ignore(10000,'\n');
+  }
+
+  if(!in.good()){
+    in.close(); return -1;
+  }
+
+  in.ignore(10000,'\n');
+
+  std::vector<KnownLevelRecord> levels;
+  std::vector<KnownGammaRecord> gammas;
+  std::vector<KnownDecayRecord> decays;
+  if(ReadKnownLevelsRecords(in,nLevels,levels,gammas,decays)<0){
+    std::cout<<" ######## Error reading file "<<fname<<" ########"<<std::endl;
+    std::cout<<" Level "<<levels.size()<<" cannot be read"<<std::endl;
+    NuDEXException(__FILE__,std::to_string(__LINE__).c_str(),"##### Error in NuDEX #####");
+  }
+  in.close();
+
+  FillKnownLevels(newSn,nLevels,levels.data(),gammas.data(),decays.data(),fname);
+
+  return 0;
+}
+
+
+int NuDEXStatisticalNucleus::ReadKnownLevelsRecords(std::istream& in,int NLevels,std::vector<KnownLevelRecord>& levels,std::vector<KnownGammaRecord>& gammas,std::vector<KnownDecayRecord>& decays){
+
+  char buffer[1000];
+  for(int i=0;i<NLevels;i++){
+    KnownLevelRecord level;
+    memset(&level,0,sizeof(level));
+    in.get(buffer,4);   level.id=atoi(buffer)-1;
+    in.get(buffer,2);
+    in.get(buffer,11);  level.Energy=atof(buffer);
+    in.get(buffer,2);
+    in.get(buffer,6);   level.spin=atof(buffer);
+    in.get(buffer,4);   level.parity=atof(buffer);
+    in.get(buffer,2);
+    in.get(buffer,11);  level.T12=atof(buffer);
+    in.get(buffer,4);   level.NGammas=atoi(buffer);
+
+    //decay modes:
+    in.get(buffer,27); //dummy
+    in.get(buffer,4);   level.Ndecays=atoi(buffer);
+    for(int j=0;j<level.Ndecays;j++){
+      KnownDecayRecord decay;
+      memset(&decay,0,sizeof(decay));
+      in.get(buffer,5);
+      in.get(buffer,11);
+      decay.decayFraction=atof(buffer);
+      in.get(buffer,2);
+      in.get(buffer,8);
+      strcpy(decay.decayMode,buffer);
+      decays.push_back(decay);
+    }
+
+    in.ignore(10000,'\n');
+
+    for(int j=0;j<level.NGammas;j++){
+      KnownGammaRecord gamma;
+      memset(&gamma,0,sizeof(gamma));
+      in.get(buffer,40);
+      in.get(buffer,5);   gamma.FinalLevelID=atoi(buffer)-1;
+      in.get(buffer,2);
+      in.get(buffer,11);  gamma.Eg=atof(buffer);
+      in.get(buffer,2);
+      in.get(buffer,11);  gamma.Pg=atof(buffer);
+      in.get(buffer,2);
+      in.get(buffer,11);  gamma.Pe=atof(buffer);
+      in.get(buffer,2);
+      in.get(buffer,11);  gamma.Icc=atof(buffer);
+      in.ignore(10000,'\n');
+      gammas.push_back(gamma);
+    }
+
+    if(!in.good()){
+      return -1;
+    }
+    levels.push_back(level);
+  }
+
+  return 0;
+}
+
 
-  if(par<0){return -spin;}
+const KnownNucleusRecord* NuDEXStatisticalNucleus::FindKnownNucleus(const char* data,size_t size,int Z,int A){
 
-  return spin;
-}
+  const NuDEXBinaryHeader* header=(const NuDEXBinaryHeader*)data;
+  if(sizeof(NuDEXBinaryHeader)+header->nEntries*sizeof(KnownNucleusRecord)>size){return 0;}
+  const KnownNucleusRecord* theIndex=(const KnownNucleusRecord*)(data+sizeof(NuDEXBinaryHeader));
+  const KnownNucleusRecord* it=std::lower_bound(theIndex,theIndex+header->nEntries,1000*Z+A,[](const KnownNucleusRecord& a,int ZA){return 1000*a.Z+a.A<ZA;});
+  if(it==theIndex+header->nEntries || it->Z!=Z || it->A!=A){return 0;}
+  if(it->NLevels<0 || it->NGammas<0 || it->NDecays<0 || it->offset<0){return 0;}
+  size_t end=it->offset+it->NLevels*sizeof(KnownLevelRecord)+it->NGammas*sizeof(KnownGammaRecord)+it->NDecays*sizeof(KnownDecayRecord);
+  if(end>size){return 0;}
 
-double NuDEXStatisticalNucleus::ReadKnownLevels(const char* fname){
+  return it;
+}
 
 
-  std::ifstream in(fname);
-  if(!in.good()){
-    std::cout<<" ######## Error opening file "<<fname<<" ########"<<std::endl;
-    NuDEXException(__FILE__,std::to_string(__LINE__).c_str(),"##### Error in NuDEX #####");
-  }
+void NuDEXStatisticalNucleus::FillKnownLevels(double newSn,int nRecords,const KnownLevelRecord* levels,const KnownGammaRecord* gammas,const KnownDecayRecord* decays,const char* fname){
 
-  char buffer[1000];
-  int aZ,aA;
-  while(in.get(buffer,6)){
-    in.get(buffer,6); aA=atoi(buffer); 
-    in.get(buffer,6); aZ=atoi(buffer); 
-    if(aZ==Z_Int && aA==A_Int){
-      in.get(buffer,6); KnownLevelsVectorSize=atoi(buffer);
-      in.get(buffer,16);
-      in.get(buffer,13); double newSn=atof(buffer);
-      if(Sn>0 && std::fabs(Sn-newSn)>0.01){
-	std::cout<<" ######## WARNING: Sn value from the level density file ("<<Sn<<") is different than the one from the known levels file ("<<newSn<<"). We use the first value. ########"<<std::endl;
-      }
-      else if(Sn<0){
-	Sn=newSn;
-      }
-      break;
-    }
-    in.ignore(10000,'\n');
+  if(Sn>0 && std::fabs(Sn-newSn)>0.01){
+    std::cout<<" ######## WARNING: Sn value from the level density file ("<<Sn<<") is different than the one from the known levels file ("<<newSn<<"). We use the first value. ########"<<std::endl;
   }
-
-  if(!in.good()){
-    in.close(); return -1;
+  else if(Sn<0){
+    Sn=newSn;
   }
 
-  in.ignore(10000,'\n');
-
+  KnownLevelsVectorSize=nRecords;
   NKnownLevels=0;
   theKnownLevels=new KnownLevel[KnownLevelsVectorSize];
-  for(int i=0;i<KnownLevelsVectorSize;i++){theKnownLevels[i].NGammas=0;}
+  for(int i=0;i<KnownLevelsVectorSize;i++){theKnownLevels[i].NGammas=0; theKnownLevels[i].GammasInPool=false;}
+
+  //The arrays of all the levels are taken from two memory pools:
+  int nGammas=0,nDecays=0;
+  for(int i=0;i<KnownLevelsVectorSize;i++){
+    nGammas+=levels[i].NGammas;
+    nDecays+=levels[i].Ndecays;
+  }
+  theKnownLevelsIntPool=new int[2*nGammas+1];
+  theKnownLevelsDoublePool=new double[5*nGammas+nDecays+1];
+  int* intPool=theKnownLevelsIntPool;
+  double* doublePool=theKnownLevelsDoublePool;
+
   double spin,par;
   for(int i=0;i<KnownLevelsVectorSize;i++){
-    in.get(buffer,4);   theKnownLevels[i].id=atoi(buffer)-1; 
-    in.get(buffer,2); 
-    in.get(buffer,11);  theKnownLevels[i].Energy=atof(buffer); 
-    in.get(buffer,2); 
-    in.get(buffer,6);   spin=atof(buffer); 
-    in.get(buffer,4);   par=atof(buffer); 
+    theKnownLevels[i].id=levels[i].id;
+    theKnownLevels[i].Energy=levels[i].Energy;
+    spin=levels[i].spin;
+    par=levels[i].parity;
     if((spin<0 || par==0) && theKnownLevels[i].Energy<Ecrit){
       std::cout<<" ######## WARNING: Spin and parity for level "<<i<<" is s="<<spin<<" p="<<par<<" for Z="<<Z_Int<<", A="<<A_Int<<" ########"<<std::endl;
       if(spin<0){
@@ -1586,9 +2039,8 @@ double NuDEXStatisticalNucleus::ReadKnownLevels(const char* fname){
 	if(theRandom1->Uniform(-1,1)<0){par=-1;}
       }
     }
-    in.get(buffer,2); 
-    in.get(buffer,11);  theKnownLevels[i].T12=atof(buffer); 
-    in.get(buffer,4);   theKnownLevels[i].NGammas=atoi(buffer);
+    theKnownLevels[i].T12=levels[i].T12;
+    theKnownLevels[i].NGammas=levels[i].NGammas;
     if(theKnownLevels[i].NGammas>0){
       if(spin<0){
 	spin=0;
@@ -1601,64 +2053,51 @@ double NuDEXStatisticalNucleus::ReadKnownLevels(const char* fname){
 	par=1;
 	if(theRandom1->Uniform(-1,1)<0){par=-1;}
       }
-    }    
+    }
     theKnownLevels[i].spinx2=(int)(spin*2+0.01);
     if(par>0){theKnownLevels[i].parity=true;}else{theKnownLevels[i].parity=false;}
 
     //---------------------------------
     //decay modes:
-    in.get(buffer,27); //dummy
-    in.get(buffer,4);
-    theKnownLevels[i].Ndecays=atoi(buffer);
+    theKnownLevels[i].Ndecays=levels[i].Ndecays;
+    theKnownLevels[i].decayFraction=0;
     if(theKnownLevels[i].Ndecays>0){
-      theKnownLevels[i].decayFraction=new double[theKnownLevels[i].Ndecays];
-      //theKnownLevels[i].decayMode=new std::string[theKnownLevels[i].Ndecays];
+      theKnownLevels[i].decayFraction=doublePool; doublePool+=theKnownLevels[i].Ndecays;
     }
     for(int j=0;j<theKnownLevels[i].Ndecays;j++){
-      in.get(buffer,5);
-      in.get(buffer,11);
-      theKnownLevels[i].decayFraction[j]=atof(buffer);
-      in.get(buffer,2);
-      in.get(buffer,8);
-      //theKnownLevels[i].decayMode[j]=std::string(buffer);
-      theKnownLevels[i].decayMode.push_back(std::string(buffer));
+      theKnownLevels[i].decayFraction[j]=decays->decayFraction;
+      theKnownLevels[i].decayMode.push_back(std::string(decays->decayMode,strnlen(decays->decayMode,sizeof(decays->decayMode))));
+      decays++;
     }
     //----------------------------------
 
-    in.ignore(10000,'\n');
-
     if(theKnownLevels[i].NGammas>0){
-      theKnownLevels[i].FinalLevelID=new int[theKnownLevels[i].NGammas];
-      theKnownLevels[i].multipolarity=new int[theKnownLevels[i].NGammas];
-      theKnownLevels[i].Eg=new double[theKnownLevels[i].NGammas];
-      theKnownLevels[i].cumulPtot=new double[theKnownLevels[i].NGammas];
-      theKnownLevels[i].Pg=new double[theKnownLevels[i].NGammas];
-      theKnownLevels[i].Pe=new double[theKnownLevels[i].NGammas];
-      theKnownLevels[i].Icc=new double[theKnownLevels[i].NGammas];
+      theKnownLevels[i].GammasInPool=true;
+      theKnownLevels[i].FinalLevelID=intPool; intPool+=theKnownLevels[i].NGammas;
+      theKnownLevels[i].multipolarity=intPool; intPool+=theKnownLevels[i].NGammas;
+      theKnownLevels[i].Eg=doublePool; doublePool+=theKnownLevels[i].NGammas;
+      theKnownLevels[i].cumulPtot=doublePool; doublePool+=theKnownLevels[i].NGammas;
+      theKnownLevels[i].Pg=doublePool; doublePool+=theKnownLevels[i].NGammas;
+      theKnownLevels[i].Pe=doublePool; doublePool+=theKnownLevels[i].NGammas;
+      theKnownLevels[i].Icc=doublePool; doublePool+=theKnownLevels[i].NGammas;
     }
 
     for(int j=0;j<theKnownLevels[i].NGammas;j++){
-      in.get(buffer,40); 
-
-      in.get(buffer,5);  theKnownLevels[i].FinalLevelID[j]=atoi(buffer)-1; 
+      theKnownLevels[i].FinalLevelID[j]=gammas->FinalLevelID;
       theKnownLevels[i].multipolarity[j]=0;
-      in.get(buffer,2); 
-      in.get(buffer,11);  theKnownLevels[i].Eg[j]=atof(buffer); 
-      in.get(buffer,2); 
-      in.get(buffer,11);  theKnownLevels[i].Pg[j]=atof(buffer); 
-      in.get(buffer,2); 
-      in.get(buffer,11);  theKnownLevels[i].Pe[j]=atof(buffer); 
-      in.get(buffer,2); 
-      in.get(buffer,11);  theKnownLevels[i].Icc[j]=atof(buffer); 
+      theKnownLevels[i].Eg[j]=gammas->Eg;
+      theKnownLevels[i].Pg[j]=gammas->Pg;
+      theKnownLevels[i].Pe[j]=gammas->Pe;
+      theKnownLevels[i].Icc[j]=gammas->Icc;
       theKnownLevels[i].cumulPtot[j]=theKnownLevels[i].Pg[j]*(1+theKnownLevels[i].Icc[j]); //we rely in Pg and Icc, where Icc=Pe/Pg
-      in.ignore(10000,'\n');
+      gammas++;
       if(theKnownLevels[i].FinalLevelID[j]>=i+1){
 	std::cout<<" ######## Error reading file "<<fname<<" ########"<<std::endl;
 	NuDEXException(__FILE__,std::to_string(__LINE__).c_str(),"##### Error in NuDEX #####");
       }
     }
 
-    if(theKnownLevels[i].id!=i || !in.good()){
+    if(theKnownLevels[i].id!=i){
       std::cout<<" ######## Error reading file "<<fname<<" ########"<<std::endl;
       std::cout<<" Level "<<i<<" has id = "<<theKnownLevels[i].id<<std::endl;
       NuDEXException(__FILE__,std::to_string(__LINE__).c_str(),"##### Error in NuDEX #####");
@@ -1692,23 +2131,522 @@ double NuDEXStatisticalNucleus::ReadKnownLevels(const char* fname){
     if(theKnownLevels[i].Energy<=Ecrit*1.0001){
       NKnownLevels++;
     }
-    /*
-    else{
-      break;
+  }
+}
+
+
+int NuDEXStatisticalNucleus::MakeKnownLevelsBinaryFile(const char* textfname,const char* binfname){
+
+  std::string image;
+  if(MakeKnownLevelsImage(textfname,image)<0){return -1;}
+
+  std::ofstream out(binfname,std::ios::binary);
+  if(!out.good()){
+    std::cout<<" ######## Error opening file "<<binfname<<" ########"<<std::endl;
+    return -1;
+  }
+  out.write(image.data(),image.size());
+  if(!out.good()){
+    std::cout<<" ######## Error writing file "<<binfname<<" ########"<<std::endl;
+    return -1;
+  }
+  out.close();
+
+  return 0;
+}
+
+
+int NuDEXStatisticalNucleus::MakeKnownLevelsImage(const char* textfname,std::string& image){
+
+  NuDEXBinaryHeader header;
+  if(NuDEXMakeBinaryHeader(&header,"NuDEXKLV",KNOWNLEVELS_BINARYVERSION,0,textfname)<0){
+    std::cout<<" ######## Error opening file "<<textfname<<" ########"<<std::endl;
+    return -1;
+  }
+
+  //All the nuclei of the file, one after the other:
+  std::ifstream in(textfname);
+  std::vector<KnownNucleusRecord> theIndex;
+  std::vector<KnownLevelRecord> levels;
+  std::vector<KnownGammaRecord> gammas;
+  std::vector<KnownDecayRecord> decays;
+  std::vector<long long> firstLevel,firstGamma,firstDecay;
+  char buffer[1000];
+  while(in.get(buffer,6)){
+    KnownNucleusRecord nucleus;
+    memset(&nucleus,0,sizeof(nucleus));
+    in.get(buffer,6); nucleus.A=atoi(buffer);
+    in.get(buffer,6); nucleus.Z=atoi(buffer);
+    in.get(buffer,6); nucleus.NLevels=atoi(buffer);
+    in.get(buffer,16);
+    in.get(buffer,13); nucleus.Sn=atof(buffer);
+    in.ignore(10000,'\n');
+    firstLevel.push_back(levels.size());
+    firstGamma.push_back(gammas.size());
+    firstDecay.push_back(decays.size());
+    if(!in.good() || ReadKnownLevelsRecords(in,nucleus.NLevels,levels,gammas,decays)<0){
+      std::cout<<" ######## Error reading file "<<textfname<<" (Z="<<nucleus.Z<<", A="<<nucleus.A<<") ########"<<std::endl;
+      return -1;
     }
-    */
+    nucleus.NGammas=gammas.size()-firstGamma.back();
+    nucleus.NDecays=decays.size()-firstDecay.back();
+    nucleus.offset=theIndex.size(); //position in the vectors, for the moment
+    theIndex.push_back(nucleus);
   }
+  in.close();
 
-  if(!in.good()){
-    in.close(); return -1;
+  //Sorted by ZA. If one nucleus is twice in the file, the first one is used (as when reading the text file):
+  std::stable_sort(theIndex.begin(),theIndex.end(),[](const KnownNucleusRecord& a,const KnownNucleusRecord& b){return 1000*a.Z+a.A<1000*b.Z+b.A;});
+  int nNuclei=theIndex.size();
+  header.nEntries=nNuclei;
+  std::vector<int> pos(nNuclei);
+  long long offset=sizeof(header)+nNuclei*sizeof(KnownNucleusRecord);
+  for(int k=0;k<nNuclei;k++){
+    pos[k]=theIndex[k].offset;
+    theIndex[k].offset=offset;
+    offset+=theIndex[k].NLevels*sizeof(KnownLevelRecord)+theIndex[k].NGammas*sizeof(KnownGammaRecord)+theIndex[k].NDecays*sizeof(KnownDecayRecord);
+  }
+
+  image.clear();
+  image.reserve(offset);
+  image.append((const char*)&header,sizeof(header));
+  image.append((const char*)theIndex.data(),nNuclei*sizeof(KnownNucleusRecord));
+  for(int k=0;k<nNuclei;k++){
+    image.append((const char*)(levels.data()+firstLevel[pos[k]]),theIndex[k].NLevels*sizeof(KnownLevelRecord));
+    image.append((const char*)(gammas.data()+firstGamma[pos[k]]),theIndex[k].NGammas*sizeof(KnownGammaRecord));
+    image.append((const char*)(decays.data()+firstDecay[pos[k]]),theIndex[k].NDecays*sizeof(KnownDecayRecord));
+  }
+
+  return 0;
+}
+
+
+void NuDEXStatisticalNucleus::SetLibraryDataCache(bool useCache){
+
+  {
+    std::lock_guard<std::mutex> lock(theKnownLevelsCacheMutex);
+    UseKnownLevelsCache=useCache;
+    if(!useCache){theKnownLevelsCache.clear();}
+  }
+  NuDEXInternalConversion::SetDataCache(useCache);
+}
+
+
+std::shared_ptr<const NuDEXFileData> NuDEXStatisticalNucleus::GetKnownLevelsFile(const char* fname){
+
+  std::unique_lock<std::mutex> lock(theKnownLevelsCacheMutex);
+  if(!UseKnownLevelsCache){lock.unlock();}
+  std::shared_ptr<const NuDEXFileData> theFile;
+  if(lock.owns_lock()){
+    std::map<std::string,std::shared_ptr<const NuDEXFileData> >::iterator it=theKnownLevelsCache.find(std::string(fname));
+    if(it!=theKnownLevelsCache.end()){theFile=it->second;}
+  }
+
+  if(!theFile){
+    NuDEXFileData* aFile=new NuDEXFileData();
+    aFile->data=NuDEXMapBinaryFile(NuDEXGetBinaryFileName(fname).c_str(),"NuDEXKLV",KNOWNLEVELS_BINARYVERSION,fname,aFile->size);
+    aFile->mapped=(aFile->data!=0);
+    //Only for the cache, the text file is read once into the image of its binary file. If this also fails, the empty file is kept, so we don't try again:
+    if(!aFile->mapped && lock.owns_lock()){
+      if(MakeKnownLevelsImage(fname,aFile->image)==0){
+	aFile->data=aFile->image.data();
+	aFile->size=aFile->image.size();
+      }
+      else{
+	aFile->image.clear();
+      }
+    }
+    theFile.reset(aFile);
+    if(lock.owns_lock()){theKnownLevelsCache[std::string(fname)]=theFile;}
+  }
+
+  if(theFile->size==0){return std::shared_ptr<const NuDEXFileData>();}
+  return theFile;
+}
+
+
+//-------------------------------------------------------------------------------------------------
+//Snapshots of the initialized nucleus. The file has a SnapshotHeader and then the body: the key, the states of theRandom1,2,3
+//after building the level scheme, theLevels[NLevels], the known levels (SnapshotKnownLevel, decay modes and arrays of each one),
+//the thermal capture level and its cumulative BR, TotalGammaRho[NLevels] and, if BROpt==1,2, TotalCumulBR of each level (N=-1 if it has not been computed).
+//The size and hash of the body are in the header, so a truncated or corrupted snapshot is detected before reading it (and then made again).
+//The structures are written as they are in memory, so the snapshots have to be read by the same build of NuDEX.
+struct SnapshotHeader{
+  char magic[8];
+  int version,keySize;
+  int NLevels,NKnownLevels,NUnknownLevels,KnownLevelsVectorSize;
+  int NKnownGammas,NKnownDecays,NLevelsBelowThermalCaptureLevel,NBands;
+  int HasThermalCaptureLevel,HasTotalCumulBR;
+  int RandomStateSize[3],unused;
+  long long BodySize;
+  unsigned long long BodyHash; //NuDEXHash of the body
+  double Sn,D0,I0,Ecrit,MaxExcEnergy,E_unk_min,E_unk_max,Emin_bands,Emax_bands,PrimaryGammasEcut;
+};
+struct SnapshotKnownLevel{
+  double Energy,T12;
+  int id,spinx2,parity,Ndecays,NGammas,unused;
+};
+//The body of the snapshot, read from memory without going beyond its end:
+struct SnapshotReader{
+  const char* pos;
+  const char* end;
+  bool good;
+};
+
+template<class T> static void WriteSnapshotArray(std::ostream& out,const T* a,long long n){
+  if(n>0){out.write((const char*)a,n*sizeof(T));}
+}
+template<class T> static void ReadSnapshotArray(SnapshotReader& in,T* a,long long n){
+  if(n<=0 || !in.good){return;}
+  if(n>(in.end-in.pos)/(long long)sizeof(T)){in.good=false; return;}
+  memcpy((char*)a,in.pos,n*sizeof(T));
+  in.pos+=n*sizeof(T);
+}
+
+
+std::string NuDEXStatisticalNucleus::MakeSnapshotKey(const char* inputfname,const char* definputfname){
+
+  std::ostringstream key;
+  key<<std::setprecision(17);
+  key<<"ZA "<<1000*Z_Int+A_Int<<" LIBDIR "<<theLibDir<<std::endl;
+  key<<"LEVELDENSITYTYPE "<<LevelDensityType<<" PSF_FLAG "<<PSFflag<<" MAXSPINX2 "<<maxspinx2<<" MINLEVELSPERBAND "<<MinLevelsPerBand<<" BANDWIDTH_MEV "<<BandWidth<<" MAXEXCENERGY_MEV "<<MaxExcEnergy<<" ECRIT_MEV "<<Ecrit<<std::endl;
+  key<<"BROPTION "<<BROpt<<" SAMPLEGAMMAWIDTHS "<<SampleGammaWidths<<" BRSTORAGEOPTION "<<BRStorageOpt<<" PSFTABULATIONERROR "<<PSFTabulationError<<" ICCTABLEPOINTSPERDECADE "<<ICCTablePointsPerDecade<<" LDTABLEPOINTSPERMEV "<<LDTablePointsPerMeV<<std::endl;
+  key<<"LEVELSCHEMESUBSTREAMS "<<(LevelSchemeNThreads>0)<<std::endl; //the level scheme does not depend on the number of threads
+  key<<"KNOWNLEVELSFLAG "<<KnownLevelsFlag<<" ELECTRONCONVERSIONFLAG "<<ElectronConversionFlag<<" PRIMARYTHCAPGAMNORM "<<PrimaryGammasIntensityNormFactor<<" PRIMARYGAMMASECUT "<<PrimaryGammasEcut<<std::endl;
+  key<<"SEED1 "<<seed1<<" SEED2 "<<seed2<<" SEED3 "<<seed3<<std::endl;
+  key<<"SN "<<Sn<<" D0 "<<D0<<" I0 "<<I0<<std::endl;
+
+  //The input files can also change the level density and PSF parameters:
+  const char* fnames[2]={definputfname,inputfname};
+  for(int i=0;i<2;i++){
+    if(fnames[i]==0){continue;}
+    std::ifstream in(fnames[i]);
+    std::string content((std::istreambuf_iterator<char>(in)),std::istreambuf_iterator<char>());
+    key<<"FILE "<<fnames[i]<<std::endl<<content<<std::endl;
+  }
+
+  //The library files read by Init (and their binary copies). The snapshot is not used anymore if any of them is modified:
+  char zfname[100];
+  sprintf(zfname,"KnownLevels/z%03d.dat",Z_Int);
+  const char* libfnames[]={"GeneralStatNuclParameters.dat","KnownLevels/levels-param.data",zfname,"ICC_factors.dat","PrimaryCaptureGammas.dat",
+			   "LevelDensities/level-densities-bfmeff.dat","LevelDensities/level-densities-ctmeff.dat","LevelDensities/shellcor-ms.dat",
+			   "PSF/PSF_param.dat","PSF/CRP_IAEA_SMLO_E1_v01.dat","PSF/gdr-parameters&errors-exp-MLO.dat","PSF/gdr-parameters-theor.dat"};
+  for(size_t i=0;i<sizeof(libfnames)/sizeof(libfnames[0]);i++){
+    std::string fname=theLibDir+"/"+libfnames[i];
+    key<<"LIBFILE "<<libfnames[i]<<" "<<NuDEXGetFileStamp(fname.c_str());
+    if(fname.size()>4 && fname.compare(fname.size()-4,4,".dat")==0){
+      key<<" "<<NuDEXGetFileStamp(NuDEXGetBinaryFileName(fname.c_str()).c_str());
+    }
+    key<<std::endl;
   }
 
+  return key.str();
+}
+
+std::string NuDEXStatisticalNucleus::GetSnapshotFileName(const std::string& key){
+
+  char fname[1000],hash[20];
+  snprintf(hash,20,"%016llx",NuDEXHash(key));
+  snprintf(fname,1000,"%s/NuDEX_ZA%d_%s.snp",theSnapshotDir.c_str(),1000*Z_Int+A_Int,hash);
+  return std::string(fname);
+}
+
+
+int NuDEXStatisticalNucleus::ReadSnapshot(const char* fname,const std::string& key){
+
+  std::ifstream in(fname,std::ios::binary);
+  if(!in.good()){return -1;}
+
+  //The size and hash of the body are checked before using anything of it:
+  SnapshotHeader header;
+  std::string body;
+  in.read((char*)&header,sizeof(SnapshotHeader));
+  bool valid=(in.good() && memcmp(header.magic,"NuDEXSNP",8)==0 && header.version==SNAPSHOT_VERSION && header.keySize==(int)key.size() && header.BodySize>=header.keySize);
+  if(valid){
+    body.assign((std::istreambuf_iterator<char>(in)),std::istreambuf_iterator<char>());
+    valid=((long long)body.size()==header.BodySize && NuDEXHash(body)==header.BodyHash && body.compare(0,key.size(),key)==0);
+  }
   in.close();
+  if(valid){
+    valid=(ReadSnapshotBody(body,header)==0);
+  }
+  if(!valid){
+    std::cout<<" ###### WARNING: "<<fname<<" is not a valid snapshot for ZA="<<1000*Z_Int+A_Int<<", it will be made again ######"<<std::endl;
+    return -1;
+  }
+
+  if(Verbosity>0){std::cout<<" NuDEX: Statistical nucleus for ZA="<<Z_Int*1000+A_Int<<" read from "<<fname<<", with "<<NLevels<<" levels in total: "<<NKnownLevels<<" from the database and "<<NUnknownLevels<<" from statistical models"<<std::endl;}
+
+  return 0;
+}
+
+//Everything is read in local variables, which are moved to the nucleus only if the whole body is consistent with the header.
+//Returns -1 (and the nucleus is not modified) if not:
+int NuDEXStatisticalNucleus::ReadSnapshotBody(const std::string& body,const SnapshotHeader& header){
+
+  //The arrays cannot be larger than the body:
+  long long bodySize=header.BodySize;
+  if(header.NLevels<0 || header.NKnownLevels<0 || header.NUnknownLevels<0 || header.KnownLevelsVectorSize<0 || header.NKnownGammas<0 || header.NKnownDecays<0){return -1;}
+  if(header.NLevelsBelowThermalCaptureLevel<0 || header.NLevelsBelowThermalCaptureLevel>header.NLevels){return -1;}
+  long long levelSize=sizeof(Level),knownLevelSize=sizeof(SnapshotKnownLevel),knownGammaSize=2*sizeof(int)+5*sizeof(double),knownDecaySize=sizeof(double);
+  if(header.NLevels*levelSize>bodySize || header.KnownLevelsVectorSize*knownLevelSize>bodySize){return -1;}
+  if(header.NKnownGammas*knownGammaSize+header.NKnownDecays*knownDecaySize>bodySize){return -1;}
+  for(int i=0;i<3;i++){
+    if(header.RandomStateSize[i]<0 || header.RandomStateSize[i]>bodySize){return -1;}
+  }
+
+  SnapshotReader in;
+  in.pos=body.data()+header.keySize; in.end=body.data()+body.size(); in.good=true;
+
+  //Random generators:
+  std::string randomState[3];
+  for(int i=0;i<3;i++){
+    randomState[i].resize(header.RandomStateSize[i]);
+    ReadSnapshotArray(in,&randomState[i][0],header.RandomStateSize[i]);
+  }
+
+  //Level scheme:
+  int nLevels=header.NLevels;
+  Level* levels=new Level[nLevels];
+  ReadSnapshotArray(in,levels,nLevels);
+
+  //Known levels, with all their arrays in the memory pools:
+  int nKnownLevels=header.KnownLevelsVectorSize;
+  KnownLevel* knownLevels=new KnownLevel[nKnownLevels];
+  int* knownLevelsIntPool=new int[2*header.NKnownGammas+1];
+  double* knownLevelsDoublePool=new double[5*header.NKnownGammas+header.NKnownDecays+1];
+  int* intPool=knownLevelsIntPool;
+  double* doublePool=knownLevelsDoublePool;
+  int* intPoolEnd=knownLevelsIntPool+2*header.NKnownGammas;
+  double* doublePoolEnd=knownLevelsDoublePool+5*header.NKnownGammas+header.NKnownDecays;
+  SnapshotKnownLevel record;
+  for(int i=0;i<nKnownLevels;i++){
+    knownLevels[i].NGammas=0; knownLevels[i].GammasInPool=false;
+  }
+  for(int i=0;i<nKnownLevels && in.good;i++){
+    KnownLevel* kl=&knownLevels[i];
+    ReadSnapshotArray(in,&record,1);
+    if(!in.good || record.Ndecays<0 || record.NGammas<0 || record.Ndecays>doublePoolEnd-doublePool){in.good=false; break;}
+    kl->id=record.id; kl->Energy=record.Energy; kl->spinx2=record.spinx2; kl->parity=(record.parity!=0); kl->T12=record.T12;
+    kl->Ndecays=record.Ndecays;
+    kl->decayFraction=0;
+    if(kl->Ndecays>0){kl->decayFraction=doublePool; doublePool+=kl->Ndecays;}
+    ReadSnapshotArray(in,kl->decayFraction,kl->Ndecays);
+    for(int j=0;j<kl->Ndecays && in.good;j++){
+      int modeSize=0;
+      ReadSnapshotArray(in,&modeSize,1);
+      if(modeSize<0 || modeSize>in.end-in.pos){in.good=false; break;}
+      std::string mode(modeSize,' ');
+      ReadSnapshotArray(in,&mode[0],mode.size());
+      kl->decayMode.push_back(mode);
+    }
+    if(record.NGammas>0){
+      if(2*(long long)record.NGammas>intPoolEnd-intPool || 5*(long long)record.NGammas>doublePoolEnd-doublePool){in.good=false; break;}
+      kl->NGammas=record.NGammas;
+      kl->GammasInPool=true;
+      kl->FinalLevelID=intPool; intPool+=kl->NGammas;
+      kl->multipolarity=intPool; intPool+=kl->NGammas;
+      kl->Eg=doublePool; doublePool+=kl->NGammas;
+      kl->cumulPtot=doublePool; doublePool+=kl->NGammas;
+      kl->Pg=doublePool; doublePool+=kl->NGammas;
+      kl->Pe=doublePool; doublePool+=kl->NGammas;
+      kl->Icc=doublePool; doublePool+=kl->NGammas;
+      ReadSnapshotArray(in,kl->FinalLevelID,kl->NGammas);
+      ReadSnapshotArray(in,kl->multipolarity,kl->NGammas);
+      ReadSnapshotArray(in,kl->Eg,kl->NGammas);
+      ReadSnapshotArray(in,kl->cumulPtot,kl->NGammas);
+      ReadSnapshotArray(in,kl->Pg,kl->NGammas);
+      ReadSnapshotArray(in,kl->Pe,kl->NGammas);
+      ReadSnapshotArray(in,kl->Icc,kl->NGammas);
+    }
+  }
+
+  //Thermal capture level:
+  Level thermalCaptureLevel;
+  double* thermalCaptureLevelCumulBR=0;
+  if(header.HasThermalCaptureLevel){
+    ReadSnapshotArray(in,&thermalCaptureLevel,1);
+    thermalCaptureLevelCumulBR=new double[header.NLevelsBelowThermalCaptureLevel];
+    ReadSnapshotArray(in,thermalCaptureLevelCumulBR,header.NLevelsBelowThermalCaptureLevel);
+  }
+
+  //BR:
+  std::vector<double> theTotalGammaRho(nLevels);
+  ReadSnapshotArray(in,theTotalGammaRho.data(),nLevels);
+  std::vector<SparseBR*> theTotalCumulBR;
+  if(header.HasTotalCumulBR){
+    theTotalCumulBR.resize(nLevels,0);
+    for(int i=0;i<nLevels && in.good;i++){
+      int N=-1;
+      ReadSnapshotArray(in,&N,1);
+      if(N<0){continue;}
+      if(N>i){in.good=false; break;} //only transitions to the levels below
+      SparseBR* cumulBR=new SparseBR;
+      cumulBR->N=N;
+      cumulBR->FinalLevel=new int[N];
+      cumulBR->CumulBR=0; cumulBR->CumulBRf=0;
+      ReadSnapshotArray(in,cumulBR->FinalLevel,N);
+      if(BRStorageOpt==1){cumulBR->CumulBRf=new float[N]; ReadSnapshotArray(in,cumulBR->CumulBRf,N);}
+      else{cumulBR->CumulBR=new double[N]; ReadSnapshotArray(in,cumulBR->CumulBR,N);}
+      theTotalCumulBR[i]=cumulBR;
+    }
+  }
+
+  //The random generators continue from the same point as if the level scheme had been built:
+  std::string oldRandomState[3];
+  NuDEXRandom* theRandom[3]={theRandom1,theRandom2,theRandom3};
+  for(int i=0;i<3 && in.good && in.pos==in.end;i++){
+    oldRandomState[i]=theRandom[i]->GetState();
+    if(!theRandom[i]->SetState(randomState[i])){
+      for(int j=0;j<=i;j++){theRandom[j]->SetState(oldRandomState[j]);}
+      in.good=false;
+    }
+  }
+
+  if(!in.good || in.pos!=in.end){
+    delete [] levels;
+    delete [] knownLevels;
+    delete [] knownLevelsIntPool;
+    delete [] knownLevelsDoublePool;
+    if(thermalCaptureLevelCumulBR!=0){delete [] thermalCaptureLevelCumulBR;}
+    for(size_t i=0;i<theTotalCumulBR.size();i++){
+      if(theTotalCumulBR[i]!=0){DeleteSparseBR(theTotalCumulBR[i]);}
+    }
+    return -1;
+  }
+
+  Sn=header.Sn; D0=header.D0; I0=header.I0;
+  Ecrit=header.Ecrit; MaxExcEnergy=header.MaxExcEnergy;
+  E_unk_min=header.E_unk_min; E_unk_max=header.E_unk_max;
+  Emin_bands=header.Emin_bands; Emax_bands=header.Emax_bands;
+  NBands=header.NBands;
+  PrimaryGammasEcut=header.PrimaryGammasEcut;
+  NLevels=header.NLevels; NKnownLevels=header.NKnownLevels; NUnknownLevels=header.NUnknownLevels;
+  KnownLevelsVectorSize=header.KnownLevelsVectorSize;
+  NLevelsBelowThermalCaptureLevel=header.NLevelsBelowThermalCaptureLevel;
+  theLevels=levels;
+  theKnownLevels=knownLevels;
+  theKnownLevelsIntPool=knownLevelsIntPool;
+  theKnownLevelsDoublePool=knownLevelsDoublePool;
+  if(header.HasThermalCaptureLevel){
+    theThermalCaptureLevel=thermalCaptureLevel;
+    theThermalCaptureLevelCumulBR=thermalCaptureLevelCumulBR;
+    if(BRSamplingOpt==1){
+      theThermalCaptureLevelAliasBR=CreateAliasTable(theThermalCaptureLevelCumulBR,NLevelsBelowThermalCaptureLevel);
+    }
+  }
+  TotalGammaRho=new std::atomic<double>[NLevels];
+  for(int i=0;i<NLevels;i++){
+    TotalGammaRho[i]=theTotalGammaRho[i];
+  }
+  if(header.HasTotalCumulBR){
+    TotalCumulBR=new std::atomic<SparseBR*>[NLevels];
+    for(int i=0;i<NLevels;i++){
+      TotalCumulBR[i]=theTotalCumulBR[i];
+    }
+  }
 
   return 0;
 }
 
 
+//Nothing uses theRandom1,2,3 in Init after building the level scheme, so their states now are the ones to continue from when the snapshot is read:
+int NuDEXStatisticalNucleus::WriteSnapshot(const char* fname,const std::string& key){
+
+  SnapshotHeader header;
+  memset(&header,0,sizeof(SnapshotHeader));
+  memcpy(header.magic,"NuDEXSNP",8);
+  header.version=SNAPSHOT_VERSION;
+  header.keySize=key.size();
+  header.NLevels=NLevels; header.NKnownLevels=NKnownLevels; header.NUnknownLevels=NUnknownLevels;
+  header.KnownLevelsVectorSize=KnownLevelsVectorSize;
+  for(int i=0;i<KnownLevelsVectorSize;i++){
+    header.NKnownGammas+=theKnownLevels[i].NGammas;
+    header.NKnownDecays+=theKnownLevels[i].Ndecays;
+  }
+  header.NLevelsBelowThermalCaptureLevel=NLevelsBelowThermalCaptureLevel;
+  header.NBands=NBands;
+  header.HasThermalCaptureLevel=(theThermalCaptureLevelCumulBR!=0);
+  header.HasTotalCumulBR=(TotalCumulBR!=0 && (BROpt==1 || BROpt==2));
+  header.Sn=Sn; header.D0=D0; header.I0=I0;
+  header.Ecrit=Ecrit; header.MaxExcEnergy=MaxExcEnergy;
+  header.E_unk_min=E_unk_min; header.E_unk_max=E_unk_max;
+  header.Emin_bands=Emin_bands; header.Emax_bands=Emax_bands;
+  header.PrimaryGammasEcut=PrimaryGammasEcut;
+
+  std::ostringstream out;
+  WriteSnapshotArray(out,key.data(),key.size());
+  std::string randomState[3]={theRandom1->GetState(),theRandom2->GetState(),theRandom3->GetState()};
+  for(int i=0;i<3;i++){
+    header.RandomStateSize[i]=randomState[i].size();
+    WriteSnapshotArray(out,randomState[i].data(),randomState[i].size());
+  }
+  WriteSnapshotArray(out,theLevels,NLevels);
+
+  SnapshotKnownLevel record;
+  memset(&record,0,sizeof(SnapshotKnownLevel));
+  for(int i=0;i<KnownLevelsVectorSize;i++){
+    const KnownLevel* kl=&theKnownLevels[i];
+    record.Energy=kl->Energy; record.T12=kl->T12;
+    record.id=kl->id; record.spinx2=kl->spinx2; record.parity=kl->parity; record.Ndecays=kl->Ndecays; record.NGammas=kl->NGammas;
+    WriteSnapshotArray(out,&record,1);
+    WriteSnapshotArray(out,kl->decayFraction,kl->Ndecays);
+    for(int j=0;j<kl->Ndecays;j++){
+      int modeSize=kl->decayMode[j].size();
+      WriteSnapshotArray(out,&modeSize,1);
+      WriteSnapshotArray(out,kl->decayMode[j].data(),modeSize);
+    }
+    WriteSnapshotArray(out,kl->FinalLevelID,kl->NGammas);
+    WriteSnapshotArray(out,kl->multipolarity,kl->NGammas);
+    WriteSnapshotArray(out,kl->Eg,kl->NGammas);
+    WriteSnapshotArray(out,kl->cumulPtot,kl->NGammas);
+    WriteSnapshotArray(out,kl->Pg,kl->NGammas);
+    WriteSnapshotArray(out,kl->Pe,kl->NGammas);
+    WriteSnapshotArray(out,kl->Icc,kl->NGammas);
+  }
+
+  if(header.HasThermalCaptureLevel){
+    WriteSnapshotArray(out,&theThermalCaptureLevel,1);
+    WriteSnapshotArray(out,theThermalCaptureLevelCumulBR,NLevelsBelowThermalCaptureLevel);
+  }
+
+  std::vector<double> theTotalGammaRho(NLevels);
+  for(int i=0;i<NLevels;i++){
+    theTotalGammaRho[i]=TotalGammaRho[i].load(std::memory_order_acquire);
+  }
+  WriteSnapshotArray(out,theTotalGammaRho.data(),NLevels);
+  if(header.HasTotalCumulBR){
+    for(int i=0;i<NLevels;i++){
+      const SparseBR* cumulBR=TotalCumulBR[i].load(std::memory_order_acquire);
+      int N=-1;
+      if(cumulBR!=0){N=cumulBR->N;}
+      WriteSnapshotArray(out,&N,1);
+      if(cumulBR==0){continue;}
+      WriteSnapshotArray(out,cumulBR->FinalLevel,N);
+      if(cumulBR->CumulBRf!=0){WriteSnapshotArray(out,cumulBR->CumulBRf,N);}
+      else{WriteSnapshotArray(out,cumulBR->CumulBR,N);}
+    }
+  }
+
+  //It is written in a temporary file and then renamed, so other processes never read an incomplete snapshot:
+  std::string body=out.str();
+  header.BodySize=body.size();
+  header.BodyHash=NuDEXHash(body);
+  std::string tmpfname=NuDEXGetTemporaryFileName(fname);
+  std::ofstream outf(tmpfname.c_str(),std::ios::binary);
+  WriteSnapshotArray(outf,&header,1);
+  WriteSnapshotArray(outf,body.data(),body.size());
+  outf.close();
+  if(!outf.good() || std::rename(tmpfname.c_str(),fname)!=0){
+    std::cout<<" ###### WARNING: the snapshot "<<fname<<" could not be written ######"<<std::endl;
+    std::remove(tmpfname.c_str());
+    return -1;
+  }
+  if(Verbosity>0){std::cout<<" NuDEX: Statistical nucleus for ZA="<<Z_Int*1000+A_Int<<" written in "<<fname<<std::endl;}
+
+  return 0;
+}
+
 
 double NuDEXStatisticalNucleus::ReadEcrit(const char* fname){
 
@@ -1755,7 +2693,15 @@ int NuDEXStatisticalNucleus::ReadSpecialInputFile(const char* fname){
     else if(word==std::string("KNOWNLEVELSFLAG")){if(KnownLevelsFlag<0){in>>KnownLevelsFlag;}}
 
     else if(word==std::string("PSF_FLAG")){if(PSFflag<0){in>>PSFflag;}}
+    else if(word==std::string("PSFTABULATIONERROR")){if(PSFTabulationError<0){in>>PSFTabulationError;}}
+    else if(word==std::string("ICCTABLEPOINTSPERDECADE")){if(ICCTablePointsPerDecade<0){in>>ICCTablePointsPerDecade;}}
+    else if(word==std::string("LDTABLEPOINTSPERMEV")){if(LDTablePointsPerMeV<0){in>>LDTablePointsPerMeV;}}
+    else if(word==std::string("LEVELSCHEMENTHREADS")){if(LevelSchemeNThreads<0){in>>LevelSchemeNThreads;}}
     else if(word==std::string("BROPTION")){if(BROpt<0){in>>BROpt;}}
+    else if(word==std::string("BRSAMPLINGOPTION")){if(BRSamplingOpt<0){in>>BRSamplingOpt;}}
+    else if(word==std::string("BRSTORAGEOPTION")){if(BRStorageOpt<0){in>>BRStorageOpt;}}
+    else if(word==std::string("BRCACHESIZE_MB")){if(BRCacheSize_MB<0){in>>BRCacheSize_MB;}}
+    else if(word==std::string("BRPRECOMPUTENTHREADS")){if(BRPrecomputeNThreads<0){in>>BRPrecomputeNThreads;}}
     else if(word==std::string("SAMPLEGAMMAWIDTHS")){if(SampleGammaWidths<0){in>>SampleGammaWidths;}}
       
     else if(word==std::string("ELECTRONCONVERSIONFLAG")){if(ElectronConversionFlag<0){in>>ElectronConversionFlag;}}
@@ -1831,8 +2777,8 @@ int NuDEXStatisticalNucleus::ReadGeneralStatNuclParameters(const char* fname){
   if(BROpt!=0 && BROpt!=1 && BROpt!=2){
     std::cout<<" ######## Error: BROpt for generating the statistical nucleus with A="<<A_Int<<" and Z="<<Z_Int<<" has been set to BROpt="<<BROpt<<", and has to be BROpt=0,1 or 2 ########"<<std::endl; NuDEXException(__FILE__,std::to_string(__LINE__).c_str(),"##### Error in NuDEX #####");
   }
-  if(SampleGammaWidths!=0 && SampleGammaWidths!=1){
-    std::cout<<" ######## Error: SampleGammaWidths parameter for generating the statistical nucleus with A="<<A_Int<<" and Z="<<Z_Int<<" has been set to SampleGammaWidths="<<SampleGammaWidths<<", and has to be SampleGammaWidths=0 or 1 ########"<<std::endl; NuDEXException(__FILE__,std::to_string(__LINE__).c_str(),"##### Error in NuDEX #####");
+  if(SampleGammaWidths!=0 && SampleGammaWidths!=1 && SampleGammaWidths!=2){
+    std::cout<<" ######## Error: SampleGammaWidths parameter for generating the statistical nucleus with A="<<A_Int<<" and Z="<<Z_Int<<" has been set to SampleGammaWidths="<<SampleGammaWidths<<", and has to be SampleGammaWidths=0, 1 or 2 ########"<<std::endl; NuDEXException(__FILE__,std::to_string(__LINE__).c_str(),"##### Error in NuDEX #####");
   }
   //-------------------------------------------------------
 
@@ -1888,11 +2834,21 @@ void NuDEXStatisticalNucleus::GenerateThermalCaptureLevelBR(const char* dirname)
 
   //------------------------------------------------------------------------------------------------------
   //We calculate which transitrions go to an existing level and the total intensity of the transitions:
-  double totalThGInt=0,ENDSFLevelEnergy=0,MinlevelDist=0,MinlevelDist_known=0,LevDist=0;
+  double totalThGInt=0,ENDSFLevelEnergy=0,MinlevelDist=0,MinlevelDist_known=0;
   int i_closest=0,i_closest_known=0;
   double MaxAllowedLevelDistance=0.010; //10 keV
   bool ComputePrimaryGammasEcut=false;
   if(PrimaryGammasEcut==0){ComputePrimaryGammasEcut=true;}
+
+  //Known levels below the thermal capture level (sorted by energy, as all the levels):
+  std::vector<int> knownLevelIDs;
+  std::vector<double> knownLevelEnergies;
+  for(int j=0;j<NLevelsBelowThermalCaptureLevel;j++){
+    if(theLevels[j].KnownLevelID>=0){
+      knownLevelIDs.push_back(j);
+      knownLevelEnergies.push_back(theLevels[j].Energy);
+    }
+  }
   
   //We take only those intensities going to our levels:
   for(int i=0;i<ng;i++){
@@ -1904,18 +2860,15 @@ void NuDEXStatisticalNucleus::GenerateThermalCaptureLevelBR(const char* dirname)
     MinlevelDist=1.e20;
     i_closest_known=0;
     MinlevelDist_known=1.e20;
-    for(int j=0;j<NLevelsBelowThermalCaptureLevel;j++){
-      LevDist=std::fabs(ENDSFLevelEnergy-theLevels[j].Energy);
-      if(theLevels[j].KnownLevelID>=0){ //then this is a known level. We priorize known levels.
-	if(LevDist<MinlevelDist_known){
-	  MinlevelDist_known=LevDist;
-	  i_closest_known=j;
-	}
-      }
-      if(LevDist<MinlevelDist){
-	MinlevelDist=LevDist;
-	i_closest=j;
-      }
+    int j=FindClosestEnergy(theLevelsSoA.Energy,NLevelsBelowThermalCaptureLevel,ENDSFLevelEnergy);
+    if(j>=0){
+      i_closest=j;
+      MinlevelDist=std::fabs(ENDSFLevelEnergy-theLevels[j].Energy);
+    }
+    j=FindClosestEnergy(knownLevelEnergies.data(),(int)knownLevelEnergies.size(),ENDSFLevelEnergy);
+    if(j>=0){ //We priorize known levels.
+      i_closest_known=knownLevelIDs[j];
+      MinlevelDist_known=std::fabs(ENDSFLevelEnergy-theLevels[i_closest_known].Energy);
     }
     if(MinlevelDist_known<MaxAllowedLevelDistance){ // We priorize known levels.
       theThermalCaptureLevelCumulBR[i_closest_known]=ThI[i];
@@ -1928,7 +2881,7 @@ void NuDEXStatisticalNucleus::GenerateThermalCaptureLevelBR(const char* dirname)
   }
   //if(TotalThI>0){std::cout<<" NuDEX: Primary thermal gammas for ZA="<<Z_Int*1000+A_Int<<" file:  "<<TotalThI<<" accepted:  "<<totalThGInt<<" ratio: "<<totalThGInt/TotalThI*100.<<" %"<<std::endl;}
   //else{std::cout<<" Primary thermal gammas for "<<Z_Int*1000+A_Int<<" file:  "<<TotalThI<<std::endl;}
-  std::cout<<" NuDEX: Primary thermal gammas for ZA="<<Z_Int*1000+A_Int<<" found in the database: "<<totalThGInt*100.<<" %"<<std::endl;
+  if(Verbosity>0){std::cout<<" NuDEX: Primary thermal gammas for ZA="<<Z_Int*1000+A_Int<<" found in the database: "<<totalThGInt*100.<<" %"<<std::endl;}
   //------------------------------------------------------------------------------------------------------
 
   //------------------------------------------------------------------------------------------------------
@@ -1941,9 +2894,11 @@ void NuDEXStatisticalNucleus::GenerateThermalCaptureLevelBR(const char* dirname)
     Level tmpLevel;
     CopyLevel(&theLevels[NLevelsBelowThermalCaptureLevel],&tmpLevel);
     CopyLevel(&theThermalCaptureLevel,&theLevels[NLevelsBelowThermalCaptureLevel]);
+    UpdateLevelsSoA(NLevelsBelowThermalCaptureLevel);
     double* CumulBR_th_v2=new double[NLevelsBelowThermalCaptureLevel];
     ComputeDecayIntensities(NLevelsBelowThermalCaptureLevel,CumulBR_th_v2);
     CopyLevel(&tmpLevel,&theLevels[NLevelsBelowThermalCaptureLevel]);
+    UpdateLevelsSoA(NLevelsBelowThermalCaptureLevel);
     //-------------------------
     
     for(int i=0;i<NLevelsBelowThermalCaptureLevel;i++){
@@ -1972,11 +2927,17 @@ void NuDEXStatisticalNucleus::GenerateThermalCaptureLevelBR(const char* dirname)
    theThermalCaptureLevelCumulBR[i]/=theThermalCaptureLevelCumulBR[NLevelsBelowThermalCaptureLevel-1];
   }
 
+  if(theThermalCaptureLevelAliasBR){DeleteAliasTable(theThermalCaptureLevelAliasBR); theThermalCaptureLevelAliasBR=0;}
+  if(BRSamplingOpt==1){
+    theThermalCaptureLevelAliasBR=CreateAliasTable(theThermalCaptureLevelCumulBR,NLevelsBelowThermalCaptureLevel);
+  }
 }
 
 //Cambiamos las intensidades de los "primary gammas". Del correspondiente al ninvel con energía "LevelEnergy"
 void NuDEXStatisticalNucleus::ChangeThermalCaptureLevelBR(double LevelEnergy,double absoluteIntensity){
 
+  CheckNoAttachedSamplers();
+
   if(!theThermalCaptureLevelCumulBR){return;}
   int level_id=GetClosestLevel(LevelEnergy,-1,true);
   if(level_id<0 || level_id>=NLevelsBelowThermalCaptureLevel){
@@ -1996,6 +2957,10 @@ void NuDEXStatisticalNucleus::ChangeThermalCaptureLevelBR(double LevelEnergy,dou
   for(int i=0;i<NLevelsBelowThermalCaptureLevel;i++){
    theThermalCaptureLevelCumulBR[i]/=theThermalCaptureLevelCumulBR[NLevelsBelowThermalCaptureLevel-1];
   }
+  if(theThermalCaptureLevelAliasBR){DeleteAliasTable(theThermalCaptureLevelAliasBR); theThermalCaptureLevelAliasBR=0;}
+  if(BRSamplingOpt==1){
+    theThermalCaptureLevelAliasBR=CreateAliasTable(theThermalCaptureLevelCumulBR,NLevelsBelowThermalCaptureLevel);
+  }
   if(level_id==0){
     std::cout<<" Thermal primary gammas to level "<<level_id<<", with E="<<theLevels[level_id].Energy<<" MeV changed from "<<OldIntensity<<" to "<<theThermalCaptureLevelCumulBR[level_id]<<std::endl;
   }
@@ -2004,26 +2969,162 @@ void NuDEXStatisticalNucleus::ChangeThermalCaptureLevelBR(double LevelEnergy,dou
   }
 }
 
+//Memory needed to store the BR of all the levels in the unknown part of the level scheme, taking into account
+//only the transitions allowed by the spin-parity selection rules (E1, M1, E2). The levels are sorted by energy.
+void NuDEXStatisticalNucleus::ComputeBRMemoryBudget(){
+
+  int maxspinx2found=0;
+  for(int i=0;i<NLevels;i++){
+    if(theLevels[i].spinx2>maxspinx2found){maxspinx2found=theLevels[i].spinx2;}
+  }
+  int NSpins=maxspinx2found+1;
+  double* NLevelsBelow=new double[2*NSpins]; //[parity*NSpins+spinx2]
+  for(int i=0;i<2*NSpins;i++){NLevelsBelow[i]=0;}
+
+  double NAllowed=0,NTotal=0,NRows=0;
+  for(int i=0;i<NLevels;i++){
+    if(HasStatisticalBR(i)){
+      NRows++;
+      NTotal+=i;
+      double thisNAllowed=0;
+      for(int spinx2=0;spinx2<NSpins;spinx2++){
+	for(int par=0;par<2;par++){
+	  if(NLevelsBelow[par*NSpins+spinx2]==0){continue;}
+	  int Lmin=std::abs(theLevels[i].spinx2-spinx2)/2;
+	  int Lmax=(theLevels[i].spinx2+spinx2)/2;
+	  bool allowed=false;
+	  if(Lmin<=1 && Lmax>=1){allowed=true;} //E1 or M1
+	  if((bool)par==theLevels[i].parity && Lmin<=2 && Lmax>=2){allowed=true;} //E2
+	  if(allowed){thisNAllowed+=NLevelsBelow[par*NSpins+spinx2];}
+	}
+      }
+      if(thisNAllowed==0){thisNAllowed=i;} //then all the transitions are allowed (see ComputeDecayIntensities)
+      NAllowed+=thisNAllowed;
+    }
+    if(theLevels[i].spinx2>=0){
+      NLevelsBelow[(int)theLevels[i].parity*NSpins+theLevels[i].spinx2]++;
+    }
+  }
+  delete [] NLevelsBelow;
+
+  double BytesPerBR=sizeof(int)+sizeof(double);
+  if(BRStorageOpt==1){BytesPerBR=sizeof(int)+sizeof(float);}
+  BRMemoryBudget_MB=(NAllowed*BytesPerBR+NRows*sizeof(SparseBR))/1.e6;
+  BRMemoryDense_MB=NTotal*sizeof(double)/1.e6;
+}
+
+bool NuDEXStatisticalNucleus::HasStatisticalBR(int i_level){
+
+  if(i_level<=0 || i_level<NKnownLevels){return false;}
+  if(theLevels[i_level].KnownLevelID>0){
+    if(theKnownLevels[theLevels[i_level].KnownLevelID].NGammas>0){return false;}
+  }
+  return true;
+}
+
+//Each level has its own seed to compute the BR, so they can be computed in any order and by any thread.
+//Each thread has its own NuDEXCascadeSampler (i.e., its own theRandom2).
+void NuDEXStatisticalNucleus::PrecomputeBR(int nThreads){
+
+  if(!hasBeenInitialized || TotalGammaRho==0){
+    std::cout<<" ############## Error: NuDEXStatisticalNucleus::PrecomputeBR cannot be used before initializing the nucleus  ##############"<<std::endl;
+    NuDEXException(__FILE__,std::to_string(__LINE__).c_str(),"##### Error in NuDEX #####");
+  }
+  std::vector<int> levels;
+  for(int i_level=NLevels-1;i_level>0;i_level--){ //the highest levels (the most expensive ones) first
+    levels.push_back(i_level);
+  }
+  PrecomputeBR(nThreads,levels);
+}
+
+void NuDEXStatisticalNucleus::PrecomputeBR(int nThreads,const std::vector<int>& levels){
+
+  if(!hasBeenInitialized || TotalGammaRho==0){
+    std::cout<<" ############## Error: NuDEXStatisticalNucleus::PrecomputeBR cannot be used before initializing the nucleus  ##############"<<std::endl;
+    NuDEXException(__FILE__,std::to_string(__LINE__).c_str(),"##### Error in NuDEX #####");
+  }
+  if(nThreads<1){nThreads=1;}
+
+  std::atomic<int> nextLevel(0);
+  std::vector<std::thread> theThreads;
+  for(int i=0;i<nThreads;i++){
+    theThreads.push_back(std::thread([this,&nextLevel,&levels](){
+      NuDEXCascadeSampler aSampler(this,1);
+      int k;
+      while((k=nextLevel++)<(int)levels.size()){
+	int i_level=levels[k];
+	if(i_level>=NLevels || !HasStatisticalBR(i_level)){continue;}
+	if(BROpt==1){
+	  GetTotalCumulBR(i_level,&aSampler);
+	  if(BRSamplingOpt==1){GetTotalAliasBR(i_level,&aSampler);}
+	}
+	else{
+	  GetTotalGammaRho(i_level,&aSampler);
+	}
+      }
+    }));
+  }
+  for(int i=0;i<nThreads;i++){
+    theThreads[i].join();
+  }
+}
+
+//Stores the BR of levels which start the cascades (e.g. the starting levels of a NuDEXNeutronSpectrum), whatever BROpt is.
+//They are used only for the first transition of the cascades (see NuDEXCascadeSampler::SampleFinalLevel), so the results are the same.
+void NuDEXStatisticalNucleus::PrecomputeEntryBR(int nThreads,const std::vector<int>& levels){
+
+  if(!hasBeenInitialized || TotalGammaRho==0){
+    std::cout<<" ############## Error: NuDEXStatisticalNucleus::PrecomputeEntryBR cannot be used before initializing the nucleus  ##############"<<std::endl;
+    NuDEXException(__FILE__,std::to_string(__LINE__).c_str(),"##### Error in NuDEX #####");
+  }
+  if(nThreads<1){nThreads=1;}
+
+  std::atomic<int> nextLevel(0);
+  std::vector<std::thread> theThreads;
+  for(int i=0;i<nThreads;i++){
+    theThreads.push_back(std::thread([this,&nextLevel,&levels](){
+      NuDEXCascadeSampler aSampler(this,1);
+      int k;
+      while((k=nextLevel++)<(int)levels.size()){
+	int i_level=levels[k];
+	if(i_level>=NLevels || !HasStatisticalBR(i_level)){continue;}
+	GetTotalCumulBR(i_level,&aSampler);
+	if(BRSamplingOpt==1){GetTotalAliasBR(i_level,&aSampler);}
+      }
+    }));
+  }
+  for(int i=0;i<nThreads;i++){
+    theThreads[i].join();
+  }
+}
+
 void NuDEXStatisticalNucleus::PrintParameters(std::ostream &out){
 
   out<<" ###################################################################################### "<<std::endl;
   out<<" GENERAL_PARS"<<std::endl;
   out<<" Z = "<<Z_Int<<"  A = "<<A_Int<<std::endl;
   out<<" Sn = "<<Sn<<"  I0(ZA-1) = "<<I0<<std::endl;
-  if(theLD!=0){theLD->PrintParameters(out);}
+  if(theLD!=0){theLD->PrintParameters(out); out<<" LDTablePointsPerMeV = "<<LDTablePointsPerMeV<<std::endl;}
   else{out<<" No level density"<<std::endl;}
-  out<<" PSFflag = "<<PSFflag<<std::endl;
+  out<<" PSFflag = "<<PSFflag<<"   PSFTabulationError = "<<PSFTabulationError<<std::endl;
   out<<" Ecrit = "<<Ecrit<<std::endl;
   out<<" E_unknown_min = "<<E_unk_min<<"  E_unknown_max = "<<E_unk_max<<std::endl;
   out<<" maxspin = "<<maxspinx2/2.<<std::endl;
   out<<" MaxExcEnergy = "<<MaxExcEnergy<<std::endl;
   out<<" NBands = "<<NBands<<"  MinLevelsPerBand = "<<MinLevelsPerBand<<"  BandWidth = "<<BandWidth<<std::endl;
+  out<<" LevelSchemeNThreads = "<<LevelSchemeNThreads<<std::endl;
   out<<" Emin_bands = "<<Emin_bands<<"  Emax_bands = "<<Emax_bands<<std::endl;
   out<<" NLevels = "<<NLevels<<"   NKnownLevels = "<<NKnownLevels<<"   NUnknownLevels = "<<NUnknownLevels<<std::endl;
-  out<<" BROpt = "<<BROpt<<"   SampleGammaWidths = "<<SampleGammaWidths<<std::endl;
+  out<<" BROpt = "<<BROpt<<"   BRSamplingOpt = "<<BRSamplingOpt<<"   BRStorageOpt = "<<BRStorageOpt<<"   SampleGammaWidths = "<<SampleGammaWidths<<std::endl;
+  if(BROpt==1 || BROpt==2){
+    out<<" BR memory budget = "<<BRMemoryBudget_MB<<" MB   (dense storage: "<<BRMemoryDense_MB<<" MB)"<<std::endl;
+  }
+  if(BROpt==0 || BROpt==2){
+    out<<" BR cache size = "<<BRCacheSize_MB<<" MB (per cascade sampler)"<<std::endl;
+  }
   out<<" PrimaryGammasIntensityNormFactor = "<<PrimaryGammasIntensityNormFactor<<"   PrimaryGammasEcut = "<<PrimaryGammasEcut<<std::endl;
   out<<" KnownLevelsFlag = "<<KnownLevelsFlag<<std::endl;
-  out<<" ElectronConversionFlag = "<<ElectronConversionFlag<<std::endl;
+  out<<" ElectronConversionFlag = "<<ElectronConversionFlag<<"   ICCTablePointsPerDecade = "<<ICCTablePointsPerDecade<<std::endl;
   out<<" ###################################################################################### "<<std::endl;
 
 }
@@ -2180,11 +3281,13 @@ void NuDEXStatisticalNucleus::PrintThermalPrimaryTransitions(std::ostream &out){
 
 void NuDEXStatisticalNucleus::PrintTotalCumulBR(int i_level,std::ostream &out){
 
-  if(TotalCumulBR[i_level]!=0){
+  if(TotalCumulBR!=0 && TotalCumulBR[i_level]!=0){
+    SparseBR* cumulBR=TotalCumulBR[i_level];
     out<<" #################################################### "<<std::endl;
-    out<<" CUMULBR FROM LEVEL "<<i_level<<" with ENERGY "<<theLevels[i_level].Energy<<std::endl;
-    for(int i=0;i<i_level;i++){
-      out<<theLevels[i].Energy<<"  "<<theLevels[i].spinx2/2.<<"  "<<theLevels[i].parity<<"  "<<TotalCumulBR[i_level][i]<<std::endl;
+    out<<" CUMULBR FROM LEVEL "<<i_level<<" with ENERGY "<<theLevels[i_level].Energy<<" (only the non-zero BR)"<<std::endl;
+    for(int k=0;k<cumulBR->N;k++){
+      int i=cumulBR->FinalLevel[k];
+      out<<theLevels[i].Energy<<"  "<<theLevels[i].spinx2/2.<<"  "<<theLevels[i].parity<<"  "<<GetSparseBRCumul(cumulBR,k)<<std::endl;
     }
     out<<" #################################################### "<<std::endl;
   }
@@ -2193,16 +3296,18 @@ void NuDEXStatisticalNucleus::PrintTotalCumulBR(int i_level,std::ostream &out){
 
 void NuDEXStatisticalNucleus::PrintBR(int i_level,double MaxExcEneToPrint_MeV,std::ostream &out){
 
-  if(TotalCumulBR[i_level]!=0){
+  if(TotalCumulBR!=0 && TotalCumulBR[i_level]!=0){
+    SparseBR* cumulBR=TotalCumulBR[i_level];
     out<<" #################################################### "<<std::endl;
-    out<<" BR FROM LEVEL "<<i_level<<" with ENERGY "<<theLevels[i_level].Energy<<std::endl;
-    for(int i=0;i<i_level;i++){
+    out<<" BR FROM LEVEL "<<i_level<<" with ENERGY "<<theLevels[i_level].Energy<<" (only the non-zero BR)"<<std::endl;
+    for(int k=0;k<cumulBR->N;k++){
+      int i=cumulBR->FinalLevel[k];
       if(theLevels[i].Energy<MaxExcEneToPrint_MeV || MaxExcEneToPrint_MeV<0){
-	if(i==0){
-	  out<<theLevels[i].Energy<<"  "<<theLevels[i].spinx2/2.<<"  "<<theLevels[i].parity<<"  "<<TotalCumulBR[i_level][i]<<std::endl;
+	if(k==0){
+	  out<<theLevels[i].Energy<<"  "<<theLevels[i].spinx2/2.<<"  "<<theLevels[i].parity<<"  "<<GetSparseBRCumul(cumulBR,k)<<std::endl;
 	}
 	else{
-	  out<<theLevels[i].Energy<<"  "<<theLevels[i].spinx2/2.<<"  "<<theLevels[i].parity<<"  "<<TotalCumulBR[i_level][i]-TotalCumulBR[i_level][i-1]<<std::endl;
+	  out<<theLevels[i].Energy<<"  "<<theLevels[i].spinx2/2.<<"  "<<theLevels[i].parity<<"  "<<GetSparseBRCumul(cumulBR,k)-GetSparseBRCumul(cumulBR,k-1)<<std::endl;
 	}
       }
     }
@@ -2212,7 +3317,6 @@ void NuDEXStatisticalNucleus::PrintBR(int i_level,double MaxExcEneToPrint_MeV,st
   
 }
 
-
 void NuDEXStatisticalNucleus::PrintPSF(std::ostream &out){
 
   thePSF->PrintPSFParameters(out);
@@ -2276,6 +3380,8 @@ void NuDEXStatisticalNucleus::PrintAll(std::ostream &out){
 void NuDEXStatisticalNucleus::PrintInput01(std::ostream &out){
 
   out<<"LEVELDENSITYTYPE "<<LevelDensityType<<std::endl;
+  out<<"LDTABLEPOINTSPERMEV "<<LDTablePointsPerMeV<<std::endl;
+  out<<"LEVELSCHEMENTHREADS "<<LevelSchemeNThreads<<std::endl;
   out<<"MAXSPIN "<<maxspinx2/2.<<std::endl;
   out<<"MINLEVELSPERBAND "<<MinLevelsPerBand<<std::endl;
   out<<"BANDWIDTH_MEV "<<BandWidth<<std::endl;
@@ -2284,7 +3390,13 @@ void NuDEXStatisticalNucleus::PrintInput01(std::ostream &out){
   out<<"KNOWNLEVELSFLAG "<<KnownLevelsFlag<<std::endl;
   out<<std::endl;
   out<<"PSF_FLAG "<<PSFflag<<std::endl;
+  out<<"PSFTABULATIONERROR "<<PSFTabulationError<<std::endl;
+  out<<"ICCTABLEPOINTSPERDECADE "<<ICCTablePointsPerDecade<<std::endl;
   out<<"BROPTION "<<BROpt<<std::endl;
+  out<<"BRSAMPLINGOPTION "<<BRSamplingOpt<<std::endl;
+  out<<"BRSTORAGEOPTION "<<BRStorageOpt<<std::endl;
+  out<<"BRCACHESIZE_MB "<<BRCacheSize_MB<<std::endl;
+  out<<"BRPRECOMPUTENTHREADS "<<BRPrecomputeNThreads<<std::endl;
   out<<"SAMPLEGAMMAWIDTHS "<<SampleGammaWidths<<std::endl;
   out<<std::endl;
   out<<"SEED1 "<<seed1<<std::endl;
@@ -2302,13 +3414,8 @@ void NuDEXStatisticalNucleus::PrintInput01(std::ostream &out){
 
 }
 
-int ComparisonLevels(const void* va, const void* vb)
-{
- Level* a, *b;
- a = (Level*) va;
- b = (Level*) vb;
- if( a->Energy == b->Energy ) return 0;
- return( ( a->Energy ) > ( b->Energy ) ) ? 1:-1;
+bool LevelEnergyLess(const Level& a,const Level& b){
+  return a.Energy<b.Energy;
 }
 
 void CopyLevel(Level* a,Level* b){
@@ -2334,4 +3441,153 @@ void CopyLevel(KnownLevel* a,Level* b){
 
 
 
+//Vose's method. The probabilities are taken from the cumulative distribution:
+AliasTable* CreateAliasTable(const double* cumulativeBR,int n){
+
+  if(n<=0 || cumulativeBR==0){
+    NuDEXException(__FILE__,std::to_string(__LINE__).c_str(),"##### Error in NuDEX #####");
+  }
+  AliasTable* a=new AliasTable;
+  a->N=n;
+  a->Prob=new double[n];
+  a->Alias=new int[n];
+
+  double total=cumulativeBR[n-1];
+  int* small=new int[n];
+  int* large=new int[n];
+  int nsmall=0,nlarge=0;
+  for(int i=0;i<n;i++){
+    double p=cumulativeBR[i];
+    if(i>0){p-=cumulativeBR[i-1];}
+    a->Prob[i]=p/total*n;
+    a->Alias[i]=i;
+    if(a->Prob[i]<1){small[nsmall++]=i;}
+    else{large[nlarge++]=i;}
+  }
+  while(nsmall>0 && nlarge>0){
+    int s=small[--nsmall];
+    int l=large[--nlarge];
+    a->Alias[s]=l;
+    a->Prob[l]=(a->Prob[l]+a->Prob[s])-1;
+    if(a->Prob[l]<1){small[nsmall++]=l;}
+    else{large[nlarge++]=l;}
+  }
+  //The remaining ones (rounding errors) are always sampled:
+  while(nlarge>0){a->Prob[large[--nlarge]]=1;}
+  while(nsmall>0){a->Prob[small[--nsmall]]=1;}
+  delete [] small;
+  delete [] large;
+
+  return a;
+}
+
+void DeleteAliasTable(AliasTable* a){
+  delete [] a->Prob;
+  delete [] a->Alias;
+  delete a;
+}
+
+int SampleFromAliasTable(const AliasTable* a,double randnumber){
+  double x=randnumber*a->N;
+  int i=(int)x;
+  if(i>=a->N){i=a->N-1;}
+  if(x-i<a->Prob[i]){return i;}
+  return a->Alias[i];
+}
+
+int SampleFromCumulative(const double* cumulativeBR,int n,double randnumber){
+  int i=(int)(std::upper_bound(cumulativeBR,cumulativeBR+n,randnumber)-cumulativeBR);
+  if(i>=n){return -1;}
+  return i;
+}
+
+int FindClosestEnergy(const double* energies,int n,double Energy){
+  if(n<=0){return -1;}
+  int i_up=(int)(std::upper_bound(energies,energies+n,Energy)-energies); //first one above Energy
+  int i_down=i_up-1; //last one below (or equal)
+  if(i_down<0){return i_up;}
+  while(i_down>0 && energies[i_down-1]==energies[i_down]){i_down--;}
+  if(i_up>=n || std::fabs(Energy-energies[i_down])<=std::fabs(Energy-energies[i_up])){return i_down;}
+  return i_up;
+}
+
+SparseBR* CreateSparseBR(const double* cumulativeBR,int n,bool useFloat){
+
+  SparseBR* a=new SparseBR;
+  a->N=0;
+  for(int i=0;i<n;i++){
+    if(i==0){if(cumulativeBR[i]>0){a->N++;}}
+    else if(cumulativeBR[i]>cumulativeBR[i-1]){a->N++;}
+  }
+  a->FinalLevel=new int[a->N];
+  a->CumulBR=0; a->CumulBRf=0;
+  if(useFloat){a->CumulBRf=new float[a->N];}
+  else{a->CumulBR=new double[a->N];}
+  int k=0;
+  for(int i=0;i<n;i++){
+    if((i==0 && cumulativeBR[i]>0) || (i>0 && cumulativeBR[i]>cumulativeBR[i-1])){
+      a->FinalLevel[k]=i;
+      if(useFloat){a->CumulBRf[k]=(float)cumulativeBR[i];}
+      else{a->CumulBR[k]=cumulativeBR[i];}
+      k++;
+    }
+  }
+  //With float the last value could be below 1, and some random numbers could not be sampled:
+  if(useFloat && a->N>0){a->CumulBRf[a->N-1]=1;}
+
+  return a;
+}
+
+void DeleteSparseBR(SparseBR* a){
+  delete [] a->FinalLevel;
+  if(a->CumulBR!=0){delete [] a->CumulBR;}
+  if(a->CumulBRf!=0){delete [] a->CumulBRf;}
+  delete a;
+}
+
+double GetSparseBRCumul(const SparseBR* a,int k){
+  if(a->CumulBRf!=0){return a->CumulBRf[k];}
+  return a->CumulBR[k];
+}
+
+AliasTable* CreateAliasTable(const SparseBR* a){
+  double* cumulativeBR=new double[a->N];
+  for(int k=0;k<a->N;k++){cumulativeBR[k]=GetSparseBRCumul(a,k);}
+  AliasTable* result=CreateAliasTable(cumulativeBR,a->N);
+  delete [] cumulativeBR;
+  return result;
+}
+
+int SampleFromSparseBR(const SparseBR* a,double randnumber){
+  int k;
+  if(a->CumulBRf!=0){
+    k=(int)(std::upper_bound(a->CumulBRf,a->CumulBRf+a->N,randnumber)-a->CumulBRf);
+  }
+  else{
+    k=(int)(std::upper_bound(a->CumulBR,a->CumulBR+a->N,randnumber)-a->CumulBR);
+  }
+  if(k>=a->N){return -1;}
+  return a->FinalLevel[k];
+}
+
+void DeleteDecayIntensitiesRow(DecayIntensitiesRow* a){
+  delete [] a->FinalLevel;
+  delete [] a->SumGammaRho;
+  delete [] a->GammaRhoMult;
+  delete a;
+}
+
+double GetDecayIntensitiesRowMemory_MB(const DecayIntensitiesRow* a){
+  return (sizeof(DecayIntensitiesRow)+a->N*(sizeof(int)+4*sizeof(double)))/1.e6;
+}
+
+//Same result as ComputeDecayIntensities(i_level,0,randnumber,TotGR), with SampledGammaRho=TotGR*randnumber
+int SampleFromDecayIntensitiesRow(const DecayIntensitiesRow* a,double SampledGammaRho,int& multipolarity){
+  int k=(int)(std::lower_bound(a->SumGammaRho,a->SumGammaRho+a->N,SampledGammaRho)-a->SumGammaRho);
+  if(k>=a->N){return -1;}
+  double PreviousGammaRho=0;
+  if(k>0){PreviousGammaRho=a->SumGammaRho[k-1];}
+  multipolarity=SampleMultipolarity(PreviousGammaRho,&a->GammaRhoMult[3*k],SampledGammaRho);
+  return a->FinalLevel[k];
+}
 
@@ -9,6 +9,7 @@
 #include "PrimaryGeneratorAction.hh"
 #include "globals.hh"
 #include <string>
+#include <vector>
 
 class ActionInitialization : public G4VUserActionInitialization
 {
@@ -16,7 +17,18 @@ public:
     ActionInitialization(bool generateCascades = true,
                         SourceMode sourceMode = (SourceMode)0,
                         int nudexZA = 17035,
-                        const std::string& nudexLibDir = "../NuDEX/NuDEXlib/");
+                        const std::string& nudexLibDir = "../NuDEX/NuDEXlib/",
+                        const std::string& nudexLibraryFile = "",
+                        bool nudexLibrarySequential = false,
+                        int nudexProducerThreads = 0,
+                        unsigned int nudexProducerSeed = 1234567,
+                        const std::vector<int>& nudexMixZA = std::vector<int>(),
+                        const std::vector<double>& nudexMixWeights = std::vector<double>(),
+                        const std::string& nudexSpectrumFile = "",
+                        int nudexEnsembleSize = 1,
+                        long long nudexEnsembleBlock = 1,
+                        int nudexInitThreads = 1,
+                        int nudexPrecomputeBRThreads = 0);
     virtual ~ActionInitialization();
 
     virtual void BuildForMaster() const;
@@ -27,6 +39,17 @@ private:
     SourceMode fSourceMode;
     int fNuDEX_ZA;
     std::string fNuDEXLibDir;
+    std::string fNuDEXLibraryFile;
+    bool fNuDEXLibrarySequential;
+    int fNuDEXProducerThreads;
+    unsigned int fNuDEXProducerSeed;
+    std::vector<int> fNuDEXMixZA;
+    std::vector<double> fNuDEXMixWeights;
+    std::string fNuDEXSpectrumFile;
+    int fNuDEXEnsembleSize;
+    long long fNuDEXEnsembleBlock;
+    int fNuDEXInitThreads;
+    int fNuDEXPrecomputeBRThreads;
 };
 
 #endif
@@ -15,6 +15,11 @@
 
 // NuDEX: statistical de-excitation cascades after neutron capture
 #include "NuDEXStatisticalNucleus.hh"
+#include "NuDEXCascadeSampler.hh"
+#include "NuDEXNucleusRegistry.hh"
+#include "NuDEXCascadeLibrary.hh"
+#include "NuDEXCascadeProducer.hh"
+#include "NuDEXNeutronSpectrum.hh"
 
 class G4ParticleGun;
 class G4Event;
@@ -49,7 +54,9 @@ struct TwoGammaPair {
 enum SourceMode {
     CO60_CASCADE,    // Co-60 cascade (2 gammas: 1.173 + 1.332 MeV)
     SINGLE_GAMMA,    // Single gamma mode (random Co-60 gamma)
-    NUDEX_CAPTURE    // Thermal neutron capture cascades via NuDEX
+    NUDEX_CAPTURE,   // Thermal neutron capture cascades via NuDEX
+    NUDEX_LIBRARY,   // NuDEX cascades replayed from a pre-generated cascade library file
+    NUDEX_SPECTRUM   // NuDEX capture cascades with the neutron energy sampled from a histogram
 };
 
 class PrimaryGeneratorAction : public G4VUserPrimaryGeneratorAction
@@ -65,7 +72,28 @@ public:
 
     void SetSourceMode(SourceMode mode);
     // NuDEX configuration
-    void SetNuDEXConfig(int za, const std::string& libdir) { fNuDEX_ZA = za; fNuDEXLibDir = libdir; }
+    void SetNuDEXConfig(int za, const std::string& libdir);
+    // Mixture of isotopes (e.g. natural Cl): one ZA per isotope, with its thermal capture weight
+    // (abundance x cross section). The isotope is sampled per event. Empty --> only the ZA of SetNuDEXConfig
+    void SetNuDEXMixture(const std::vector<int>& za, const std::vector<double>& weights);
+    // Cascade library replayed in NUDEX_LIBRARY mode (random or sequential access)
+    void SetNuDEXLibrary(const std::string& fname, bool sequential);
+    // Neutron energy histogram of NUDEX_SPECTRUM mode (lines "Emin Emax content", MeV)
+    void SetNuDEXSpectrum(const std::string& fname);
+    // Pipelined NUDEX_CAPTURE mode: if nThreads > 0, the cascades are generated ahead of demand by
+    // nThreads background threads (shared by all the workers), and the event k takes the cascade k
+    void SetNuDEXProducers(int nThreads, unsigned int seed);
+    // Ensemble mode: if nRealizations > 1, each isotope has nRealizations realizations of its level scheme
+    // (NuDEXNucleusEnsemble), used one after the other in blocks of blockSize events (by event ID)
+    void SetNuDEXEnsemble(int nRealizations, long long blockSize);
+    int GetNuDEXRealization() const { return fNuDEXRealization; } // of the last event (-1 if none)
+    // Threads used to initialize the NuDEX nuclei (the ones of the run). If precomputeBRThreads > 0 (at most
+    // nThreads), all the BR are computed at initialization with them, instead of when needed (default)
+    void SetNuDEXInitThreads(int nThreads, int precomputeBRThreads);
+    static void PrintNuDEXProducerStatistics();
+    // Called by the RunAction of this thread at the beginning of each run: releases the producer of the
+    // previous run (pipelined mode), so its threads stop as soon as no worker uses it anymore
+    void BeginOfRun();
 
 private:
     G4ParticleGun* fParticleGun;
@@ -75,10 +103,40 @@ private:
     bool fGenerateCascades;                   // Flag for cascade mode
 
     SourceMode fSourceMode;
-    // NuDEX members
-    NuDEXStatisticalNucleus* fNuDEX = nullptr;
+    // NuDEX members: the nuclei (level scheme, BR, ...) are shared by all the threads,
+    // each PrimaryGeneratorAction has its own sampler (random generators) for each isotope and realization,
+    // reseeded at each event
+    struct NuDEXIsotope {
+        int za;
+        double weight;                               // thermal capture weight
+        int realization = 0;                         // of the level scheme (ensemble mode)
+        NuDEXStatisticalNucleus* nucleus = nullptr;  // shared by all the threads
+        NuDEXCascadeSampler* sampler = nullptr;      // not used in pipelined mode
+        const NuDEXNeutronSpectrum* spectrum = nullptr; // NUDEX_SPECTRUM mode, shared by all the threads
+    };
+    std::vector<NuDEXIsotope> fNuDEXIsotopes;       // built at the first event, [isotope*realizations+realization]
+    AliasTable* fNuDEXIsotopeAlias = nullptr;        // isotope sampled per event (if more than one)
     int fNuDEX_ZA = -1;
     std::string fNuDEXLibDir;
+    std::vector<int> fNuDEXMixZA;                   // if not empty, used instead of fNuDEX_ZA
+    std::vector<double> fNuDEXMixWeights;
+    std::string fNuDEXSpectrumFile;
+    int fNuDEXEnsembleSize = 1;
+    long long fNuDEXEnsembleBlock = 1;
+    int fNuDEXInitThreads = 1;
+    int fNuDEXPrecomputeBRThreads = 0;
+    int fNuDEXRealization = -1;
+    int fNuDEXProducerThreads = 0;
+    unsigned int fNuDEXProducerSeed = 1234567;
+    NuDEXCascadeProducer* fNuDEXProducer = nullptr;  // pipelined mode: of the current run, shared by all the threads
+    static const int kNuDEXQueueSize = 4096;         // minimum size of the queue of the producer
+    // Cascade of the event: filled by the sampler, or swapped with the producer in pipelined mode
+    NuDEXCascadeBuffer* fNuDEXCascade = nullptr;
+    // Cascade library (NUDEX_LIBRARY mode): memory mapped by each PrimaryGeneratorAction
+    NuDEXCascadeLibrary* fNuDEXLibrary = nullptr;
+    std::string fNuDEXLibraryFile;
+    bool fNuDEXLibrarySequential = false;
+    long long fNuDEXLibraryNext = 0;
 
     // Methods for cascade handling
     GammaData SampleGamma();                  // Sample individual gamma (legacy)
@@ -91,6 +149,11 @@ private:
     void GenerateSingleGammaEvent(G4Event* anEvent);
     void GenerateCo60Cascade(G4Event* anEvent);
     void GenerateNuDEXCascade(G4Event* anEvent);
+    bool InitNuDEXIsotopes();
+    void ResetNuDEXGenerator();
+    void GenerateNuDEXLibraryCascade(G4Event* anEvent);
+    void AddNuDEXParticle(G4Event* anEvent, char type, double energy, double time,
+                          const G4ThreeVector& position);
     const char* SourceModeToString(SourceMode mode) const;
 };
 
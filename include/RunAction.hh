@@ -11,11 +11,14 @@
 #include "globals.hh"
 
 class G4Run;
+class PrimaryGeneratorAction;
 
 class RunAction : public G4UserRunAction
 {
 public:
-    RunAction();
+    // nudexRealizations > 1: NuDEX ensemble mode, the realization of each event is saved in the ntuple
+    // primaryGenerator: of the same thread (none in the master), told when each run begins
+    RunAction(G4int nudexRealizations = 1, PrimaryGeneratorAction* primaryGenerator = nullptr);
     virtual ~RunAction();
 
     virtual G4Run* GenerateRun();
@@ -24,11 +27,14 @@ public:
 
     void AddEnergyDepositDet1(G4double edep);
     void AddEnergyDepositDet2(G4double edep);
+    G4int GetNuDEXRealizations() const { return fNuDEXRealizations; }
 
 private:
     G4Accumulable<G4double> fEnergyDepositDet1;
     G4Accumulable<G4double> fEnergyDepositDet2;
     G4Accumulable<G4int> fEventCountDet1;
     G4Accumulable<G4int> fEventCountDet2;
+    G4int fNuDEXRealizations;
+    PrimaryGeneratorAction* fPrimaryGenerator;
 };
 #endif
\ No newline at end of file
@@ -15,12 +15,34 @@ extern bool g_quietMode;
 ActionInitialization::ActionInitialization(bool generateCascades,
                                          SourceMode sourceMode,
                                          int nudexZA,
-                                         const std::string& nudexLibDir)
+                                         const std::string& nudexLibDir,
+                                         const std::string& nudexLibraryFile,
+                                         bool nudexLibrarySequential,
+                                         int nudexProducerThreads,
+                                         unsigned int nudexProducerSeed,
+                                         const std::vector<int>& nudexMixZA,
+                                         const std::vector<double>& nudexMixWeights,
+                                         const std::string& nudexSpectrumFile,
+                                         int nudexEnsembleSize,
+                                         long long nudexEnsembleBlock,
+                                         int nudexInitThreads,
+                                         int nudexPrecomputeBRThreads)
 : G4VUserActionInitialization(),
   fGenerateCascades(generateCascades),
   fSourceMode(sourceMode),
   fNuDEX_ZA(nudexZA),
-  fNuDEXLibDir(nudexLibDir)
+  fNuDEXLibDir(nudexLibDir),
+  fNuDEXLibraryFile(nudexLibraryFile),
+  fNuDEXLibrarySequential(nudexLibrarySequential),
+  fNuDEXProducerThreads(nudexProducerThreads),
+  fNuDEXProducerSeed(nudexProducerSeed),
+  fNuDEXMixZA(nudexMixZA),
+  fNuDEXMixWeights(nudexMixWeights),
+  fNuDEXSpectrumFile(nudexSpectrumFile),
+  fNuDEXEnsembleSize(nudexEnsembleSize),
+  fNuDEXEnsembleBlock(nudexEnsembleBlock),
+  fNuDEXInitThreads(nudexInitThreads),
+  fNuDEXPrecomputeBRThreads(nudexPrecomputeBRThreads)
 {}
 
 //....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
@@ -33,7 +55,7 @@ ActionInitialization::~ActionInitialization()
 void ActionInitialization::BuildForMaster() const
 {
     // Master thread only creates RunAction for global run accumulation
-    SetUserAction(new RunAction);
+    SetUserAction(new RunAction(fNuDEXEnsembleSize));
 }
 
 //....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
@@ -45,13 +67,19 @@ void ActionInitialization::Build() const
         new PrimaryGeneratorAction(fGenerateCascades, fSourceMode);
     // Pass NuDEX configuration
     primaryGenerator->SetNuDEXConfig(fNuDEX_ZA, fNuDEXLibDir);
+    primaryGenerator->SetNuDEXLibrary(fNuDEXLibraryFile, fNuDEXLibrarySequential);
+    primaryGenerator->SetNuDEXProducers(fNuDEXProducerThreads, fNuDEXProducerSeed);
+    primaryGenerator->SetNuDEXMixture(fNuDEXMixZA, fNuDEXMixWeights);
+    primaryGenerator->SetNuDEXSpectrum(fNuDEXSpectrumFile);
+    primaryGenerator->SetNuDEXEnsemble(fNuDEXEnsembleSize, fNuDEXEnsembleBlock);
+    primaryGenerator->SetNuDEXInitThreads(fNuDEXInitThreads, fNuDEXPrecomputeBRThreads);
 
     // CASCADE mode removed
 
     SetUserAction(primaryGenerator);
 
     // Run action
-    RunAction* runAction = new RunAction();
+    RunAction* runAction = new RunAction(fNuDEXEnsembleSize, primaryGenerator);
     SetUserAction(runAction);
 
     // Event action
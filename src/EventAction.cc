@@ -3,6 +3,7 @@
 
 #include "EventAction.hh"
 #include "RunAction.hh"
+#include "PrimaryGeneratorAction.hh"
 
 #include "G4Event.hh"
 #include "Run.hh"
@@ -74,6 +75,11 @@ void EventAction::EndOfEventAction(const G4Event* event)
         // Convert energies from MeV to keV
         analysisManager->FillNtupleDColumn(0, fEnergyDepositDet1 / keV);
         analysisManager->FillNtupleDColumn(1, fEnergyDepositDet2 / keV);
+        if (fRunAction->GetNuDEXRealizations() > 1) {
+            const PrimaryGeneratorAction* generatorAction = static_cast<const PrimaryGeneratorAction*>(
+                G4RunManager::GetRunManager()->GetUserPrimaryGeneratorAction());
+            analysisManager->FillNtupleIColumn(2, generatorAction ? generatorAction->GetNuDEXRealization() : -1);
+        }
         analysisManager->AddNtupleRow();
     }
 
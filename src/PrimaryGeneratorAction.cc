@@ -16,8 +16,13 @@
 #include "Randomize.hh"
 #include "G4PhysicalConstants.hh"
 #include "G4Event.hh"
+#include "G4Run.hh"
+#include "G4RunManager.hh"
+#include "G4MTRunManager.hh"
 #include "G4Gamma.hh"
 #include "G4ReactionProduct.hh"
+#include "G4AutoLock.hh"
+#include "G4Threading.hh"
 #include <fstream>
 #include <iostream>
 #include <iomanip>
@@ -25,10 +30,190 @@
 #include <map>
 #include <vector>
 #include <sstream>
+#include <tuple>
+#include <climits>
+#include <cmath>
 
 // External global variable for quiet mode
 extern bool g_quietMode;
 
+namespace {
+    // NuDEX nuclei are kept by NuDEXNucleusRegistry (one per ZA and library), so they are
+    // built once and shared by all the worker threads, generators and runs. The cascades
+    // are sampled by a NuDEXCascadeSampler owned by each PrimaryGeneratorAction.
+    std::string ResolveNuDEXLibDir(const std::string& libdir)
+    {
+        // Resolve library directory (handle different working directories)
+        std::vector<std::string> candidates = {
+            libdir,
+            std::string("NuDEX/NuDEXlib/"),
+            std::string("./NuDEX/NuDEXlib/"),
+            std::string("../NuDEX/NuDEXlib/"),
+            std::string("/Users/namtran/Project/DualHPGe_NuDEX/NuDEX/NuDEXlib/")
+        };
+        for (const auto& c : candidates) {
+            std::ifstream test((c + "GeneralStatNuclParameters.dat").c_str());
+            if (test.good()) { return c; }
+        }
+        return libdir;
+    }
+
+    NuDEXStatisticalNucleus* GetSharedNuDEX(int za, const std::string& libdir, int precomputeBRThreads)
+    {
+        std::string resolved = ResolveNuDEXLibDir(libdir);
+        int Z = za / 1000;
+        int A = za % 1000;
+        bool created = false;
+        // precomputeBRThreads > 0: all the branching ratios computed now (in parallel), not when needed
+        NuDEXStatisticalNucleus* nucleus =
+            NuDEXNucleusRegistry::GetNucleus(Z, A, resolved.c_str(), 0,
+                                             precomputeBRThreads, &created);
+        if (!nucleus) {
+            G4cerr << "ERROR: NuDEX initialization failed for ZA=" << za
+                   << " using libdir='" << resolved << "'" << G4endl;
+            return nullptr;
+        }
+        if (created && !g_quietMode) {
+            G4cout << "NuDEX initialized: ZA=" << za
+                   << ", libdir resolved" << G4endl;
+        }
+        return nucleus;
+    }
+
+    // Ensemble mode: the realizations of the level scheme of a nucleus, also kept by the registry
+    NuDEXNucleusEnsemble* GetSharedNuDEXEnsemble(int za, const std::string& libdir, int nRealizations,
+                                                 int nThreads, int precomputeBRThreads)
+    {
+        std::string resolved = ResolveNuDEXLibDir(libdir);
+        bool created = false;
+        NuDEXNucleusEnsemble* ensemble =
+            NuDEXNucleusRegistry::GetEnsemble(za / 1000, za % 1000, resolved.c_str(), nRealizations, 0,
+                                              nThreads, precomputeBRThreads, &created);
+        if (!ensemble) {
+            G4cerr << "ERROR: NuDEX ensemble initialization failed for ZA=" << za
+                   << " using libdir='" << resolved << "'" << G4endl;
+            return nullptr;
+        }
+        if (created && !g_quietMode) {
+            G4cout << "NuDEX ensemble initialized: ZA=" << za << ", "
+                   << nRealizations << " realizations of the level scheme" << G4endl;
+        }
+        return ensemble;
+    }
+
+    // Background cascade producers (pipelined mode), one per run and configuration (isotopes, weights,
+    // spectra and realizations), shared by all the worker threads. The cascade k of a producer is the
+    // one of the event k of its run. Each PrimaryGeneratorAction releases the producer of a run at the
+    // beginning of the next run (or when it is deleted), and it is stopped when the last one using it releases it.
+    G4Mutex producerMutex = G4MUTEX_INITIALIZER;
+    struct SharedProducer {
+        NuDEXCascadeProducer* producer;
+        int nUsers;
+    };
+    typedef std::tuple<std::vector<NuDEXStatisticalNucleus*>, std::vector<const NuDEXNeutronSpectrum*>,
+                       std::vector<double>, std::vector<int>, long long, int> ProducerKey;
+    std::map<ProducerKey, SharedProducer> sharedProducers;
+
+    NuDEXCascadeProducer* AcquireSharedProducer(const std::vector<NuDEXStatisticalNucleus*>& nuclei,
+                                                const std::vector<const NuDEXNeutronSpectrum*>& spectra,
+                                                const std::vector<double>& weights,
+                                                const std::vector<int>& realizations,
+                                                long long blockSize, int runID, int nThreads,
+                                                unsigned int seed, int queueSize)
+    {
+        G4AutoLock lock(&producerMutex);
+        ProducerKey key(nuclei, spectra, weights, realizations, blockSize, runID);
+        auto it = sharedProducers.find(key);
+        if (it == sharedProducers.end()) {
+            // Each run has its own cascades: the seed of the run 0 is the one given
+            unsigned int runSeed = seed;
+            if (runID > 0) {
+                std::ostringstream runKey;
+                runKey << "RUN " << runID << " SEED " << seed;
+                runSeed = (unsigned int)(NuDEXHash(runKey.str()) % 4294967295ULL) + 1;
+            }
+            NuDEXCascadeProducer* producer = new NuDEXCascadeProducer(nullptr, runSeed, queueSize);
+            // Start from thermal capture level with ~thermal neutron energy (negative to indicate En),
+            // or from the levels of the sampled neutron energy
+            producer->SetInitialLevel(-1, -1e-6);
+            for (size_t i = 0; i < nuclei.size(); ++i) {
+                producer->AddNucleus(nuclei[i], weights[i], spectra[i], realizations[i]);
+            }
+            producer->SetRealizationBlockSize(blockSize);
+            producer->Start(nThreads);
+            if (!g_quietMode) {
+                G4cout << "NuDEX cascade producer started: " << nThreads
+                       << " threads, queue of " << queueSize << " cascades" << G4endl;
+            }
+            it = sharedProducers.insert(std::make_pair(key, SharedProducer{producer, 0})).first;
+        }
+        it->second.nUsers++;
+        return it->second.producer;
+    }
+
+    // Queue of the producer of a run. The workers take the event IDs in blocks of eventModulo consecutive ones,
+    // so a worker can ask for any cascade of its block while an older one, of the block of another worker, is
+    // still not taken, and the producers cannot go further than the size of the queue beyond it. The queue
+    // holds twice the blocks of all the workers (the present and the next ones), and at most the whole run.
+    int GetProducerQueueSize(int minSize)
+    {
+        G4MTRunManager* masterRunManager = G4MTRunManager::GetMasterRunManager();
+        if (!masterRunManager) {
+            return minSize; // sequential mode: the events are taken in order
+        }
+        long long nEvents = std::max(masterRunManager->GetNumberOfEventsToBeProcessed(), 1);
+        long long nWorkers = std::max(masterRunManager->GetNumberOfThreads(), 1);
+        long long eventModulo = masterRunManager->GetEventModulo();
+        if (eventModulo <= 0) {
+            // Default of G4MTRunManager
+            eventModulo = std::max((long long)std::sqrt(double(nEvents / nWorkers)), 1LL);
+        }
+        long long queueSize = std::max((long long)minSize, 2 * eventModulo * nWorkers);
+        queueSize = std::min(queueSize, nEvents);
+        return (int)std::min(queueSize, (long long)INT_MAX);
+    }
+
+    void ReleaseSharedProducer(NuDEXCascadeProducer* producer)
+    {
+        G4AutoLock lock(&producerMutex);
+        for (auto it = sharedProducers.begin(); it != sharedProducers.end(); ++it) {
+            if (it->second.producer == producer) {
+                if (--it->second.nUsers == 0) {
+                    delete it->second.producer;
+                    sharedProducers.erase(it);
+                }
+                return;
+            }
+        }
+    }
+
+    // Neutron energy spectra (NUDEX_SPECTRUM mode), one per nucleus and histogram file, kept until
+    // the end of the program like the nuclei. Their starting levels and BR are found only once.
+    G4Mutex spectrumMutex = G4MUTEX_INITIALIZER;
+    std::map<std::pair<NuDEXStatisticalNucleus*, std::string>, NuDEXNeutronSpectrum*> sharedSpectra;
+
+    // The BR of the starting levels of the spectrum are computed with nThreads threads (the ones of the run)
+    const NuDEXNeutronSpectrum* GetSharedSpectrum(NuDEXStatisticalNucleus* nucleus, const std::string& fname,
+                                                  int nThreads)
+    {
+        G4AutoLock lock(&spectrumMutex);
+        std::pair<NuDEXStatisticalNucleus*, std::string> key(nucleus, fname);
+        auto it = sharedSpectra.find(key);
+        if (it == sharedSpectra.end()) {
+            NuDEXNeutronSpectrum* spectrum = new NuDEXNeutronSpectrum(nucleus);
+            if (spectrum->Init(fname.c_str(), 0.5e-6, nThreads) < 0) {
+                G4cerr << "ERROR: cannot read NuDEX neutron spectrum '" << fname << "'" << G4endl;
+                delete spectrum;
+                spectrum = nullptr;
+            } else if (!g_quietMode) {
+                spectrum->PrintStartingLevels(G4cout);
+            }
+            it = sharedSpectra.insert(std::make_pair(key, spectrum)).first;
+        }
+        return it->second;
+    }
+}
+
 //....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
 
 PrimaryGeneratorAction::PrimaryGeneratorAction(bool generateCascades,
@@ -74,6 +259,9 @@ PrimaryGeneratorAction::PrimaryGeneratorAction(bool generateCascades,
 
 PrimaryGeneratorAction::~PrimaryGeneratorAction()
 {
+    ResetNuDEXGenerator();
+    delete fNuDEXCascade;
+    delete fNuDEXLibrary;
     delete fParticleGun;
 }
 
@@ -84,6 +272,8 @@ void PrimaryGeneratorAction::SetSourceMode(SourceMode mode)
     if (fSourceMode == mode) return;
 
     fSourceMode = mode;
+    // Thermal and spectrum captures use different samplers / producers
+    ResetNuDEXGenerator();
 
     if (!g_quietMode) {
         G4cout << "PrimaryGeneratorAction: Switching source mode to "
@@ -101,6 +291,10 @@ const char* PrimaryGeneratorAction::SourceModeToString(SourceMode mode) const
             return "single gamma";
         case NUDEX_CAPTURE:
             return "NuDEX thermal capture";
+        case NUDEX_LIBRARY:
+            return "NuDEX cascade library";
+        case NUDEX_SPECTRUM:
+            return "NuDEX capture (neutron spectrum)";
         default:
             break;
     }
@@ -119,8 +313,12 @@ void PrimaryGeneratorAction::GeneratePrimaries(G4Event* anEvent)
             GenerateSingleGammaEvent(anEvent);
             break;
         case NUDEX_CAPTURE:
+        case NUDEX_SPECTRUM:
             GenerateNuDEXCascade(anEvent);
             break;
+        case NUDEX_LIBRARY:
+            GenerateNuDEXLibraryCascade(anEvent);
+            break;
         default:
             break;
     }
@@ -173,77 +371,336 @@ void PrimaryGeneratorAction::GenerateCo60Cascade(G4Event* anEvent)
 
 // CASCADE mode removed
 
+void PrimaryGeneratorAction::SetNuDEXConfig(int za, const std::string& libdir)
+{
+    // A new nucleus is taken from the registry at the next event if the configuration changes
+    if (za != fNuDEX_ZA || libdir != fNuDEXLibDir) {
+        ResetNuDEXGenerator();
+    }
+    fNuDEX_ZA = za;
+    fNuDEXLibDir = libdir;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void PrimaryGeneratorAction::SetNuDEXMixture(const std::vector<int>& za,
+                                             const std::vector<double>& weights)
+{
+    if (za != fNuDEXMixZA || weights != fNuDEXMixWeights) {
+        ResetNuDEXGenerator();
+    }
+    fNuDEXMixZA = za;
+    fNuDEXMixWeights = weights;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void PrimaryGeneratorAction::SetNuDEXSpectrum(const std::string& fname)
+{
+    if (fname != fNuDEXSpectrumFile) {
+        ResetNuDEXGenerator();
+    }
+    fNuDEXSpectrumFile = fname;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void PrimaryGeneratorAction::SetNuDEXEnsemble(int nRealizations, long long blockSize)
+{
+    if (nRealizations < 1) { nRealizations = 1; }
+    if (blockSize < 1) { blockSize = 1; }
+    // The block size is also used by the producer, so it is created again if it changes
+    if (nRealizations != fNuDEXEnsembleSize || blockSize != fNuDEXEnsembleBlock) {
+        ResetNuDEXGenerator();
+    }
+    fNuDEXEnsembleSize = nRealizations;
+    fNuDEXEnsembleBlock = blockSize;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void PrimaryGeneratorAction::SetNuDEXInitThreads(int nThreads, int precomputeBRThreads)
+{
+    // Only used when the nuclei are initialized (they are shared, so a change does not reset them)
+    fNuDEXInitThreads = std::max(nThreads, 1);
+    fNuDEXPrecomputeBRThreads = std::min(std::max(precomputeBRThreads, 0), fNuDEXInitThreads);
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void PrimaryGeneratorAction::SetNuDEXProducers(int nThreads, unsigned int seed)
+{
+    if (nThreads != fNuDEXProducerThreads || seed != fNuDEXProducerSeed) {
+        ResetNuDEXGenerator();
+    }
+    fNuDEXProducerThreads = nThreads;
+    fNuDEXProducerSeed = seed;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void PrimaryGeneratorAction::ResetNuDEXGenerator()
+{
+    // The samplers or producers are created again at the next event
+    for (auto& iso : fNuDEXIsotopes) {
+        delete iso.sampler;
+    }
+    fNuDEXIsotopes.clear();
+    if (fNuDEXProducer) {
+        ReleaseSharedProducer(fNuDEXProducer);
+        fNuDEXProducer = nullptr;
+    }
+    if (fNuDEXIsotopeAlias) {
+        DeleteAliasTable(fNuDEXIsotopeAlias);
+        fNuDEXIsotopeAlias = nullptr;
+    }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+bool PrimaryGeneratorAction::InitNuDEXIsotopes()
+{
+    // All the nuclei are initialized (or taken from the registry) now, not when they are first sampled
+    std::vector<int> za = fNuDEXMixZA;
+    std::vector<double> weights = fNuDEXMixWeights;
+    if (za.empty()) {
+        za.push_back(fNuDEX_ZA);
+        weights.push_back(1.0);
+    }
+    if (fNuDEXLibDir.empty() || weights.size() != za.size()) {
+        G4cerr << "ERROR: NuDEX configuration missing (ZA/libdir)." << G4endl;
+        return false;
+    }
+    std::vector<double> cumulWeights(za.size());
+    for (size_t i = 0; i < za.size(); ++i) {
+        if (za[i] <= 0 || weights[i] < 0) {
+            G4cerr << "ERROR: wrong NuDEX isotope ZA=" << za[i] << ", weight=" << weights[i] << G4endl;
+            return false;
+        }
+        cumulWeights[i] = weights[i] + (i > 0 ? cumulWeights[i - 1] : 0);
+    }
+    if (cumulWeights.back() <= 0) {
+        G4cerr << "ERROR: the NuDEX isotope weights sum to zero." << G4endl;
+        return false;
+    }
+
+    for (size_t i = 0; i < za.size(); ++i) {
+        // Level scheme realizations of this isotope (only one if not in ensemble mode)
+        std::vector<NuDEXStatisticalNucleus*> nuclei;
+        if (fNuDEXEnsembleSize > 1) {
+            NuDEXNucleusEnsemble* ensemble = GetSharedNuDEXEnsemble(za[i], fNuDEXLibDir, fNuDEXEnsembleSize,
+                                                                    fNuDEXInitThreads, fNuDEXPrecomputeBRThreads);
+            for (int r = 0; ensemble && r < ensemble->GetNRealizations(); ++r) {
+                nuclei.push_back(ensemble->GetRealization(r));
+            }
+        } else {
+            nuclei.push_back(GetSharedNuDEX(za[i], fNuDEXLibDir, fNuDEXPrecomputeBRThreads));
+        }
+        if (nuclei.empty() || !nuclei[0]) {
+            ResetNuDEXGenerator();
+            return false;
+        }
+        for (size_t r = 0; r < nuclei.size(); ++r) {
+            NuDEXStatisticalNucleus* nucleus = nuclei[r];
+            NuDEXIsotope iso;
+            iso.za = za[i];
+            iso.weight = weights[i];
+            iso.realization = (int)r;
+            iso.nucleus = nucleus;
+            if (fSourceMode == NUDEX_SPECTRUM) {
+                iso.spectrum = GetSharedSpectrum(nucleus, fNuDEXSpectrumFile, fNuDEXInitThreads);
+                if (!iso.spectrum) {
+                    ResetNuDEXGenerator();
+                    return false;
+                }
+            }
+            if (fNuDEXProducerThreads == 0) {
+                // The seed is set again at each event (see GenerateNuDEXCascade)
+                iso.sampler = new NuDEXCascadeSampler(nucleus, 1);
+            }
+            fNuDEXIsotopes.push_back(iso);
+        }
+    }
+    if (za.size() > 1) {
+        fNuDEXIsotopeAlias = CreateAliasTable(cumulWeights.data(), (int)cumulWeights.size());
+    }
+    return true;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void PrimaryGeneratorAction::PrintNuDEXProducerStatistics()
+{
+    G4AutoLock lock(&producerMutex);
+    for (auto it = sharedProducers.begin(); it != sharedProducers.end(); ++it) {
+        it->second.producer->PrintStatistics(G4cout);
+    }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void PrimaryGeneratorAction::BeginOfRun()
+{
+    // The producer of this run is taken at its first event (the samplers are kept between runs)
+    if (fNuDEXProducer) {
+        ReleaseSharedProducer(fNuDEXProducer);
+        fNuDEXProducer = nullptr;
+    }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
 void PrimaryGeneratorAction::GenerateNuDEXCascade(G4Event* anEvent)
 {
-    // Lazy init NuDEX if needed
-    if (!fNuDEX) {
-        if (fNuDEX_ZA <= 0 || fNuDEXLibDir.empty()) {
-            G4cerr << "ERROR: NuDEX configuration missing (ZA/libdir)." << G4endl;
+    // Lazy init NuDEX if needed: shared nuclei, one sampler per thread and isotope (or shared producers)
+    if (fNuDEXIsotopes.empty() && !InitNuDEXIsotopes()) {
+        return;
+    }
+
+    // Realization of the level scheme, from the event ID (same as NuDEXNucleusEnsemble::GetRealizationOfEvent)
+    fNuDEXRealization = 0;
+    if (fNuDEXEnsembleSize > 1) {
+        fNuDEXRealization = (int)((anEvent->GetEventID() / fNuDEXEnsembleBlock) % fNuDEXEnsembleSize);
+    }
+
+    // Pipelined mode: the cascade of the event k (and its isotope) is the cascade k of the producer of the
+    // run, generated with its own seed by the producer threads, whatever the worker processing the event
+    if (fNuDEXProducerThreads > 0) {
+        if (!fNuDEXProducer) {
+            G4int runID = G4RunManager::GetRunManager()->GetCurrentRun()->GetRunID();
+            std::vector<NuDEXStatisticalNucleus*> nuclei;
+            std::vector<const NuDEXNeutronSpectrum*> spectra;
+            std::vector<double> weights;
+            std::vector<int> realizations;
+            for (const auto& channel : fNuDEXIsotopes) {
+                nuclei.push_back(channel.nucleus);
+                spectra.push_back(channel.spectrum);
+                weights.push_back(channel.weight);
+                realizations.push_back(channel.realization);
+            }
+            fNuDEXProducer = AcquireSharedProducer(nuclei, spectra, weights, realizations, fNuDEXEnsembleBlock,
+                                                   runID, fNuDEXProducerThreads, fNuDEXProducerSeed,
+                                                   GetProducerQueueSize(kNuDEXQueueSize));
+        }
+        // The buffer of the cascade is swapped with the one of the producer, nothing is copied
+        if (!fNuDEXProducer->GetCascade(anEvent->GetEventID(), fNuDEXCascade)) {
             return;
         }
-        int Z = fNuDEX_ZA / 1000;
-        int A = fNuDEX_ZA % 1000;
-        fNuDEX = new NuDEXStatisticalNucleus(Z, A);
-        // Resolve library directory (handle different working directories)
-        std::vector<std::string> candidates = {
-            fNuDEXLibDir,
-            std::string("NuDEX/NuDEXlib/"),
-            std::string("./NuDEX/NuDEXlib/"),
-            std::string("../NuDEX/NuDEXlib/"),
-            std::string("/Users/namtran/Project/DualHPGe_NuDEX/NuDEX/NuDEXlib/")
-        };
-        std::string resolved;
-        for (const auto& c : candidates) {
-            std::ifstream test((c + "GeneralStatNuclParameters.dat").c_str());
-            if (test.good()) { resolved = c; break; }
+    } else {
+        // Isotope captured in this event (no random number used if there is only one)
+        int iIsotope = fNuDEXIsotopeAlias ? SampleFromAliasTable(fNuDEXIsotopeAlias, G4UniformRand()) : 0;
+        NuDEXIsotope& iso = fNuDEXIsotopes[iIsotope * (fNuDEXEnsembleSize > 1 ? fNuDEXEnsembleSize : 1) + fNuDEXRealization];
+
+        // The sampler is reseeded from the Geant4 engine at each event. The MT run manager reseeds the engine
+        // of every event from the seeds of the master, so the cascade only depends on the event, and not on
+        // the thread processing it or on the events processed before by this thread
+        unsigned int seed = (unsigned int)(G4UniformRand()*4294967294.) + 1;
+        iso.sampler->SetSeed(seed);
+
+        // Start from thermal capture level with ~thermal neutron energy (negative to indicate En),
+        // or from the levels of the sampled neutron energy
+        int initialLevel = -1;
+        double excitationEnergy = -1e-6;
+        if (iso.spectrum) {
+            G4double r1 = G4UniformRand(), r2 = G4UniformRand(), r3 = G4UniformRand();
+            iso.spectrum->Sample(r1, r2, r3, initialLevel, excitationEnergy);
         }
-        if (resolved.empty()) { resolved = fNuDEXLibDir; }
-        // Initialize from resolved library directory
-        if (fNuDEX->Init(resolved.c_str()) < 0) {
-            G4cerr << "ERROR: NuDEX initialization failed for ZA=" << fNuDEX_ZA
-                   << " using libdir='" << resolved << "'" << G4endl;
-            delete fNuDEX;
-            fNuDEX = nullptr;
+        // The buffer is reused event after event, without memory allocations. On failure the cascade
+        // is stored without particles, and nothing is generated for this event
+        if (!fNuDEXCascade) {
+            fNuDEXCascade = new NuDEXCascadeBuffer(1, 100);
+        }
+        iso.sampler->GenerateCascades(1, initialLevel, excitationEnergy, fNuDEXCascade);
+    }
+
+    // The particles are read directly from the buffer
+    G4ThreeVector sourcePos = SampleSourcePosition();
+    const char* types = fNuDEXCascade->GetTypes(0);
+    const double* energies = fNuDEXCascade->GetEnergies(0);
+    const double* times = fNuDEXCascade->GetTimes(0);
+    for (int i = 0; i < fNuDEXCascade->GetNParticles(0); ++i) {
+        AddNuDEXParticle(anEvent, types[i], energies[i], times[i], sourcePos);
+    }
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void PrimaryGeneratorAction::SetNuDEXLibrary(const std::string& fname, bool sequential)
+{
+    // The file is (re)mapped at the next event if it changes
+    if (fNuDEXLibrary && fname != fNuDEXLibraryFile) {
+        delete fNuDEXLibrary;
+        fNuDEXLibrary = nullptr;
+    }
+    fNuDEXLibraryFile = fname;
+    fNuDEXLibrarySequential = sequential;
+}
+
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void PrimaryGeneratorAction::GenerateNuDEXLibraryCascade(G4Event* anEvent)
+{
+    // Lazy open of the library: read-only memory map, no NuDEX initialization
+    if (!fNuDEXLibrary) {
+        if (fNuDEXLibraryFile.empty()) {
+            G4cerr << "ERROR: NuDEX cascade library file not set." << G4endl;
+            return;
+        }
+        fNuDEXLibrary = new NuDEXCascadeLibrary();
+        if (fNuDEXLibrary->Open(fNuDEXLibraryFile.c_str()) < 0) {
+            G4cerr << "ERROR: cannot read NuDEX cascade library '" << fNuDEXLibraryFile << "'" << G4endl;
+            delete fNuDEXLibrary;
+            fNuDEXLibrary = nullptr;
             return;
         }
         if (!g_quietMode) {
-            G4cout << "NuDEX initialized: ZA=" << fNuDEX_ZA
-                   << ", libdir resolved" << G4endl;
+            G4cout << "NuDEX cascade library: " << fNuDEXLibrary->GetNCascades()
+                   << " cascades (Z=" << fNuDEXLibrary->GetHeader()->Z
+                   << ", A=" << fNuDEXLibrary->GetHeader()->A << ") from "
+                   << fNuDEXLibraryFile << G4endl;
         }
+        // Sequential access: each thread starts at a different (random) cascade and then wraps around
+        long long n = fNuDEXLibrary->GetNCascades();
+        fNuDEXLibraryNext = std::min((long long)(G4UniformRand()*n), n - 1);
     }
 
-    std::vector<char> types;
-    std::vector<double> energies;
-    std::vector<double> times;
-
-    // Start from thermal capture level with ~thermal neutron energy (negative to indicate En)
-    int npar = fNuDEX->GenerateCascade(-1, -1e-6, types, energies, times);
-    if (npar <= 0) {
-        // On failure, do nothing for this event
-        return;
+    long long n = fNuDEXLibrary->GetNCascades();
+    long long iCascade;
+    if (fNuDEXLibrarySequential) {
+        iCascade = fNuDEXLibraryNext;
+        fNuDEXLibraryNext = (fNuDEXLibraryNext + 1) % n;
+    } else {
+        iCascade = std::min((long long)(G4UniformRand()*n), n - 1);
     }
 
+    int npar = fNuDEXLibrary->GetNParticles(iCascade);
+    const NuDEXCascadeLibraryParticle* particles = fNuDEXLibrary->GetParticles(iCascade);
     G4ThreeVector sourcePos = SampleSourcePosition();
     for (int i = 0; i < npar; ++i) {
-        char t = types[i];
-        double E = energies[i];    // MeV
-        double T = times[i];       // seconds
-
-        if (t == 'g') {
-            fParticleGun->SetParticleDefinition(G4ParticleTable::GetParticleTable()->FindParticle("gamma"));
-        } else if (t == 'e') {
-            fParticleGun->SetParticleDefinition(G4ParticleTable::GetParticleTable()->FindParticle("e-"));
-        } else {
-            // Skip unknown particle types
-            continue;
-        }
+        AddNuDEXParticle(anEvent, particles[i].Type, particles[i].Energy, particles[i].Time, sourcePos);
+    }
+}
 
-        fParticleGun->SetParticleEnergy(E * MeV);
-        fParticleGun->SetParticlePosition(sourcePos);
-        fParticleGun->SetParticleMomentumDirection(SampleDirection());
-        fParticleGun->SetParticleTime(T * s);
-        fParticleGun->GeneratePrimaryVertex(anEvent);
+//....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
+
+void PrimaryGeneratorAction::AddNuDEXParticle(G4Event* anEvent, char type, double energy,
+                                              double time, const G4ThreeVector& position)
+{
+    // energy in MeV, time in seconds (NuDEX units)
+    if (type == 'g') {
+        fParticleGun->SetParticleDefinition(G4ParticleTable::GetParticleTable()->FindParticle("gamma"));
+    } else if (type == 'e') {
+        fParticleGun->SetParticleDefinition(G4ParticleTable::GetParticleTable()->FindParticle("e-"));
+    } else {
+        // Skip unknown particle types
+        return;
     }
+
+    fParticleGun->SetParticleEnergy(energy * MeV);
+    fParticleGun->SetParticlePosition(position);
+    fParticleGun->SetParticleMomentumDirection(SampleDirection());
+    fParticleGun->SetParticleTime(time * s);
+    fParticleGun->GeneratePrimaryVertex(anEvent);
 }
 
 //....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
@@ -14,14 +14,19 @@
 #include "G4UnitsTable.hh"
 #include "G4SystemOfUnits.hh"
 
+// External global variable for quiet mode
+extern bool g_quietMode;
+
 //....oooOO0OOooo........oooOO0OOooo........oooOO0OOooo........oooOO0OOooo......
 
-RunAction::RunAction()
+RunAction::RunAction(G4int nudexRealizations, PrimaryGeneratorAction* primaryGenerator)
 : G4UserRunAction(),
   fEnergyDepositDet1("EnergyDepositDet1", 0.),
   fEnergyDepositDet2("EnergyDepositDet2", 0.),
   fEventCountDet1("EventCountDet1", 0),
-  fEventCountDet2("EventCountDet2", 0)
+  fEventCountDet2("EventCountDet2", 0),
+  fNuDEXRealizations(nudexRealizations),
+  fPrimaryGenerator(primaryGenerator)
 {
     // Register accumulables to the accumulable manager
     G4AccumulableManager* accumulableManager = G4AccumulableManager::Instance();
@@ -42,6 +47,10 @@ RunAction::RunAction()
     analysisManager->CreateNtuple("Tree", "All detector events from dual HPGe detectors");
     analysisManager->CreateNtupleDColumn("e1");  // Detector 1 energy (keV)
     analysisManager->CreateNtupleDColumn("e2");  // Detector 2 energy (keV)
+    if (fNuDEXRealizations > 1) {
+        // NuDEX level scheme realization (ensemble mode), to split the spectra per realization
+        analysisManager->CreateNtupleIColumn("realization");
+    }
     analysisManager->FinishNtuple();
 }
 
@@ -73,6 +82,11 @@ void RunAction::BeginOfRunAction(const G4Run*)
     auto analysisManager = G4AnalysisManager::Instance();
     analysisManager->OpenFile("output.root");
 
+    // NuDEX cascade producer of the previous run (pipelined mode) no longer used by this thread
+    if (fPrimaryGenerator) {
+        fPrimaryGenerator->BeginOfRun();
+    }
+
     G4cout << "\n-------- Starting Run (Dual Detector System) --------" << G4endl;
 }
 
@@ -171,6 +185,11 @@ void RunAction::EndOfRunAction(const G4Run* run)
          << "------------------------------------"
          << G4endl
          << G4endl;
+
+        // Queue depth and stalls of the pipelined NuDEX mode (if used)
+        if (!g_quietMode) {
+            PrimaryGeneratorAction::PrintNuDEXProducerStatistics();
+        }
     }
     
     // Write and close ROOT file